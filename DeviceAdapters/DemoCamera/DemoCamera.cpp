@@ -1090,38 +1090,51 @@ int CDemoCamera::StartSequenceAcquisition(long numImages, double interval_ms, bo
 int CDemoCamera::InsertImage()
 {
    MM::MMTime timeStamp = this->GetCurrentMMTime();
-   char label[MM::MaxStrLength];
-   this->GetLabel(label);
- 
-   // Important:  metadata about the image are generated here:
-   Metadata md;
-   md.put("Camera", label);
-   md.put(MM::g_Keyword_Elapsed_Time_ms, CDeviceUtils::ConvertToString((timeStamp - sequenceStartTime_).getMsec()));
-   md.put(MM::g_Keyword_Metadata_ROI_X, CDeviceUtils::ConvertToString( (long) roiX_)); 
-   md.put(MM::g_Keyword_Metadata_ROI_Y, CDeviceUtils::ConvertToString( (long) roiY_)); 
 
    imageCounter_++;
 
    char buf[MM::MaxStrLength];
    GetProperty(MM::g_Keyword_Binning, buf);
-   md.put(MM::g_Keyword_Binning, buf);
+
+   // Important:  metadata about the image are generated here. They are passed
+   // to the Core in binary form, and the Core adds the camera label.
+   const MM::ImageTag tags[] = {
+      MM::ImageTag::Float(MM::ImageTagElapsedTimeMs, (timeStamp - sequenceStartTime_).getMsec()),
+      MM::ImageTag::Integer(MM::ImageTagROIX, roiX_),
+      MM::ImageTag::Integer(MM::ImageTagROIY, roiY_),
+      MM::ImageTag::String(MM::ImageTagBinning, buf),
+   };
+   const unsigned tagCount = sizeof(tags) / sizeof(tags[0]);
 
    MMThreadGuard g(imgPixelsLock_);
 
-   const unsigned char* pI;
-   pI = GetImageBuffer();
+   if (GeneratesIntoImageSlot())
+   {
+      // The image is generated straight into the Core's sequence buffer slot
+      // by FillImageSlot(), and any image processing happens on the slot at
+      // commit time.
+      int ret = InsertImageInSlot(tags, tagCount);
+      if (!stopOnOverflow_ && ret == DEVICE_BUFFER_OVERFLOW)
+      {
+         // do not stop on overflow - just reset the buffer
+         GetCoreCallback()->ClearImageBuffer(this);
+         return InsertImageInSlot(tags, tagCount);
+      }
+      return ret;
+   }
 
+   const unsigned char* pI = GetImageBuffer();
    unsigned int w = GetImageWidth();
    unsigned int h = GetImageHeight();
    unsigned int b = GetImageBytesPerPixel();
 
-   int ret = GetCoreCallback()->InsertImage(this, pI, w, h, b, nComponents_, md.Serialize().c_str());
+   int ret = GetCoreCallback()->InsertImage(this, pI, w, h, b, nComponents_, tags, tagCount);
    if (!stopOnOverflow_ && ret == DEVICE_BUFFER_OVERFLOW)
    {
       // do not stop on overflow - just reset the buffer
       GetCoreCallback()->ClearImageBuffer(this);
       // don't process this same image again...
-      return GetCoreCallback()->InsertImage(this, pI, w, h, b, nComponents_, md.Serialize().c_str(), false);
+      return GetCoreCallback()->InsertImage(this, pI, w, h, b, nComponents_, tags, tagCount, false);
    }
    else
    {
@@ -1129,6 +1142,28 @@ int CDemoCamera::InsertImage()
    }
 }
 
+/*
+ * Generates the next sequence image into a Core sequence buffer slot
+ */
+int CDemoCamera::FillImageSlot(unsigned char* slot)
+{
+   MMThreadGuard g(imgPixelsLock_);
+   GenerateSyntheticImage(slot, img_.Width(), img_.Height(), img_.Depth(),
+         GetSequenceExposure());
+   return DEVICE_OK;
+}
+
+/*
+ * Whether sequence images are generated straight into the sequence buffer.
+ * Otherwise they are copied from img_: the fast image mode sends the same
+ * image every time, and image manipulators (such as DemoGalvo) work on
+ * img_.
+ */
+bool CDemoCamera::GeneratesIntoImageSlot() const
+{
+   return !fastImage_ && imgManpl_ == 0;
+}
+
 /*
  * Do actual capturing
  * Called from inside the thread  
@@ -1149,7 +1184,7 @@ int CDemoCamera::RunSequenceOnThread()
 
    double exposure = GetSequenceExposure();
 
-   if (!fastImage_)
+   if (!fastImage_ && !GeneratesIntoImageSlot())
    {
       GenerateSyntheticImage(img_, exposure);
    }
@@ -2061,9 +2096,24 @@ void CDemoCamera::GenerateEmptyImage(ImgBuffer& img)
 */
 void CDemoCamera::GenerateSyntheticImage(ImgBuffer& img, double exp)
 {
-  
    MMThreadGuard g(imgPixelsLock_);
+   GenerateSyntheticImage(img.GetPixelsRW(), img.Width(), img.Height(),
+         img.Depth(), exp);
+   if (mode_ == MODE_NOISE && imgManpl_ != 0)
+   {
+      imgManpl_->ChangePixels(img);
+   }
+}
+
 
+/**
+* Generates an image into a pixel buffer of the given geometry, such as a
+* sequence buffer slot. The image manipulator (see
+* RegisterImgManipulatorCallBack()) is not applied.
+*/
+void CDemoCamera::GenerateSyntheticImage(unsigned char* pixels,
+      unsigned imgWidth, unsigned imgHeight, unsigned imgDepth, double exp)
+{
    if (mode_ == MODE_NOISE)
    {
       double max = 1 << GetBitDepth();
@@ -2073,17 +2123,13 @@ void CDemoCamera::GenerateSyntheticImage(ImgBuffer& img, double exp)
          offset = 100;
       }
 	   double readNoiseDN = readNoise_ / pcf_;
-      AddBackgroundAndNoise(img, offset, readNoiseDN);
-      AddSignal (img, photonFlux_, exp, pcf_);
-      if (imgManpl_ != 0)
-      {
-         imgManpl_->ChangePixels(img);
-      }
+      AddBackgroundAndNoise(pixels, imgWidth * imgHeight, offset, readNoiseDN);
+      AddSignal (pixels, imgWidth * imgHeight, photonFlux_, exp, pcf_);
       return;
    }
    else if (mode_ == MODE_COLOR_TEST)
    {
-      if (GenerateColorTestPattern(img))
+      if (GenerateColorTestPattern(pixels, imgWidth, imgHeight, imgDepth))
          return;
    }
 
@@ -2092,17 +2138,16 @@ void CDemoCamera::GenerateSyntheticImage(ImgBuffer& img, double exp)
    GetProperty(MM::g_Keyword_PixelType, buf);
    std::string pixelType(buf);
 
-	if (img.Height() == 0 || img.Width() == 0 || img.Depth() == 0)
+	if (imgHeight == 0 || imgWidth == 0 || imgDepth == 0)
       return;
 
    double lSinePeriod = 3.14159265358979 * stripeWidth_;
-   unsigned imgWidth = img.Width();
-   unsigned int* rawBuf = (unsigned int*) img.GetPixelsRW();
+   unsigned int* rawBuf = (unsigned int*) pixels;
    double maxDrawnVal = 0;
    long lPeriod = (long) imgWidth / 2;
    double dLinePhase = 0.0;
    const double dAmp = exp;
-   double cLinePhaseInc = 2.0 * lSinePeriod / 4.0 / img.Height();
+   double cLinePhaseInc = 2.0 * lSinePeriod / 4.0 / imgHeight;
    if (shouldRotateImages_) {
       // Adjust the angle of the sin wave pattern based on how many images
       // we've taken, to increase the period (i.e. time between repeat images).
@@ -2124,17 +2169,17 @@ void CDemoCamera::GenerateSyntheticImage(ImgBuffer& img, double exp)
 
 	long pixelsToDrop = 0;
 	if( dropPixels_)
-		pixelsToDrop = (long)(0.5 + fractionOfPixelsToDropOrSaturate_*img.Height()*imgWidth);
+		pixelsToDrop = (long)(0.5 + fractionOfPixelsToDropOrSaturate_*imgHeight*imgWidth);
 	long pixelsToSaturate = 0;
 	if( saturatePixels_)
-		pixelsToSaturate = (long)(0.5 + fractionOfPixelsToDropOrSaturate_*img.Height()*imgWidth);
+		pixelsToSaturate = (long)(0.5 + fractionOfPixelsToDropOrSaturate_*imgHeight*imgWidth);
 
    unsigned j, k;
    if (pixelType.compare(g_PixelType_8bit) == 0)
    {
       double pedestal = 127 * exp / 100.0 * GetBinning() * GetBinning();
-      unsigned char* pBuf = const_cast<unsigned char*>(img.GetPixels());
-      for (j=0; j<img.Height(); j++)
+      unsigned char* pBuf = pixels;
+      for (j=0; j<imgHeight; j++)
       {
          for (k=0; k<imgWidth; k++)
          {
@@ -2149,14 +2194,14 @@ void CDemoCamera::GenerateSyntheticImage(ImgBuffer& img, double exp)
       }
 	   for(int snoise = 0; snoise < pixelsToSaturate; ++snoise)
 		{
-			j = (unsigned)( (double)(img.Height()-1)*(double)rand()/(double)RAND_MAX);
+			j = (unsigned)( (double)(imgHeight-1)*(double)rand()/(double)RAND_MAX);
 			k = (unsigned)( (double)(imgWidth-1)*(double)rand()/(double)RAND_MAX);
 			*(pBuf + imgWidth*j + k) = (unsigned char)maxValue;
 		}
 		int pnoise;
 		for(pnoise = 0; pnoise < pixelsToDrop; ++pnoise)
 		{
-			j = (unsigned)( (double)(img.Height()-1)*(double)rand()/(double)RAND_MAX);
+			j = (unsigned)( (double)(imgHeight-1)*(double)rand()/(double)RAND_MAX);
 			k = (unsigned)( (double)(imgWidth-1)*(double)rand()/(double)RAND_MAX);
 			*(pBuf + imgWidth*j + k) = 0;
 		}
@@ -2166,8 +2211,8 @@ void CDemoCamera::GenerateSyntheticImage(ImgBuffer& img, double exp)
    {
       double pedestal = maxValue/2 * exp / 100.0 * GetBinning() * GetBinning();
       double dAmp16 = dAmp * maxValue/255.0; // scale to behave like 8-bit
-      unsigned short* pBuf = (unsigned short*) const_cast<unsigned char*>(img.GetPixels());
-      for (j=0; j<img.Height(); j++)
+      unsigned short* pBuf = (unsigned short*) pixels;
+      for (j=0; j<imgHeight; j++)
       {
          for (k=0; k<imgWidth; k++)
          {
@@ -2182,14 +2227,14 @@ void CDemoCamera::GenerateSyntheticImage(ImgBuffer& img, double exp)
       }         
 	   for(int snoise = 0; snoise < pixelsToSaturate; ++snoise)
 		{
-			j = (unsigned)(0.5 + (double)img.Height()*(double)rand()/(double)RAND_MAX);
+			j = (unsigned)(0.5 + (double)imgHeight*(double)rand()/(double)RAND_MAX);
 			k = (unsigned)(0.5 + (double)imgWidth*(double)rand()/(double)RAND_MAX);
 			*(pBuf + imgWidth*j + k) = (unsigned short)maxValue;
 		}
 		int pnoise;
 		for(pnoise = 0; pnoise < pixelsToDrop; ++pnoise)
 		{
-			j = (unsigned)(0.5 + (double)img.Height()*(double)rand()/(double)RAND_MAX);
+			j = (unsigned)(0.5 + (double)imgHeight*(double)rand()/(double)RAND_MAX);
 			k = (unsigned)(0.5 + (double)imgWidth*(double)rand()/(double)RAND_MAX);
 			*(pBuf + imgWidth*j + k) = 0;
 		}
@@ -2198,11 +2243,11 @@ void CDemoCamera::GenerateSyntheticImage(ImgBuffer& img, double exp)
    else if (pixelType.compare(g_PixelType_32bit) == 0)
    {
       double pedestal = 127 * exp / 100.0 * GetBinning() * GetBinning();
-      float* pBuf = (float*) const_cast<unsigned char*>(img.GetPixels());
+      float* pBuf = (float*) pixels;
       float saturatedValue = 255.;
-      memset(pBuf, 0, img.Height()*imgWidth*4);
+      memset(pBuf, 0, imgHeight*imgWidth*4);
       // static unsigned int j2;
-      for (j=0; j<img.Height(); j++)
+      for (j=0; j<imgHeight; j++)
       {
          for (k=0; k<imgWidth; k++)
          {
@@ -2225,14 +2270,14 @@ void CDemoCamera::GenerateSyntheticImage(ImgBuffer& img, double exp)
 
 	   for(int snoise = 0; snoise < pixelsToSaturate; ++snoise)
 		{
-			j = (unsigned)(0.5 + (double)img.Height()*(double)rand()/(double)RAND_MAX);
+			j = (unsigned)(0.5 + (double)imgHeight*(double)rand()/(double)RAND_MAX);
 			k = (unsigned)(0.5 + (double)imgWidth*(double)rand()/(double)RAND_MAX);
 			*(pBuf + imgWidth*j + k) = saturatedValue;
 		}
 		int pnoise;
 		for(pnoise = 0; pnoise < pixelsToDrop; ++pnoise)
 		{
-			j = (unsigned)(0.5 + (double)img.Height()*(double)rand()/(double)RAND_MAX);
+			j = (unsigned)(0.5 + (double)imgHeight*(double)rand()/(double)RAND_MAX);
 			k = (unsigned)(0.5 + (double)imgWidth*(double)rand()/(double)RAND_MAX);
 			*(pBuf + imgWidth*j + k) = 0;
       }
@@ -2247,7 +2292,7 @@ void CDemoCamera::GenerateSyntheticImage(ImgBuffer& img, double exp)
 
       if(debugRGB)
       {
-         const unsigned long bfsize = img.Height() * imgWidth * 3;
+         const unsigned long bfsize = imgHeight * imgWidth * 3;
          if(  bfsize != dbgBufferSize)
          {
             if (NULL != pDebug)
@@ -2267,9 +2312,9 @@ void CDemoCamera::GenerateSyntheticImage(ImgBuffer& img, double exp)
       pTmpBuffer = pDebug;
       unsigned char* pTmp2 = pTmpBuffer;
       if( NULL!= pTmpBuffer)
-			memset( pTmpBuffer, 0, img.Height() * imgWidth * 3);
+			memset( pTmpBuffer, 0, imgHeight * imgWidth * 3);
 
-      for (j=0; j<img.Height(); j++)
+      for (j=0; j<imgHeight; j++)
       {
          unsigned char theBytes[4];
          for (k=0; k<imgWidth; k++)
@@ -2310,7 +2355,7 @@ void CDemoCamera::GenerateSyntheticImage(ImgBuffer& img, double exp)
          // write the compact debug image...
          char ctmp[12];
          snprintf(ctmp,12,"%ld",iseq++);
-         writeCompactTiffRGB(imgWidth, img.Height(), pTmpBuffer, ("democamera" + std::string(ctmp)).c_str());
+         writeCompactTiffRGB(imgWidth, imgHeight, pTmpBuffer, ("democamera" + std::string(ctmp)).c_str());
       }
 
 	}
@@ -2323,7 +2368,7 @@ void CDemoCamera::GenerateSyntheticImage(ImgBuffer& img, double exp)
       
 		double maxPixelValue = (1<<(bitDepth_))-1;
       unsigned long long * pBuf = (unsigned long long*) rawBuf;
-      for (j=0; j<img.Height(); j++)
+      for (j=0; j<imgHeight; j++)
       {
          for (k=0; k<imgWidth; k++)
          {
@@ -2413,7 +2458,7 @@ void CDemoCamera::GenerateSyntheticImage(ImgBuffer& img, double exp)
       // this function.
       for (unsigned int i = 0; i < imgWidth; ++i)
       {
-         for (unsigned j = 0; j < img.Height(); ++j)
+         for (unsigned j = 0; j < imgHeight; ++j)
          {
             bool shouldKeep = false;
             for (unsigned int k = 0; k < multiROIXs_.size(); ++k)
@@ -2455,15 +2500,15 @@ void CDemoCamera::GenerateSyntheticImage(ImgBuffer& img, double exp)
 }
 
 
-bool CDemoCamera::GenerateColorTestPattern(ImgBuffer& img)
+bool CDemoCamera::GenerateColorTestPattern(unsigned char* pixels,
+      unsigned width, unsigned height, unsigned depth)
 {
-   unsigned width = img.Width(), height = img.Height();
-   switch (img.Depth())
+   switch (depth)
    {
       case 1:
       {
          const unsigned char maxVal = 255;
-         unsigned char* rawBytes = img.GetPixelsRW();
+         unsigned char* rawBytes = pixels;
          for (unsigned y = 0; y < height; ++y)
          {
             for (unsigned x = 0; x < width; ++x)
@@ -2483,7 +2528,7 @@ bool CDemoCamera::GenerateColorTestPattern(ImgBuffer& img)
       {
          const unsigned short maxVal = 65535;
          unsigned short* rawShorts =
-            reinterpret_cast<unsigned short*>(img.GetPixelsRW());
+            reinterpret_cast<unsigned short*>(pixels);
          for (unsigned y = 0; y < height; ++y)
          {
             for (unsigned x = 0; x < width; ++x)
@@ -2502,7 +2547,7 @@ bool CDemoCamera::GenerateColorTestPattern(ImgBuffer& img)
       case 4:
       {
          const unsigned long maxVal = 255;
-         unsigned* rawPixels = reinterpret_cast<unsigned*>(img.GetPixelsRW());
+         unsigned* rawPixels = reinterpret_cast<unsigned*>(pixels);
          for (unsigned section = 0; section < 8; ++section)
          {
             unsigned ystart = section * (height / 8);
@@ -2543,16 +2588,21 @@ void CDemoCamera::TestResourceLocking(const bool recurse)
 * Generate an image with offset plus noise
 */
 void CDemoCamera::AddBackgroundAndNoise(ImgBuffer& img, double mean, double stdDev)
+{
+   AddBackgroundAndNoise(img.GetPixelsRW(), img.Width() * img.Height(), mean, stdDev);
+}
+
+void CDemoCamera::AddBackgroundAndNoise(unsigned char* pixels, long nrPixels,
+      double mean, double stdDev)
 { 
 	char buf[MM::MaxStrLength];
    GetProperty(MM::g_Keyword_PixelType, buf);
 	std::string pixelType(buf);
 
    int maxValue = 1 << GetBitDepth();
-   long nrPixels = img.Width() * img.Height();
    if (pixelType.compare(g_PixelType_8bit) == 0)
    {
-      unsigned char* pBuf = (unsigned char*) const_cast<unsigned char*>(img.GetPixels());
+      unsigned char* pBuf = (unsigned char*) pixels;
       for (long i = 0; i < nrPixels; i++) 
       {
          double value = GaussDistributedValue(mean, stdDev);
@@ -2569,7 +2619,7 @@ void CDemoCamera::AddBackgroundAndNoise(ImgBuffer& img, double mean, double stdD
    }
    else if (pixelType.compare(g_PixelType_16bit) == 0)
    {
-      unsigned short* pBuf = (unsigned short*) const_cast<unsigned char*>(img.GetPixels());
+      unsigned short* pBuf = (unsigned short*) pixels;
       for (long i = 0; i < nrPixels; i++) 
       {
          double value = GaussDistributedValue(mean, stdDev);
@@ -2595,20 +2645,25 @@ void CDemoCamera::AddBackgroundAndNoise(ImgBuffer& img, double mean, double stdD
 * Assumes QE of 100%
 */
 void CDemoCamera::AddSignal(ImgBuffer& img, double photonFlux, double exp, double cf)
+{
+   AddSignal(img.GetPixelsRW(), img.Width() * img.Height(), photonFlux, exp, cf);
+}
+
+void CDemoCamera::AddSignal(unsigned char* pixels, long nrPixels,
+      double photonFlux, double exp, double cf)
 { 
 	char buf[MM::MaxStrLength];
    GetProperty(MM::g_Keyword_PixelType, buf);
 	std::string pixelType(buf);
 
    int maxValue = (1 << GetBitDepth()) -1;
-   long nrPixels = img.Width() * img.Height();
    double photons = photonFlux * exp;
    double shotNoise = sqrt(photons);
    double digitalValue = photons / cf;
    double shotNoiseDigital = shotNoise / cf;
    if (pixelType.compare(g_PixelType_8bit) == 0)
    {
-      unsigned char* pBuf = (unsigned char*) const_cast<unsigned char*>(img.GetPixels());
+      unsigned char* pBuf = (unsigned char*) pixels;
       for (long i = 0; i < nrPixels; i++) 
       {
          double value = *(pBuf + i) + GaussDistributedValue(digitalValue, shotNoiseDigital);
@@ -2625,7 +2680,7 @@ void CDemoCamera::AddSignal(ImgBuffer& img, double photonFlux, double exp, doubl
    }
    else if (pixelType.compare(g_PixelType_16bit) == 0)
    {
-      unsigned short* pBuf = (unsigned short*) const_cast<unsigned char*>(img.GetPixels());
+      unsigned short* pBuf = (unsigned short*) pixels;
       for (long i = 0; i < nrPixels; i++) 
       {
          double value = *(pBuf + i) + GaussDistributedValue(digitalValue, shotNoiseDigital);
@@ -3657,6 +3712,8 @@ int CDemoXYStage::Initialize()
 
 int CDemoXYStage::Shutdown()
 {
+   if (moveFinished_.valid())
+      moveFinished_.wait();
    if (initialized_)
    {
       initialized_ = false;
@@ -3682,6 +3739,8 @@ int CDemoXYStage::SetPositionSteps(long x, long y)
    {
       if (!timeOutTimer_->expired(GetCurrentMMTime()))
          return ERR_STAGE_MOVING;
+      if (moveFinished_.valid())
+         moveFinished_.wait();
       delete (timeOutTimer_);
    }
    double newPosX = x * stepSize_um_;
@@ -3691,6 +3750,8 @@ int CDemoXYStage::SetPositionSteps(long x, long y)
    double distance = sqrt( (difX * difX) + (difY * difY) );
    long timeOut = (long) (distance / velocity_);
    timeOutTimer_ = new MM::TimeoutMs(GetCurrentMMTime(),  timeOut);
+   moveFinished_ = std::async(std::launch::async,
+         &CDemoXYStage::ReportMoveFinished, this, timeOut);
    posX_um_ = x * stepSize_um_;
    posY_um_ = y * stepSize_um_;
    int ret = OnXYStagePositionChanged(posX_um_, posY_um_);
@@ -3707,6 +3768,17 @@ int CDemoXYStage::GetPositionSteps(long& x, long& y)
    return DEVICE_OK;
 }
 
+// Tells the core as soon as the simulated move is over, as a stage reporting
+// its arrival would, so that waiting for the stage does not take until the
+// next poll
+void CDemoXYStage::ReportMoveFinished(long moveMs)
+{
+   CDeviceUtils::SleepMs(moveMs);
+   while (Busy())
+      CDeviceUtils::SleepMs(1);
+   OnDeviceIdle();
+}
+
 int CDemoXYStage::SetRelativePositionSteps(long x, long y)
 {
    long xSteps, ySteps;
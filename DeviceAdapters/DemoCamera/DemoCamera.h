@@ -154,6 +154,7 @@ public:
    int StartSequenceAcquisition(long numImages, double interval_ms, bool stopOnOverflow);
    int StopSequenceAcquisition();
    int InsertImage();
+   int FillImageSlot(unsigned char* slot);
    int RunSequenceOnThread();
    bool IsCapturing();
    void OnThreadExiting() throw(); 
@@ -221,8 +222,16 @@ private:
    void TestResourceLocking(const bool);
    void GenerateEmptyImage(ImgBuffer& img);
    void GenerateSyntheticImage(ImgBuffer& img, double exp);
-   bool GenerateColorTestPattern(ImgBuffer& img);
+   void GenerateSyntheticImage(unsigned char* pixels, unsigned imgWidth,
+         unsigned imgHeight, unsigned imgDepth, double exp);
+   bool GenerateColorTestPattern(unsigned char* pixels, unsigned width,
+         unsigned height, unsigned depth);
+   void AddBackgroundAndNoise(unsigned char* pixels, long nrPixels,
+         double mean, double stdDev);
+   void AddSignal(unsigned char* pixels, long nrPixels, double photonFlux,
+         double exp, double cf);
    int ResizeImageBuffer();
+   bool GeneratesIntoImageSlot() const;
 
    static const double nominalPixelSizeUm_;
 
@@ -585,6 +594,8 @@ public:
    int OnPosition(MM::PropertyBase* pProp, MM::ActionType eAct);
 
 private:
+   void ReportMoveFinished(long moveMs);
+
    double stepSize_um_;
    double posX_um_;
    double posY_um_;
@@ -594,6 +605,7 @@ private:
    bool initialized_;
    double lowerLimit_;
    double upperLimit_;
+   std::future<void> moveFinished_; // Runs ReportMoveFinished()
 };
 
 //////////////////////////////////////////////////////////////////////////////
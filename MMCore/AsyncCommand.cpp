@@ -0,0 +1,87 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          AsyncCommand.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Completion state of asynchronous device commands
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "AsyncCommand.h"
+
+namespace mm
+{
+
+AsyncCommand::AsyncCommand(int parts) :
+   pendingParts_(parts),
+   failed_(false),
+   errorCode_(0)
+{
+}
+
+void AsyncCommand::PartDone()
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   FinishPart();
+}
+
+void AsyncCommand::PartFailed(const std::string& message, int code)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   if (!failed_)
+   {
+      failed_ = true;
+      errorMessage_ = message;
+      errorCode_ = code;
+   }
+   FinishPart();
+}
+
+bool AsyncCommand::IsDone()
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return pendingParts_ == 0;
+}
+
+/**
+ * Blocks until all parts are done.
+ */
+void AsyncCommand::Wait()
+{
+   std::unique_lock<std::mutex> lock(mutex_);
+   cv_.wait(lock, [this] { return pendingParts_ == 0; });
+}
+
+/**
+ * Returns true, with the first part's error, if any part failed.
+ */
+bool AsyncCommand::GetError(std::string& message, int& code)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   if (failed_)
+   {
+      message = errorMessage_;
+      code = errorCode_;
+   }
+   return failed_;
+}
+
+// Must be called with mutex_ held
+void AsyncCommand::FinishPart()
+{
+   if (--pendingParts_ == 0)
+      cv_.notify_all();
+}
+
+} // namespace mm
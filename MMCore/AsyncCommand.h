@@ -0,0 +1,62 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          AsyncCommand.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Completion state of asynchronous device commands
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+namespace mm
+{
+
+/**
+ * Completion state of an asynchronous device command, which may consist of
+ * several parts running on different adapter module workers (see
+ * DeviceCommandQueue). The command is done when all parts are, and has
+ * failed if any part did; the first failure is kept.
+ */
+class AsyncCommand
+{
+   std::mutex mutex_;
+   std::condition_variable cv_;
+   int pendingParts_; // Guarded by mutex_
+   bool failed_; // Guarded by mutex_
+   std::string errorMessage_; // Guarded by mutex_
+   int errorCode_; // Guarded by mutex_
+
+public:
+   explicit AsyncCommand(int parts);
+
+   AsyncCommand(const AsyncCommand&) = delete;
+   AsyncCommand& operator=(const AsyncCommand&) = delete;
+
+   void PartDone();
+   void PartFailed(const std::string& message, int code);
+
+   bool IsDone();
+   void Wait();
+   bool GetError(std::string& message, int& code);
+
+private:
+   void FinishPart();
+};
+
+} // namespace mm
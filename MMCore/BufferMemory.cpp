@@ -0,0 +1,377 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          BufferMemory.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Memory block backing the circular buffer
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "BufferMemory.h"
+
+#include <algorithm>
+#include <new>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/syscall.h>
+#endif
+
+namespace mm
+{
+
+namespace
+{
+
+// Pages are touched by several threads when there are this many bytes or more
+const size_t parallelPrefaultBytes = 256 << 20;
+
+size_t PageSize()
+{
+#ifdef _WIN32
+   SYSTEM_INFO info;
+   GetSystemInfo(&info);
+   return info.dwPageSize;
+#else
+   long size = sysconf(_SC_PAGESIZE);
+   return size > 0 ? (size_t)size : 4096;
+#endif
+}
+
+size_t RoundUp(size_t bytes, size_t multiple)
+{
+   return (bytes + multiple - 1) / multiple * multiple;
+}
+
+#ifdef __linux__
+size_t ExplicitHugePageSize()
+{
+   size_t size = 2 << 20;
+   FILE* meminfo = fopen("/proc/meminfo", "r");
+   if (!meminfo)
+      return size;
+   char line[256];
+   while (fgets(line, sizeof(line), meminfo))
+   {
+      unsigned long kB;
+      if (sscanf(line, "Hugepagesize: %lu kB", &kB) == 1)
+      {
+         size = (size_t)kB << 10;
+         break;
+      }
+   }
+   fclose(meminfo);
+   return size;
+}
+#endif
+
+#ifdef _WIN32
+// Large pages require the "Lock pages in memory" right, which is disabled in
+// the process token by default
+bool EnableLockMemoryPrivilege()
+{
+   HANDLE token;
+   if (!OpenProcessToken(GetCurrentProcess(),
+            TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+      return false;
+   TOKEN_PRIVILEGES privileges;
+   privileges.PrivilegeCount = 1;
+   privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+   bool ok = LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME,
+         &privileges.Privileges[0].Luid) &&
+      AdjustTokenPrivileges(token, FALSE, &privileges, 0, NULL, NULL) &&
+      GetLastError() == ERROR_SUCCESS;
+   CloseHandle(token);
+   return ok;
+}
+#endif
+
+} // anonymous namespace
+
+/**
+ * Allocate the memory, applying the options that the system supports.
+ * Throws std::bad_alloc if the memory cannot be allocated.
+ */
+BufferMemory::BufferMemory(size_t bytes, const BufferMemoryOptions& options) :
+   base_(0),
+   bytes_(bytes),
+   mappedBytes_(0),
+   requested_(options),
+   hugePages_(HugePagesNone),
+   locked_(false),
+   numaNode_(-1),
+   prefaulted_(false)
+{
+   if (bytes_ == 0)
+      return;
+
+   Allocate();
+#ifndef _WIN32 // Windows allocates on the node directly
+   if (requested_.numaNode >= 0)
+      BindToNumaNode(requested_.numaNode);
+#endif
+
+   if (requested_.lock)
+   {
+#ifdef _WIN32
+      // Large pages are never paged out. Otherwise, the working set must be
+      // able to hold the locked pages.
+      if (hugePages_ == HugePagesExplicit)
+         locked_ = true;
+      else
+      {
+         SIZE_T minSize, maxSize;
+         HANDLE process = GetCurrentProcess();
+         if (GetProcessWorkingSetSize(process, &minSize, &maxSize))
+            SetProcessWorkingSetSize(process, minSize + mappedBytes_,
+                  maxSize + mappedBytes_);
+         locked_ = VirtualLock(base_, mappedBytes_) != 0;
+      }
+#else
+      locked_ = mlock(base_, mappedBytes_) == 0;
+#endif
+   }
+
+   if (requested_.prefault)
+      Prefault();
+}
+
+BufferMemory::~BufferMemory()
+{
+   Release();
+}
+
+void BufferMemory::Allocate()
+{
+#ifdef _WIN32
+   const DWORD node = requested_.numaNode >= 0 ?
+      (DWORD)requested_.numaNode : NUMA_NO_PREFERRED_NODE;
+   if (requested_.hugePages != HugePagesNone)
+   {
+      const SIZE_T largePageSize = GetLargePageMinimum();
+      if (largePageSize > 0 && EnableLockMemoryPrivilege())
+      {
+         mappedBytes_ = RoundUp(bytes_, largePageSize);
+         base_ = static_cast<unsigned char*>(VirtualAllocExNuma(
+                  GetCurrentProcess(), NULL, mappedBytes_,
+                  MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE,
+                  node));
+         if (base_)
+            hugePages_ = HugePagesExplicit;
+      }
+   }
+   if (!base_)
+   {
+      mappedBytes_ = RoundUp(bytes_, PageSize());
+      base_ = static_cast<unsigned char*>(VirtualAllocExNuma(
+               GetCurrentProcess(), NULL, mappedBytes_,
+               MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, node));
+      if (!base_)
+         throw std::bad_alloc();
+   }
+   if (requested_.numaNode >= 0)
+      numaNode_ = requested_.numaNode;
+#else
+#ifdef MAP_HUGETLB
+   if (requested_.hugePages == HugePagesExplicit)
+   {
+      mappedBytes_ = RoundUp(bytes_, ExplicitHugePageSize());
+      void* p = mmap(0, mappedBytes_, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (p != MAP_FAILED)
+      {
+         base_ = static_cast<unsigned char*>(p);
+         hugePages_ = HugePagesExplicit;
+      }
+   }
+#endif
+   if (!base_)
+   {
+      mappedBytes_ = RoundUp(bytes_, PageSize());
+      void* p = mmap(0, mappedBytes_, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (p == MAP_FAILED)
+         throw std::bad_alloc();
+      base_ = static_cast<unsigned char*>(p);
+
+      // Without a reserved pool, fall back to transparent huge pages
+#ifdef MADV_HUGEPAGE
+      if (requested_.hugePages != HugePagesNone &&
+            madvise(base_, mappedBytes_, MADV_HUGEPAGE) == 0)
+         hugePages_ = HugePagesTransparent;
+#endif
+   }
+#endif
+}
+
+// Must be called before any page is touched
+void BufferMemory::BindToNumaNode(int node)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+   const int mpolBind = 2; // MPOL_BIND, from <numaif.h>
+   const size_t bitsPerWord = 8 * sizeof(unsigned long);
+   unsigned long mask[1024 / bitsPerWord] = { 0 };
+   if (node >= 1024)
+      return;
+   mask[node / bitsPerWord] = 1UL << (node % bitsPerWord);
+   // The kernel reads one bit less than maxnode
+   if (syscall(SYS_mbind, base_, mappedBytes_, mpolBind, mask,
+            8 * sizeof(mask) + 1, 0) == 0)
+      numaNode_ = node;
+#else
+   (void)node;
+#endif
+}
+
+void BufferMemory::Prefault()
+{
+   const size_t pageSize = PageSize();
+   unsigned char* const base = base_;
+   const size_t pageCount = mappedBytes_ / pageSize;
+   auto touch = [base, pageSize](size_t first, size_t last) {
+      for (size_t i = first; i < last; ++i)
+         static_cast<volatile unsigned char*>(base)[i * pageSize] = 0;
+   };
+
+   size_t threadCount = 1;
+   if (mappedBytes_ >= parallelPrefaultBytes)
+      threadCount = std::max(1u, std::min(8u, std::thread::hardware_concurrency()));
+   std::vector<std::thread> threads;
+   for (size_t t = 1; t < threadCount; ++t)
+   {
+      threads.emplace_back(touch, pageCount * t / threadCount,
+            pageCount * (t + 1) / threadCount);
+   }
+   touch(0, pageCount / threadCount);
+   for (size_t t = 0; t < threads.size(); ++t)
+      threads[t].join();
+   prefaulted_ = true;
+}
+
+void BufferMemory::Release()
+{
+   if (!base_)
+      return;
+#ifdef _WIN32
+   VirtualFree(base_, 0, MEM_RELEASE);
+#else
+   munmap(base_, mappedBytes_);
+#endif
+   base_ = 0;
+}
+
+/**
+ * Describe the memory actually obtained, noting requested options that could
+ * not be applied.
+ */
+std::string BufferMemory::Describe() const
+{
+   std::ostringstream desc;
+   if (bytes_ >= (1 << 20))
+      desc << (bytes_ >> 20) << " MB";
+   else
+      desc << bytes_ << " bytes";
+
+   switch (hugePages_)
+   {
+      case HugePagesExplicit:
+         desc << ", explicit huge pages";
+         break;
+      case HugePagesTransparent:
+         desc << ", transparent huge pages";
+         if (requested_.hugePages == HugePagesExplicit)
+            desc << " (explicit huge pages unavailable)";
+         break;
+      default:
+         desc << ", standard pages";
+         if (requested_.hugePages != HugePagesNone)
+            desc << " (huge pages unavailable)";
+         break;
+   }
+
+   if (locked_)
+      desc << ", locked";
+   else if (requested_.lock)
+      desc << ", not locked (lock failed)";
+
+   if (numaNode_ >= 0)
+      desc << ", NUMA node " << numaNode_;
+   else if (requested_.numaNode >= 0)
+      desc << ", not bound to NUMA node " << requested_.numaNode;
+
+   if (prefaulted_)
+      desc << ", prefaulted";
+   return desc.str();
+}
+
+/**
+ * Returns the amount of physical memory, or 0 if it cannot be determined.
+ */
+unsigned long long BufferMemory::GetPhysicalMemoryBytes()
+{
+#ifdef _WIN32
+   MEMORYSTATUSEX status;
+   status.dwLength = sizeof(status);
+   if (!GlobalMemoryStatusEx(&status))
+      return 0;
+   return status.ullTotalPhys;
+#else
+   long pages = sysconf(_SC_PHYS_PAGES);
+   long pageSize = sysconf(_SC_PAGESIZE);
+   if (pages <= 0 || pageSize <= 0)
+      return 0;
+   return (unsigned long long)pages * pageSize;
+#endif
+}
+
+/**
+ * Returns the number of NUMA nodes (1 on systems without NUMA).
+ */
+int BufferMemory::GetNumaNodeCount()
+{
+   int count = 0;
+#if defined(_WIN32)
+   ULONG highest;
+   if (GetNumaHighestNodeNumber(&highest))
+      count = (int)highest + 1;
+#elif defined(__linux__)
+   DIR* dir = opendir("/sys/devices/system/node");
+   if (dir)
+   {
+      while (struct dirent* entry = readdir(dir))
+      {
+         int node;
+         char rest;
+         if (sscanf(entry->d_name, "node%d%c", &node, &rest) == 1)
+            count = std::max(count, node + 1);
+      }
+      closedir(dir);
+   }
+#endif
+   return std::max(count, 1);
+}
+
+} // namespace mm
@@ -0,0 +1,106 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          BufferMemory.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Memory block backing the circular buffer
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace mm
+{
+
+enum HugePageMode
+{
+   HugePagesNone,
+   HugePagesTransparent, // Ask the kernel to back the memory with huge pages
+   HugePagesExplicit, // Allocate from the reserved huge page pool
+};
+
+struct BufferMemoryOptions
+{
+   HugePageMode hugePages;
+   bool lock; // Keep the memory from being paged out
+   int numaNode; // -1 for no preference
+   bool prefault; // Touch every page when allocating
+
+   BufferMemoryOptions() :
+      hugePages(HugePagesNone),
+      lock(false),
+      numaNode(-1),
+      prefault(false)
+   {}
+
+   bool operator==(const BufferMemoryOptions& other) const
+   {
+      return hugePages == other.hugePages && lock == other.lock &&
+         numaNode == other.numaNode && prefault == other.prefault;
+   }
+   bool operator!=(const BufferMemoryOptions& other) const
+   { return !(*this == other); }
+};
+
+/**
+ * A single contiguous block of memory backing a circular buffer.
+ *
+ * The requested options are applied as far as the platform and the process's
+ * privileges allow; an option that cannot be applied is skipped, and the
+ * description records what was actually obtained. Only failing to allocate
+ * the memory at all is an error (std::bad_alloc).
+ */
+class BufferMemory
+{
+   unsigned char* base_;
+   size_t bytes_;
+   size_t mappedBytes_;
+   BufferMemoryOptions requested_;
+
+   HugePageMode hugePages_;
+   bool locked_;
+   int numaNode_;
+   bool prefaulted_;
+
+public:
+   BufferMemory(size_t bytes, const BufferMemoryOptions& options);
+   ~BufferMemory();
+
+   BufferMemory(const BufferMemory&) = delete;
+   BufferMemory& operator=(const BufferMemory&) = delete;
+
+   unsigned char* Get() const { return base_; }
+   size_t Size() const { return bytes_; }
+   const BufferMemoryOptions& GetRequestedOptions() const { return requested_; }
+
+   HugePageMode GetHugePages() const { return hugePages_; }
+   bool IsLocked() const { return locked_; }
+   int GetNumaNode() const { return numaNode_; }
+   bool IsPrefaulted() const { return prefaulted_; }
+   std::string Describe() const;
+
+   static unsigned long long GetPhysicalMemoryBytes();
+   static int GetNumaNodeCount();
+
+private:
+   void Allocate();
+   void BindToNumaNode(int node);
+   void Prefault();
+   void Release();
+};
+
+} // namespace mm
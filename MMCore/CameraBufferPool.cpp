@@ -0,0 +1,282 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          CameraBufferPool.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Per-camera circular buffers
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "CameraBufferPool.h"
+
+#include "CircularBuffer.h"
+
+namespace mm
+{
+
+namespace
+{
+
+unsigned long long FrameBytes(unsigned channels, unsigned width,
+      unsigned height, unsigned pixDepth)
+{
+   return (unsigned long long)width * height * pixDepth * channels;
+}
+
+} // anonymous namespace
+
+CameraBufferPool::CameraBufferPool(unsigned memorySizeMB) :
+   memorySizeBytes_((unsigned long long)memorySizeMB << 20),
+   lockFree_(false),
+   variableSizeFrames_(false),
+   bufferCount_(0)
+{
+}
+
+CameraBufferPool::~CameraBufferPool()
+{
+}
+
+/**
+ * Change the total memory footprint. Buffers that are already allocated
+ * keep their size until they are next initialized.
+ */
+void CameraBufferPool::SetMemorySizeMB(unsigned memorySizeMB)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   memorySizeBytes_ = (unsigned long long)memorySizeMB << 20;
+}
+
+void CameraBufferPool::EnableLockFree(bool enable)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   lockFree_ = enable;
+   for (std::map<std::string, Entry>::iterator it = entries_.begin(),
+         end = entries_.end(); it != end; ++it)
+   {
+      if (it->second.buffer_)
+         it->second.buffer_->EnableLockFree(enable);
+   }
+}
+
+/**
+ * Applies to each buffer from its next initialization.
+ */
+void CameraBufferPool::EnableVariableSizeFrames(bool enable)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   variableSizeFrames_ = enable;
+   for (std::map<std::string, Entry>::iterator it = entries_.begin(),
+         end = entries_.end(); it != end; ++it)
+   {
+      if (it->second.buffer_)
+         it->second.buffer_->EnableVariableSizeFrames(enable);
+   }
+}
+
+/**
+ * Applies to each buffer from its next initialization.
+ */
+void CameraBufferPool::SetMemoryOptions(const BufferMemoryOptions& options)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   memoryOptions_ = options;
+   for (std::map<std::string, Entry>::iterator it = entries_.begin(),
+         end = entries_.end(); it != end; ++it)
+   {
+      if (it->second.buffer_)
+         it->second.buffer_->SetMemoryOptions(options);
+   }
+}
+
+/**
+ * Sets the thread pool that the buffers copy frames in with. Buffers created
+ * before a pool is set have their own.
+ */
+void CameraBufferPool::SetThreadPool(std::shared_ptr<ThreadPool> threadPool)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   threadPool_ = threadPool;
+   for (std::map<std::string, Entry>::iterator it = entries_.begin(),
+         end = entries_.end(); it != end; ++it)
+   {
+      if (it->second.buffer_)
+         it->second.buffer_->SetThreadPool(threadPool);
+   }
+}
+
+/**
+ * Make the camera known to the pool without allocating its buffer, so that
+ * memory is set aside for it when other cameras' buffers are initialized.
+ */
+void CameraBufferPool::RegisterDemand(const std::string& label,
+      unsigned channels, unsigned width, unsigned height, unsigned pixDepth)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   entries_[label].frameBytes_ = FrameBytes(channels, width, height, pixDepth);
+}
+
+/**
+ * Allocate (or reallocate) the camera's buffer for the given image format.
+ *
+ * Returns false if the camera's share of the memory footprint does not hold
+ * a single image, or if the buffer cannot be reallocated because it has
+ * pinned images.
+ */
+bool CameraBufferPool::Initialize(const std::string& label, unsigned channels,
+      unsigned width, unsigned height, unsigned pixDepth)
+{
+   const unsigned long long frameBytes =
+      FrameBytes(channels, width, height, pixDepth);
+   if (frameBytes == 0)
+      return false;
+
+   std::lock_guard<std::mutex> lock(mutex_);
+
+   Entry& entry = entries_[label];
+   entry.frameBytes_ = frameBytes;
+
+   // Release the idle buffers of other cameras, and add up the memory that
+   // the busy ones keep
+   unsigned long long totalDemand = frameBytes;
+   unsigned long long heldBytes = 0;
+   for (std::map<std::string, Entry>::iterator it = entries_.begin(),
+         end = entries_.end(); it != end; ++it)
+   {
+      if (&it->second == &entry)
+         continue;
+      totalDemand += it->second.frameBytes_;
+      if (!it->second.buffer_)
+         continue;
+      if (IsBusy(it->second))
+         heldBytes += it->second.buffer_->GetMemorySizeBytes();
+      else
+         ReleaseBuffer(it->second);
+   }
+
+   // Every known camera gets room for the same number of images
+   unsigned long long share = (memorySizeBytes_ / totalDemand) * frameBytes;
+   const unsigned long long available =
+      memorySizeBytes_ > heldBytes ? memorySizeBytes_ - heldBytes : 0;
+   if (share > available)
+      share = (available / frameBytes) * frameBytes;
+   if (share < frameBytes)
+      return false;
+
+   if (!entry.buffer_)
+   {
+      entry.buffer_ = std::make_shared<CircularBuffer>(0, threadPool_);
+      entry.buffer_->EnableLockFree(lockFree_);
+      entry.buffer_->EnableVariableSizeFrames(variableSizeFrames_);
+      entry.buffer_->SetMemoryOptions(memoryOptions_);
+      ++bufferCount_;
+   }
+   entry.buffer_->SetMemorySizeBytes(share);
+   if (!entry.buffer_->Initialize(channels, width, height, pixDepth))
+   {
+      if (entry.buffer_->GetPinnedImageCount() == 0)
+         ReleaseBuffer(entry);
+      return false;
+   }
+   return true;
+}
+
+/**
+ * Mark the camera's buffer as receiving images, which keeps it from being
+ * released or resized for other cameras.
+ */
+void CameraBufferPool::SetStreaming(const std::string& label, bool streaming)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   std::map<std::string, Entry>::iterator it = entries_.find(label);
+   if (it != entries_.end())
+      it->second.streaming_ = streaming;
+}
+
+/**
+ * Return the camera's buffer, or null if it does not have one.
+ */
+std::shared_ptr<CircularBuffer> CameraBufferPool::Find(
+      const std::string& label) const
+{
+   if (bufferCount_ == 0)
+      return std::shared_ptr<CircularBuffer>();
+
+   std::lock_guard<std::mutex> lock(mutex_);
+   std::map<std::string, Entry>::const_iterator it = entries_.find(label);
+   if (it == entries_.end())
+      return std::shared_ptr<CircularBuffer>();
+   return it->second.buffer_;
+}
+
+/**
+ * Return the labels of the cameras that currently have a buffer.
+ */
+std::vector<std::string> CameraBufferPool::GetCameraLabels() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   std::vector<std::string> labels;
+   for (std::map<std::string, Entry>::const_iterator it = entries_.begin(),
+         end = entries_.end(); it != end; ++it)
+   {
+      if (it->second.buffer_)
+         labels.push_back(it->first);
+   }
+   return labels;
+}
+
+unsigned long CameraBufferPool::GetPinnedImageCount() const
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   unsigned long count = 0;
+   for (std::map<std::string, Entry>::const_iterator it = entries_.begin(),
+         end = entries_.end(); it != end; ++it)
+   {
+      if (it->second.buffer_)
+         count += it->second.buffer_->GetPinnedImageCount();
+   }
+   return count;
+}
+
+/**
+ * Release all buffers and forget the known cameras. The caller must make
+ * sure that no images are pinned.
+ */
+void CameraBufferPool::Reset()
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   entries_.clear();
+   bufferCount_ = 0;
+}
+
+// Must be called with mutex_ held
+bool CameraBufferPool::IsBusy(const Entry& entry) const
+{
+   return entry.streaming_ ||
+      entry.buffer_->GetRemainingImageCount() > 0 ||
+      entry.buffer_->GetPinnedImageCount() > 0;
+}
+
+// Must be called with mutex_ held
+void CameraBufferPool::ReleaseBuffer(Entry& entry)
+{
+   if (entry.buffer_)
+   {
+      entry.buffer_.reset();
+      --bufferCount_;
+   }
+   entry.streaming_ = false;
+}
+
+} // namespace mm
@@ -0,0 +1,103 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          CameraBufferPool.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Per-camera circular buffers
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include "BufferMemory.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class CircularBuffer;
+class ThreadPool;
+
+namespace mm
+{
+
+/**
+ * Per-camera circular buffers, keyed by camera label.
+ *
+ * The memory footprint is divided among the cameras known to the pool in
+ * proportion to their frame size, so that each camera's buffer holds about
+ * the same number of images. A camera becomes known when its buffer is
+ * initialized or its demand is registered (e.g. when the camera is prepared
+ * for sequence acquisition), and stays known until the pool is reset.
+ *
+ * A buffer that is streaming, holds unread images or has pinned images is
+ * never resized or released; a camera that joins later gets at most the
+ * memory left over. Buffers that are idle are released when another camera
+ * needs their memory and reallocated the next time they are initialized.
+ */
+class CameraBufferPool
+{
+   struct Entry
+   {
+      std::shared_ptr<CircularBuffer> buffer_;
+      unsigned long long frameBytes_;
+      bool streaming_;
+
+      Entry() : frameBytes_(0), streaming_(false) {}
+   };
+
+   mutable std::mutex mutex_;
+   unsigned long long memorySizeBytes_;
+   bool lockFree_;
+   bool variableSizeFrames_;
+   BufferMemoryOptions memoryOptions_;
+   std::shared_ptr<ThreadPool> threadPool_;
+   std::map<std::string, Entry> entries_;
+
+   // Number of entries with a buffer; lets the image insertion path skip the
+   // lookup while no camera has its own buffer
+   std::atomic<size_t> bufferCount_;
+
+public:
+   explicit CameraBufferPool(unsigned memorySizeMB);
+   ~CameraBufferPool();
+
+   void SetMemorySizeMB(unsigned memorySizeMB);
+   void EnableLockFree(bool enable);
+   void EnableVariableSizeFrames(bool enable);
+   void SetMemoryOptions(const BufferMemoryOptions& options);
+   void SetThreadPool(std::shared_ptr<ThreadPool> threadPool);
+
+   void RegisterDemand(const std::string& label, unsigned channels,
+         unsigned width, unsigned height, unsigned pixDepth);
+   bool Initialize(const std::string& label, unsigned channels,
+         unsigned width, unsigned height, unsigned pixDepth);
+   void SetStreaming(const std::string& label, bool streaming);
+
+   bool HasBuffers() const { return bufferCount_ > 0; }
+   std::shared_ptr<CircularBuffer> Find(const std::string& label) const;
+   std::vector<std::string> GetCameraLabels() const;
+   unsigned long GetPinnedImageCount() const;
+
+   void Reset();
+
+private:
+   bool IsBusy(const Entry& entry) const;
+   void ReleaseBuffer(Entry& entry);
+};
+
+} // namespace mm
@@ -3,10 +3,12 @@
 // PROJECT:       Micro-Manager
 // SUBSYSTEM:     MMCore
 //-----------------------------------------------------------------------------
-// DESCRIPTION:   Generic implementation of the circular buffer. The buffer
-//                allows only one thread to enter at a time by using a mutex lock.
-//                This makes the buffer susceptible to race conditions if the
-//                calling threads are mutually dependent.
+// DESCRIPTION:   Generic implementation of the circular buffer. By default the
+//                buffer allows only one thread to enter at a time by using a
+//                mutex lock. This makes the buffer susceptible to race
+//                conditions if the calling threads are mutually dependent.
+//                In lock-free mode, readers and the producer coordinate
+//                through atomic indices and per-slot sequence numbers instead.
 //              
 // COPYRIGHT:     University of California, San Francisco, 2007,
 //
@@ -30,42 +32,221 @@
 
 #include "../MMDevice/DeviceUtils.h"
 
+#include <algorithm>
 #include <chrono>
 #include <cstdio>
 #include <ctime>
 #include <memory>
 #include <string>
+#include <thread>
 
 
 const long long bytesInMB = 1 << 20;
-const long adjustThreshold = LONG_MAX / 2;
+
+// Sequence number of a slot that the producer is currently filling
+const long long slotBeingWritten = -1;
 
 // Maximum number of images allowed in the buffer. This arbitrary limit is code
 // smell, but kept for now until careful checks for integer overflow and
 // division by zero can be added.
 const unsigned long maxCBSize = 10000000;
 
-CircularBuffer::CircularBuffer(unsigned int memorySizeMB) :
+// In variable-size mode, the number of slots allows for frames this small
+// (or as small as the nominal frame, if that is smaller)
+const unsigned long long minVariableSlotBytes = 64 * 1024;
+
+// Number of spilled images whose copies stay valid after being returned by
+// GetNextImageBuffer()
+const size_t spillReturnedFrames = 8;
+
+// Keeps Initialize() from reallocating the buffer for the duration of an
+// operation. In the default mode this simply holds g_bufferLock. In lock-free
+// mode the calling thread only registers itself, and falls back to the lock
+// while a reallocation is in progress.
+class CircularBuffer::AccessGuard
+{
+public:
+   explicit AccessGuard(const CircularBuffer& buffer) :
+      buffer_(buffer),
+      locked_(false)
+   {
+      if (buffer_.lockFree_)
+      {
+         ++buffer_.activeAccessors_;
+         if (!buffer_.reallocating_)
+            return;
+         --buffer_.activeAccessors_;
+      }
+      buffer_.g_bufferLock.Lock();
+      locked_ = true;
+   }
+
+   ~AccessGuard()
+   {
+      if (locked_)
+         buffer_.g_bufferLock.Unlock();
+      else
+         --buffer_.activeAccessors_;
+   }
+
+   AccessGuard(const AccessGuard&) = delete;
+   AccessGuard& operator=(const AccessGuard&) = delete;
+
+private:
+   const CircularBuffer& buffer_;
+   bool locked_;
+};
+
+CircularBuffer::CircularBuffer(unsigned int memorySizeMB,
+      std::shared_ptr<ThreadPool> threadPool) :
    width_(0), 
    height_(0), 
    pixDepth_(0), 
    imageCounter_(0), 
+   startTime_(0),
+   imageNumbersReset_(false),
+   lockFree_(false),
+   reallocating_(false),
+   activeAccessors_(0),
    insertIndex_(0), 
    saveIndex_(0), 
-   memorySizeMB_(memorySizeMB), 
+   memorySizeBytes_(memorySizeMB * bytesInMB), 
    overflow_(false),
-   threadPool_(std::make_shared<ThreadPool>()),
+   variableSizeFrames_(false),
+   variableFrames_(false),
+   arenaBytes_(0),
+   allocatedBytes_(0),
+   tailIndex_(0),
+   acquiredSlot_(0),
+   acquiredIndex_(0),
+   acquiredComponents_(0),
+   pins_(std::make_shared<mm::ImagePinTable>(0)),
+   spillEnabled_(false),
+   spilledFrames_(0),
+   writerAttached_(false),
+   writerIndex_(0),
+   threadPool_(threadPool ? threadPool : std::make_shared<ThreadPool>()),
    tasksMemCopy_(std::make_shared<TaskSet_CopyMemory>(threadPool_))
 {
 }
 
 CircularBuffer::~CircularBuffer() {}
 
+/**
+* Switches the thread pool used to copy frames in. Waits for any insertion in
+* progress.
+*/
+void CircularBuffer::SetThreadPool(std::shared_ptr<ThreadPool> threadPool)
+{
+   if (!threadPool)
+      return;
+   std::shared_ptr<TaskSet_CopyMemory> tasks =
+      std::make_shared<TaskSet_CopyMemory>(threadPool);
+   MMThreadGuard insertGuard(g_insertLock);
+   threadPool_ = threadPool;
+   tasksMemCopy_ = tasks;
+}
+
+/**
+* Changes the memory footprint used by the next Initialize() call that
+* reallocates the buffer. Initialize() reallocates if the capacity changes
+* as a result, even if the image dimensions stay the same.
+*/
+void CircularBuffer::SetMemorySizeBytes(unsigned long long bytes)
+{
+   memorySizeBytes_ = bytes;
+}
+
+/**
+* Changes the options for allocating the backing memory, which take effect at
+* the next Initialize() call. Initialize() then reallocates even if the image
+* dimensions stay the same.
+*/
+void CircularBuffer::SetMemoryOptions(const mm::BufferMemoryOptions& options)
+{
+   MMThreadGuard guard(g_bufferLock);
+   memoryOptions_ = options;
+}
+
+mm::BufferMemoryOptions CircularBuffer::GetMemoryOptions() const
+{
+   MMThreadGuard guard(g_bufferLock);
+   return memoryOptions_;
+}
+
+/**
+* Describes the backing memory actually obtained (see
+* mm::BufferMemory::Describe()).
+*/
+std::string CircularBuffer::GetMemoryDescription() const
+{
+   MMThreadGuard guard(g_bufferLock);
+   if (!memory_)
+      return "Not allocated";
+   return memory_->Describe();
+}
+
+/**
+* Enables spill mode: once the buffer is full, inserting an image moves the
+* oldest unread image to the given file (which is created, or truncated)
+* instead of failing, and GetNextImage() and friends return spilled images
+* first. Insertion fails as before only if the disk is full, or if the buffer
+* is full of pinned images.
+*
+* The file does not grow beyond maxBytes, unless that is 0; once it is full,
+* the buffer overflows as it would without spilling.
+*
+* The file is deleted when spill mode is disabled and all images in it have
+* been read, or when the buffer is destroyed.
+*/
+void CircularBuffer::EnableSpill(const std::string& path,
+      unsigned long long maxBytes) throw (CMMError)
+{
+   AccessGuard guard(*this);
+   std::lock_guard<std::mutex> lock(spillMutex_);
+   if (!spill_ || spill_->GetPath() != path)
+   {
+      if (spill_ && spill_->GetFrameCount() > 0)
+         throw CMMError("Cannot change the spill file while it holds unread images");
+      spill_.reset();
+      spill_.reset(new mm::SpillFile(path));
+   }
+   spill_->SetMaxBytes(maxBytes);
+   spillEnabled_ = true;
+}
+
+/**
+* Disables spill mode. Images already spilled remain available to be read.
+*/
+void CircularBuffer::DisableSpill()
+{
+   AccessGuard guard(*this);
+   std::lock_guard<std::mutex> lock(spillMutex_);
+   spillEnabled_ = false;
+   if (spill_ && spill_->GetFrameCount() == 0)
+      spill_.reset();
+}
+
 bool CircularBuffer::Initialize(unsigned channels, unsigned int w, unsigned int h, unsigned int pixDepth)
 {
    MMThreadGuard guard(g_bufferLock);
-   imageNumbers_.clear();
-   startTime_ = std::chrono::steady_clock::now();
+
+   // Lock-free accessors do not take g_bufferLock: send new ones to the lock
+   // and wait for those already inside to leave
+   reallocating_ = true;
+   while (activeAccessors_ > 0)
+      std::this_thread::yield();
+
+   bool ret = Reallocate(channels, w, h, pixDepth);
+   reallocating_ = false;
+   return ret;
+}
+
+// Must be called with g_bufferLock held and no lock-free accessors active
+bool CircularBuffer::Reallocate(unsigned channels, unsigned int w, unsigned int h, unsigned int pixDepth)
+{
+   imageNumbersReset_ = true;
+   ResetStartTime();
 
    bool ret = true;
    try
@@ -73,10 +254,42 @@ bool CircularBuffer::Initialize(unsigned channels, unsigned int w, unsigned int
       if (w == 0 || h==0 || pixDepth == 0 || channels == 0)
          return false; // does not make sense
 
-      if (w == width_ && height_ == h && pixDepth_ == pixDepth && channels == numChannels_)
-         if (frameArray_.size() > 0)
+      // calculate the size of the entire buffer array once all images get allocated
+      // the actual size at the time of the creation is going to be less, because
+      // images are not allocated until pixels become available
+      unsigned long frameSizeBytes = w * h * pixDepth * channels;
+      const bool variable = variableSizeFrames_;
+      unsigned long cbSize = (unsigned long) (memorySizeBytes_ / (variable ?
+            std::min<unsigned long long>(frameSizeBytes, minVariableSlotBytes) :
+            frameSizeBytes));
+
+      // set a reasonable limit to circular buffer capacity 
+      if (cbSize > maxCBSize)
+         cbSize = maxCBSize; 
+
+      if (variable)
+      {
+         // Frames of any size go into the existing arena, so a new image
+         // size only changes the nominal size used for capacity reporting
+         if (variableFrames_ && memory_ && memory_->GetRequestedOptions() == memoryOptions_ &&
+               arenaBytes_ == memorySizeBytes_ && frameArray_.size() == cbSize)
+         {
+            width_ = w;
+            height_ = h;
+            pixDepth_ = pixDepth;
+            numChannels_ = channels;
+            return true;
+         }
+      }
+      else if (!variableFrames_ && w == width_ && height_ == h && pixDepth_ == pixDepth && channels == numChannels_)
+         if (frameArray_.size() > 0 && frameArray_.size() == cbSize &&
+               memory_ && memory_->GetRequestedOptions() == memoryOptions_)
             return true; // nothing to change
 
+      // Pinned images must stay valid until their handles are released
+      if (pins_->GetPinnedCount() > 0)
+         return false;
+
       width_ = w;
       height_ = h;
       pixDepth_ = pixDepth;
@@ -84,13 +297,24 @@ bool CircularBuffer::Initialize(unsigned channels, unsigned int w, unsigned int
 
       insertIndex_ = 0;
       saveIndex_ = 0;
+      writerIndex_ = 0;
       overflow_ = false;
+      {
+         std::lock_guard<std::mutex> lock(spillMutex_);
+         DropSpilledFrames();
+      }
 
-      // calculate the size of the entire buffer array once all images get allocated
-      // the actual size at the time of the creation is going to be less, because
-      // images are not allocated until pixels become available
-      unsigned long frameSizeBytes = width_ * height_ * pixDepth_ * numChannels_;
-      unsigned long cbSize = (unsigned long) ((memorySizeMB_ * bytesInMB) / frameSizeBytes);
+      for (unsigned long i=0; i<frameArray_.size(); i++)
+         frameArray_[i].Clear();
+
+      // Release the old memory before allocating the new
+      memory_.reset();
+      variableFrames_ = variable;
+      arenaBytes_ = 0;
+      allocatedBytes_ = 0;
+      slotStart_.reset();
+      slotOwner_.clear();
+      tailIndex_ = 0;
 
       if (cbSize == 0) 
       {
@@ -98,27 +322,48 @@ bool CircularBuffer::Initialize(unsigned channels, unsigned int w, unsigned int
          return false; // memory footprint too small
       }
 
-      // set a reasonable limit to circular buffer capacity 
-      if (cbSize > maxCBSize)
-         cbSize = maxCBSize; 
-
-      // TODO: verify if we have enough RAM to satisfy this request
-
-      for (unsigned long i=0; i<frameArray_.size(); i++)
-         frameArray_[i].Clear();
+      // All slots share one block of memory: in fixed-size mode each slot
+      // owns its own part; in variable-size mode the whole block is the arena
+      const unsigned long long memoryBytes = variable ?
+         (unsigned long long)memorySizeBytes_ : (unsigned long long)cbSize * frameSizeBytes;
+      const unsigned long long physicalBytes = mm::BufferMemory::GetPhysicalMemoryBytes();
+      if (physicalBytes > 0 && memoryBytes > physicalBytes)
+      {
+         frameArray_.resize(0);
+         return false; // would never fit in RAM
+      }
 
       // allocate buffers  - could conceivably throw an out-of-memory exception
+      memory_.reset(new mm::BufferMemory((size_t)memoryBytes, memoryOptions_));
       frameArray_.resize(cbSize);
-      for (unsigned long i=0; i<frameArray_.size(); i++)
+      if (variable)
       {
-         frameArray_[i].Resize(w, h, pixDepth);
-         frameArray_[i].Preallocate(numChannels_);
+         // Images are attached to the arena as frames are inserted
+         arenaBytes_ = memoryBytes;
+         slotStart_.reset(new std::atomic<unsigned long long>[cbSize]);
+         for (unsigned long i=0; i<cbSize; i++)
+            slotStart_[i] = 0;
+         slotOwner_.assign(cbSize, -1);
       }
+      else
+      {
+         for (unsigned long i=0; i<frameArray_.size(); i++)
+         {
+            frameArray_[i].Attach(memory_->Get() + i * frameSizeBytes,
+                  numChannels_, w, h, pixDepth);
+         }
+      }
+      slotSequence_.reset(new std::atomic<long long>[cbSize]);
+      for (unsigned long i=0; i<cbSize; i++)
+         slotSequence_[i] = 0;
+      pins_ = std::make_shared<mm::ImagePinTable>(cbSize);
    }
 
    catch( ... /* std::bad_alloc& ex */)
    {
       frameArray_.resize(0);
+      memory_.reset();
+      arenaBytes_ = 0;
       ret = false;
    }
    return ret;
@@ -126,34 +371,117 @@ bool CircularBuffer::Initialize(unsigned channels, unsigned int w, unsigned int
 
 void CircularBuffer::Clear() 
 {
-   MMThreadGuard guard(g_bufferLock); 
-   insertIndex_=0; 
-   saveIndex_=0; 
+   AccessGuard guard(*this);
+
+   // The indices only ever move forward, so that a reader acting on a stale
+   // index fails its compare-and-swap instead of consuming a newer image.
+   // Restart at the first slot that is not pinned, so that insertion does not
+   // immediately back off.
+   const long long size = (long long)frameArray_.size();
+   long long insert = insertIndex_;
+   long long start;
+   do
+   {
+      start = insert;
+      for (long long i = 0; i < size && pins_->IsPinned(start % size); ++i)
+         ++start;
+   } while (!insertIndex_.compare_exchange_weak(insert, start));
+   saveIndex_ = start;
+   writerIndex_ = start;
+   {
+      std::lock_guard<std::mutex> lock(spillMutex_);
+      DropSpilledFrames();
+   }
+
    overflow_ = false;
-   startTime_ = std::chrono::steady_clock::now();
-   imageNumbers_.clear();
+   ResetStartTime();
+   imageNumbersReset_ = true;
 }
 
+/**
+* Returns the number of images the buffer can hold. In variable-size mode,
+* this is the number of images of the size the buffer was last initialized
+* with.
+*/
 unsigned long CircularBuffer::GetSize() const
 {
-   MMThreadGuard guard(g_bufferLock);
+   AccessGuard guard(*this);
+   if (variableFrames_)
+      return (unsigned long)std::min<unsigned long long>(frameArray_.size(),
+            arenaBytes_ / FrameSizeBytes());
    return (unsigned long)frameArray_.size();
 }
 
 unsigned long CircularBuffer::GetFreeSize() const
 {
-   MMThreadGuard guard(g_bufferLock);
-   long freeSize = (long)frameArray_.size() - (insertIndex_ - saveIndex_);
-   if (freeSize < 0)
-      return 0;
-   else
-      return (unsigned long)freeSize;
+   AccessGuard guard(*this);
+   const unsigned long long freeSlots = frameArray_.size() - AvailableImages();
+   if (variableFrames_)
+      return (unsigned long)std::min(freeSlots, FreeArenaBytes() / FrameSizeBytes());
+   return (unsigned long)freeSlots;
+}
+
+/**
+* Returns the memory available for pixels, in bytes.
+*/
+unsigned long long CircularBuffer::GetSizeBytes() const
+{
+   AccessGuard guard(*this);
+   if (variableFrames_)
+      return arenaBytes_;
+   return frameArray_.size() * FrameSizeBytes();
+}
+
+/**
+* Returns the memory available for new pixels without overwriting unread
+* images, in bytes. In variable-size mode, this is the space between the
+* write position and the oldest unread image, which may include space
+* skipped at the end of the arena; it is approximate while images are being
+* inserted or read.
+*/
+unsigned long long CircularBuffer::GetFreeSizeBytes() const
+{
+   AccessGuard guard(*this);
+   if (variableFrames_)
+      return FreeArenaBytes();
+   return (frameArray_.size() - AvailableImages()) * FrameSizeBytes();
+}
+
+// Must be called inside an AccessGuard
+unsigned long long CircularBuffer::FrameSizeBytes() const
+{
+   return (unsigned long long)width_ * height_ * pixDepth_ * numChannels_;
+}
+
+// Must be called inside an AccessGuard, in variable-size mode
+unsigned long long CircularBuffer::FreeArenaBytes() const
+{
+   const long long save = saveIndex_;
+   if (save >= insertIndex_)
+      return arenaBytes_;
+   const unsigned long long start = slotStart_[save % frameArray_.size()];
+   const unsigned long long allocated = allocatedBytes_;
+   const unsigned long long used = allocated - std::min(start, allocated);
+   return used < arenaBytes_ ? arenaBytes_ - used : 0;
 }
 
+/**
+* Returns the number of unread images, including those in the spill file.
+*/
 unsigned long CircularBuffer::GetRemainingImageCount() const
 {
-   MMThreadGuard guard(g_bufferLock);
-   return (unsigned long)(insertIndex_ - saveIndex_);
+   AccessGuard guard(*this);
+   return (unsigned long)(AvailableImages() + spilledFrames_);
+}
+
+// Must be called inside an AccessGuard. saveIndex_ is read first: since both
+// indices only increase, the difference cannot come out negative. It can
+// momentarily exceed the buffer size while Clear() is running.
+long long CircularBuffer::AvailableImages() const
+{
+   long long save = saveIndex_;
+   long long available = insertIndex_ - save;
+   return std::min(available, (long long)frameArray_.size());
 }
 
 static std::string FormatLocalTime(std::chrono::time_point<std::chrono::system_clock> tp) {
@@ -183,6 +511,7 @@ static std::string FormatLocalTime(std::chrono::time_point<std::chrono::system_c
    return buf;
 }
 
+
 /**
 * Inserts a single image in the buffer.
 */
@@ -216,82 +545,36 @@ bool CircularBuffer::InsertMultiChannel(const unsigned char* pixArray, unsigned
  
     mm::ImgBuffer* pImg;
     unsigned long singleChannelSize = (unsigned long)width * height * byteDepth;
+    long long index;
  
     {
-       MMThreadGuard guard(g_bufferLock);
+       AccessGuard guard(*this);
  
        // check image dimensions
-       if (width != width_ || height != height_ || byteDepth != pixDepth_)
+       if (!variableFrames_ && (width != width_ || height != height_ || byteDepth != pixDepth_))
           throw CMMError("Incompatible image dimensions in the circular buffer", MMERR_CircularBufferIncompatibleImage);
  
-       bool overflowed = (insertIndex_ - saveIndex_) >= static_cast<long>(frameArray_.size());
-       if (overflowed) {
+       if (!ClaimInsertSlot(numChannels, width, height, byteDepth, index)) {
           overflow_ = true;
           return false;
        }
     }
  
+    // TODO: the same metadata is inserted for each channel ???
+    // Perhaps we need to add specific tags to each channel
+    Metadata md = PrepareMetadata(pMd, width, height, byteDepth, nComponents);
+
     for (unsigned i=0; i<numChannels; i++)
     {
-       Metadata md;
        {
-          MMThreadGuard guard(g_bufferLock);
+          AccessGuard guard(*this);
           // we assume that all buffers are pre-allocated
-          pImg = frameArray_[insertIndex_ % frameArray_.size()].FindImage(i);
+          pImg = frameArray_[index % frameArray_.size()].FindImage(i);
           if (!pImg)
              return false;
- 
-          if (pMd)
-          {
-             // TODO: the same metadata is inserted for each channel ???
-             // Perhaps we need to add specific tags to each channel
-             md = *pMd;
-          }
-
-         std::string cameraName = md.GetSingleTag("Camera").GetValue();
-         if (imageNumbers_.end() == imageNumbers_.find(cameraName))
-         {
-            imageNumbers_[cameraName] = 0;
-         }
-
-         // insert image number. 
-         md.put(MM::g_Keyword_Metadata_ImageNumber, CDeviceUtils::ConvertToString(imageNumbers_[cameraName]));
-         ++imageNumbers_[cameraName];
-      }
-
-      if (!md.HasTag(MM::g_Keyword_Elapsed_Time_ms))
-      {
-         // if time tag was not supplied by the camera insert current timestamp
-         using namespace std::chrono;
-         auto elapsed = steady_clock::now() - startTime_;
-         md.PutImageTag(MM::g_Keyword_Elapsed_Time_ms,
-            std::to_string(duration_cast<milliseconds>(elapsed).count()));
-      }
-
-      // Note: It is not ideal to use local time. I think this tag is rarely
-      // used. Consider replacing with UTC (micro)seconds-since-epoch (with
-      // different tag key) after addressing current usage.
-      auto now = std::chrono::system_clock::now();
-      md.PutImageTag(MM::g_Keyword_Metadata_TimeInCore, FormatLocalTime(now));
-
-      md.PutImageTag("Width",width);
-      md.PutImageTag("Height",height);
-      if (byteDepth == 1)
-         md.PutImageTag("PixelType","GRAY8");
-      else if (byteDepth == 2)
-         md.PutImageTag("PixelType","GRAY16");
-      else if (byteDepth == 4)
-      {
-         if (nComponents == 1)
-            md.PutImageTag("PixelType","GRAY32");
-         else
-            md.PutImageTag("PixelType","RGB32");
-      }
-      else if (byteDepth == 8)
-         md.PutImageTag("PixelType","RGB64");
-      else
-         md.PutImageTag("PixelType","Unknown"); 
+       }
 
+      PutImageNumber(md);
       pImg->SetMetadata(md);
       //pImg->SetPixels(pixArray + i * singleChannelSize);
       // TODO: In MMCore the ImgBuffer::GetPixels() returns const pointer.
@@ -302,22 +585,410 @@ bool CircularBuffer::InsertMultiChannel(const unsigned char* pixArray, unsigned
             pixArray + i * singleChannelSize, singleChannelSize);
    }
 
+   // If the buffer was cleared in the meantime the frame is dropped, as if it
+   // had arrived before the clear
+   AccessGuard guard(*this);
+   PublishSlot(index);
+   return true;
+}
+
+/**
+* Hands out the pixel buffer of the next free slot so that the caller can
+* write a single-channel image into it directly, avoiding the copy made by
+* InsertImage(). Returns null if the buffer is full.
+*
+* On success, the insert lock remains held by the calling thread until the
+* slot is published with CommitSlot() or abandoned with DiscardSlot(); one of
+* these must always be called, from the same thread.
+*/
+unsigned char* CircularBuffer::AcquireSlot(unsigned int width, unsigned int height, unsigned int byteDepth, unsigned int nComponents) throw (CMMError)
+{
+   g_insertLock.Lock();
+
+   AccessGuard guard(*this);
+
+   if (acquiredSlot_)
+   {
+      g_insertLock.Unlock();
+      throw CMMError("Circular buffer slot already acquired");
+   }
+
+   if (!variableFrames_ && (width != width_ || height != height_ || byteDepth != pixDepth_))
+   {
+      g_insertLock.Unlock();
+      throw CMMError("Incompatible image dimensions in the circular buffer", MMERR_CircularBufferIncompatibleImage);
+   }
+
+   long long index;
+   if (!ClaimInsertSlot(1, width, height, byteDepth, index))
+   {
+      overflow_ = true;
+      g_insertLock.Unlock();
+      return 0;
+   }
+
+   mm::ImgBuffer* pImg = frameArray_[index % frameArray_.size()].FindImage(0);
+   if (!pImg)
+   {
+      g_insertLock.Unlock();
+      return 0;
+   }
+
+   acquiredSlot_ = pImg;
+   acquiredIndex_ = index;
+   acquiredComponents_ = nComponents;
+   return const_cast<unsigned char*>(pImg->GetPixels());
+}
+
+/**
+* Returns the slot currently held by AcquireSlot(), or null. Must only be
+* called from the thread holding the slot.
+*/
+const mm::ImgBuffer* CircularBuffer::GetAcquiredSlot() const
+{
+   return acquiredSlot_;
+}
+
+/**
+* Publishes the slot obtained from AcquireSlot(), making it visible to
+* GetNextImage() and friends, and releases the insert lock. Returns false
+* (dropping the frame) if no slot is held or if the buffer was cleared while
+* the slot was being filled.
+*/
+bool CircularBuffer::CommitSlot(const Metadata* pMd)
+{
+   // acquiredSlot_ is only touched by the thread holding g_insertLock
+   mm::ImgBuffer* pImg = acquiredSlot_;
+   if (!pImg)
+      return false;
+   acquiredSlot_ = 0;
+
+   try
+   {
+      Metadata md = PrepareMetadata(pMd, pImg->Width(), pImg->Height(),
+            pImg->Depth(), acquiredComponents_);
+      PutImageNumber(md);
+      pImg->SetMetadata(md);
+   }
+   catch (...)
+   {
+      g_insertLock.Unlock();
+      throw;
+   }
+
+   bool published;
    {
-      MMThreadGuard guard(g_bufferLock);
+      AccessGuard guard(*this);
+      published = PublishSlot(acquiredIndex_);
+   }
+   g_insertLock.Unlock();
+   return published;
+}
+
+/**
+* Abandons the slot obtained from AcquireSlot() without publishing it, and
+* releases the insert lock.
+*/
+void CircularBuffer::DiscardSlot()
+{
+   if (!acquiredSlot_)
+      return;
+   acquiredSlot_ = 0;
+   g_insertLock.Unlock();
+}
 
-      imageCounter_++;
-      insertIndex_++;
-      if ((insertIndex_ - (long)frameArray_.size()) > adjustThreshold && (saveIndex_- (long)frameArray_.size()) > adjustThreshold)
+// Must be called with g_insertLock held, inside an AccessGuard. Reserves the
+// slot for the next image, spilling unread images to make room if spill mode
+// is enabled.
+bool CircularBuffer::ClaimInsertSlot(unsigned numChannels, unsigned width, unsigned height, unsigned byteDepth, long long& index)
+{
+   while (!TryClaimInsertSlot(numChannels, width, height, byteDepth, index))
+   {
+      if (spillEnabled_ && SpillOldest())
+         continue;
+      if (!writerAttached_ || !SkipWrittenImage())
+         return false;
+   }
+   return true;
+}
+
+// Must be called inside an AccessGuard. Returns the index of the oldest image
+// that a reader or the writer may still take.
+long long CircularBuffer::OldestInUse() const
+{
+   const long long save = saveIndex_;
+   if (!writerAttached_)
+      return save;
+   return std::min(save, (long long)writerIndex_);
+}
+
+// Must be called with g_insertLock held, inside an AccessGuard. Reserves the
+// slot for the next image and marks it as being written; returns false if the
+// buffer is full. In variable-size mode, also reserves room for the pixels.
+bool CircularBuffer::TryClaimInsertSlot(unsigned numChannels, unsigned width, unsigned height, unsigned byteDepth, long long& index)
+{
+   const long long size = (long long)frameArray_.size();
+   const long long insert = insertIndex_;
+   if (size == 0 || insert - OldestInUse() >= size)
+      return false;
+
+   if (variableFrames_)
+   {
+      // The slot may still describe the pixels of a consumed but pinned image
+      ReclaimConsumedFrames(insert);
+      if (insert - tailIndex_ >= size)
+         return false;
+   }
+
+   // Mark the slot before checking for pins. MakeHandle() pins before
+   // checking the mark, so either we see its pin or it sees our mark.
+   const size_t slot = (size_t)(insert % size);
+   slotSequence_[slot] = slotBeingWritten;
+
+   // A slot pinned by an ImageHandle is treated as still occupied
+   if (pins_->IsPinned(slot))
+   {
+      slotSequence_[slot] = 0;
+      return false;
+   }
+
+   if (variableFrames_ && !AllocateFrame(slot, insert, numChannels, width, height, byteDepth))
+   {
+      slotSequence_[slot] = 0;
+      return false;
+   }
+
+   index = insert;
+   return true;
+}
+
+// Must be called with g_insertLock held, inside an AccessGuard, in
+// variable-size mode. Frees the arena space of consumed images, oldest
+// first, stopping at the first one that is pinned.
+void CircularBuffer::ReclaimConsumedFrames(long long insert)
+{
+   const long long size = (long long)frameArray_.size();
+   const long long save = std::min(OldestInUse(), insert);
+   while (tailIndex_ < save)
+   {
+      const size_t slot = (size_t)(tailIndex_ % size);
+      if (slotOwner_[slot] == tailIndex_)
       {
-         // adjust buffer indices to avoid overflowing integer size
-         insertIndex_ -= adjustThreshold;
-         saveIndex_ -= adjustThreshold;
+         // Unpublish before checking for pins, as in ClaimInsertSlot()
+         slotSequence_[slot] = 0;
+         if (pins_->IsPinned(slot))
+            return;
+         slotOwner_[slot] = -1;
       }
+      ++tailIndex_;
    }
+}
+
+// Must be called with g_insertLock held, inside an AccessGuard, in
+// variable-size mode. Places the pixels of the image after those of the
+// previous one (or at the start of the arena if they do not fit before its
+// end), provided that this does not reach the oldest image still in use.
+bool CircularBuffer::AllocateFrame(size_t slot, long long index, unsigned numChannels, unsigned width, unsigned height, unsigned byteDepth)
+{
+   const unsigned long long bytes = (unsigned long long)width * height * byteDepth * numChannels;
+   if (bytes == 0 || bytes > arenaBytes_)
+      return false;
 
+   unsigned long long start = allocatedBytes_;
+   const unsigned long long offset = start % arenaBytes_;
+   if (offset + bytes > arenaBytes_)
+      start += arenaBytes_ - offset;
+
+   const size_t tailSlot = (size_t)(tailIndex_ % frameArray_.size());
+   if (tailIndex_ < index && slotOwner_[tailSlot] == tailIndex_ &&
+         start + bytes - slotStart_[tailSlot] > arenaBytes_)
+      return false;
+
+   frameArray_[slot].Attach(memory_->Get() + start % arenaBytes_,
+         numChannels, width, height, byteDepth);
+   slotOwner_[slot] = index;
+   slotStart_[slot] = start;
+   allocatedBytes_ = start + bytes;
    return true;
 }
- 
+
+// Must be called with g_insertLock held, inside an AccessGuard, after failing
+// to claim a slot. Moves the oldest unread image to the spill file. Returns
+// false if that would not make room (because the buffer is full of pinned
+// images) or if the image cannot be written.
+bool CircularBuffer::SpillOldest()
+{
+   const long long size = (long long)frameArray_.size();
+   const long long insert = insertIndex_;
+   const long long save = saveIndex_;
+   if (size == 0 || save >= insert)
+      return false;
+   if (variableFrames_)
+   {
+      ReclaimConsumedFrames(insert);
+      if (tailIndex_ < save)
+         return false;
+   }
+   else if (insert - save < size)
+      return false;
+
+   std::lock_guard<std::mutex> lock(spillMutex_);
+   if (!spill_ || !spillEnabled_)
+      return false;
+
+   // Slots skipped by a concurrent Clear() hold no image and are passed over
+   const bool published = IsPublished(save);
+   if (published)
+   {
+      if (!spill_->Append(frameArray_[save % size]))
+         return false;
+      ++spilledFrames_;
+   }
+   long long expected = save;
+   if (!saveIndex_.compare_exchange_strong(expected, save + 1) && published)
+   {
+      // A reader took the image in the meantime
+      spill_->DiscardLast();
+      --spilledFrames_;
+   }
+   return true;
+}
+
+// Must be called with g_insertLock held, inside an AccessGuard, after failing
+// to claim a slot, while a writer is attached. Discards the oldest unread
+// image if the writer has already taken it. Returns false if that would not
+// make room.
+bool CircularBuffer::SkipWrittenImage()
+{
+   const long long size = (long long)frameArray_.size();
+   const long long insert = insertIndex_;
+   const long long save = saveIndex_;
+   if (size == 0 || save >= insert || writerIndex_ <= save)
+      return false;
+   if (variableFrames_)
+   {
+      ReclaimConsumedFrames(insert);
+      if (tailIndex_ < save)
+         return false;
+   }
+   else if (insert - save < size)
+      return false;
+
+   // Fails only if a reader took the image in the meantime
+   long long expected = save;
+   saveIndex_.compare_exchange_strong(expected, save + 1);
+   return true;
+}
+
+// Must be called with spillMutex_ held, inside an AccessGuard. Moves the
+// oldest spilled image into spillStaging_; returns false if there is none.
+// An image that cannot be read back is consumed with no channels.
+bool CircularBuffer::ReadSpilledFrame()
+{
+   if (!spill_ || spill_->GetFrameCount() == 0)
+      return false;
+   spill_->ReadNext(spillStaging_);
+   --spilledFrames_;
+   if (!spillEnabled_ && spill_->GetFrameCount() == 0)
+      spill_.reset();
+   return true;
+}
+
+// Must be called with spillMutex_ held
+void CircularBuffer::DropSpilledFrames()
+{
+   if (spill_)
+      spill_->Clear();
+   spilledFrames_ = 0;
+   if (!spillEnabled_)
+      spill_.reset();
+}
+
+// Must be called with g_insertLock held, inside an AccessGuard. Returns false
+// if Clear() moved the insert index past the claimed slot.
+bool CircularBuffer::PublishSlot(long long index)
+{
+   slotSequence_[index % frameArray_.size()] = index + 1;
+   long long expected = index;
+   if (!insertIndex_.compare_exchange_strong(expected, index + 1))
+      return false;
+   imageCounter_++;
+   return true;
+}
+
+void CircularBuffer::ResetStartTime()
+{
+   startTime_ = std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+/**
+* Builds the metadata stored with an inserted frame: the caller-supplied tags
+* plus timestamps and image geometry. These are the same for all channels of
+* the frame; see PutImageNumber() for the rest.
+*/
+Metadata CircularBuffer::PrepareMetadata(const Metadata* pMd, unsigned int width, unsigned int height, unsigned int byteDepth, unsigned int nComponents)
+{
+   Metadata md;
+   if (pMd)
+      md = *pMd;
+
+   if (!md.HasTag(MM::g_Keyword_Elapsed_Time_ms))
+   {
+      // if time tag was not supplied by the camera insert current timestamp
+      using namespace std::chrono;
+      steady_clock::time_point start{steady_clock::duration(startTime_)};
+      auto elapsed = steady_clock::now() - start;
+      md.PutImageTag(MM::g_Keyword_Elapsed_Time_ms,
+         std::to_string(duration_cast<milliseconds>(elapsed).count()));
+   }
+
+   // Note: It is not ideal to use local time. I think this tag is rarely
+   // used. Consider replacing with UTC (micro)seconds-since-epoch (with
+   // different tag key) after addressing current usage.
+   auto now = std::chrono::system_clock::now();
+   md.PutImageTag(MM::g_Keyword_Metadata_TimeInCore, FormatLocalTime(now));
+
+   md.PutImageTag("Width",width);
+   md.PutImageTag("Height",height);
+   if (byteDepth == 1)
+      md.PutImageTag("PixelType","GRAY8");
+   else if (byteDepth == 2)
+      md.PutImageTag("PixelType","GRAY16");
+   else if (byteDepth == 4)
+   {
+      if (nComponents == 1)
+         md.PutImageTag("PixelType","GRAY32");
+      else
+         md.PutImageTag("PixelType","RGB32");
+   }
+   else if (byteDepth == 8)
+      md.PutImageTag("PixelType","RGB64");
+   else
+      md.PutImageTag("PixelType","Unknown"); 
+
+   return md;
+}
+
+/**
+* Sets the image number tag of md to the next number for its camera. Must be
+* called with g_insertLock held.
+*/
+void CircularBuffer::PutImageNumber(Metadata& md)
+{
+   if (imageNumbersReset_.exchange(false))
+      imageNumbers_.clear();
+
+   std::string cameraName = md.GetSingleTag("Camera").GetValue();
+   if (imageNumbers_.end() == imageNumbers_.find(cameraName))
+   {
+      imageNumbers_[cameraName] = 0;
+   }
+
+   // insert image number. 
+   md.put(MM::g_Keyword_Metadata_ImageNumber, std::to_string(imageNumbers_[cameraName]));
+   ++imageNumbers_[cameraName];
+}
+
 
 const unsigned char* CircularBuffer::GetTopImage() const
 {
@@ -340,18 +1011,17 @@ const mm::ImgBuffer* CircularBuffer::GetNthFromTopImageBuffer(unsigned long n) c
 const mm::ImgBuffer* CircularBuffer::GetNthFromTopImageBuffer(long n,
       unsigned channel) const
 {
-   MMThreadGuard guard(g_bufferLock);
+   AccessGuard guard(*this);
 
-   long availableImages = insertIndex_ - saveIndex_;
-   if (n + 1 > availableImages)
+   long long save = saveIndex_;
+   long long insert = insertIndex_;
+   if (n + 1 > insert - save)
       return 0;
 
-   long targetIndex = insertIndex_ - n - 1L;
-   while (targetIndex < 0)
-      targetIndex += (long) frameArray_.size();
-   targetIndex %= frameArray_.size();
-
-   return frameArray_[targetIndex].FindImage(channel);
+   long long targetIndex = insert - n - 1L;
+   if (!IsPublished(targetIndex))
+      return 0;
+   return frameArray_[targetIndex % frameArray_.size()].FindImage(channel);
 }
 
 const unsigned char* CircularBuffer::GetNextImage()
@@ -362,15 +1032,252 @@ const unsigned char* CircularBuffer::GetNextImage()
    return img->GetPixels();
 }
 
+/**
+* Removes the next image from the buffer and returns the given channel of it.
+* An image that was spilled to disk is returned from a copy, which remains
+* valid until 8 more spilled images have been returned by this function.
+*/
 const mm::ImgBuffer* CircularBuffer::GetNextImageBuffer(unsigned channel)
 {
-   MMThreadGuard guard(g_bufferLock);
+   AccessGuard guard(*this);
+
+   long long save = saveIndex_;
+   for (;;)
+   {
+      // Spilled images are older than those in the buffer
+      if (spilledFrames_ > 0)
+      {
+         std::lock_guard<std::mutex> lock(spillMutex_);
+         if (ReadSpilledFrame())
+         {
+            spillReturned_.push_back(spillStaging_);
+            if (spillReturned_.size() > spillReturnedFrames)
+               spillReturned_.pop_front();
+            return channel < spillStaging_.size() ? spillStaging_[channel].get() : 0;
+         }
+      }
+      if (save >= insertIndex_)
+         break;
+
+      // Check before consuming: the producer may reuse the slot as soon as
+      // saveIndex_ has moved past it. Slots skipped by a concurrent Clear()
+      // hold no image and are passed over.
+      bool published = IsPublished(save);
+      if (saveIndex_.compare_exchange_weak(save, save + 1))
+      {
+         if (published)
+            return frameArray_[save % frameArray_.size()].FindImage(channel);
+         ++save;
+      }
+   }
+   return 0;
+}
+
+/**
+* Returns a handle to the most recently inserted image, pinning its slot until
+* the handle is released. Returns an invalid handle if the buffer is empty.
+*/
+ImageHandle CircularBuffer::GetTopImageHandle(unsigned channel) const
+{
+   AccessGuard guard(*this);
+
+   long long save = saveIndex_;
+   long long insert = insertIndex_;
+   if (insert - save < 1)
+      return ImageHandle();
+   return MakeHandle(insert - 1, channel);
+}
+
+/**
+* Removes the next image from the buffer and returns a handle to it, pinning
+* its slot until the handle is released. Returns an invalid handle if the
+* buffer is empty.
+*/
+ImageHandle CircularBuffer::GetNextImageHandle(unsigned channel)
+{
+   AccessGuard guard(*this);
+
+   long long save = saveIndex_;
+   for (;;)
+   {
+      // A spilled image is held by the handle itself
+      if (spilledFrames_ > 0)
+      {
+         std::lock_guard<std::mutex> lock(spillMutex_);
+         if (ReadSpilledFrame())
+         {
+            if (channel >= spillStaging_.size())
+               return ImageHandle();
+            std::shared_ptr<mm::ImgBuffer> img = spillStaging_[channel];
+            return ImageHandle(img, img.get(), ComponentCount(img.get()));
+         }
+      }
+      if (save >= insertIndex_)
+         break;
+
+      // Pin before consuming, so that the producer cannot take the slot
+      bool published = IsPublished(save);
+      ImageHandle handle = published ? MakeHandle(save, channel) : ImageHandle();
+      if (saveIndex_.compare_exchange_weak(save, save + 1))
+      {
+         if (published)
+            return handle;
+         ++save;
+      }
+   }
+   return ImageHandle();
+}
+
+/**
+* Attaches a writer (see GetNextWriterFrame()), starting at the oldest unread
+* image. Only one writer can be attached at a time.
+*/
+void CircularBuffer::AttachWriter()
+{
+   MMThreadGuard insertGuard(g_insertLock);
+   AccessGuard guard(*this);
+   writerIndex_ = (long long)saveIndex_;
+   writerAttached_ = true;
+}
+
+void CircularBuffer::DetachWriter()
+{
+   writerAttached_ = false;
+}
+
+/**
+* Returns handles to all channels of the next image not yet taken by the
+* writer, independently of GetNextImage() and friends. The handles pin the
+* slot until they are released. Returns false if the writer has taken all
+* images. Must only be called from one thread at a time.
+*/
+bool CircularBuffer::GetNextWriterFrame(std::vector<ImageHandle>& channels)
+{
+   AccessGuard guard(*this);
+
+   channels.clear();
+   long long index = writerIndex_;
+   while (index < insertIndex_)
+   {
+      // Slots skipped by a concurrent Clear() hold no image and are passed
+      // over
+      for (unsigned channel = 0; ; ++channel)
+      {
+         ImageHandle handle = MakeHandle(index, channel);
+         if (!handle.isValid())
+            break;
+         channels.push_back(handle);
+      }
+      if (writerIndex_.compare_exchange_weak(index, index + 1))
+      {
+         if (!channels.empty())
+            return true;
+         ++index;
+      }
+      channels.clear();
+   }
+   return false;
+}
 
-   long availableImages = insertIndex_ - saveIndex_;
-   if (availableImages < 1)
+/**
+* Returns the number of images the writer has yet to take.
+*/
+unsigned long CircularBuffer::GetWriterBacklog() const
+{
+   AccessGuard guard(*this);
+   if (!writerAttached_)
       return 0;
+   const long long writer = writerIndex_;
+   return (unsigned long)std::max(0LL, insertIndex_ - writer);
+}
+
+unsigned long CircularBuffer::GetPinnedImageCount() const
+{
+   AccessGuard guard(*this);
+   return (unsigned long)pins_->GetPinnedCount();
+}
+
+// Must be called inside an AccessGuard
+bool CircularBuffer::IsPublished(long long index) const
+{
+   return slotSequence_[index % frameArray_.size()] == index + 1;
+}
+
+// Must be called inside an AccessGuard
+ImageHandle CircularBuffer::MakeHandle(long long index, unsigned channel) const
+{
+   const size_t slot = (size_t)(index % frameArray_.size());
+
+   // Pin first, then make sure the producer has not started overwriting the
+   // slot (see ClaimInsertSlot())
+   std::shared_ptr<mm::ImagePin> pin = std::make_shared<mm::ImagePin>(pins_, slot);
+   if (!IsPublished(index))
+      return ImageHandle();
+
+   const mm::ImgBuffer* img = frameArray_[slot].FindImage(channel);
+   if (!img)
+      return ImageHandle();
+   return ImageHandle(pin, img, ComponentCount(img));
+}
+
+unsigned CircularBuffer::ComponentCount(const mm::ImgBuffer* img)
+{
+   try
+   {
+      const std::string pixelType = img->GetMetadata().GetSingleTag("PixelType").GetValue();
+      if (pixelType == "RGB32" || pixelType == "RGB64")
+         return 4;
+   }
+   catch (const MetadataKeyError&)
+   {
+   }
+   return 1;
+}
+
+
+namespace mm {
+
+ImagePinTable::ImagePinTable(size_t slotCount) :
+   slotCount_(slotCount),
+   counts_(new std::atomic<unsigned>[slotCount]),
+   pinnedCount_(0)
+{
+   for (size_t i = 0; i < slotCount_; ++i)
+      counts_[i] = 0;
+}
+
+void ImagePinTable::Pin(size_t slot)
+{
+   if (counts_[slot]++ == 0)
+      ++pinnedCount_;
+}
+
+void ImagePinTable::Unpin(size_t slot)
+{
+   if (--counts_[slot] == 0)
+      --pinnedCount_;
+}
+
+bool ImagePinTable::IsPinned(size_t slot) const
+{
+   return slot < slotCount_ && counts_[slot] > 0;
+}
+
+size_t ImagePinTable::GetPinnedCount() const
+{
+   return pinnedCount_;
+}
+
+ImagePin::ImagePin(std::shared_ptr<ImagePinTable> table, size_t slot) :
+   table_(table),
+   slot_(slot)
+{
+   table_->Pin(slot_);
+}
 
-   long targetIndex = saveIndex_ % frameArray_.size();
-   ++saveIndex_;
-   return frameArray_[targetIndex].FindImage(channel);
+ImagePin::~ImagePin()
+{
+   table_->Unpin(slot_);
 }
+
+} // namespace mm
@@ -24,15 +24,22 @@
 
 #pragma once
 
+#include "BufferMemory.h"
 #include "Error.h"
 #include "ErrorCodes.h"
 #include "FrameBuffer.h"
+#include "ImageHandle.h"
+#include "SpillFile.h"
 
 #include "../MMDevice/DeviceThreads.h"
 #include "../MMDevice/MMDevice.h"
 
+#include <atomic>
 #include <chrono>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 
 #ifdef _MSC_VER
@@ -43,18 +50,88 @@
 class ThreadPool;
 class TaskSet_CopyMemory;
 
+namespace mm {
+
+// Per-slot pin counts of a CircularBuffer. Shared between the buffer and the
+// pins it hands out, so that releasing a pin remains safe even if the buffer
+// has already been reallocated. The counts are atomic so that the insertion
+// path can check them without taking a lock.
+class ImagePinTable
+{
+public:
+   explicit ImagePinTable(size_t slotCount);
+
+   void Pin(size_t slot);
+   void Unpin(size_t slot);
+   bool IsPinned(size_t slot) const;
+   size_t GetPinnedCount() const;
+
+private:
+   const size_t slotCount_;
+   std::unique_ptr<std::atomic<unsigned>[]> counts_;
+   std::atomic<size_t> pinnedCount_;
+};
+
+// Keeps one slot pinned for as long as it exists; shared by copies of an
+// ImageHandle.
+class ImagePin
+{
+public:
+   ImagePin(std::shared_ptr<ImagePinTable> table, size_t slot);
+   ~ImagePin();
+
+   ImagePin(const ImagePin&) = delete;
+   ImagePin& operator=(const ImagePin&) = delete;
+
+private:
+   const std::shared_ptr<ImagePinTable> table_;
+   const size_t slot_;
+};
+
+} // namespace mm
+
 class CircularBuffer
 {
 public:
-   CircularBuffer(unsigned int memorySizeMB);
+   // Frames are copied in using threadPool, or a pool of the buffer's own if
+   // it is null
+   CircularBuffer(unsigned int memorySizeMB,
+         std::shared_ptr<ThreadPool> threadPool = std::shared_ptr<ThreadPool>());
    ~CircularBuffer();
 
-   unsigned GetMemorySizeMB() const { return memorySizeMB_; }
+   void SetThreadPool(std::shared_ptr<ThreadPool> threadPool);
+
+   unsigned GetMemorySizeMB() const { return (unsigned)(memorySizeBytes_ >> 20); }
+   unsigned long long GetMemorySizeBytes() const { return memorySizeBytes_; }
+   void SetMemorySizeBytes(unsigned long long bytes);
+
+   void EnableLockFree(bool enable) { lockFree_ = enable; }
+   bool IsLockFree() const { return lockFree_; }
+
+   void EnableVariableSizeFrames(bool enable) { variableSizeFrames_ = enable; }
+   bool IsVariableSizeFrames() const { return variableSizeFrames_; }
+
+   void SetMemoryOptions(const mm::BufferMemoryOptions& options);
+   mm::BufferMemoryOptions GetMemoryOptions() const;
+   std::string GetMemoryDescription() const;
+
+   void EnableSpill(const std::string& path,
+         unsigned long long maxBytes = 0) throw (CMMError);
+   void DisableSpill();
+   bool IsSpillEnabled() const { return spillEnabled_; }
+   unsigned long GetSpilledImageCount() const { return (unsigned long)spilledFrames_; }
+
+   void AttachWriter();
+   void DetachWriter();
+   bool GetNextWriterFrame(std::vector<ImageHandle>& channels);
+   unsigned long GetWriterBacklog() const;
 
    bool Initialize(unsigned channels, unsigned int xSize, unsigned int ySize, unsigned int pixDepth);
    unsigned long GetSize() const;
    unsigned long GetFreeSize() const;
    unsigned long GetRemainingImageCount() const;
+   unsigned long long GetSizeBytes() const;
+   unsigned long long GetFreeSizeBytes() const;
 
    unsigned int Width() const {MMThreadGuard guard(g_bufferLock); return width_;}
    unsigned int Height() const {MMThreadGuard guard(g_bufferLock); return height_;}
@@ -64,38 +141,138 @@ public:
    bool InsertMultiChannel(const unsigned char* pixArray, unsigned int numChannels, unsigned int width, unsigned int height, unsigned int byteDepth, const Metadata* pMd) throw (CMMError);
    bool InsertImage(const unsigned char* pixArray, unsigned int width, unsigned int height, unsigned int byteDepth, unsigned int nComponents, const Metadata* pMd) throw (CMMError);
    bool InsertMultiChannel(const unsigned char* pixArray, unsigned int numChannels, unsigned int width, unsigned int height, unsigned int byteDepth, unsigned int nComponents, const Metadata* pMd) throw (CMMError);
+   unsigned char* AcquireSlot(unsigned int width, unsigned int height, unsigned int byteDepth, unsigned int nComponents) throw (CMMError);
+   const mm::ImgBuffer* GetAcquiredSlot() const;
+   bool CommitSlot(const Metadata* pMd);
+   void DiscardSlot();
    const unsigned char* GetTopImage() const;
    const unsigned char* GetNextImage();
    const mm::ImgBuffer* GetTopImageBuffer(unsigned channel) const;
    const mm::ImgBuffer* GetNthFromTopImageBuffer(unsigned long n) const;
    const mm::ImgBuffer* GetNthFromTopImageBuffer(long n, unsigned channel) const;
    const mm::ImgBuffer* GetNextImageBuffer(unsigned channel);
+   ImageHandle GetTopImageHandle(unsigned channel) const;
+   ImageHandle GetNextImageHandle(unsigned channel);
+   unsigned long GetPinnedImageCount() const;
    void Clear(); 
 
-   bool Overflow() {MMThreadGuard guard(g_bufferLock); return overflow_;}
+   bool Overflow() { return overflow_; }
 
    mutable MMThreadLock g_bufferLock;
    mutable MMThreadLock g_insertLock;
 
 private:
+   class AccessGuard;
+
+   bool Reallocate(unsigned channels, unsigned int xSize, unsigned int ySize, unsigned int pixDepth);
+   void ResetStartTime();
+   Metadata PrepareMetadata(const Metadata* pMd, unsigned int width, unsigned int height, unsigned int byteDepth, unsigned int nComponents);
+   void PutImageNumber(Metadata& md);
+   bool ClaimInsertSlot(unsigned numChannels, unsigned width, unsigned height, unsigned byteDepth, long long& index);
+   bool TryClaimInsertSlot(unsigned numChannels, unsigned width, unsigned height, unsigned byteDepth, long long& index);
+   bool SpillOldest();
+   bool SkipWrittenImage();
+   long long OldestInUse() const;
+   bool ReadSpilledFrame();
+   void DropSpilledFrames();
+   void ReclaimConsumedFrames(long long insert);
+   bool AllocateFrame(size_t slot, long long index, unsigned numChannels, unsigned width, unsigned height, unsigned byteDepth);
+   unsigned long long FrameSizeBytes() const;
+   unsigned long long FreeArenaBytes() const;
+   bool PublishSlot(long long index);
+   long long AvailableImages() const;
+   bool IsPublished(long long index) const;
+   ImageHandle MakeHandle(long long index, unsigned channel) const;
+   static unsigned ComponentCount(const mm::ImgBuffer* img);
+
    unsigned int width_;
    unsigned int height_;
    unsigned int pixDepth_;
    long imageCounter_;
-   std::chrono::time_point<std::chrono::steady_clock> startTime_;
+   std::atomic<std::chrono::steady_clock::rep> startTime_;
+
+   // Guarded by g_insertLock; cleared by the producer when
+   // imageNumbersReset_ is set
    std::map<std::string, long> imageNumbers_;
+   std::atomic<bool> imageNumbersReset_;
+
+   // In lock-free mode, readers and producers only use the atomics below and
+   // do not take g_bufferLock, except while Initialize() reallocates.
+   std::atomic<bool> lockFree_;
+   std::atomic<bool> reallocating_;
+   mutable std::atomic<unsigned> activeAccessors_;
 
    // Invariants:
    // 0 <= saveIndex_ <= insertIndex_
    // insertIndex_ - saveIndex_ <= frameArray_.size()
-   long insertIndex_;
-   long saveIndex_;
+   // Both only increase, except when Initialize() reallocates.
+   std::atomic<long long> insertIndex_;
+   std::atomic<long long> saveIndex_;
 
-   unsigned long memorySizeMB_;
+   // Takes effect at the next reallocation
+   std::atomic<unsigned long long> memorySizeBytes_;
    unsigned int numChannels_;
-   bool overflow_;
+   std::atomic<bool> overflow_;
    std::vector<mm::FrameBuffer> frameArray_;
 
+   // For each slot, 1 + the index of the image last published in it (or
+   // slotBeingWritten while the producer fills it). Lets lock-free readers
+   // tell whether a slot still holds the image they are after.
+   std::unique_ptr<std::atomic<long long>[]> slotSequence_;
+
+   // Backing memory for the pixels of all slots. Guarded by g_bufferLock;
+   // the requested options take effect at the next reallocation.
+   std::unique_ptr<mm::BufferMemory> memory_;
+   mm::BufferMemoryOptions memoryOptions_;
+
+   // Variable-size mode (requested by variableSizeFrames_, applied by the
+   // next reallocation): the pixels of all frames are packed into memory_ in
+   // insertion order, and frameArray_ only describes them.
+   std::atomic<bool> variableSizeFrames_;
+   bool variableFrames_;
+   unsigned long long arenaBytes_;
+   // Bytes handed out since reallocation, counting the space skipped at the
+   // end of the arena when a frame does not fit there; and its value at the
+   // start of each slot's frame. Offsets in the arena are these modulo
+   // arenaBytes_.
+   std::atomic<unsigned long long> allocatedBytes_;
+   std::unique_ptr<std::atomic<unsigned long long>[]> slotStart_;
+   // Producer-only: the image whose pixels each slot holds (-1 if none), and
+   // the oldest image whose pixels may still be in use
+   std::vector<long long> slotOwner_;
+   long long tailIndex_;
+
+   // Slot handed out by AcquireSlot() and not yet committed or discarded
+   // (g_insertLock stays held by the producer in between).
+   mm::ImgBuffer* acquiredSlot_;
+   long long acquiredIndex_;
+   unsigned int acquiredComponents_;
+
+   std::shared_ptr<mm::ImagePinTable> pins_;
+
+   // Spill mode: when the buffer is full, the producer moves the oldest
+   // unread images to spill_ instead of dropping the new one, and readers
+   // take images from there first. spillMutex_ guards spill_,
+   // spillStaging_ (the channels of the image read from it last) and
+   // spillReturned_ (copies of the last images returned by
+   // GetNextImageBuffer(), kept for a while since the caller holds a raw
+   // pointer) and is taken inside an AccessGuard. spilledFrames_ is raised before an image
+   // leaves the buffer, so that a reader seeing no spilled images cannot
+   // overtake it.
+   std::mutex spillMutex_;
+   std::unique_ptr<mm::SpillFile> spill_;
+   std::atomic<bool> spillEnabled_;
+   std::atomic<size_t> spilledFrames_;
+   std::vector<std::shared_ptr<mm::ImgBuffer> > spillStaging_;
+   std::deque<std::vector<std::shared_ptr<mm::ImgBuffer> > > spillReturned_;
+
+   // While a writer is attached, it reads every image in insertion order
+   // through its own index, and slots are only reused once both the writer
+   // and the readers are done with them. When the readers fall behind, the
+   // producer skips images that the writer has already taken.
+   std::atomic<bool> writerAttached_;
+   std::atomic<long long> writerIndex_;
+
    std::shared_ptr<ThreadPool> threadPool_;
    std::shared_ptr<TaskSet_CopyMemory> tasksMemCopy_;
 };
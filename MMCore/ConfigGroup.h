@@ -27,6 +27,8 @@
 
 #include "Configuration.h"
 #include "Error.h"
+#include <cstring>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -44,6 +46,7 @@ public:
    void Define(const char* configName)
    {
       configs_[configName];
+      ++changeCount_;
    }
 
 	/**
@@ -53,6 +56,7 @@ public:
    {
       PropertySetting setting(deviceLabel, propName, value);
       configs_[configName].addSetting(setting);
+      ++changeCount_;
 	}
 
    /**
@@ -82,6 +86,7 @@ public:
 	  
 	  configs_[newConfigName] = it->second;
       configs_.erase(it->first);
+      ++changeCount_;
       return true;
    }
 
@@ -98,6 +103,7 @@ public:
       if (it == configs_.end())
          return false;
       configs_.erase(configName);
+      ++changeCount_;
       return true;
    }
 
@@ -117,6 +123,7 @@ public:
 	  
 	  // Delete the specified property
       configs_[configName].deleteSetting(deviceLabel,propName);
+      ++changeCount_;
 	  return true;
    }
 
@@ -138,11 +145,21 @@ public:
       return configs_.size() == 0;
    }
 
+   /**
+    * Returns a number that changes whenever presets are defined, renamed or
+    * deleted (but not when a preset is modified through Find()).
+    */
+   unsigned long long GetChangeCount() const
+   {
+      return changeCount_;
+   }
+
 protected:
-   ConfigGroupBase() {}
+   ConfigGroupBase() : changeCount_(0) {}
    virtual ~ConfigGroupBase() {}
 
    std::map<std::string, T> configs_;
+   unsigned long long changeCount_;
 };
 
 
@@ -158,7 +175,7 @@ class ConfigGroup : public ConfigGroupBase<Configuration>
  */
 class ConfigGroupCollection {
 public:
-   ConfigGroupCollection() {}
+   ConfigGroupCollection() : changeCount_(0) {}
    ~ConfigGroupCollection() {}
 
    /**
@@ -167,6 +184,7 @@ public:
    void Define(const char* groupName, const char* configName)
    {
       groups_[groupName].Define(configName);
+      ++changeCount_;
    }
 
    /**
@@ -175,6 +193,7 @@ public:
    void Define(const char* groupName, const char* configName, const char* deviceLabel, const char* propName, const char* value)
    {
       groups_[groupName].Define(configName, deviceLabel, propName, value);
+      ++changeCount_;
    }
 
    /**
@@ -186,6 +205,7 @@ public:
       if (it == groups_.end())
       {
          groups_[groupName]; // effectively inserts an empty group
+         ++changeCount_;
          return true;
       }
       else
@@ -232,6 +252,7 @@ public:
             return false; // group not found
          if (it->second.Rename(oldConfigName, newConfigName))
          {
+            ++changeCount_;
             // NOTE: changed to not remove empty groups, N.A. 1.31.2006
             // check if the config group is empty, and if so remove it
             //if (it->second.IsEmpty())
@@ -259,6 +280,7 @@ public:
          return false; // group not found
       if (it->second.Delete(configName, deviceLabel, propName))
       {
+         ++changeCount_;
          return true;
       }
       else
@@ -280,6 +302,7 @@ public:
          return false; // group not found
       if (it->second.Delete(configName))
       {
+         ++changeCount_;
          // NOTE: changed to not remove empty groups, N.A. 1.31.2006
          // check if the config group is empty, and if so remove it
          //if (it->second.IsEmpty())
@@ -303,6 +326,7 @@ public:
       if (it != groups_.end())
       {
          groups_.erase(it->first);
+         ++changeCount_;
          return true;
       }
       return false; //not found
@@ -324,6 +348,7 @@ public:
          {
             groups_[newGroupName] = it->second;
             groups_.erase(it->first);
+            ++changeCount_;
             return true;
          }
          return false; //not found
@@ -366,11 +391,22 @@ public:
    void Clear()
    {
       groups_.clear();
+      ++changeCount_;
+   }
+
+   /**
+    * Returns a number that changes whenever groups or presets are defined,
+    * renamed or deleted (but not when a preset is modified through Find()).
+    */
+   unsigned long long GetChangeCount() const
+   {
+      return changeCount_;
    }
 
 
 private:
    std::map<std::string, ConfigGroup> groups_;
+   unsigned long long changeCount_;
 };
 
 /**
@@ -425,6 +461,7 @@ public:
    {
       PropertySetting setting(deviceLabel, propName, value);
       configs_[resolutionID].addSetting(setting);
+      ++changeCount_;
       if (configs_[resolutionID].getPixelSizeUm() == 0.0)
       {
          // this is the first setting, so it is OK to set pixel size
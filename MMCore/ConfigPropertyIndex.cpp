@@ -0,0 +1,113 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          ConfigPropertyIndex.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Configuration groups by included property
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "ConfigPropertyIndex.h"
+
+#include "ConfigGroup.h"
+
+
+namespace mm
+{
+
+ConfigPropertyIndex::ConfigPropertyIndex(ConfigGroupCollection& groups,
+      PixelSizeConfigGroup& pixelSizeGroup) :
+   groups_(groups),
+   pixelSizeGroup_(pixelSizeGroup),
+   built_(false),
+   groupsChangeCount_(0),
+   pixelSizeChangeCount_(0)
+{
+}
+
+/**
+ * Looks up the configuration groups (in alphabetical order) that include the
+ * property, and whether a pixel size preset does. Returns false if neither
+ * does.
+ */
+bool ConfigPropertyIndex::Find(const std::string& device,
+      const std::string& property, std::vector<std::string>& groups,
+      bool& inPixelSizeConfig)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   if (!built_ || groupsChangeCount_ != groups_.GetChangeCount() ||
+         pixelSizeChangeCount_ != pixelSizeGroup_.GetChangeCount())
+      Rebuild();
+
+   std::map<std::pair<std::string, std::string>, Entry>::const_iterator it =
+      entries_.find(std::make_pair(device, property));
+   if (it == entries_.end())
+   {
+      groups.clear();
+      inPixelSizeConfig = false;
+      return false;
+   }
+   groups = it->second.groups;
+   inPixelSizeConfig = it->second.inPixelSizeConfig;
+   return true;
+}
+
+// Must be called with mutex_ held
+void ConfigPropertyIndex::Rebuild()
+{
+   entries_.clear();
+   groupsChangeCount_ = groups_.GetChangeCount();
+   pixelSizeChangeCount_ = pixelSizeGroup_.GetChangeCount();
+
+   const std::vector<std::string> groupNames = groups_.GetAvailableGroups();
+   for (size_t g = 0; g < groupNames.size(); ++g)
+   {
+      const std::vector<std::string> presets =
+         groups_.GetAvailableConfigs(groupNames[g].c_str());
+      for (size_t p = 0; p < presets.size(); ++p)
+      {
+         const Configuration* config =
+            groups_.Find(groupNames[g].c_str(), presets[p].c_str());
+         if (!config || config->size() <= 1)
+            continue;
+         for (size_t i = 0; i < config->size(); ++i)
+         {
+            const PropertySetting setting = config->getSetting(i);
+            std::vector<std::string>& entryGroups = entries_[std::make_pair(
+                  setting.getDeviceLabel(), setting.getPropertyName())].groups;
+            // Groups are visited in order, so a repeat is always the last one
+            if (entryGroups.empty() || entryGroups.back() != groupNames[g])
+               entryGroups.push_back(groupNames[g]);
+         }
+      }
+   }
+
+   const std::vector<std::string> pixelSizePresets = pixelSizeGroup_.GetAvailable();
+   for (size_t p = 0; p < pixelSizePresets.size(); ++p)
+   {
+      const PixelSizeConfiguration* config =
+         pixelSizeGroup_.Find(pixelSizePresets[p].c_str());
+      if (!config)
+         continue;
+      for (size_t i = 0; i < config->size(); ++i)
+      {
+         const PropertySetting setting = config->getSetting(i);
+         entries_[std::make_pair(setting.getDeviceLabel(),
+               setting.getPropertyName())].inPixelSizeConfig = true;
+      }
+   }
+   built_ = true;
+}
+
+} // namespace mm
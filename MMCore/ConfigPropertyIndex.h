@@ -0,0 +1,79 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          ConfigPropertyIndex.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Configuration groups by included property
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+class ConfigGroupCollection;
+class PixelSizeConfigGroup;
+
+namespace mm
+{
+
+/**
+ * Maps each device property to the configuration groups and pixel size
+ * presets that include it, so that a property change can be related to the
+ * groups it affects without scanning every preset.
+ *
+ * Only groups with a preset of more than one setting are listed, since the
+ * application treats single-property groups differently.
+ *
+ * The index is rebuilt on lookup whenever the change count of the groups or
+ * of the pixel size presets differs from when it was built. Thread-safe.
+ */
+class ConfigPropertyIndex
+{
+   struct Entry
+   {
+      std::vector<std::string> groups;
+      bool inPixelSizeConfig;
+
+      Entry() : inPixelSizeConfig(false) {}
+   };
+
+   ConfigGroupCollection& groups_;
+   PixelSizeConfigGroup& pixelSizeGroup_;
+
+   std::mutex mutex_;
+   bool built_; // Guarded by mutex_
+   unsigned long long groupsChangeCount_; // Guarded by mutex_
+   unsigned long long pixelSizeChangeCount_; // Guarded by mutex_
+   std::map<std::pair<std::string, std::string>, Entry> entries_; // Guarded by mutex_
+
+public:
+   ConfigPropertyIndex(ConfigGroupCollection& groups,
+         PixelSizeConfigGroup& pixelSizeGroup);
+
+   ConfigPropertyIndex(const ConfigPropertyIndex&) = delete;
+   ConfigPropertyIndex& operator=(const ConfigPropertyIndex&) = delete;
+
+   bool Find(const std::string& device, const std::string& property,
+         std::vector<std::string>& groups, bool& inPixelSizeConfig);
+
+private:
+   void Rebuild();
+};
+
+} // namespace mm
@@ -21,6 +21,7 @@
 #include "Configuration.h"
 #include "../MMDevice/MMDevice.h"
 #include "Error.h"
+#include "SymbolTable.h"
 #include <assert.h>
 #include <sstream>
 #include <string>
@@ -29,6 +30,15 @@
 
 using namespace std;
 
+PropertySetting::PropertySetting(const char* deviceLabel, const char* prop, const char* value, bool readOnly) :
+   deviceLabel_(deviceLabel),
+   propertyName_(prop),
+   value_(value),
+   key_(mm::SymbolTable::InternKey(deviceLabel, prop)),
+   readOnly_(readOnly)
+{
+}
+
 string PropertySetting::generateKey(const char* device, const char* prop)
 {
    string key(device);
@@ -93,11 +103,10 @@ PropertySetting Configuration::getSetting(size_t index) const throw (CMMError)
 
 bool Configuration::isPropertyIncluded(const char* device, const char* prop)
 {
-   map<string, int>::iterator it = index_.find(PropertySetting::generateKey(device, prop));
-   if (it != index_.end())
-      return true;
-   else
+   unsigned long long key;
+   if (!mm::SymbolTable::FindKey(device, prop, key))
       return false;
+   return index_.find(key) != index_.end();
 }
 
 /**
@@ -106,14 +115,17 @@ bool Configuration::isPropertyIncluded(const char* device, const char* prop)
 
 PropertySetting Configuration::getSetting(const char* device, const char* prop)
 {
-   map<string, int>::iterator it = index_.find(PropertySetting::generateKey(device, prop));
+   unsigned long long key;
+   unordered_map<unsigned long long, size_t>::iterator it = index_.end();
+   if (mm::SymbolTable::FindKey(device, prop, key))
+      it = index_.find(key);
    if (it == index_.end())
    {
       std::ostringstream errTxt;
       errTxt << "Property " << prop << " not found in device " << device << ".";
       throw CMMError(errTxt.str().c_str(), MMERR_DEVICE_GENERIC);
    }
-   if (((unsigned int) it->second) >= settings_.size()) {
+   if (it->second >= settings_.size()) {
       std::ostringstream errTxt;
       errTxt << "Internal Error locating Property " << prop << " in device " << device << ".";
       throw CMMError(errTxt.str().c_str(), MMERR_DEVICE_GENERIC);
@@ -128,11 +140,8 @@ PropertySetting Configuration::getSetting(const char* device, const char* prop)
 
 bool Configuration::isSettingIncluded(const PropertySetting& ps)
 {
-   map<string, int>::iterator it = index_.find(ps.getKey());
-   if (it != index_.end() && settings_[it->second].getPropertyValue().compare(ps.getPropertyValue()) == 0)
-      return true;
-   else
-      return false;
+   unordered_map<unsigned long long, size_t>::const_iterator it = index_.find(ps.key_);
+   return it != index_.end() && settings_[it->second].value_ == ps.value_;
 }
 
 /**
@@ -156,7 +165,7 @@ bool Configuration::isConfigurationIncluded(const Configuration& cfg)
  */
 void Configuration::addSetting(const PropertySetting& setting)
 {
-   map<string, int>::iterator it = index_.find(setting.getKey());
+   unordered_map<unsigned long long, size_t>::iterator it = index_.find(setting.key_);
    if (it != index_.end())
    {
       // replace
@@ -165,7 +174,7 @@ void Configuration::addSetting(const PropertySetting& setting)
    else
    {
       // add new
-      index_[setting.getKey()] = (int)settings_.size();
+      index_.insert(make_pair(setting.key_, settings_.size()));
       settings_.push_back(setting);
    }
 }
@@ -175,7 +184,10 @@ void Configuration::addSetting(const PropertySetting& setting)
  */
 void Configuration::deleteSetting(const char* device, const char* prop)
 {
-   map<string, int>::iterator it = index_.find(PropertySetting::generateKey(device, prop));
+   unsigned long long key;
+   unordered_map<unsigned long long, size_t>::iterator it = index_.end();
+   if (mm::SymbolTable::FindKey(device, prop, key))
+      it = index_.find(key);
    if (it == index_.end())
    {
       std::ostringstream errTxt;
@@ -183,15 +195,15 @@ void Configuration::deleteSetting(const char* device, const char* prop)
       throw CMMError(errTxt.str().c_str(), MMERR_DEVICE_GENERIC);
    }
 
-   settings_.erase(settings_.begin() + it->second); // The argument of erase produces an iterator at the desired position.
+   const size_t pos = it->second;
+   index_.erase(it);
+   settings_.erase(settings_.begin() + pos);
 
-   // Re-index 
-   index_.clear();
-   for (unsigned int i = 0; i < settings_.size(); i++) 
+   // Re-index the settings that moved down
+   for (size_t i = pos; i < settings_.size(); i++)
    {
-      index_[settings_[i].getKey()] = i;
+      index_[settings_[i].key_] = i;
    }
-
 }
 
 
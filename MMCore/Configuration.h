@@ -30,6 +30,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include "Error.h"
 
 
@@ -45,13 +46,9 @@ struct PropertySetting
     * @param prop
     * @param value 
     */
-    PropertySetting(const char* deviceLabel, const char* prop, const char* value, bool readOnly = false) :
-      deviceLabel_(deviceLabel), propertyName_(prop), value_(value), readOnly_(readOnly)
-      {
-        key_ = generateKey(deviceLabel, prop);
-      }
+    PropertySetting(const char* deviceLabel, const char* prop, const char* value, bool readOnly = false);
 
-    PropertySetting() : readOnly_(false) {}
+    PropertySetting() : key_(0), readOnly_(false) {}
     ~PropertySetting() {}
 
    /**
@@ -71,7 +68,7 @@ struct PropertySetting
     */
    std::string getPropertyValue() const {return value_;}
 
-   std::string getKey() const {return key_;}
+   std::string getKey() const {return generateKey(deviceLabel_.c_str(), propertyName_.c_str());}
 
    static std::string generateKey(const char* device, const char* prop);
 
@@ -79,10 +76,12 @@ struct PropertySetting
    bool isEqualTo(const PropertySetting& ps);
 
 private:
+   friend class Configuration;
+
    std::string deviceLabel_;
    std::string propertyName_;
    std::string value_;
-   std::string key_;
+   unsigned long long key_; // Interned (device, property); see mm::SymbolTable
    bool readOnly_;
 };
 
@@ -148,7 +147,7 @@ public:
  
 private:
    std::vector<PropertySetting> settings_;
-   std::map<std::string, int> index_;
+   std::unordered_map<unsigned long long, size_t> index_; // Key to position in settings_
 };
 
 /**
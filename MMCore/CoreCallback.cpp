@@ -28,12 +28,16 @@
 #include "../MMDevice/DeviceThreads.h"
 #include "../MMDevice/DeviceUtils.h"
 #include "../MMDevice/ImgBuffer.h"
+#include "CameraBufferPool.h"
 #include "CircularBuffer.h"
+#include "ConfigPropertyIndex.h"
 #include "CoreCallback.h"
+#include "DeviceIdleSignal.h"
 #include "DeviceManager.h"
 
 #include <cassert>
 #include <chrono>
+#include <cstdio>
 #include <string>
 #include <vector>
 
@@ -217,30 +221,125 @@ CoreCallback::AddCameraMetadata(const MM::Device* caller, const Metadata* pMd)
       newMD = *pMd;
    }
 
+   AddCameraTags(caller, newMD);
+   return newMD;
+}
+
+/**
+ * Add the camera label and the metadata tags attached to device caller to md.
+ */
+void
+CoreCallback::AddCameraTags(const MM::Device* caller, Metadata& md)
+{
    std::shared_ptr<CameraInstance> camera =
       std::static_pointer_cast<CameraInstance>(
             core_->deviceManager_->GetDevice(caller));
 
    std::string label = camera->GetLabel();
-   newMD.put("Camera", label);
+   md.put("Camera", label);
 
-   std::string serializedMD;
    try
    {
-      serializedMD = camera->GetTags();
+      camera->MergeTags(md);
    }
    catch (const CMMError&)
    {
-      return newMD;
    }
+}
 
-   Metadata devMD;
-   devMD.Restore(serializedMD.c_str());
-   newMD.Merge(devMD);
+/**
+ * Return the camera's own circular buffer, or null if images from the camera
+ * go to the shared buffer (see CMMCore::enablePerCameraCircularBuffers()).
+ */
+std::shared_ptr<CircularBuffer>
+CoreCallback::CameraBuffer(const MM::Device* caller)
+{
+   if (!core_->cameraBuffers_->HasBuffers())
+      return std::shared_ptr<CircularBuffer>();
 
-   return newMD;
+   try
+   {
+      return core_->cameraBuffers_->Find(
+            core_->deviceManager_->GetDevice(caller)->GetLabel());
+   }
+   catch (const CMMError&)
+   {
+      return std::shared_ptr<CircularBuffer>();
+   }
+}
+
+/**
+ * Same as CameraBuffer(caller), for image metadata that has the camera label
+ * added by AddCameraTags().
+ */
+std::shared_ptr<CircularBuffer>
+CoreCallback::CameraBuffer(const Metadata& md)
+{
+   if (!core_->cameraBuffers_->HasBuffers() || !md.HasTag("Camera"))
+      return std::shared_ptr<CircularBuffer>();
+   return core_->cameraBuffers_->Find(md.GetSingleTag("Camera").GetValue());
+}
+
+namespace {
+
+const char* ImageTagKeyword(const MM::ImageTag& tag)
+{
+   switch (tag.key)
+   {
+      case MM::ImageTagElapsedTimeMs:
+         return MM::g_Keyword_Elapsed_Time_ms;
+      case MM::ImageTagROIX:
+         return MM::g_Keyword_Metadata_ROI_X;
+      case MM::ImageTagROIY:
+         return MM::g_Keyword_Metadata_ROI_Y;
+      case MM::ImageTagBinning:
+         return MM::g_Keyword_Binning;
+      case MM::ImageTagScore:
+         return MM::g_Keyword_Metadata_Score;
+      case MM::ImageTagCameraChannelIndex:
+         return MM::g_Keyword_CameraChannelIndex;
+      case MM::ImageTagCameraChannelName:
+         return MM::g_Keyword_CameraChannelName;
+      default:
+         return tag.name;
+   }
+}
+
+/**
+ * Convert binary image tags to metadata, with the same formatting that
+ * devices use for serialized metadata. Tags without a known key are ignored.
+ */
+void PutImageTags(Metadata& md, const MM::ImageTag* tags, unsigned tagCount)
+{
+   for (unsigned i = 0; i < tagCount; ++i)
+   {
+      const MM::ImageTag& tag = tags[i];
+      const char* keyword = ImageTagKeyword(tag);
+      if (!keyword)
+         continue;
+
+      char value[64];
+      switch (tag.type)
+      {
+         case MM::Integer:
+            std::snprintf(value, sizeof(value), "%lld", tag.integerValue);
+            md.PutImageTag(keyword, value);
+            break;
+         case MM::Float:
+            std::snprintf(value, sizeof(value), "%.2f", tag.floatValue);
+            md.PutImageTag(keyword, value);
+            break;
+         case MM::String:
+            md.PutImageTag(keyword, tag.stringValue ? tag.stringValue : "");
+            break;
+         default:
+            break;
+      }
+   }
 }
 
+} // anonymous namespace
+
 int CoreCallback::InsertImage(const MM::Device* caller, const unsigned char* buf, unsigned width, unsigned height, unsigned byteDepth, const char* serializedMetadata, const bool doProcess)
 {
    Metadata md;
@@ -262,7 +361,9 @@ int CoreCallback::InsertImage(const MM::Device* caller, const unsigned char* buf
             ip->Process(const_cast<unsigned char*>(buf), width, height, byteDepth);
          }
       }
-      if (core_->cbuf_->InsertImage(buf, width, height, byteDepth, &md))
+      std::shared_ptr<CircularBuffer> cameraBuffer = CameraBuffer(md);
+      CircularBuffer* buffer = cameraBuffer ? cameraBuffer.get() : core_->cbuf_;
+      if (buffer->InsertImage(buf, width, height, byteDepth, &md))
          return DEVICE_OK;
       else
          return DEVICE_BUFFER_OVERFLOW;
@@ -280,6 +381,13 @@ int CoreCallback::InsertImage(const MM::Device* caller, const unsigned char* buf
    return InsertImage(caller, buf, width, height, byteDepth, nComponents, &md, doProcess);
 }
 
+int CoreCallback::InsertImage(const MM::Device* caller, const unsigned char* buf, unsigned width, unsigned height, unsigned byteDepth, unsigned nComponents, const MM::ImageTag* tags, unsigned tagCount, const bool doProcess)
+{
+   Metadata md;
+   PutImageTags(md, tags, tagCount);
+   return InsertImage(caller, buf, width, height, byteDepth, nComponents, &md, doProcess);
+}
+
 int CoreCallback::InsertImage(const MM::Device* caller, const unsigned char* buf, unsigned width, unsigned height, unsigned byteDepth, unsigned nComponents, const Metadata* pMd, bool doProcess)
 {
    try 
@@ -294,7 +402,9 @@ int CoreCallback::InsertImage(const MM::Device* caller, const unsigned char* buf
             ip->Process(const_cast<unsigned char*>(buf), width, height, byteDepth);
          }
       }
-      if (core_->cbuf_->InsertImage(buf, width, height, byteDepth, nComponents, &md))
+      std::shared_ptr<CircularBuffer> cameraBuffer = CameraBuffer(md);
+      CircularBuffer* buffer = cameraBuffer ? cameraBuffer.get() : core_->cbuf_;
+      if (buffer->InsertImage(buf, width, height, byteDepth, nComponents, &md))
          return DEVICE_OK;
       else
          return DEVICE_BUFFER_OVERFLOW;
@@ -319,9 +429,123 @@ int CoreCallback::InsertImage(const MM::Device* caller, const ImgBuffer & imgBuf
       imgBuf.Height(), imgBuf.Depth(), &md);
 }
 
-void CoreCallback::ClearImageBuffer(const MM::Device* /*caller*/)
+int CoreCallback::AcquireImageSlot(const MM::Device* caller, unsigned width, unsigned height, unsigned byteDepth, unsigned nComponents, unsigned char** slot)
+{
+   if (!slot)
+      return DEVICE_ERR;
+   *slot = 0;
+
+   try
+   {
+      std::shared_ptr<CircularBuffer> cameraBuffer = CameraBuffer(caller);
+      CircularBuffer* buffer = cameraBuffer ? cameraBuffer.get() : core_->cbuf_;
+      unsigned char* pixels = buffer->AcquireSlot(width, height, byteDepth, nComponents);
+      if (!pixels)
+         return DEVICE_BUFFER_OVERFLOW;
+
+      AcquiredSlot acquired;
+      acquired.cameraBuffer = cameraBuffer;
+      acquired.buffer = buffer;
+      {
+         MMThreadGuard g(acquiredSlotsLock_);
+         acquiredSlots_[caller] = acquired;
+      }
+      *slot = pixels;
+      return DEVICE_OK;
+   }
+   catch (CMMError& /*e*/)
+   {
+      return DEVICE_INCOMPATIBLE_IMAGE;
+   }
+}
+
+int CoreCallback::CommitImageSlot(const MM::Device* caller, const char* serializedMetadata, const bool doProcess)
+{
+   Metadata md;
+   md.Restore(serializedMetadata);
+   return CommitImageSlot(caller, md, doProcess);
+}
+
+int CoreCallback::CommitImageSlot(const MM::Device* caller, const MM::ImageTag* tags, unsigned tagCount, const bool doProcess)
+{
+   Metadata md;
+   PutImageTags(md, tags, tagCount);
+   return CommitImageSlot(caller, md, doProcess);
+}
+
+// Common part of the CommitImageSlot() variants; md holds the device-supplied
+// image metadata
+int CoreCallback::CommitImageSlot(const MM::Device* caller, Metadata& md, bool doProcess)
+{
+   AcquiredSlot acquired;
+   if (!TakeAcquiredSlot(caller, acquired))
+      return DEVICE_ERR;
+   CircularBuffer* buffer = acquired.buffer;
+   const mm::ImgBuffer* slot = buffer->GetAcquiredSlot();
+   if (!slot)
+      return DEVICE_ERR;
+
+   try
+   {
+      AddCameraTags(caller, md);
+   }
+   catch (CMMError& /*e*/)
+   {
+      buffer->DiscardSlot();
+      return DEVICE_ERR;
+   }
+
+   if (doProcess)
+   {
+      MM::ImageProcessor* ip = GetImageProcessor(caller);
+      if (NULL != ip)
+      {
+         ip->Process(const_cast<unsigned char*>(slot->GetPixels()),
+               slot->Width(), slot->Height(), slot->Depth());
+      }
+   }
+
+   try
+   {
+      if (buffer->CommitSlot(&md))
+         return DEVICE_OK;
+      else
+         return DEVICE_BUFFER_OVERFLOW;
+   }
+   catch (CMMError& /*e*/)
+   {
+      // The slot has been released, without publishing the image
+      return DEVICE_ERR;
+   }
+}
+
+int CoreCallback::DiscardImageSlot(const MM::Device* caller)
+{
+   AcquiredSlot acquired;
+   if (TakeAcquiredSlot(caller, acquired))
+      acquired.buffer->DiscardSlot();
+   return DEVICE_OK;
+}
+
+// Removes and returns the slot that the caller holds; returns false if it
+// holds none
+bool CoreCallback::TakeAcquiredSlot(const MM::Device* caller, AcquiredSlot& slot)
+{
+   MMThreadGuard g(acquiredSlotsLock_);
+   std::map<const MM::Device*, AcquiredSlot>::iterator it =
+      acquiredSlots_.find(caller);
+   if (it == acquiredSlots_.end())
+      return false;
+   slot = it->second;
+   acquiredSlots_.erase(it);
+   return true;
+}
+
+void CoreCallback::ClearImageBuffer(const MM::Device* caller)
 {
-   core_->cbuf_->Clear();
+   std::shared_ptr<CircularBuffer> cameraBuffer = CameraBuffer(caller);
+   CircularBuffer* buffer = cameraBuffer ? cameraBuffer.get() : core_->cbuf_;
+   buffer->Clear();
 }
 
 bool CoreCallback::InitializeImageBuffer(unsigned channels, unsigned slices,
@@ -351,7 +575,9 @@ int CoreCallback::InsertMultiChannel(const MM::Device* caller,
       {
          ip->Process( const_cast<unsigned char*>(buf), width, height, byteDepth);
       }
-      if (core_->cbuf_->InsertMultiChannel(buf, numChannels, width, height, byteDepth, &md))
+      std::shared_ptr<CircularBuffer> cameraBuffer = CameraBuffer(md);
+      CircularBuffer* buffer = cameraBuffer ? cameraBuffer.get() : core_->cbuf_;
+      if (buffer->InsertMultiChannel(buf, numChannels, width, height, byteDepth, &md))
          return DEVICE_OK;
       else
          return DEVICE_BUFFER_OVERFLOW;
@@ -377,6 +603,8 @@ int CoreCallback::AcqFinished(const MM::Device* caller, int /*statusCode*/)
       return DEVICE_ERR;
    }
 
+   core_->cameraBuffers_->SetStreaming(camera->GetLabel(), false);
+
    std::shared_ptr<DeviceInstance> currentCamera =
       core_->currentCameraDevice_.lock();
 
@@ -387,8 +615,10 @@ int CoreCallback::AcqFinished(const MM::Device* caller, int /*statusCode*/)
       if (shutter)
       {
          // We need to lock the shutter's module for thread safety, but there's
-         // a case where deadlock would result.
-         if (camera->GetAdapterModule() == shutter->GetAdapterModule())
+         // a case where deadlock would result. (Devices of a module that
+         // declared per-device thread safety do not share a lock, so only
+         // the locks are compared.)
+         if (camera->GetLock() == shutter->GetLock())
          {
             // This is a nasty hack to allow the case where the shutter and
             // camera live in the same module. It is not safe, but this is how
@@ -396,8 +626,8 @@ int CoreCallback::AcqFinished(const MM::Device* caller, int /*statusCode*/)
             // think of a fully safe fix that is reasonably simple.
             shutter->SetOpen(false);
          }
-         else if (currentCamera && currentCamera->GetAdapterModule() ==
-               shutter->GetAdapterModule())
+         else if (currentCamera && currentCamera->GetLock() ==
+               shutter->GetLock())
          {
             // Likewise, we might be called as a result of a call to
             // StopSequenceAcquisition() on a virtual wrapper camera device
@@ -470,66 +700,43 @@ int CoreCallback::OnPropertyChanged(const MM::Device* device, const char* propNa
       device->GetLabel(label);
       bool readOnly;
       device->GetPropertyReadOnly(propName, readOnly);
-      const PropertySetting* ps = new PropertySetting(label, propName, value, readOnly);
+      const PropertySetting ps(label, propName, value, readOnly);
       {
          MMThreadGuard scg(core_->stateCacheLock_);
-         core_->stateCache_.addSetting(*ps);
+         core_->addToStateCache(ps);
       }
       core_->externalCallback_->onPropertyChanged(label, propName, value);
 
-      // Find all configs that contain this property and callback to indicate 
-      // that the config group changed
-      // TODO: Assess whether performance is better by maintaining a map tying
-      // property to configurations
-      std::vector<std::string> configGroups = 
-         core_->getAvailableConfigGroups ();
-      for (std::vector<std::string>::iterator it = configGroups.begin(); 
-            it != configGroups.end(); ++it) 
+      // Notify the change of each config group that contains this property,
+      // and of the pixel size if a pixel size config contains it
+      std::vector<std::string> configGroups;
+      bool inPixelSizeConfig;
+      if (!core_->configPropertyIndex_->Find(label, propName, configGroups,
+               inPixelSizeConfig))
+         return DEVICE_OK;
+
+      for (std::vector<std::string>::iterator it = configGroups.begin();
+            it != configGroups.end(); ++it)
       {
-         std::vector<std::string> configs = 
-            core_->getAvailableConfigs((*it).c_str());
-         bool found = false;
-         for (std::vector<std::string>::iterator itc = configs.begin();
-               itc != configs.end() && !found; itc++) 
-         {
-            Configuration config = 
-               core_->getConfigData((*it).c_str(), (*itc).c_str());
-            // only callback when there is more than 1 property in a group
-            // This is needed, since the UI treats groups with one 
-            // property differently, whereas the core does not....
-            if (config.size() > 1 && config.isPropertyIncluded(label, propName)) {
-               found = true;
-               // If we are part of this configuration, notify that it 
-               // was changed. Get the new config from cache rather 
-               // than by querying the hardware
-               std::string currentConfig = 
-                  core_->getCurrentConfigFromCache( (*it).c_str() );
-               OnConfigGroupChanged((*it).c_str(), currentConfig.c_str());
-            }
-         }
+         // Get the new config from cache rather than by querying the
+         // hardware
+         std::string currentConfig =
+            core_->getCurrentConfigFromCache( (*it).c_str() );
+         OnConfigGroupChanged((*it).c_str(), currentConfig.c_str());
       }
-          
 
-      // Check if pixel size was potentially affected.  If so, update from cache
-      std::vector<std::string> pixelSizeConfigs = core_->getAvailablePixelSizeConfigs();
-      bool found = false;
-      for (std::vector<std::string>::iterator itpsc = pixelSizeConfigs.begin();
-            itpsc != pixelSizeConfigs.end() && !found; itpsc++) 
+      if (inPixelSizeConfig)
       {
-         Configuration pixelSizeConfig = core_->getPixelSizeConfigData( (*itpsc).c_str());
-         if (pixelSizeConfig.isPropertyIncluded(label, propName)) {
-            found = true;
-            double pixSizeUm;
-            try {
-               // update pixel size from cache
-               pixSizeUm = core_->getPixelSizeUm(true);
-               OnPixelSizeAffineChanged(core_->getPixelSizeAffine(true));
-            }
-            catch (const CMMError&) {
-               pixSizeUm = 0.0;
-            }
-            OnPixelSizeChanged(pixSizeUm);
+         double pixSizeUm;
+         try {
+            // update pixel size from cache
+            pixSizeUm = core_->getPixelSizeUm(true);
+            OnPixelSizeAffineChanged(core_->getPixelSizeAffine(true));
          }
+         catch (const CMMError&) {
+            pixSizeUm = 0.0;
+         }
+         OnPixelSizeChanged(pixSizeUm);
       }
    }
 
@@ -658,6 +865,16 @@ int CoreCallback::OnMagnifierChanged(const MM::Device* /* device */)
    return DEVICE_OK;
 }
 
+/**
+ * Handler for devices reporting that they are no longer busy; wakes any
+ * thread waiting for devices.
+ */
+int CoreCallback::OnDeviceIdle(const MM::Device* /* device */)
+{
+   core_->deviceIdleSignal_->Notify();
+   return DEVICE_OK;
+}
+
 
 
 int CoreCallback::SetSerialProperties(const char* portName,
@@ -31,6 +31,8 @@
 #include "MMEventCallback.h"
 #include "../MMDevice/DeviceUtils.h"
 
+#include <map>
+
 namespace mm
 {
    class DeviceManager;
@@ -87,11 +89,16 @@ public:
    int InsertImage(const MM::Device* caller, const ImgBuffer& imgBuf); // Note: _not_ mm::ImgBuffer
    int InsertImage(const MM::Device* caller, const unsigned char* buf, unsigned width, unsigned height, unsigned byteDepth, const char* serializedMetadata, const bool doProcess = true);
    int InsertImage(const MM::Device* caller, const unsigned char* buf, unsigned width, unsigned height, unsigned byteDepth, unsigned nComponents, const char* serializedMetadata, const bool doProcess = true);
+   int InsertImage(const MM::Device* caller, const unsigned char* buf, unsigned width, unsigned height, unsigned byteDepth, unsigned nComponents, const MM::ImageTag* tags, unsigned tagCount, const bool doProcess = true);
 
    /*Deprecated*/ int InsertImage(const MM::Device* caller, const unsigned char* buf, unsigned width, unsigned height, unsigned byteDepth, const Metadata* pMd = 0, const bool doProcess = true);
    /*Deprecated*/ int InsertImage(const MM::Device* caller, const unsigned char* buf, unsigned width, unsigned height, unsigned byteDepth, unsigned nComponents, const Metadata* pMd = 0, const bool doProcess = true);
 
    /*Deprecated*/ int InsertMultiChannel(const MM::Device* caller, const unsigned char* buf, unsigned numChannels, unsigned width, unsigned height, unsigned byteDepth, Metadata* pMd = 0);
+   int AcquireImageSlot(const MM::Device* caller, unsigned width, unsigned height, unsigned byteDepth, unsigned nComponents, unsigned char** slot);
+   int CommitImageSlot(const MM::Device* caller, const char* serializedMetadata, const bool doProcess = true);
+   int CommitImageSlot(const MM::Device* caller, const MM::ImageTag* tags, unsigned tagCount, const bool doProcess = true);
+   int DiscardImageSlot(const MM::Device* caller);
    void ClearImageBuffer(const MM::Device* caller);
    bool InitializeImageBuffer(unsigned channels, unsigned slices, unsigned int w, unsigned int h, unsigned int pixDepth);
 
@@ -121,6 +128,7 @@ public:
    int OnExposureChanged(const MM::Device* device, double newExposure);
    int OnSLMExposureChanged(const MM::Device* device, double newExposure);
    int OnMagnifierChanged(const MM::Device* device);
+   int OnDeviceIdle(const MM::Device* device);
 
 
    void NextPostedError(int& errorCode, char* pMessage, int maxlen, int& messageLength);
@@ -141,7 +149,23 @@ private:
    CMMCore* core_;
    MMThreadLock* pValueChangeLock_;
 
+   // The buffer each camera holds a slot in, from AcquireImageSlot() until
+   // CommitImageSlot() or DiscardImageSlot(); kept so that the slot is
+   // released on the same buffer even if the camera buffers change meanwhile
+   struct AcquiredSlot
+   {
+      std::shared_ptr<CircularBuffer> cameraBuffer; // null for the shared buffer
+      CircularBuffer* buffer;
+   };
+   std::map<const MM::Device*, AcquiredSlot> acquiredSlots_;
+   MMThreadLock acquiredSlotsLock_;
+
    Metadata AddCameraMetadata(const MM::Device* caller, const Metadata* pMd);
+   void AddCameraTags(const MM::Device* caller, Metadata& md);
+   int CommitImageSlot(const MM::Device* caller, Metadata& md, bool doProcess);
+   bool TakeAcquiredSlot(const MM::Device* caller, AcquiredSlot& slot);
+   std::shared_ptr<CircularBuffer> CameraBuffer(const MM::Device* caller);
+   std::shared_ptr<CircularBuffer> CameraBuffer(const Metadata& md);
 
    int OnConfigGroupChanged(const char* groupName, const char* newConfigName);
    int OnPixelSizeChanged(double newPixelSizeUm);
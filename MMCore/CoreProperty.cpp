@@ -25,6 +25,7 @@
 //
 
 #include "CoreProperty.h"
+#include "CircularBuffer.h"
 #include "CoreUtils.h"
 #include "MMCore.h"
 #include "Error.h"
@@ -160,6 +161,21 @@ void CorePropertyCollection::Execute(const char* propName, const char* value)
    {
       core_->setChannelGroup(value);
    }
+   // circular buffer memory
+   else if (strcmp(propName, MM::g_Keyword_CoreBufferHugePages) == 0 ||
+         strcmp(propName, MM::g_Keyword_CoreBufferLockMemory) == 0 ||
+         strcmp(propName, MM::g_Keyword_CoreBufferNUMANode) == 0 ||
+         strcmp(propName, MM::g_Keyword_CoreBufferPrefault) == 0)
+   {
+      core_->applyCircularBufferMemoryOptions();
+   }
+   // thread pool
+   else if (strcmp(propName, MM::g_Keyword_CoreThreadPoolSize) == 0 ||
+         strcmp(propName, MM::g_Keyword_CoreThreadPoolAffinity) == 0 ||
+         strcmp(propName, MM::g_Keyword_CoreThreadPoolNUMANode) == 0)
+   {
+      core_->applyThreadPoolOptions();
+   }
    // unknown property
    else
    {
@@ -181,6 +197,11 @@ string CorePropertyCollection::Get(const char* propName) const
             ToString(propName) + ")",
             MMERR_InvalidCoreProperty);
 
+   // Reflects the buffer's current allocation, which changes whenever the
+   // buffer is reallocated
+   if (strcmp(propName, MM::g_Keyword_CoreBufferAllocation) == 0)
+      return core_->cbuf_ ? core_->cbuf_->GetMemoryDescription() : "Not allocated";
+
    return it->second.Get();
 }
 
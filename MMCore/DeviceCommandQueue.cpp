@@ -0,0 +1,116 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          DeviceCommandQueue.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Worker threads running device commands per module
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "DeviceCommandQueue.h"
+
+#include <system_error>
+
+namespace mm
+{
+
+DeviceCommandQueue::DeviceCommandQueue() :
+   stopping_(false)
+{
+}
+
+DeviceCommandQueue::~DeviceCommandQueue()
+{
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+   }
+   cv_.notify_all();
+   for (std::map< const void*, std::unique_ptr<Worker> >::iterator it = workers_.begin(),
+         end = workers_.end(); it != end; ++it)
+      it->second->thread.join();
+}
+
+/**
+ * Queues the job on the worker of the given adapter module. If a worker
+ * thread cannot be started, the job is run on the calling thread.
+ */
+void DeviceCommandQueue::Submit(const void* module, Job job)
+{
+   bool runHere = false;
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      std::unique_ptr<Worker>& worker = workers_[module];
+      if (!worker)
+      {
+         std::unique_ptr<Worker> newWorker(new Worker());
+         try
+         {
+            newWorker->thread = std::thread(&DeviceCommandQueue::Run, this,
+                  newWorker.get());
+            worker = std::move(newWorker);
+         }
+         catch (const std::system_error&)
+         {
+            workers_.erase(module); // Nothing else is queued for this module
+            runHere = true;
+         }
+      }
+      if (!runHere)
+         worker->jobs.push_back(job);
+   }
+   if (runHere)
+      job();
+   else
+      cv_.notify_all();
+}
+
+/**
+ * Blocks until all queued jobs, including ones queued meanwhile, have run.
+ */
+void DeviceCommandQueue::Drain()
+{
+   std::unique_lock<std::mutex> lock(mutex_);
+   cv_.wait(lock, [this] {
+      for (std::map< const void*, std::unique_ptr<Worker> >::const_iterator it = workers_.begin(),
+            end = workers_.end(); it != end; ++it)
+      {
+         if (it->second->running || !it->second->jobs.empty())
+            return false;
+      }
+      return true;
+   });
+}
+
+void DeviceCommandQueue::Run(Worker* worker)
+{
+   std::unique_lock<std::mutex> lock(mutex_);
+   for (;;)
+   {
+      cv_.wait(lock, [this, worker] { return stopping_ || !worker->jobs.empty(); });
+      if (worker->jobs.empty())
+         return; // Stopping
+
+      Job job = worker->jobs.front();
+      worker->jobs.pop_front();
+      worker->running = true;
+      lock.unlock();
+      job();
+      lock.lock();
+      worker->running = false;
+      cv_.notify_all();
+   }
+}
+
+} // namespace mm
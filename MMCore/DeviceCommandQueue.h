@@ -0,0 +1,76 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          DeviceCommandQueue.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Worker threads running device commands per module
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace mm
+{
+
+/**
+ * Runs jobs on one worker thread per adapter module, so that commands to
+ * devices of different modules overlap while those to the same module run
+ * in the order submitted. Workers are started on first use and stopped on
+ * destruction, after running any remaining jobs.
+ *
+ * Jobs must not throw. Thread-safe.
+ */
+class DeviceCommandQueue
+{
+public:
+   typedef std::function<void()> Job;
+
+private:
+   struct Worker
+   {
+      std::thread thread;
+      std::deque<Job> jobs;
+      bool running;
+
+      Worker() : running(false) {}
+   };
+
+   std::mutex mutex_;
+   std::condition_variable cv_; // Signals a new job, finished job or stop
+   bool stopping_; // Guarded by mutex_
+   std::map< const void*, std::unique_ptr<Worker> > workers_; // Guarded by mutex_
+
+public:
+   DeviceCommandQueue();
+   ~DeviceCommandQueue();
+
+   DeviceCommandQueue(const DeviceCommandQueue&) = delete;
+   DeviceCommandQueue& operator=(const DeviceCommandQueue&) = delete;
+
+   void Submit(const void* module, Job job);
+   void Drain();
+
+private:
+   void Run(Worker* worker);
+};
+
+} // namespace mm
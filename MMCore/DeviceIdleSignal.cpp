@@ -0,0 +1,90 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          DeviceIdleSignal.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Notification of devices becoming non-busy
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "DeviceIdleSignal.h"
+
+#include <algorithm>
+
+namespace mm
+{
+
+DeviceIdleSignal::DeviceIdleSignal() :
+   count_(0)
+{
+}
+
+/**
+ * Returns the number of notifications so far.
+ */
+unsigned long long DeviceIdleSignal::GetCount()
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return count_;
+}
+
+/**
+ * Wakes all waiters. Called from device threads.
+ */
+void DeviceIdleSignal::Notify()
+{
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++count_;
+   }
+   cv_.notify_all();
+}
+
+/**
+ * Blocks until there has been a notification since GetCount() returned
+ * count, or until the deadline.
+ */
+void DeviceIdleSignal::WaitUntil(unsigned long long count,
+      std::chrono::steady_clock::time_point deadline)
+{
+   std::unique_lock<std::mutex> lock(mutex_);
+   cv_.wait_until(lock, deadline, [&] { return count_ != count; });
+}
+
+/**
+ * Blocks until busy() returns false, calling it again as soon as there is a
+ * notification and otherwise every polling interval. Returns false if the
+ * deadline passes first.
+ */
+bool DeviceIdleSignal::WaitWhileBusy(const std::function<bool()>& busy,
+      std::chrono::steady_clock::duration pollingInterval,
+      std::chrono::steady_clock::time_point deadline)
+{
+   for (;;)
+   {
+      // Taken before polling, so that a device becoming idle meanwhile
+      // ends the wait below
+      const unsigned long long count = GetCount();
+      if (!busy())
+         return true;
+
+      const std::chrono::steady_clock::time_point now =
+         std::chrono::steady_clock::now();
+      if (now >= deadline)
+         return false;
+      WaitUntil(count, std::min(now + pollingInterval, deadline));
+   }
+}
+
+} // namespace mm
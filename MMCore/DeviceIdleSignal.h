@@ -0,0 +1,63 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          DeviceIdleSignal.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Notification of devices becoming non-busy
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+namespace mm
+{
+
+/**
+ * Wakes threads waiting for devices to become non-busy when a device reports
+ * that it did (MM::Core::OnDeviceIdle()).
+ *
+ * A waiter takes GetCount() before checking the devices, then calls
+ * WaitUntil() with that count if any of them is busy, so that a notification
+ * in between is not missed. Devices that never notify are handled by the
+ * waiter's deadline, which serves as the polling interval. WaitWhileBusy()
+ * implements this.
+ */
+class DeviceIdleSignal
+{
+   std::mutex mutex_;
+   std::condition_variable cv_;
+   unsigned long long count_; // Guarded by mutex_
+
+public:
+   DeviceIdleSignal();
+
+   DeviceIdleSignal(const DeviceIdleSignal&) = delete;
+   DeviceIdleSignal& operator=(const DeviceIdleSignal&) = delete;
+
+   unsigned long long GetCount();
+   void Notify();
+   void WaitUntil(unsigned long long count,
+         std::chrono::steady_clock::time_point deadline);
+
+   bool WaitWhileBusy(const std::function<bool()>& busy,
+         std::chrono::steady_clock::duration pollingInterval,
+         std::chrono::steady_clock::time_point deadline);
+};
+
+} // namespace mm
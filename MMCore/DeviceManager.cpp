@@ -29,6 +29,14 @@ namespace mm
 {
 
 
+DeviceManager::DeviceManager() :
+   deviceRawPtrIndex_(0),
+   currentRawPtrIndex_(new RawPtrIndex())
+{
+   deviceRawPtrIndex_.store(currentRawPtrIndex_.get());
+}
+
+
 DeviceManager::~DeviceManager()
 {
    UnloadAllDevices();
@@ -73,7 +81,7 @@ DeviceManager::LoadDevice(std::shared_ptr<LoadedDeviceAdapter> module,
    }
 
    devices_.push_back(std::make_pair(label, device));
-   deviceRawPtrIndex_.insert(std::make_pair(device->GetRawPtr(), device));
+   AddToRawPtrIndex(device);
    return device;
 }
 
@@ -89,7 +97,7 @@ DeviceManager::UnloadDevice(std::shared_ptr<DeviceInstance> device)
       if (it->second == device)
       {
          device->Shutdown(); // TODO Should be automatic
-         deviceRawPtrIndex_.erase(it->second->GetRawPtr());
+         RemoveFromRawPtrIndex(it->second->GetRawPtr());
          devices_.erase(it);
          break;
       }
@@ -139,7 +147,7 @@ DeviceManager::UnloadAllDevices()
       (*it)->Shutdown();
    }
 
-   deviceRawPtrIndex_.clear();
+   ClearRawPtrIndex();
    devices_.clear();
 
    // Now the only remaining references to the device objects should be in
@@ -152,6 +160,10 @@ DeviceManager::UnloadAllDevices()
    {
       serialDevices.pop_back();
    }
+
+   // Every device has been shut down (stopping its threads) and released,
+   // so nothing can still be reading an old snapshot.
+   FreeRetiredRawPtrIndices();
 }
 
 
@@ -197,9 +209,9 @@ DeviceManager::GetDevice(const char* label) const
 std::shared_ptr<DeviceInstance>
 DeviceManager::GetDevice(const MM::Device* rawPtr) const
 {
-   typedef std::map< const MM::Device*, std::weak_ptr<DeviceInstance> >::const_iterator Iterator;
-   Iterator it = deviceRawPtrIndex_.find(rawPtr);
-   if (it == deviceRawPtrIndex_.end())
+   const RawPtrIndex* index = deviceRawPtrIndex_.load(std::memory_order_acquire);
+   RawPtrIndex::const_iterator it = index->find(rawPtr);
+   if (it == index->end())
       throw CMMError("Invalid device pointer");
    return it->second.lock();
 }
@@ -292,9 +304,70 @@ DeviceManager::GetParentDevice(std::shared_ptr<DeviceInstance> device) const
 }
 
 
+void
+DeviceManager::AddToRawPtrIndex(std::shared_ptr<DeviceInstance> device)
+{
+   std::lock_guard<std::mutex> lock(rawPtrIndexMutex_);
+   std::unique_ptr<RawPtrIndex> index(new RawPtrIndex(*currentRawPtrIndex_));
+   (*index)[device->GetRawPtr()] = device;
+   PublishRawPtrIndex(std::move(index));
+}
+
+
+void
+DeviceManager::RemoveFromRawPtrIndex(const MM::Device* rawPtr)
+{
+   std::lock_guard<std::mutex> lock(rawPtrIndexMutex_);
+   std::unique_ptr<RawPtrIndex> index(new RawPtrIndex(*currentRawPtrIndex_));
+   index->erase(rawPtr);
+   PublishRawPtrIndex(std::move(index));
+}
+
+
+void
+DeviceManager::ClearRawPtrIndex()
+{
+   std::lock_guard<std::mutex> lock(rawPtrIndexMutex_);
+   PublishRawPtrIndex(std::unique_ptr<const RawPtrIndex>(new RawPtrIndex()));
+}
+
+
+// Must be called with rawPtrIndexMutex_ held
+void
+DeviceManager::PublishRawPtrIndex(std::unique_ptr<const RawPtrIndex> index)
+{
+   deviceRawPtrIndex_.store(index.get(), std::memory_order_release);
+   retiredRawPtrIndices_.push_back(std::move(currentRawPtrIndex_));
+   currentRawPtrIndex_ = std::move(index);
+}
+
+
+// Only safe when no device remains that could be calling GetDevice(rawPtr)
+void
+DeviceManager::FreeRetiredRawPtrIndices()
+{
+   std::lock_guard<std::mutex> lock(rawPtrIndexMutex_);
+   retiredRawPtrIndices_.clear();
+}
+
+
 DeviceModuleLockGuard::DeviceModuleLockGuard(std::shared_ptr<DeviceInstance> device) :
-   g_(device->GetAdapterModule()->GetLock())
-{}
+   device_(device),
+   acquired_(LockStatistics::Clock::now()),
+   wait_(),
+   g_(device->GetLock())
+{
+   const LockStatistics::Clock::time_point requested = acquired_;
+   acquired_ = LockStatistics::Clock::now();
+   wait_ = acquired_ - requested;
+}
+
+
+DeviceModuleLockGuard::~DeviceModuleLockGuard()
+{
+   device_->GetLockStatistics().Record(wait_,
+         LockStatistics::Clock::now() - acquired_);
+}
 
 
 } // namespace mm
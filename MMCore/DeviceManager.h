@@ -22,11 +22,14 @@
 #include "CoreUtils.h"
 #include "Devices/DeviceInstance.h"
 #include "Error.h"
+#include "LockStatistics.h"
 #include "Logging/Logger.h"
 
-#include <map>
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 class CMMCore;
@@ -49,12 +52,27 @@ class DeviceManager /* final */
       DeviceIterator;
 
    // Map raw device pointers to DeviceInstance objects, for those few places
-   // where we need to retrieve device information from raw pointers.
-   std::map< const MM::Device*, std::weak_ptr<DeviceInstance> > deviceRawPtrIndex_;
+   // where we need to retrieve device information from raw pointers. These
+   // are mostly device callbacks, made from device threads concurrently with
+   // loading and unloading, so the map is an immutable snapshot that is
+   // replaced (never modified) by the loading thread and read without
+   // locking. Replaced snapshots are retired rather than deleted, since a
+   // reader may still be using one, and freed only once no device remains
+   // that could be making a callback.
+   typedef std::unordered_map< const MM::Device*, std::weak_ptr<DeviceInstance> >
+      RawPtrIndex;
+   std::atomic<const RawPtrIndex*> deviceRawPtrIndex_;
+   std::mutex rawPtrIndexMutex_; // Serializes replacement of the snapshot
+   std::unique_ptr<const RawPtrIndex> currentRawPtrIndex_; // Guarded by rawPtrIndexMutex_
+   std::vector< std::unique_ptr<const RawPtrIndex> > retiredRawPtrIndices_; // Guarded by rawPtrIndexMutex_
 
 public:
+   DeviceManager();
    ~DeviceManager();
 
+   DeviceManager(const DeviceManager&) = delete;
+   DeviceManager& operator=(const DeviceManager&) = delete;
+
    /**
     * \brief Load the specified device and assign a device label.
     */
@@ -107,6 +125,9 @@ public:
 
    /**
     * \brief Get a device from a raw pointer to its MMDevice object.
+    *
+    * Safe to call from any thread, concurrently with loading and unloading;
+    * does not lock or allocate (except to throw).
     */
    std::shared_ptr<DeviceInstance> GetDevice(const MM::Device* rawPtr) const;
 
@@ -129,15 +150,32 @@ public:
     */
    std::shared_ptr<HubInstance> GetParentDevice(std::shared_ptr<DeviceInstance> device) const;
    // TODO GetParentDevice() should be a DeviceInstance method.
+
+private:
+   void AddToRawPtrIndex(std::shared_ptr<DeviceInstance> device);
+   void RemoveFromRawPtrIndex(const MM::Device* rawPtr);
+   void ClearRawPtrIndex();
+   void PublishRawPtrIndex(std::unique_ptr<const RawPtrIndex> index);
+   void FreeRetiredRawPtrIndices();
 };
 
 
-// Scoped acquisition of a device's module's lock
+// Scoped acquisition of a device's module's lock (or of the device's own
+// lock, if its module declared per-device thread safety). The time spent
+// waiting for and holding the lock is recorded in the device's
+// LockStatistics.
 class DeviceModuleLockGuard
 {
+   std::shared_ptr<DeviceInstance> device_;
+   LockStatistics::Clock::time_point acquired_;
+   LockStatistics::Clock::duration wait_;
    MMThreadGuard g_;
 public:
+   DeviceModuleLockGuard(const DeviceModuleLockGuard&) = delete;
+   DeviceModuleLockGuard& operator=(const DeviceModuleLockGuard&) = delete;
+
    explicit DeviceModuleLockGuard(std::shared_ptr<DeviceInstance> device);
+   ~DeviceModuleLockGuard();
 };
 
 } // namespace mm
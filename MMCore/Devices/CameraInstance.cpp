@@ -137,6 +137,23 @@ std::string CameraInstance::GetTags()
    return serializedMetadataBuf.Get();
 }
 
+/**
+ * Merge the device's metadata tags (see GetTags()) into md. The tags are only
+ * parsed again when they have changed.
+ */
+void CameraInstance::MergeTags(Metadata& md)
+{
+   std::string serializedTags = GetTags();
+
+   std::lock_guard<std::mutex> lock(tagsMutex_);
+   if (serializedTags != serializedTags_)
+   {
+      tags_.Restore(serializedTags.c_str());
+      serializedTags_.swap(serializedTags);
+   }
+   md.Merge(tags_);
+}
+
 void CameraInstance::AddTag(const char* key, const char* deviceLabel, const char* value) { return GetImpl()->AddTag(key, deviceLabel, value); }
 void CameraInstance::RemoveTag(const char* key) { return GetImpl()->RemoveTag(key); }
 int CameraInstance::IsExposureSequenceable(bool& isSequenceable) const { return GetImpl()->IsExposureSequenceable(isSequenceable); }
@@ -21,6 +21,8 @@
 
 #include "DeviceInstanceBase.h"
 
+#include <mutex>
+
 
 class CameraInstance : public DeviceInstanceBase<MM::Camera>
 {
@@ -73,6 +75,7 @@ public:
    int PrepareSequenceAcqusition();
    bool IsCapturing();
    std::string GetTags();
+   void MergeTags(Metadata& md);
    void AddTag(const char* key, const char* deviceLabel, const char* value);
    void RemoveTag(const char* key);
    int IsExposureSequenceable(bool& isSequenceable) const;
@@ -82,4 +85,10 @@ public:
    int ClearExposureSequence();
    int AddToExposureSequence(double exposureTime_ms);
    int SendExposureSequence() const;
+
+private:
+   // Last result of GetTags(), and its parsed form
+   std::mutex tagsMutex_;
+   std::string serializedTags_;
+   Metadata tags_;
 };
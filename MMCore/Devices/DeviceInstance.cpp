@@ -52,7 +52,9 @@ DeviceInstance::DeviceInstance(CMMCore* core,
    label_(label),
    deleteFunction_(deleteFunction),
    deviceLogger_(deviceLogger),
-   coreLogger_(coreLogger)
+   coreLogger_(coreLogger),
+   lock_(adapter->DeclaresPerDeviceThreadSafety() ?
+         &deviceLock_ : adapter->GetLock())
 {
    const std::string actualName = GetName();
    if (actualName != name)
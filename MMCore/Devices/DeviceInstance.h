@@ -19,8 +19,10 @@
 
 #pragma once
 
+#include "../../MMDevice/DeviceThreads.h"
 #include "../../MMDevice/MMDeviceConstants.h"
 #include "../Error.h"
+#include "../LockStatistics.h"
 #include "../Logging/Logger.h"
 
 #include <cstring>
@@ -71,6 +73,9 @@ private:
    DeleteDeviceFunction deleteFunction_;
    mm::logging::Logger deviceLogger_;
    mm::logging::Logger coreLogger_;
+   MMThreadLock deviceLock_;
+   MMThreadLock* lock_; // Either deviceLock_ or the module lock
+   mm::LockStatistics lockStatistics_;
 
 public:
    DeviceInstance(const DeviceInstance&) = delete;
@@ -85,6 +90,13 @@ public:
    // need it for the few CoreCallback methods that return a device pointer.
    MM::Device* GetRawPtr() const /* final */ { return pImpl_; }
 
+   // The lock that serializes calls into this device: the module lock,
+   // unless the adapter declared per-device thread safety, in which case a
+   // lock owned by this instance. Fixed for the lifetime of the instance.
+   MMThreadLock* GetLock() const /* final */ { return lock_; }
+   bool UsesPerDeviceLock() const /* final */ { return lock_ == &deviceLock_; }
+   mm::LockStatistics& GetLockStatistics() /* final */ { return lockStatistics_; }
+
    // Callback API
    int LogMessage(const char* msg, bool debugOnly);
 
@@ -78,4 +78,7 @@
 #define MMERR_CreatePeripheralFailed   50
 #define MMERR_PropertyNotInCache       51
 #define MMERR_BadAffineTransform       52
+#define MMERR_CircularBufferImagesPinned 53
+#define MMERR_FrameWriterRunning       54
+#define MMERR_UnknownAsyncCommand      55
 #endif //_ERRORCODES_H_
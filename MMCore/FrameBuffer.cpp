@@ -18,13 +18,16 @@
 
 #include "FrameBuffer.h"
 
+#include "StreamingCopy.h"
+
 #include <cmath>
+#include <cstdint>
 #include <cstring>
 
 namespace mm {
 
 ImgBuffer::ImgBuffer(unsigned xSize, unsigned ySize, unsigned pixDepth) :
-   pixels_(0), width_(xSize), height_(ySize), pixDepth_(pixDepth)
+   pixels_(0), ownsPixels_(true), width_(xSize), height_(ySize), pixDepth_(pixDepth)
 {
    pixels_ = new unsigned char[xSize * ySize * pixDepth];
    memset(pixels_, 0, xSize * ySize * pixDepth);
@@ -32,7 +35,8 @@ ImgBuffer::ImgBuffer(unsigned xSize, unsigned ySize, unsigned pixDepth) :
 
 ImgBuffer::~ImgBuffer()
 {
-   delete[] pixels_;
+   if (ownsPixels_)
+      delete[] pixels_;
 }
 
 const unsigned char* ImgBuffer::GetPixels() const
@@ -42,16 +46,18 @@ const unsigned char* ImgBuffer::GetPixels() const
 
 void ImgBuffer::SetPixels(const void* pix)
 {
-   memcpy((void*)pixels_, pix, width_ * height_ * pixDepth_);
+   CopyFrame((void*)pixels_, pix, width_ * height_ * pixDepth_);
 }
 
 void ImgBuffer::Resize(unsigned xSize, unsigned ySize, unsigned pixDepth)
 {
    // re-allocate internal buffer if it is not big enough
-   if (width_ * height_ * pixDepth_ < xSize * ySize * pixDepth)
+   if (!ownsPixels_ || width_ * height_ * pixDepth_ < xSize * ySize * pixDepth)
    {
-      delete[] pixels_;
+      if (ownsPixels_)
+         delete[] pixels_;
       pixels_ = new unsigned char [xSize * ySize * pixDepth];
+      ownsPixels_ = true;
    }
 
    width_ = xSize;
@@ -62,10 +68,12 @@ void ImgBuffer::Resize(unsigned xSize, unsigned ySize, unsigned pixDepth)
 void ImgBuffer::Resize(unsigned xSize, unsigned ySize)
 {
    // re-allocate internal buffer if it is not big enough
-   if (width_ * height_ < xSize * ySize)
+   if (!ownsPixels_ || width_ * height_ < xSize * ySize)
    {
-      delete[] pixels_;
+      if (ownsPixels_)
+         delete[] pixels_;
       pixels_ = new unsigned char[xSize * ySize * pixDepth_];
+      ownsPixels_ = true;
    }
 
    width_ = xSize;
@@ -74,6 +82,21 @@ void ImgBuffer::Resize(unsigned xSize, unsigned ySize)
    memset(pixels_, 0, width_ * height_ * pixDepth_);
 }
 
+/**
+ * Use memory owned by the caller for the pixels, which must stay valid for as
+ * long as the image is in use (or until the next Resize() or Attach()).
+ */
+void ImgBuffer::Attach(unsigned char* pixels, unsigned xSize, unsigned ySize, unsigned pixDepth)
+{
+   if (ownsPixels_)
+      delete[] pixels_;
+   pixels_ = pixels;
+   ownsPixels_ = false;
+   width_ = xSize;
+   height_ = ySize;
+   pixDepth_ = pixDepth;
+}
+
 void ImgBuffer::SetMetadata(const Metadata& md)
 {
    //metadata_ = md;
@@ -88,14 +111,16 @@ void ImgBuffer::SetMetadata(const Metadata& md)
 // FrameBuffer class
 ///////////////////////////////////////////////////////////////////////////////
 
-FrameBuffer::FrameBuffer(unsigned xSize, unsigned ySize, unsigned byteDepth)
+FrameBuffer::FrameBuffer(unsigned xSize, unsigned ySize, unsigned byteDepth) :
+   channelLimit_(SIZE_MAX)
 {
    width_ = xSize;
    height_ = ySize;
    depth_ = byteDepth;
 }
 
-FrameBuffer::FrameBuffer()
+FrameBuffer::FrameBuffer() :
+   channelLimit_(SIZE_MAX)
 {
    width_ = 0;
    height_ = 0;
@@ -115,6 +140,7 @@ void FrameBuffer::Clear()
       delete *it;
    }
    channels_.clear();
+   channelLimit_ = SIZE_MAX;
 }
 
 void FrameBuffer::Preallocate(unsigned channels)
@@ -127,6 +153,29 @@ void FrameBuffer::Preallocate(unsigned channels)
    }
 }
 
+/**
+ * Point the images of the first channels at consecutive planes of memory
+ * owned by the caller. Images of any further channels are kept (so that
+ * pointers to them stay valid) but hidden from FindImage() until the next
+ * call.
+ */
+void FrameBuffer::Attach(unsigned char* pixels, unsigned channels, unsigned xSize, unsigned ySize, unsigned byteDepth)
+{
+   const size_t planeSize = (size_t)xSize * ySize * byteDepth;
+   channelLimit_ = SIZE_MAX;
+   for (unsigned i = 0; i < channels; i++)
+   {
+      ImgBuffer* img = FindImage(i);
+      if (!img)
+         img = InsertNewImage(i);
+      img->Attach(pixels + i * planeSize, xSize, ySize, byteDepth);
+   }
+   channelLimit_ = channels;
+   width_ = xSize;
+   height_ = ySize;
+   depth_ = byteDepth;
+}
+
 void FrameBuffer::Resize(unsigned xSize, unsigned ySize, unsigned byteDepth)
 {
    Clear();
@@ -165,7 +214,7 @@ const unsigned char* FrameBuffer::GetPixels(unsigned channel) const
 
 ImgBuffer* FrameBuffer::FindImage(unsigned channel) const
 {
-   if (channel >= channels_.size())
+   if (channel >= channels_.size() || channel >= channelLimit_)
       return 0;
    return channels_[channel];
 }
@@ -29,6 +29,7 @@ namespace mm {
 class ImgBuffer
 {
    unsigned char* pixels_;
+   bool ownsPixels_;
    unsigned int width_;
    unsigned int height_;
    unsigned int pixDepth_;
@@ -46,6 +47,7 @@ public:
 
    void Resize(unsigned xSize, unsigned ySize, unsigned pixDepth);
    void Resize(unsigned xSize, unsigned ySize);
+   void Attach(unsigned char* pixels, unsigned xSize, unsigned ySize, unsigned pixDepth);
 
    void SetMetadata(const Metadata& md);
    const Metadata& GetMetadata() const {return metadata_;}
@@ -59,6 +61,8 @@ class FrameBuffer
    // Holds null for any unallocated channels, and is as long as need to
    // contain the allocated channels.
    std::vector<ImgBuffer*> channels_;
+   // Channels at or beyond this index are hidden (see Attach())
+   size_t channelLimit_;
    unsigned int width_;
    unsigned int height_;
    unsigned int depth_;
@@ -71,6 +75,7 @@ public:
    void Resize(unsigned xSize, unsigned ySize, unsigned pixDepth);
    void Clear();
    void Preallocate(unsigned channels);
+   void Attach(unsigned char* pixels, unsigned channels, unsigned xSize, unsigned ySize, unsigned byteDepth);
 
    ImgBuffer* FindImage(unsigned channel) const;
    const unsigned char* GetPixels(unsigned channel) const;
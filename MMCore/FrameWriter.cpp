@@ -0,0 +1,439 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          FrameWriter.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Writes images inserted into the circular buffer to disk
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "FrameWriter.h"
+
+#include "CircularBuffer.h"
+#include "ErrorCodes.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace mm
+{
+
+namespace
+{
+
+// Unbuffered writes must be aligned to the storage's logical block size,
+// which is at most this on current hardware
+const size_t directIOAlignment = 4096;
+
+// How long the collector waits for new images when the buffer is drained
+const std::chrono::microseconds pollInterval(500);
+
+const unsigned indexMagic = 0x4d4d4649; // "MMFI"
+const unsigned indexVersion = 1;
+
+size_t RoundUp(size_t bytes, size_t multiple)
+{
+   return (bytes + multiple - 1) / multiple * multiple;
+}
+
+} // anonymous namespace
+
+/**
+ * Creates (or truncates) the files and starts writing. Throws if the files
+ * cannot be created.
+ */
+FrameWriter::FrameWriter(CircularBuffer& buffer, const std::string& path,
+      const FrameWriterOptions& options) throw (CMMError) :
+   buffer_(buffer),
+   path_(path),
+   options_(options),
+   directIO_(false),
+#ifdef _WIN32
+   file_(INVALID_HANDLE_VALUE),
+#else
+   fd_(-1),
+#endif
+   index_(0),
+   collectorDone_(false),
+   chunk_(0),
+   chunkFill_(0),
+   chunkOffset_(0),
+   rawBytes_(0),
+   stopRequested_(false),
+   failed_(false),
+   running_(false),
+   imageCount_(0),
+   bytesWritten_(0),
+   elapsed_(0),
+   stopped_(false)
+{
+   options_.chunkBytes = RoundUp(std::max<size_t>(options_.chunkBytes, 1),
+         directIOAlignment);
+   options_.chunkCount = std::max(options_.chunkCount, 2u);
+   options_.ioThreadCount = std::max(options_.ioThreadCount, 1u);
+
+   try
+   {
+      chunkMemory_.reset(new BufferMemory(
+               options_.chunkBytes * options_.chunkCount, BufferMemoryOptions()));
+   }
+   catch (const std::bad_alloc&)
+   {
+      throw CMMError("Cannot allocate memory for the frame writer",
+            MMERR_OutOfMemory);
+   }
+   for (unsigned i = 1; i < options_.chunkCount; ++i)
+      freeChunks_.push_back(chunkMemory_->Get() + i * options_.chunkBytes);
+   chunk_ = chunkMemory_->Get();
+
+   OpenRawFile();
+   const std::string indexPath = path_ + ".idx";
+   index_ = std::fopen(indexPath.c_str(), "wb");
+   if (!index_)
+   {
+      CloseFiles();
+      throw CMMError("Cannot create frame writer index file " + indexPath,
+            MMERR_FileOpenFailed);
+   }
+   std::setvbuf(index_, 0, _IOFBF, 1 << 20);
+   IndexHeader header;
+   header.magic = indexMagic;
+   header.version = indexVersion;
+   header.entryBytes = sizeof(IndexEntry);
+   header.reserved = 0;
+   std::fwrite(&header, sizeof(header), 1, index_);
+
+   buffer_.AttachWriter();
+   running_ = true;
+   startTime_ = std::chrono::steady_clock::now();
+   for (unsigned i = 0; i < options_.ioThreadCount; ++i)
+      ioThreads_.emplace_back(&FrameWriter::WriteLoop, this);
+   collector_ = std::thread(&FrameWriter::CollectLoop, this);
+}
+
+FrameWriter::~FrameWriter()
+{
+   try
+   {
+      Stop();
+   }
+   catch (const CMMError&)
+   {
+   }
+}
+
+void FrameWriter::OpenRawFile() throw (CMMError)
+{
+   const std::string rawPath = path_ + ".raw";
+#ifdef _WIN32
+   const DWORD flags = FILE_ATTRIBUTE_NORMAL;
+   if (options_.directIO)
+   {
+      file_ = CreateFileA(rawPath.c_str(), GENERIC_WRITE, 0, NULL,
+            CREATE_ALWAYS, flags | FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH,
+            NULL);
+      directIO_ = file_ != INVALID_HANDLE_VALUE;
+   }
+   if (file_ == INVALID_HANDLE_VALUE)
+      file_ = CreateFileA(rawPath.c_str(), GENERIC_WRITE, 0, NULL,
+            CREATE_ALWAYS, flags, NULL);
+   if (file_ == INVALID_HANDLE_VALUE)
+#else
+   const int flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+   // Fails with EINVAL on file systems that do not support direct I/O
+   if (options_.directIO)
+   {
+      fd_ = open(rawPath.c_str(), flags | O_DIRECT, 0644);
+      directIO_ = fd_ >= 0;
+   }
+#endif
+   if (fd_ < 0)
+      fd_ = open(rawPath.c_str(), flags, 0644);
+#ifdef F_NOCACHE
+   if (fd_ >= 0 && options_.directIO)
+      directIO_ = fcntl(fd_, F_NOCACHE, 1) == 0;
+#endif
+   if (fd_ < 0)
+#endif
+   {
+      throw CMMError("Cannot create frame writer file " + rawPath,
+            MMERR_FileOpenFailed);
+   }
+}
+
+void FrameWriter::CloseFiles()
+{
+#ifdef _WIN32
+   if (file_ != INVALID_HANDLE_VALUE)
+      CloseHandle(file_);
+   file_ = INVALID_HANDLE_VALUE;
+#else
+   if (fd_ >= 0)
+      close(fd_);
+   fd_ = -1;
+#endif
+   if (index_)
+      std::fclose(index_);
+   index_ = 0;
+}
+
+/**
+ * Writes the images remaining in the buffer, waits for the writes to
+ * complete and closes the files. Throws if writing failed at any point.
+ */
+void FrameWriter::Stop() throw (CMMError)
+{
+   if (!stopped_)
+   {
+      stopped_ = true;
+      stopRequested_ = true;
+      collector_.join();
+      for (size_t i = 0; i < ioThreads_.size(); ++i)
+         ioThreads_[i].join();
+      ioThreads_.clear();
+
+      // Unbuffered writes of the last chunk were padded
+      if (!failed_ && !TruncateRawFile(rawBytes_))
+         Fail("Cannot set the size of " + path_ + ".raw");
+      if (index_ && (std::fflush(index_) != 0 || std::ferror(index_)))
+         Fail("Cannot write " + path_ + ".idx");
+      CloseFiles();
+      elapsed_ = (std::chrono::steady_clock::now() - startTime_).count();
+      running_ = false;
+   }
+
+   if (failed_)
+      throw CMMError("Frame writer failed: " + GetError());
+}
+
+/**
+ * Returns the average rate at which pixels were written since the start, in
+ * megabytes (2^20 bytes) per second.
+ */
+double FrameWriter::GetWriteRateMBps() const
+{
+   std::chrono::steady_clock::duration elapsed;
+   if (running_)
+      elapsed = std::chrono::steady_clock::now() - startTime_;
+   else
+      elapsed = std::chrono::steady_clock::duration(elapsed_);
+   const double seconds = std::chrono::duration<double>(elapsed).count();
+   if (seconds <= 0.0)
+      return 0.0;
+   return (double)bytesWritten_ / (1 << 20) / seconds;
+}
+
+/**
+ * Returns the description of the first error, or an empty string.
+ */
+std::string FrameWriter::GetError()
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   return error_;
+}
+
+void FrameWriter::Fail(const std::string& message)
+{
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (error_.empty())
+         error_ = message;
+      failed_ = true;
+   }
+   chunkFreed_.notify_all();
+}
+
+void FrameWriter::CollectLoop()
+{
+   std::vector<ImageHandle> channels;
+   while (!failed_)
+   {
+      // Stop only once the buffer is drained
+      const bool stopping = stopRequested_;
+      if (!buffer_.GetNextWriterFrame(channels))
+      {
+         if (stopping)
+            break;
+         std::this_thread::sleep_for(pollInterval);
+         continue;
+      }
+      for (unsigned channel = 0; channel < channels.size(); ++channel)
+      {
+         if (!AppendImage(channels[channel], channel))
+            break;
+      }
+      channels.clear();
+      ++imageCount_;
+   }
+   channels.clear();
+
+   // Do not hold up the buffer's readers and producer any longer
+   buffer_.DetachWriter();
+
+   if (!failed_ && chunkFill_ > 0)
+      QueueChunk();
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      collectorDone_ = true;
+   }
+   chunkQueued_.notify_all();
+}
+
+// Called by the collector thread. Copies the pixels into chunks and adds the
+// index entry.
+bool FrameWriter::AppendImage(const ImageHandle& image, unsigned channel)
+{
+   const unsigned char* pixels = static_cast<const unsigned char*>(image.getPixels());
+   const std::string metadata = image.getMetadata().Serialize();
+
+   IndexEntry entry;
+   entry.frame = imageCount_;
+   entry.offset = rawBytes_;
+   entry.channel = channel;
+   entry.width = image.getImageWidth();
+   entry.height = image.getImageHeight();
+   entry.bytesPerPixel = image.getBytesPerPixel();
+   entry.components = image.getNumberOfComponents();
+   entry.metadataBytes = (unsigned)metadata.size();
+   if (std::fwrite(&entry, sizeof(entry), 1, index_) != 1 ||
+         std::fwrite(metadata.data(), 1, metadata.size(), index_) != metadata.size())
+   {
+      Fail("Cannot write " + path_ + ".idx");
+      return false;
+   }
+
+   size_t remaining = (size_t)entry.width * entry.height * entry.bytesPerPixel;
+   rawBytes_ += remaining;
+   while (remaining > 0)
+   {
+      const size_t bytes = std::min(remaining, options_.chunkBytes - chunkFill_);
+      memcpy(chunk_ + chunkFill_, pixels, bytes);
+      chunkFill_ += bytes;
+      pixels += bytes;
+      remaining -= bytes;
+      if (chunkFill_ == options_.chunkBytes && !QueueChunk())
+         return false;
+   }
+   return true;
+}
+
+// Called by the collector thread. Hands the current chunk to the I/O threads
+// and waits for a free one.
+bool FrameWriter::QueueChunk()
+{
+   Chunk chunk;
+   chunk.data = chunk_;
+   chunk.offset = chunkOffset_;
+   chunk.bytes = chunkFill_;
+
+   std::unique_lock<std::mutex> lock(mutex_);
+   pendingChunks_.push_back(chunk);
+   chunkQueued_.notify_one();
+   chunk_ = 0;
+   chunkFill_ = 0;
+   chunkOffset_ += options_.chunkBytes;
+   chunkFreed_.wait(lock, [this] { return !freeChunks_.empty() || failed_; });
+   if (freeChunks_.empty())
+      return false;
+   chunk_ = freeChunks_.back();
+   freeChunks_.pop_back();
+   return true;
+}
+
+void FrameWriter::WriteLoop()
+{
+   for (;;)
+   {
+      Chunk chunk;
+      {
+         std::unique_lock<std::mutex> lock(mutex_);
+         chunkQueued_.wait(lock, [this] {
+            return !pendingChunks_.empty() || collectorDone_;
+         });
+         if (pendingChunks_.empty())
+            return;
+         chunk = pendingChunks_.front();
+         pendingChunks_.pop_front();
+      }
+
+      // Only the last chunk can be partly filled; unbuffered writes are
+      // padded and the file is truncated afterwards
+      const size_t bytes = directIO_ ?
+         RoundUp(chunk.bytes, directIOAlignment) : chunk.bytes;
+      if (!failed_)
+      {
+         if (WriteAt(chunk.data, bytes, chunk.offset))
+            bytesWritten_ += chunk.bytes;
+         else
+            Fail("Cannot write " + path_ + ".raw");
+      }
+
+      {
+         std::lock_guard<std::mutex> lock(mutex_);
+         freeChunks_.push_back(chunk.data);
+      }
+      chunkFreed_.notify_one();
+   }
+}
+
+bool FrameWriter::WriteAt(const unsigned char* data, size_t bytes,
+      unsigned long long offset)
+{
+   while (bytes > 0)
+   {
+#ifdef _WIN32
+      OVERLAPPED position;
+      memset(&position, 0, sizeof(position));
+      position.Offset = (DWORD)offset;
+      position.OffsetHigh = (DWORD)(offset >> 32);
+      const DWORD request = (DWORD)std::min<size_t>(bytes, 1 << 30);
+      DWORD written = 0;
+      if (!WriteFile(file_, data, request, &written, &position) || written == 0)
+         return false;
+#else
+      const ssize_t written = pwrite(fd_, data, bytes, (off_t)offset);
+      if (written < 0 && errno == EINTR)
+         continue;
+      if (written <= 0)
+         return false;
+#endif
+      data += written;
+      bytes -= (size_t)written;
+      offset += (unsigned long long)written;
+   }
+   return true;
+}
+
+bool FrameWriter::TruncateRawFile(unsigned long long bytes)
+{
+#ifdef _WIN32
+   FILE_END_OF_FILE_INFO info;
+   info.EndOfFile.QuadPart = (LONGLONG)bytes;
+   return SetFileInformationByHandle(file_, FileEndOfFileInfo, &info,
+         sizeof(info)) != 0;
+#else
+   return ftruncate(fd_, (off_t)bytes) == 0;
+#endif
+}
+
+} // namespace mm
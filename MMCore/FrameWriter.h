@@ -0,0 +1,176 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          FrameWriter.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Writes images inserted into the circular buffer to disk
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include "BufferMemory.h"
+#include "Error.h"
+#include "ImageHandle.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _MSC_VER
+#pragma warning(disable : 4290) // exception declaration warning
+#endif
+
+class CircularBuffer;
+
+namespace mm
+{
+
+struct FrameWriterOptions
+{
+   bool directIO; // Bypass the page cache, if the file system allows
+   unsigned ioThreadCount;
+   size_t chunkBytes; // Size of each write (rounded up to a multiple of 4 KiB)
+   unsigned chunkCount; // Chunks being filled or written at a time
+
+   FrameWriterOptions() :
+      directIO(true),
+      ioThreadCount(2),
+      chunkBytes(8 << 20),
+      chunkCount(8)
+   {}
+};
+
+/**
+ * Writes every image inserted into a circular buffer to disk, on threads of
+ * its own, while the buffer's readers carry on as usual.
+ *
+ * Two files are written:
+ * - <path>.raw holds the pixels of all images back to back, in insertion
+ *   order (channels of a multi-channel image in order);
+ * - <path>.idx holds a header followed by an entry for each image: the
+ *   position of its pixels in the raw file, its geometry, and its serialized
+ *   metadata.
+ *
+ * A collector thread copies images out of the buffer into large, aligned
+ * chunks, which the I/O threads write at their place in the raw file (with
+ * O_DIRECT or FILE_FLAG_NO_BUFFERING where possible). When the disk cannot
+ * keep up, the buffer fills up as it would with a slow reader.
+ */
+class FrameWriter
+{
+   struct Chunk
+   {
+      unsigned char* data;
+      unsigned long long offset;
+      size_t bytes;
+   };
+
+   // Layout of the index file, in native byte order
+   struct IndexHeader
+   {
+      unsigned magic;
+      unsigned version;
+      unsigned entryBytes;
+      unsigned reserved;
+   };
+
+   struct IndexEntry
+   {
+      unsigned long long frame;
+      unsigned long long offset;
+      unsigned channel;
+      unsigned width;
+      unsigned height;
+      unsigned bytesPerPixel;
+      unsigned components;
+      unsigned metadataBytes; // Serialized metadata follows the entry
+   };
+
+   CircularBuffer& buffer_;
+   const std::string path_;
+   FrameWriterOptions options_;
+   bool directIO_;
+#ifdef _WIN32
+   void* file_;
+#else
+   int fd_;
+#endif
+   std::FILE* index_;
+
+   std::unique_ptr<BufferMemory> chunkMemory_;
+   std::mutex mutex_;
+   std::condition_variable chunkQueued_;
+   std::condition_variable chunkFreed_;
+   std::deque<Chunk> pendingChunks_; // Guarded by mutex_
+   std::vector<unsigned char*> freeChunks_; // Guarded by mutex_
+   bool collectorDone_; // Guarded by mutex_
+   std::string error_; // Guarded by mutex_
+
+   // Used by the collector thread only
+   unsigned char* chunk_;
+   size_t chunkFill_;
+   unsigned long long chunkOffset_;
+   unsigned long long rawBytes_;
+
+   std::atomic<bool> stopRequested_;
+   std::atomic<bool> failed_;
+   std::atomic<bool> running_;
+   std::atomic<unsigned long long> imageCount_;
+   std::atomic<unsigned long long> bytesWritten_;
+   std::chrono::steady_clock::time_point startTime_;
+   std::atomic<std::chrono::steady_clock::rep> elapsed_; // Set when stopped
+
+   std::thread collector_;
+   std::vector<std::thread> ioThreads_;
+   bool stopped_;
+
+public:
+   FrameWriter(CircularBuffer& buffer, const std::string& path,
+         const FrameWriterOptions& options) throw (CMMError);
+   ~FrameWriter();
+
+   FrameWriter(const FrameWriter&) = delete;
+   FrameWriter& operator=(const FrameWriter&) = delete;
+
+   void Stop() throw (CMMError);
+
+   const std::string& GetPath() const { return path_; }
+   bool IsRunning() const { return running_; }
+   bool IsDirectIO() const { return directIO_; }
+   unsigned long long GetImageCount() const { return imageCount_; }
+   unsigned long long GetBytesWritten() const { return bytesWritten_; }
+   double GetWriteRateMBps() const;
+   std::string GetError();
+
+private:
+   void OpenRawFile() throw (CMMError);
+   void CloseFiles();
+   void CollectLoop();
+   void WriteLoop();
+   bool AppendImage(const ImageHandle& image, unsigned channel);
+   bool QueueChunk();
+   bool WriteAt(const unsigned char* data, size_t bytes, unsigned long long offset);
+   bool TruncateRawFile(unsigned long long bytes);
+   void Fail(const std::string& message);
+};
+
+} // namespace mm
@@ -0,0 +1,96 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          ImageHandle.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Reference-counted handle to an image in the circular buffer
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "ImageHandle.h"
+
+#include "CircularBuffer.h"
+#include "FrameBuffer.h"
+
+
+ImageHandle::ImageHandle() :
+   image_(0),
+   nComponents_(0)
+{
+}
+
+ImageHandle::ImageHandle(std::shared_ptr<void> keepAlive,
+      const mm::ImgBuffer* image, unsigned nComponents) :
+   keepAlive_(keepAlive),
+   image_(image),
+   nComponents_(nComponents)
+{
+}
+
+bool ImageHandle::isValid() const
+{
+   return image_ != 0;
+}
+
+/**
+ * Drops this handle's reference to the image. The buffer slot is unpinned
+ * once all copies of the handle have been released.
+ */
+void ImageHandle::release()
+{
+   keepAlive_.reset();
+   image_ = 0;
+}
+
+const mm::ImgBuffer* ImageHandle::GetImage() const throw (CMMError)
+{
+   if (!image_)
+      throw CMMError("Image handle is not valid");
+   return image_;
+}
+
+/**
+ * Returns the pixels of the image, which remain valid (and unmodified) until
+ * the handle is released.
+ */
+void* ImageHandle::getPixels() const throw (CMMError)
+{
+   return const_cast<unsigned char*>(GetImage()->GetPixels());
+}
+
+unsigned ImageHandle::getImageWidth() const throw (CMMError)
+{
+   return GetImage()->Width();
+}
+
+unsigned ImageHandle::getImageHeight() const throw (CMMError)
+{
+   return GetImage()->Height();
+}
+
+unsigned ImageHandle::getBytesPerPixel() const throw (CMMError)
+{
+   return GetImage()->Depth();
+}
+
+unsigned ImageHandle::getNumberOfComponents() const throw (CMMError)
+{
+   GetImage();
+   return nComponents_;
+}
+
+Metadata ImageHandle::getMetadata() const throw (CMMError)
+{
+   return GetImage()->GetMetadata();
+}
@@ -0,0 +1,79 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          ImageHandle.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Reference-counted handle to an image in the circular buffer
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#ifdef _MSC_VER
+#pragma warning(disable : 4290) // exception declaration warning
+#endif
+
+#include "Error.h"
+#include "../MMDevice/ImageMetadata.h"
+
+#include <memory>
+
+class CircularBuffer;
+
+namespace mm {
+   class ImgBuffer;
+} // namespace mm
+
+
+/// A reference to an image held in the circular (sequence) buffer.
+/**
+ * As long as any copy of a valid handle exists, the buffer slot containing the
+ * image is pinned: new images are not written into it (insertion backs off as
+ * if the buffer were full), so the pixels can be read in place without a
+ * defensive copy. Call release() (or destroy all copies) as soon as the image
+ * is no longer needed, or the acquisition will eventually stall.
+ *
+ * Handles must be released before the circular buffer is reallocated (e.g.
+ * by changing its memory footprint or the image dimensions).
+ *
+ * An image that the buffer had spilled to disk is read back into memory owned
+ * by the handle, and pins nothing.
+ */
+class ImageHandle
+{
+public:
+   ImageHandle();
+
+   bool isValid() const;
+   void release();
+
+   void* getPixels() const throw (CMMError);
+   unsigned getImageWidth() const throw (CMMError);
+   unsigned getImageHeight() const throw (CMMError);
+   unsigned getBytesPerPixel() const throw (CMMError);
+   unsigned getNumberOfComponents() const throw (CMMError);
+   Metadata getMetadata() const throw (CMMError);
+
+private:
+   friend class CircularBuffer;
+   ImageHandle(std::shared_ptr<void> keepAlive, const mm::ImgBuffer* image,
+         unsigned nComponents);
+
+   const mm::ImgBuffer* GetImage() const throw (CMMError);
+
+   // The pin of the buffer slot, or the image itself if it was spilled
+   std::shared_ptr<void> keepAlive_;
+   const mm::ImgBuffer* image_;
+   unsigned nComponents_;
+};
@@ -31,6 +31,7 @@
 
 LoadedDeviceAdapter::LoadedDeviceAdapter(const std::string& name, const std::string& filename) :
    name_(name),
+   perDeviceThreadSafety_(false),
    InitializeModuleData_(0),
    CreateDevice_(0),
    DeleteDevice_(0),
@@ -39,7 +40,8 @@ LoadedDeviceAdapter::LoadedDeviceAdapter(const std::string& name, const std::str
    GetNumberOfDevices_(0),
    GetDeviceName_(0),
    GetDeviceType_(0),
-   GetDeviceDescription_(0)
+   GetDeviceDescription_(0),
+   GetPerDeviceThreadSafety_(0)
 {
    try
    {
@@ -63,6 +65,7 @@ LoadedDeviceAdapter::LoadedDeviceAdapter(const std::string& name, const std::str
    }
 
    InitializeModuleData();
+   perDeviceThreadSafety_ = GetPerDeviceThreadSafety();
 }
 
 
@@ -318,3 +321,13 @@ LoadedDeviceAdapter::GetDeviceDescription(const char* deviceName, char* buf, uns
          (module_->GetFunction("GetDeviceDescription"));
    return GetDeviceDescription_(deviceName, buf, bufLen);
 }
+
+
+bool
+LoadedDeviceAdapter::GetPerDeviceThreadSafety() const
+{
+   if (!GetPerDeviceThreadSafety_)
+      GetPerDeviceThreadSafety_ = reinterpret_cast<fnGetPerDeviceThreadSafety>
+         (module_->GetFunction("GetPerDeviceThreadSafety"));
+   return GetPerDeviceThreadSafety_();
+}
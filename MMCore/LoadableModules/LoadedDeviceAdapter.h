@@ -55,6 +55,11 @@ public:
    // adapter.
    MMThreadLock* GetLock();
 
+   // True if the module declared (via DeclarePerDeviceThreadSafety()) that
+   // its devices only need to be locked individually. Queried once, after
+   // InitializeModuleData().
+   bool DeclaresPerDeviceThreadSafety() const { return perDeviceThreadSafety_; }
+
    std::vector<std::string> GetAvailableDeviceNames() const;
    std::string GetDeviceDescription(const std::string& deviceName) const;
    MM::DeviceType GetAdvertisedDeviceType(const std::string& deviceName) const;
@@ -105,6 +110,7 @@ private:
    bool GetDeviceDescription(const char* deviceName,
          char* buf, unsigned bufLen) const;
    bool GetDeviceType(const char* deviceName, int* type) const;
+   bool GetPerDeviceThreadSafety() const;
    MM::Device* CreateDevice(const char* deviceName);
    void DeleteDevice(MM::Device* device);
 
@@ -112,6 +118,7 @@ private:
    std::shared_ptr<LoadedModule> module_;
 
    MMThreadLock lock_;
+   bool perDeviceThreadSafety_;
 
    // Cached function pointers
    mutable fnInitializeModuleData InitializeModuleData_;
@@ -123,4 +130,5 @@ private:
    mutable fnGetDeviceName GetDeviceName_;
    mutable fnGetDeviceType GetDeviceType_;
    mutable fnGetDeviceDescription GetDeviceDescription_;
+   mutable fnGetPerDeviceThreadSafety GetPerDeviceThreadSafety_;
 };
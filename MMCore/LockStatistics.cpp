@@ -0,0 +1,98 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          LockStatistics.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Wait and hold times of a lock
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "LockStatistics.h"
+
+namespace mm
+{
+
+namespace
+{
+
+unsigned long long ToNs(LockStatistics::Clock::duration d)
+{
+   long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+   return ns > 0 ? static_cast<unsigned long long>(ns) : 0;
+}
+
+double NsToMs(unsigned long long ns)
+{
+   return static_cast<double>(ns) / 1.0e6;
+}
+
+void UpdateMax(std::atomic<unsigned long long>& max, unsigned long long value)
+{
+   unsigned long long prev = max.load(std::memory_order_relaxed);
+   while (value > prev &&
+         !max.compare_exchange_weak(prev, value, std::memory_order_relaxed))
+      ;
+}
+
+} // anonymous namespace
+
+LockStatistics::LockStatistics() :
+   count_(0),
+   totalWaitNs_(0),
+   maxWaitNs_(0),
+   totalHoldNs_(0),
+   maxHoldNs_(0)
+{
+}
+
+/**
+ * Records one acquisition: the time spent waiting to acquire the lock and the
+ * time it was then held.
+ */
+void LockStatistics::Record(Clock::duration wait, Clock::duration hold)
+{
+   const unsigned long long waitNs = ToNs(wait);
+   const unsigned long long holdNs = ToNs(hold);
+   count_.fetch_add(1, std::memory_order_relaxed);
+   totalWaitNs_.fetch_add(waitNs, std::memory_order_relaxed);
+   totalHoldNs_.fetch_add(holdNs, std::memory_order_relaxed);
+   UpdateMax(maxWaitNs_, waitNs);
+   UpdateMax(maxHoldNs_, holdNs);
+}
+
+/**
+ * Returns the statistics so far. The fields are read individually, so a
+ * snapshot taken while the lock is in use may mix adjacent acquisitions.
+ */
+LockStatistics::Snapshot LockStatistics::Get() const
+{
+   Snapshot s;
+   s.count = count_.load(std::memory_order_relaxed);
+   s.totalWaitMs = NsToMs(totalWaitNs_.load(std::memory_order_relaxed));
+   s.maxWaitMs = NsToMs(maxWaitNs_.load(std::memory_order_relaxed));
+   s.totalHoldMs = NsToMs(totalHoldNs_.load(std::memory_order_relaxed));
+   s.maxHoldMs = NsToMs(maxHoldNs_.load(std::memory_order_relaxed));
+   return s;
+}
+
+void LockStatistics::Reset()
+{
+   count_.store(0, std::memory_order_relaxed);
+   totalWaitNs_.store(0, std::memory_order_relaxed);
+   maxWaitNs_.store(0, std::memory_order_relaxed);
+   totalHoldNs_.store(0, std::memory_order_relaxed);
+   maxHoldNs_.store(0, std::memory_order_relaxed);
+}
+
+} // namespace mm
@@ -0,0 +1,67 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          LockStatistics.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Wait and hold times of a lock
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+namespace mm
+{
+
+/**
+ * Accumulates how long a lock was waited for and held, to make contention
+ * visible. Each acquisition is recorded once, on release.
+ *
+ * Thread-safe; recording is lock-free.
+ */
+class LockStatistics
+{
+public:
+   typedef std::chrono::steady_clock Clock;
+
+   struct Snapshot
+   {
+      unsigned long long count;
+      double totalWaitMs;
+      double maxWaitMs;
+      double totalHoldMs;
+      double maxHoldMs;
+   };
+
+private:
+   std::atomic<unsigned long long> count_;
+   std::atomic<unsigned long long> totalWaitNs_;
+   std::atomic<unsigned long long> maxWaitNs_;
+   std::atomic<unsigned long long> totalHoldNs_;
+   std::atomic<unsigned long long> maxHoldNs_;
+
+public:
+   LockStatistics();
+
+   LockStatistics(const LockStatistics&) = delete;
+   LockStatistics& operator=(const LockStatistics&) = delete;
+
+   void Record(Clock::duration wait, Clock::duration hold);
+   Snapshot Get() const;
+   void Reset();
+};
+
+} // namespace mm
@@ -237,6 +237,39 @@ LogManager::AddSecondaryLogFile(LogLevel level,
       throw CMMError("Cannot open file " + ToQuotedString(filename));
    }
 
+   return InsertSecondaryLogFile(level, filename, sink, mode);
+}
+
+
+LogManager::LogFileHandle
+LogManager::AddSecondaryBinaryLogFile(LogLevel level,
+      const std::string& filename, std::size_t maxFileBytes,
+      unsigned maxBackupFiles, SinkMode mode)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+
+   std::shared_ptr<LogSink> sink;
+   try
+   {
+      sink = std::make_shared<BinaryFileLogSink>(filename, maxFileBytes,
+            maxBackupFiles);
+   }
+   catch (const CannotOpenFileException&)
+   {
+      LOG_ERROR(internalLogger_) << "Failed to open file " <<
+         filename << " as secondary binary log file";
+      throw CMMError("Cannot open file " + ToQuotedString(filename));
+   }
+
+   return InsertSecondaryLogFile(level, filename, sink, mode);
+}
+
+
+LogManager::LogFileHandle
+LogManager::InsertSecondaryLogFile(LogLevel level,
+      const std::string& filename, std::shared_ptr<LogSink> sink,
+      SinkMode mode)
+{
    sink->SetFilter(std::make_shared<LevelFilter>(level));
 
    LogFileHandle handle = nextSecondaryHandle_++;
@@ -273,6 +306,48 @@ LogManager::RemoveSecondaryLogFile(LogManager::LogFileHandle handle)
 }
 
 
+void
+LogManager::SetAsyncBatchInterval(std::chrono::microseconds interval)
+{
+   loggingCore_->SetAsyncBatchInterval(interval);
+}
+
+
+std::chrono::microseconds
+LogManager::GetAsyncBatchInterval() const
+{
+   return loggingCore_->GetAsyncBatchInterval();
+}
+
+
+void
+LogManager::SetAsyncOverflowPolicy(OverflowPolicy policy)
+{
+   loggingCore_->SetAsyncOverflowPolicy(policy);
+}
+
+
+OverflowPolicy
+LogManager::GetAsyncOverflowPolicy() const
+{
+   return loggingCore_->GetAsyncOverflowPolicy();
+}
+
+
+PacketQueueStatistics
+LogManager::GetAsyncQueueStatistics() const
+{
+   return loggingCore_->GetAsyncQueueStatistics();
+}
+
+
+void
+LogManager::ResetAsyncQueueStatistics()
+{
+   loggingCore_->ResetAsyncQueueStatistics();
+}
+
+
 Logger
 LogManager::NewLogger(const std::string& label)
 {
@@ -1,7 +1,10 @@
 #pragma once
 
+#include "Logging/BinaryLog.h"
 #include "Logging/Logging.h"
 
+#include <chrono>
+#include <cstddef>
 #include <map>
 #include <mutex>
 #include <string>
@@ -50,6 +53,11 @@ private:
 
    static const logging::SinkMode PrimarySinkMode;
 
+   // Must be called with mutex_ held
+   LogFileHandle InsertSecondaryLogFile(logging::LogLevel level,
+         const std::string& filename, std::shared_ptr<logging::LogSink> sink,
+         logging::SinkMode mode);
+
 public:
    LogManager();
 
@@ -66,7 +74,18 @@ public:
    LogFileHandle AddSecondaryLogFile(logging::LogLevel level,
          const std::string& filename, bool truncate = true,
          logging::SinkMode mode = logging::SinkModeAsynchronous);
+   LogFileHandle AddSecondaryBinaryLogFile(logging::LogLevel level,
+         const std::string& filename, std::size_t maxFileBytes = 0,
+         unsigned maxBackupFiles = 1,
+         logging::SinkMode mode = logging::SinkModeAsynchronous);
    void RemoveSecondaryLogFile(LogFileHandle handle);
+
+   void SetAsyncBatchInterval(std::chrono::microseconds interval);
+   std::chrono::microseconds GetAsyncBatchInterval() const;
+   void SetAsyncOverflowPolicy(logging::OverflowPolicy policy);
+   logging::OverflowPolicy GetAsyncOverflowPolicy() const;
+   logging::PacketQueueStatistics GetAsyncQueueStatistics() const;
+   void ResetAsyncQueueStatistics();
    // We could add an atomic SwapSecondaryLogFile(handle, filename, truncate),
    // nice for log rotation, but we don't need it now.
 
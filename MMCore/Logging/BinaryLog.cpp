@@ -0,0 +1,342 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          BinaryLog.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Binary log file sink and reader
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "BinaryLog.h"
+
+#include "MetadataFormatter.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+
+namespace mm
+{
+namespace logging
+{
+
+namespace
+{
+
+const std::size_t HeaderSize = sizeof(BinaryLogMagic) +
+   sizeof(BinaryLogVersion) + sizeof(BinaryLogByteOrderMark);
+
+template <typename T>
+void Put(std::vector<char>& buf, T value)
+{
+   static_assert(std::is_arithmetic<T>::value, "Raw fields only");
+   const char* p = reinterpret_cast<const char*>(&value);
+   buf.insert(buf.end(), p, p + sizeof(T));
+}
+
+void PutBytes(std::vector<char>& buf, const char* p, std::size_t len)
+{
+   buf.insert(buf.end(), p, p + len);
+}
+
+// pthread_t is an integer on Linux but a pointer on macOS
+template <typename T>
+std::uint64_t ThreadIdToInteger(T* tid)
+{ return reinterpret_cast<std::uintptr_t>(tid); }
+
+template <typename T>
+std::uint64_t ThreadIdToInteger(T tid)
+{ return static_cast<std::uint64_t>(tid); }
+
+template <typename T>
+void Get(std::istream& stream, T& value)
+{
+   if (!stream.read(reinterpret_cast<char*>(&value), sizeof(T)))
+      throw BadBinaryLogException("Truncated record");
+}
+
+void GetBytes(std::istream& stream, std::string& s, std::size_t len)
+{
+   s.resize(len);
+   if (len > 0 && !stream.read(&s[0], len))
+      throw BadBinaryLogException("Truncated record");
+}
+
+} // anonymous namespace
+
+
+BinaryFileLogSink::BinaryFileLogSink(const std::string& filename,
+      std::size_t maxFileBytes, unsigned maxBackupFiles) :
+   filename_(filename),
+   maxFileBytes_(maxFileBytes),
+   maxBackupFiles_(maxBackupFiles),
+   fileBytes_(0),
+   hadError_(false)
+{
+   Open();
+}
+
+
+void
+BinaryFileLogSink::Consume(const PacketArrayType& packets)
+{
+   std::shared_ptr<EntryFilter> filter = GetFilter();
+
+   // Reassemble each entry's message from its line packets. Null while
+   // skipping the packets of an entry rejected by the filter.
+   const Metadata* metadata = 0;
+   for (PacketArrayType::ConstIteratorType it = packets.Begin(),
+         end = packets.End(); it != end; ++it)
+   {
+      if (it->GetPacketState() == internal::PacketStateEntryFirstLine)
+      {
+         if (metadata)
+            AppendEntry(*metadata, entryText_);
+         metadata = 0;
+         if (filter && !filter->Filter(it->GetMetadataConstRef()))
+            continue;
+         metadata = &it->GetMetadataConstRef();
+         entryText_.assign(it->GetText());
+      }
+      else if (metadata)
+      {
+         if (it->GetPacketState() == internal::PacketStateNewLine)
+            entryText_ += '\n';
+         entryText_ += it->GetText();
+      }
+   }
+   if (metadata)
+      AppendEntry(*metadata, entryText_);
+
+   WriteBuffer();
+}
+
+
+void
+BinaryFileLogSink::Open()
+{
+   fileStream_.open(filename_.c_str(),
+         std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+   if (!fileStream_)
+      throw CannotOpenFileException();
+   fileBytes_ = 0;
+   labelIds_.clear();
+
+   PutBytes(buffer_, BinaryLogMagic, sizeof(BinaryLogMagic));
+   Put(buffer_, BinaryLogVersion);
+   Put(buffer_, BinaryLogByteOrderMark);
+   WriteBuffer();
+}
+
+
+void
+BinaryFileLogSink::Rotate()
+{
+   fileStream_.close();
+   if (maxBackupFiles_ > 0)
+   {
+      const std::string base = filename_ + '.';
+      std::remove((base + std::to_string(maxBackupFiles_)).c_str());
+      for (unsigned i = maxBackupFiles_ - 1; i > 0; --i)
+      {
+         std::rename((base + std::to_string(i)).c_str(),
+               (base + std::to_string(i + 1)).c_str());
+      }
+      std::rename(filename_.c_str(), (base + "1").c_str());
+   }
+
+   try
+   {
+      Open();
+   }
+   catch (const CannotOpenFileException&)
+   {
+      if (!hadError_)
+      {
+         hadError_ = true;
+         std::cerr << "Logging: cannot reopen binary log file " <<
+            filename_ << " after rotation\n";
+      }
+   }
+}
+
+
+void
+BinaryFileLogSink::AppendEntry(const Metadata& metadata,
+      const std::string& text)
+{
+   if (maxFileBytes_ > 0 && fileBytes_ + buffer_.size() >= maxFileBytes_ &&
+         fileBytes_ + buffer_.size() > HeaderSize)
+   {
+      WriteBuffer();
+      Rotate();
+   }
+
+   const char* label = metadata.GetLoggerData().GetComponentLabel();
+   std::map<const char*, std::uint32_t>::const_iterator found =
+      labelIds_.find(label);
+   std::uint32_t labelId;
+   if (found != labelIds_.end())
+   {
+      labelId = found->second;
+   }
+   else
+   {
+      labelId = static_cast<std::uint32_t>(labelIds_.size());
+      labelIds_.insert(std::make_pair(label, labelId));
+
+      const std::size_t len =
+         std::min<std::size_t>(std::strlen(label), 0xffff);
+      Put(buffer_, static_cast<std::uint8_t>(BinaryLogRecordLabel));
+      Put(buffer_, labelId);
+      Put(buffer_, static_cast<std::uint16_t>(len));
+      PutBytes(buffer_, label, len);
+   }
+
+   const std::int64_t us =
+      std::chrono::duration_cast<std::chrono::microseconds>(
+         metadata.GetStampData().GetTimestamp().time_since_epoch()).count();
+   Put(buffer_, static_cast<std::uint8_t>(BinaryLogRecordEntry));
+   Put(buffer_, us);
+   Put(buffer_, ThreadIdToInteger(metadata.GetStampData().GetThreadId()));
+   Put(buffer_, labelId);
+   Put(buffer_, static_cast<std::uint8_t>(metadata.GetEntryData().GetLevel()));
+   Put(buffer_, static_cast<std::uint32_t>(text.size()));
+   PutBytes(buffer_, text.data(), text.size());
+}
+
+
+void
+BinaryFileLogSink::WriteBuffer()
+{
+   if (buffer_.empty())
+      return;
+   if (fileStream_.is_open())
+   {
+      fileStream_.write(buffer_.data(), buffer_.size());
+      fileStream_.flush();
+      fileBytes_ += buffer_.size();
+      if (!fileStream_ && !hadError_)
+      {
+         hadError_ = true;
+         std::cerr << "Logging: cannot write to binary log file " <<
+            filename_ << '\n';
+      }
+   }
+   buffer_.clear();
+}
+
+
+BinaryLogReader::BinaryLogReader(std::istream& stream) :
+   stream_(stream)
+{
+   char magic[sizeof(BinaryLogMagic)];
+   std::uint32_t version;
+   std::uint32_t byteOrderMark;
+   if (!stream_.read(magic, sizeof(magic)) ||
+         std::memcmp(magic, BinaryLogMagic, sizeof(magic)) != 0)
+      throw BadBinaryLogException("Not a binary log file");
+   Get(stream_, version);
+   Get(stream_, byteOrderMark);
+   if (byteOrderMark != BinaryLogByteOrderMark)
+      throw BadBinaryLogException(
+            "Binary log file was written with a different byte order");
+   if (version != BinaryLogVersion)
+      throw BadBinaryLogException("Unsupported binary log format version " +
+            std::to_string(version));
+}
+
+
+bool
+BinaryLogReader::ReadEntry(Entry& entry)
+{
+   for (;;)
+   {
+      const int type = stream_.get();
+      if (type == std::char_traits<char>::eof())
+         return false;
+
+      switch (type)
+      {
+         case BinaryLogRecordLabel:
+         {
+            std::uint32_t id;
+            std::uint16_t len;
+            Get(stream_, id);
+            Get(stream_, len);
+            GetBytes(stream_, labels_[id], len);
+            break;
+         }
+         case BinaryLogRecordEntry:
+         {
+            std::int64_t us;
+            std::uint32_t labelId;
+            std::uint8_t level;
+            std::uint32_t len;
+            Get(stream_, us);
+            Get(stream_, entry.threadId);
+            Get(stream_, labelId);
+            Get(stream_, level);
+            Get(stream_, len);
+
+            std::map<std::uint32_t, std::string>::const_iterator label =
+               labels_.find(labelId);
+            if (label == labels_.end())
+               throw BadBinaryLogException("Entry refers to undefined label " +
+                     std::to_string(labelId));
+
+            typedef std::chrono::system_clock Clock;
+            entry.timestamp = Clock::time_point(
+                  std::chrono::duration_cast<Clock::duration>(
+                     std::chrono::microseconds(us)));
+            entry.level = static_cast<LogLevel>(level);
+            entry.label = label->second;
+            GetBytes(stream_, entry.text, len);
+            return true;
+         }
+         default:
+            throw BadBinaryLogException("Unknown record type " +
+                  std::to_string(type));
+      }
+   }
+}
+
+
+void
+FormatBinaryLogEntry(std::ostream& stream,
+      const BinaryLogReader::Entry& entry)
+{
+   internal::MetadataFormatter formatter;
+   formatter.FormatLinePrefix(stream, entry.timestamp,
+         std::to_string(entry.threadId), entry.level, entry.label.c_str());
+
+   std::string::size_type begin = 0;
+   for (;;)
+   {
+      const std::string::size_type end = entry.text.find('\n', begin);
+      stream << ' ';
+      stream.write(entry.text.data() + begin,
+            (end == std::string::npos ? entry.text.size() : end) - begin);
+      stream << '\n';
+      if (end == std::string::npos)
+         break;
+      begin = end + 1;
+      formatter.FormatContinuationPrefix(stream);
+   }
+}
+
+} // namespace logging
+} // namespace mm
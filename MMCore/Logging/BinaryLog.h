@@ -0,0 +1,156 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          BinaryLog.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Binary log file sink and reader
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include "Logging.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <istream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace mm
+{
+namespace logging
+{
+
+// Binary log files start with a 16-byte header: the magic bytes "MMBINLOG",
+// the format version and the value 0x01020304 as native-order uint32 (so that
+// files written on a machine of the other byte order are recognized). The
+// header is followed by records, each starting with a uint8 record type:
+//
+// - Label (1): uint32 label id, uint16 length, label bytes. Defines the id
+//   used by subsequent entries for a logger label.
+// - Entry (2): int64 microseconds since the epoch (system clock), uint64
+//   thread id, uint32 label id, uint8 level, uint32 length, message bytes.
+//   Lines of multi-line messages are separated by '\n'.
+//
+// Every file (including each file started by rotation) defines its labels
+// before use and can be decoded on its own.
+const char BinaryLogMagic[8] = { 'M', 'M', 'B', 'I', 'N', 'L', 'O', 'G' };
+const std::uint32_t BinaryLogVersion = 1;
+const std::uint32_t BinaryLogByteOrderMark = 0x01020304;
+
+enum BinaryLogRecordType
+{
+   BinaryLogRecordLabel = 1,
+   BinaryLogRecordEntry = 2,
+};
+
+
+class BadBinaryLogException : public std::exception
+{
+   std::string msg_;
+
+public:
+   explicit BadBinaryLogException(const std::string& msg) : msg_(msg) {}
+   virtual const char* what() const throw() { return msg_.c_str(); }
+};
+
+
+/**
+ * Log sink writing entries as binary records.
+ *
+ * Records hold the metadata as raw fields and the message unformatted, so
+ * that logging to this sink costs much less than to a text file sink.
+ * DecodeBinaryLog renders the files in the usual text format.
+ *
+ * If maxFileBytes is nonzero, the file is rotated once it reaches that size:
+ * filename is renamed to filename.1 (existing filename.N to filename.N+1,
+ * keeping up to maxBackupFiles of them) and a new file is started.
+ */
+class BinaryFileLogSink : public LogSink
+{
+   std::string filename_;
+   std::size_t maxFileBytes_;
+   unsigned maxBackupFiles_;
+
+   std::ofstream fileStream_;
+   std::size_t fileBytes_;
+   bool hadError_;
+
+   // Ids of the labels defined in the current file; keyed by the interned
+   // label pointer (see LoggerData)
+   std::map<const char*, std::uint32_t> labelIds_;
+   std::vector<char> buffer_;
+   std::string entryText_;
+
+public:
+   BinaryFileLogSink(const BinaryFileLogSink&) = delete;
+   BinaryFileLogSink& operator=(const BinaryFileLogSink&) = delete;
+
+   BinaryFileLogSink(const std::string& filename,
+         std::size_t maxFileBytes = 0, unsigned maxBackupFiles = 1);
+
+   virtual void Consume(const PacketArrayType& packets);
+
+private:
+   void Open();
+   void Rotate();
+   void AppendEntry(const Metadata& metadata, const std::string& text);
+   void WriteBuffer();
+};
+
+
+/**
+ * Reads entries from a binary log file.
+ */
+class BinaryLogReader
+{
+public:
+   struct Entry
+   {
+      std::chrono::time_point<std::chrono::system_clock> timestamp;
+      std::uint64_t threadId;
+      LogLevel level;
+      std::string label;
+      std::string text;
+   };
+
+private:
+   std::istream& stream_;
+   std::map<std::uint32_t, std::string> labels_;
+
+public:
+   BinaryLogReader(const BinaryLogReader&) = delete;
+   BinaryLogReader& operator=(const BinaryLogReader&) = delete;
+
+   // Throws BadBinaryLogException if the stream does not start with a valid
+   // header.
+   explicit BinaryLogReader(std::istream& stream);
+
+   // Returns false at the end of the stream. Throws BadBinaryLogException if
+   // the stream is corrupt or truncated within a record.
+   bool ReadEntry(Entry& entry);
+};
+
+
+// Writes the entry in the text log file format
+void FormatBinaryLogEntry(std::ostream& stream,
+      const BinaryLogReader::Entry& entry);
+
+} // namespace logging
+} // namespace mm
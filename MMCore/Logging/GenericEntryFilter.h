@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <limits>
+
 
 namespace mm
 {
@@ -31,6 +33,13 @@ class GenericEntryFilter
 public:
    virtual ~GenericEntryFilter() {}
    virtual bool Filter(const TMetadata& metadata) const = 0;
+
+   // Lowest entry level (EntryDataType::GetLevel()) that this filter can
+   // possibly pass. The logging core uses this to let loggers skip formatting
+   // entries that no sink will accept. Filters that do not select by level
+   // should keep the default, which admits all levels.
+   virtual int GetMinimumLevel() const
+   { return std::numeric_limits<int>::min(); }
 };
 
 
@@ -16,7 +16,9 @@
 
 #pragma once
 
+#include <atomic>
 #include <functional>
+#include <memory>
 #include <sstream>
 #include <string>
 
@@ -34,13 +36,32 @@ class GenericLogger
 {
    std::function<void (TEntryData, const char*)> impl_;
 
+   // Lowest level that any sink currently accepts, published by the logging
+   // core. Null means that every level is enabled.
+   std::shared_ptr<const std::atomic<int>> minimumLevel_;
+
 public:
    typedef TEntryData EntryDataType;
 
-   GenericLogger(std::function<void (TEntryData, const char*)> f) :
-      impl_(f)
+   GenericLogger(std::function<void (TEntryData, const char*)> f,
+         std::shared_ptr<const std::atomic<int>> minimumLevel = nullptr) :
+      impl_(f),
+      minimumLevel_(minimumLevel)
    {}
 
+   /**
+    * Return whether an entry with the given data may reach any sink.
+    *
+    * This is a cheap check (one relaxed atomic load) meant to be done before
+    * formatting the entry text. Entries for which it returns true may still
+    * be dropped by sink filters.
+    */
+   bool IsEnabled(TEntryData entryData) const
+   {
+      return !minimumLevel_ || static_cast<int>(entryData.GetLevel()) >=
+         minimumLevel_->load(std::memory_order_relaxed);
+   }
+
    void operator()(TEntryData entryData, const char* message) const
    { impl_(entryData, message); }
 
@@ -23,7 +23,10 @@
 #include "GenericSink.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <functional>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -73,8 +76,22 @@ private:
    // _and_ the queue receive loop stopped.
    std::vector< std::shared_ptr<SinkType> > asynchronousSinks_;
 
+   // Lowest entry level accepted by any sink, shared with the loggers so that
+   // they can skip formatting entries nobody will consume. The per-list
+   // minima are protected by minimumLevelMutex_, which is always acquired
+   // last.
+   std::mutex minimumLevelMutex_;
+   int syncMinimumLevel_;
+   int asyncMinimumLevel_;
+   std::shared_ptr< std::atomic<int> > minimumLevel_;
+
 public:
-   GenericLoggingCore() { StartAsyncReceiveLoop(); }
+   GenericLoggingCore() :
+      syncMinimumLevel_(std::numeric_limits<int>::max()),
+      asyncMinimumLevel_(std::numeric_limits<int>::max()),
+      minimumLevel_(std::make_shared< std::atomic<int> >(
+               std::numeric_limits<int>::max()))
+   { StartAsyncReceiveLoop(); }
    ~GenericLoggingCore() { StopAsyncReceiveLoop(); }
 
    /**
@@ -88,9 +105,43 @@ public:
       // guaranteed to be safe to call at any time.
       return internal::GenericLogger<EntryDataType>(
             std::bind(&GenericLoggingCore::SendEntryToShared,
-               this->shared_from_this(), metadata, std::placeholders::_1, std::placeholders::_2));
+               this->shared_from_this(), metadata, std::placeholders::_1, std::placeholders::_2),
+            minimumLevel_);
    }
 
+   /**
+    * Return the lowest entry level accepted by any attached sink.
+    *
+    * Returns the largest int when no sink is attached.
+    */
+   int GetMinimumLevel() const
+   { return minimumLevel_->load(std::memory_order_relaxed); }
+
+   /**
+    * Set the interval at which entries are handed to the asynchronous sinks
+    * while logging is busy.
+    */
+   void SetAsyncBatchInterval(std::chrono::microseconds interval)
+   { asyncQueue_.SetBatchInterval(interval); }
+
+   std::chrono::microseconds GetAsyncBatchInterval() const
+   { return asyncQueue_.GetBatchInterval(); }
+
+   /**
+    * Set what loggers do when the queue to the asynchronous sinks is full.
+    */
+   void SetAsyncOverflowPolicy(OverflowPolicy policy)
+   { asyncQueue_.SetOverflowPolicy(policy); }
+
+   OverflowPolicy GetAsyncOverflowPolicy() const
+   { return asyncQueue_.GetOverflowPolicy(); }
+
+   PacketQueueStatistics GetAsyncQueueStatistics() const
+   { return asyncQueue_.GetStatistics(); }
+
+   void ResetAsyncQueueStatistics()
+   { asyncQueue_.ResetStatistics(); }
+
    /**
     * Add a synchronous or asynchronous sink.
     */
@@ -102,6 +153,7 @@ public:
          {
             std::lock_guard<std::mutex> lock(syncSinksMutex_);
             synchronousSinks_.push_back(sink);
+            UpdateMinimumLevel(SinkModeSynchronous);
             break;
          }
          case SinkModeAsynchronous:
@@ -109,6 +161,7 @@ public:
             std::lock_guard<std::mutex> lock(asyncQueueMutex_);
             StopAsyncReceiveLoop();
             asynchronousSinks_.push_back(sink);
+            UpdateMinimumLevel(SinkModeAsynchronous);
             StartAsyncReceiveLoop();
             break;
          }
@@ -133,6 +186,7 @@ public:
                      sink);
             if (it != synchronousSinks_.end())
                synchronousSinks_.erase(it);
+            UpdateMinimumLevel(SinkModeSynchronous);
             break;
          }
          case SinkModeAsynchronous:
@@ -144,6 +198,7 @@ public:
                      sink);
             if (it != asynchronousSinks_.end())
                asynchronousSinks_.erase(it);
+            UpdateMinimumLevel(SinkModeAsynchronous);
             StartAsyncReceiveLoop();
             break;
          }
@@ -207,6 +262,8 @@ public:
          }
       }
 
+      UpdateMinimumLevel(SinkModeSynchronous);
+      UpdateMinimumLevel(SinkModeAsynchronous);
       StartAsyncReceiveLoop();
    }
 
@@ -251,10 +308,34 @@ public:
             (*foundIt)->SetFilter(filter);
       }
 
+      UpdateMinimumLevel(SinkModeSynchronous);
+      UpdateMinimumLevel(SinkModeAsynchronous);
       StartAsyncReceiveLoop();
    }
 
 private:
+   // Must be called with the mutex protecting the sink list for mode held
+   // (syncSinksMutex_ or asyncQueueMutex_).
+   void UpdateMinimumLevel(SinkMode mode)
+   {
+      const std::vector< std::shared_ptr<SinkType> >& sinks =
+         mode == SinkModeSynchronous ? synchronousSinks_ : asynchronousSinks_;
+      int level = std::numeric_limits<int>::max();
+      for (typename std::vector< std::shared_ptr<SinkType> >::const_iterator
+            it = sinks.begin(), end = sinks.end(); it != end; ++it)
+      {
+         level = (std::min)(level, (*it)->GetMinimumLevel());
+      }
+
+      std::lock_guard<std::mutex> lock(minimumLevelMutex_);
+      if (mode == SinkModeSynchronous)
+         syncMinimumLevel_ = level;
+      else
+         asyncMinimumLevel_ = level;
+      minimumLevel_->store((std::min)(syncMinimumLevel_, asyncMinimumLevel_),
+            std::memory_order_relaxed);
+   }
+
    // Static wrapper allowing the use of a shared_ptr for the target instance
    static void
    SendEntryToShared(std::shared_ptr<GenericLoggingCore> self,
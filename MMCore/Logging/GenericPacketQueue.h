@@ -16,52 +16,237 @@
 
 #pragma once
 
+#include "GenericLinePacket.h"
+#include "GenericPacketArray.h"
+
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <iterator>
+#include <memory>
 #include <mutex>
+#include <new>
 #include <thread>
+#include <type_traits>
 
 
 namespace mm
 {
 namespace logging
 {
+
+
+/**
+ * What a producer does when the asynchronous queue is full.
+ */
+enum OverflowPolicy
+{
+   OverflowPolicyBlock, // Wait until the backend has made room
+   OverflowPolicyDropOldest, // Discard the oldest queued entries
+   OverflowPolicyDropNewest, // Discard the entry being sent
+};
+
+
+struct PacketQueueStatistics
+{
+   std::uint64_t queued; // Entries accepted into the queue
+   std::uint64_t dropped; // Entries discarded on overflow
+   std::uint64_t flushed; // Entries handed to the sinks
+};
+
+
 namespace internal
 {
 
+/**
+ * Bounded queue carrying log packets to the asynchronous sinks.
+ *
+ * Producers do not take a lock: each entry reserves a contiguous run of slots
+ * in a ring with a single compare-and-swap, so that entries from different
+ * threads never interleave. Slots carry a sequence number recording whether
+ * they are free or published for the current lap around the ring (after
+ * D. Vyukov's bounded MPMC queue). The receive thread takes the published
+ * entries in batches, at most once per batch interval while there is steady
+ * traffic.
+ */
 template <typename TMetadata>
 class GenericPacketQueue
 {
    typedef GenericPacketArray<TMetadata> PacketArrayType;
+   typedef GenericLinePacket<TMetadata> LinePacketType;
+
+   static_assert(std::is_trivially_destructible<LinePacketType>::value,
+         "Packets are left in the ring without being destroyed");
+
+public:
+   static const std::size_t DefaultCapacity = 16384; // Packets
 
 private:
-   // The "queue" for asynchronous sinks.
+   struct Slot
+   {
+      // Equals the position for a free slot, position + 1 once the packet is
+      // published, and advances by the capacity when the slot is released.
+      std::atomic<std::size_t> sequence;
+      // Number of packets in the entry starting at this slot (valid on the
+      // first slot of a published entry)
+      std::atomic<std::size_t> span;
+      typename std::aligned_storage<sizeof(LinePacketType),
+         alignof(LinePacketType)>::type storage;
+
+      LinePacketType* Packet()
+      { return reinterpret_cast<LinePacketType*>(&storage); }
+   };
+
+   const std::size_t capacity_; // Power of 2
+   const std::size_t mask_;
+   std::unique_ptr<Slot[]> slots_;
+
+   // Producers and the receive thread each contend on their own position;
+   // keep them on separate cache lines.
+   char pad0_[64];
+   std::atomic<std::size_t> enqueuePos_;
+   char pad1_[64];
+   std::atomic<std::size_t> dequeuePos_;
+   char pad2_[64];
+
+   std::atomic<long long> intervalUs_;
+   std::atomic<int> overflowPolicy_;
+
+   std::atomic<std::uint64_t> queuedCount_;
+   std::atomic<std::uint64_t> droppedCount_;
+   std::atomic<std::uint64_t> flushedCount_;
+
+   // mutex_ and condVar_ are only used to put the receive thread to sleep and
+   // wake it up; producers touch them only when the thread is waiting for
+   // data or when they need room in the ring.
    std::mutex mutex_;
    std::condition_variable condVar_;
-   PacketArrayType queue_;
+   std::atomic<bool> receiverWaiting_;
+   bool flushRequested_; // Protected by mutex_
+   bool shutdownRequested_; // Protected by mutex_
 
-   // Swapped with queue_ and accessed from receiving thread.
+   // Filled and accessed from receiving thread.
    PacketArrayType received_;
 
-   bool shutdownRequested_; // Protected by mutex_
-
    // threadMutex_ protects the start/stop of loopThread_; it must be acquired
    // before mutex_.
    std::mutex threadMutex_;
    std::thread loopThread_; // Protected by threadMutex_
 
 public:
-   GenericPacketQueue() :
+   GenericPacketQueue(const GenericPacketQueue&) = delete;
+   GenericPacketQueue& operator=(const GenericPacketQueue&) = delete;
+
+   explicit GenericPacketQueue(std::size_t capacity = DefaultCapacity) :
+      capacity_(RoundUpToPowerOf2(capacity)),
+      mask_(capacity_ - 1),
+      slots_(new Slot[capacity_]),
+      enqueuePos_(0),
+      dequeuePos_(0),
+      intervalUs_(10000),
+      overflowPolicy_(OverflowPolicyBlock),
+      queuedCount_(0),
+      droppedCount_(0),
+      flushedCount_(0),
+      receiverWaiting_(false),
+      flushRequested_(false),
       shutdownRequested_(false)
-   {}
+   {
+      for (std::size_t i = 0; i < capacity_; ++i)
+      {
+         slots_[i].sequence.store(i, std::memory_order_relaxed);
+         slots_[i].span.store(0, std::memory_order_relaxed);
+      }
+   }
+
+   std::size_t GetCapacity() const { return capacity_; }
+
+   /**
+    * Set the minimum interval between batches while entries keep arriving.
+    *
+    * A longer interval means fewer, larger writes to the sinks (and fewer
+    * stream flushes), at the cost of more latency and queue space.
+    */
+   void SetBatchInterval(std::chrono::microseconds interval)
+   {
+      intervalUs_.store(std::max<long long>(0, interval.count()),
+            std::memory_order_relaxed);
+   }
+
+   std::chrono::microseconds GetBatchInterval() const
+   {
+      return std::chrono::microseconds(
+            intervalUs_.load(std::memory_order_relaxed));
+   }
+
+   void SetOverflowPolicy(OverflowPolicy policy)
+   { overflowPolicy_.store(policy, std::memory_order_relaxed); }
+
+   OverflowPolicy GetOverflowPolicy() const
+   {
+      return static_cast<OverflowPolicy>(
+            overflowPolicy_.load(std::memory_order_relaxed));
+   }
+
+   PacketQueueStatistics GetStatistics() const
+   {
+      PacketQueueStatistics stats;
+      stats.queued = queuedCount_.load(std::memory_order_relaxed);
+      stats.dropped = droppedCount_.load(std::memory_order_relaxed);
+      stats.flushed = flushedCount_.load(std::memory_order_relaxed);
+      return stats;
+   }
+
+   void ResetStatistics()
+   {
+      queuedCount_.store(0, std::memory_order_relaxed);
+      droppedCount_.store(0, std::memory_order_relaxed);
+      flushedCount_.store(0, std::memory_order_relaxed);
+   }
 
    template <typename TPacketIter>
    void SendPackets(TPacketIter first, TPacketIter last)
    {
-      std::lock_guard<std::mutex> lock(mutex_);
-      queue_.Append(first, last);
-      condVar_.notify_one();
+      bool published = false;
+      while (first != last)
+      {
+         // An entry longer than the whole ring is sent in pieces, which may
+         // then interleave with other entries.
+         const std::size_t count = std::min<std::size_t>(
+               std::distance(first, last), capacity_);
+         TPacketIter pieceLast = first;
+         std::advance(pieceLast, count);
+         const std::size_t entries = CountEntries(first, pieceLast);
+
+         std::size_t pos;
+         if (Reserve(count, pos))
+         {
+            Publish(pos, first, pieceLast);
+            queuedCount_.fetch_add(entries, std::memory_order_relaxed);
+            published = true;
+         }
+         else
+         {
+            droppedCount_.fetch_add(entries, std::memory_order_relaxed);
+         }
+         first = pieceLast;
+      }
+
+      if (published)
+      {
+         // Pairs with the fence in ReceiveLoop(): either we see that the
+         // receiver is waiting, or it sees our packets before waiting.
+         std::atomic_thread_fence(std::memory_order_seq_cst);
+         if (receiverWaiting_.load(std::memory_order_relaxed))
+         {
+            std::lock_guard<std::mutex> lock(mutex_);
+            condVar_.notify_one();
+         }
+      }
    }
 
    void RunReceiveLoop(std::function<void (PacketArrayType&)>
@@ -106,16 +291,199 @@ public:
    }
 
 private:
-   void ReceiveLoop(std::function<void (PacketArrayType&)> consume)
+   static std::size_t RoundUpToPowerOf2(std::size_t n)
+   {
+      std::size_t p = 2;
+      while (p < n)
+         p <<= 1;
+      return p;
+   }
+
+   template <typename TPacketIter>
+   static std::size_t CountEntries(TPacketIter first, TPacketIter last)
    {
-      using namespace std::chrono_literals;
+      std::size_t entries = 0;
+      for (; first != last; ++first)
+      {
+         if (first->GetPacketState() == PacketStateEntryFirstLine)
+            ++entries;
+      }
+      return entries;
+   }
+
+   static std::ptrdiff_t Difference(std::size_t a, std::size_t b)
+   { return static_cast<std::ptrdiff_t>(a - b); }
 
+   // Claim count contiguous free slots, returning the position of the first.
+   bool TryReserve(std::size_t count, std::size_t& pos)
+   {
+      pos = enqueuePos_.load(std::memory_order_relaxed);
+      for (;;)
+      {
+         std::ptrdiff_t diff = 0;
+         for (std::size_t i = 0; i < count && diff == 0; ++i)
+         {
+            const std::size_t seq = slots_[(pos + i) & mask_].sequence.load(
+                  std::memory_order_acquire);
+            diff = Difference(seq, pos + i);
+         }
+         if (diff < 0) // Slot not yet released from the previous lap
+            return false;
+         if (diff > 0) // Another producer got there first
+         {
+            pos = enqueuePos_.load(std::memory_order_relaxed);
+            continue;
+         }
+         if (enqueuePos_.compare_exchange_weak(pos, pos + count,
+                  std::memory_order_relaxed))
+            return true;
+      }
+   }
+
+   // Reserve room for count packets, applying the overflow policy while the
+   // ring is full. Returns false if the packets are to be dropped.
+   bool Reserve(std::size_t count, std::size_t& pos)
+   {
+      bool flushRequested = false;
+      for (unsigned attempt = 0; ; ++attempt)
+      {
+         if (TryReserve(count, pos))
+            return true;
+
+         switch (GetOverflowPolicy())
+         {
+            case OverflowPolicyDropNewest:
+               return false;
+            case OverflowPolicyDropOldest:
+               DropOldest(count);
+               continue;
+            case OverflowPolicyBlock:
+               if (!flushRequested)
+               {
+                  // Cut the batch interval short to make room sooner.
+                  std::lock_guard<std::mutex> lock(mutex_);
+                  flushRequested_ = true;
+                  condVar_.notify_one();
+                  flushRequested = true;
+               }
+               break;
+         }
+
+         if (attempt < 64)
+            std::this_thread::yield();
+         else
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+      }
+   }
+
+   // Write the packets into reserved slots, then publish them last to first,
+   // so that the first slot being published means the whole entry is.
+   template <typename TPacketIter>
+   void Publish(std::size_t pos, TPacketIter first, TPacketIter last)
+   {
+      const std::size_t count = std::distance(first, last);
+      std::size_t i = 0;
+      for (TPacketIter it = first; it != last; ++it, ++i)
+         new (&slots_[(pos + i) & mask_].storage) LinePacketType(*it);
+      slots_[pos & mask_].span.store(count, std::memory_order_relaxed);
+      for (i = count; i-- > 0; )
+      {
+         slots_[(pos + i) & mask_].sequence.store(pos + i + 1,
+               std::memory_order_release);
+      }
+   }
+
+   // Claim the oldest published entry. Entries are claimed whole, so the
+   // receive thread and producers dropping entries never split one.
+   bool TryClaim(std::size_t& pos, std::size_t& count)
+   {
+      pos = dequeuePos_.load(std::memory_order_relaxed);
+      for (;;)
+      {
+         Slot& slot = slots_[pos & mask_];
+         const std::ptrdiff_t diff = Difference(
+               slot.sequence.load(std::memory_order_acquire), pos + 1);
+         if (diff < 0) // Empty, or the oldest entry is still being written
+            return false;
+         if (diff > 0)
+         {
+            pos = dequeuePos_.load(std::memory_order_relaxed);
+            continue;
+         }
+         count = slot.span.load(std::memory_order_relaxed);
+         if (dequeuePos_.compare_exchange_weak(pos, pos + count,
+                  std::memory_order_relaxed))
+            return true;
+      }
+   }
+
+   void Release(std::size_t pos, std::size_t count)
+   {
+      for (std::size_t i = 0; i < count; ++i)
+      {
+         slots_[(pos + i) & mask_].sequence.store(pos + i + capacity_,
+               std::memory_order_release);
+      }
+   }
+
+   bool HasPublishedEntry()
+   {
+      const std::size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+      return slots_[pos & mask_].sequence.load(std::memory_order_acquire) ==
+         pos + 1;
+   }
+
+   // Discard whole entries from the head until at least count packets have
+   // been freed (or nothing more can be claimed).
+   void DropOldest(std::size_t count)
+   {
+      std::size_t freed = 0;
+      std::size_t pos, claimed;
+      while (freed < count && TryClaim(pos, claimed))
+      {
+         std::size_t entries = 0;
+         for (std::size_t i = 0; i < claimed; ++i)
+         {
+            if (slots_[(pos + i) & mask_].Packet()->GetPacketState() ==
+                  PacketStateEntryFirstLine)
+               ++entries;
+         }
+         Release(pos, claimed);
+         droppedCount_.fetch_add(entries, std::memory_order_relaxed);
+         freed += claimed;
+      }
+   }
+
+   // Move published entries into received_, at most one ring's worth.
+   void Drain()
+   {
+      std::size_t taken = 0;
+      std::size_t pos, claimed;
+      while (taken < capacity_ && TryClaim(pos, claimed))
+      {
+         std::size_t entries = 0;
+         for (std::size_t i = 0; i < claimed; ++i)
+         {
+            const LinePacketType* packet = slots_[(pos + i) & mask_].Packet();
+            if (packet->GetPacketState() == PacketStateEntryFirstLine)
+               ++entries;
+            received_.Append(packet, packet + 1);
+         }
+         Release(pos, claimed);
+         flushedCount_.fetch_add(entries, std::memory_order_relaxed);
+         taken += claimed;
+      }
+   }
+
+   void ReceiveLoop(std::function<void (PacketArrayType&)> consume)
+   {
       // The loop operates in one of two modes: timed wait and untimed wait.
       //
-      // When in timed wait mode, the loop unconditionally waits for a fixed
-      // interval before checking for data. If data is available, it is
-      // processed and the loop repeats an unconditional wait. If no data is
-      // available, the loop switches to untimed wait mode.
+      // When in timed wait mode, the loop waits for the batch interval before
+      // checking for data (unless a producer blocked on a full queue asks for
+      // an early flush). If data is available, it is processed and the loop
+      // repeats a timed wait. If no data is available, the loop switches to
+      // untimed wait mode.
       //
       // In untimed wait mode, the loop waits on a condition variable until
       // notification from the frontend. Once data is available, the loop
@@ -126,59 +494,53 @@ private:
       // threads and limiting the frequency of stream flushing.
 
       bool timedWaitMode = true;
-      bool shuttingDown = false;
 
       for (;;)
       {
-         if (timedWaitMode)
+         bool shuttingDown;
          {
-            // TODO Make interval configurable
-            std::this_thread::sleep_for(10ms);
-
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (timedWaitMode)
             {
-               std::lock_guard<std::mutex> lock(mutex_);
-               if (shutdownRequested_)
-               {
-                  shutdownRequested_ = false; // Allow for restarting
-                  shuttingDown = true;
-               }
-               if (!shuttingDown && queue_.IsEmpty())
-               {
-                  timedWaitMode = false;
-                  continue;
-               }
-               queue_.Swap(received_);
+               condVar_.wait_for(lock, GetBatchInterval(),
+                     [&] { return shutdownRequested_ || flushRequested_; });
+            }
+            else
+            {
+               receiverWaiting_.store(true, std::memory_order_relaxed);
+               std::atomic_thread_fence(std::memory_order_seq_cst);
+               condVar_.wait(lock,
+                     [&] { return shutdownRequested_ || HasPublishedEntry(); });
+               receiverWaiting_.store(false, std::memory_order_relaxed);
             }
-            consume(received_);
-            received_.Clear();
+            flushRequested_ = false;
+            shuttingDown = shutdownRequested_;
+            shutdownRequested_ = false; // Allow for restarting
+         }
 
+         Drain();
+         if (received_.IsEmpty())
+         {
             if (shuttingDown)
                return;
+            timedWaitMode = false;
+            continue;
          }
-         else // untimed wait mode
+         consume(received_);
+         received_.Clear();
+
+         if (shuttingDown)
          {
+            // Deliver everything already published before returning.
+            for (Drain(); !received_.IsEmpty(); Drain())
             {
-               std::unique_lock<std::mutex> lock(mutex_);
-               while (queue_.IsEmpty())
-               {
-                  condVar_.wait(lock);
-                  if (shutdownRequested_)
-                  {
-                     shutdownRequested_ = false; // Allow for restarting
-                     shuttingDown = true;
-                     break;
-                  }
-               }
-               queue_.Swap(received_);
+               consume(received_);
+               received_.Clear();
             }
-            consume(received_);
-            received_.Clear();
-
-            if (shuttingDown)
-               return;
-
-            timedWaitMode = true;
+            return;
          }
+
+         timedWaitMode = true;
       }
    }
 };
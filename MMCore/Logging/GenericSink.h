@@ -20,6 +20,7 @@
 #include "GenericLinePacket.h"
 #include "GenericPacketArray.h"
 
+#include <limits>
 #include <memory>
 
 
@@ -51,6 +52,14 @@ public:
    // logger. See the LoggingCore member function AtomicSetSinkFilters().
    void SetFilter(std::shared_ptr< GenericEntryFilter<TMetadata> > filter)
    { filter_ = filter; }
+
+   // Lowest entry level this sink may consume (see
+   // GenericEntryFilter::GetMinimumLevel()).
+   int GetMinimumLevel() const
+   {
+      return filter_ ? filter_->GetMinimumLevel() :
+         std::numeric_limits<int>::min();
+   }
 };
 
 
@@ -48,11 +48,17 @@ typedef internal::GenericLogStream<Logger> LogStream;
 // In C++ pre-11, the above statement will fail for some data types of x (e.g.
 // const char*). So, to make the left hand side of << an lvalue, we need to use
 // a trick.
-
+//
+// The outer for loop skips constructing the stream, and evaluating the
+// operands of <<, when no sink accepts the level. (Being a loop rather than
+// an if, it leaves no else for a trailing else in user code to bind to.)
+// Note that `logger' is evaluated twice.
 #define LOG_WITH_LEVEL(logger, level) \
-   for (::mm::logging::LogStream strm((logger), (level)); \
-         !strm.Used(); strm.MarkUsed()) \
-      strm
+   for (bool mmLogEnabled = (logger).IsEnabled(level); mmLogEnabled; \
+         mmLogEnabled = false) \
+      for (::mm::logging::LogStream strm((logger), (level)); \
+            !strm.Used(); strm.MarkUsed()) \
+         strm
 
 #define LOG_TRACE(logger) LOG_WITH_LEVEL((logger), ::mm::logging::LogLevelTrace)
 #define LOG_DEBUG(logger) LOG_WITH_LEVEL((logger), ::mm::logging::LogLevelDebug)
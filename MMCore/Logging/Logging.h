@@ -52,6 +52,8 @@ public:
 
    virtual bool Filter(const Metadata& metadata) const
    { return metadata.GetEntryData().GetLevel() >= minLevel_; }
+
+   virtual int GetMinimumLevel() const { return minLevel_; }
 };
 
 
@@ -66,6 +66,12 @@ public:
    // Format the line prefix for the first line of an entry
    void FormatLinePrefix(std::ostream& stream, const Metadata& metadata);
 
+   // Same, from metadata fields recorded elsewhere (e.g. in a binary log)
+   void FormatLinePrefix(std::ostream& stream,
+         std::chrono::time_point<std::chrono::system_clock> timestamp,
+         const std::string& threadId, LogLevel level,
+         const char* componentLabel);
+
    // Format the line prefix for subsequent lines of an entry
    void FormatContinuationPrefix(std::ostream& stream);
 };
@@ -104,22 +110,34 @@ FormatLocalTime(std::chrono::time_point<std::chrono::system_clock> tp)
 inline void
 MetadataFormatter::FormatLinePrefix(std::ostream& stream,
       const Metadata& metadata)
+{
+   sstrm_.str(std::string());
+   sstrm_ << metadata.GetStampData().GetThreadId();
+   FormatLinePrefix(stream, metadata.GetStampData().GetTimestamp(),
+         sstrm_.str(), metadata.GetEntryData().GetLevel(),
+         metadata.GetLoggerData().GetComponentLabel());
+}
+
+
+inline void
+MetadataFormatter::FormatLinePrefix(std::ostream& stream,
+      std::chrono::time_point<std::chrono::system_clock> timestamp,
+      const std::string& threadId, LogLevel level,
+      const char* componentLabel)
 {
    // Pre-forming string is more efficient than writing bit by bit to stream.
 
-   buf_ = FormatLocalTime(metadata.GetStampData().GetTimestamp());
+   buf_ = FormatLocalTime(timestamp);
    buf_ += " tid";
-   sstrm_.str(std::string());
-   sstrm_ << metadata.GetStampData().GetThreadId();
-   buf_ += sstrm_.str();
+   buf_ += threadId;
    buf_ += ' ';
 
    openBracketCol_ = buf_.size();
    buf_ += '[';
 
-   buf_ += LevelString(metadata.GetEntryData().GetLevel());
+   buf_ += LevelString(level);
    buf_ += ',';
-   buf_ += metadata.GetLoggerData().GetComponentLabel();
+   buf_ += componentLabel;
 
    closeBracketCol_ = buf_.size();
    buf_ += ']';
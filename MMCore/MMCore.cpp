@@ -42,27 +42,41 @@
 #include "../MMDevice/DeviceUtils.h"
 #include "../MMDevice/ImageMetadata.h"
 #include "../MMDevice/ModuleInterface.h"
+#include "AsyncCommand.h"
+#include "CameraBufferPool.h"
 #include "CircularBuffer.h"
 #include "ConfigGroup.h"
+#include "ConfigPropertyIndex.h"
 #include "Configuration.h"
 #include "CoreCallback.h"
 #include "CoreProperty.h"
 #include "CoreUtils.h"
+#include "DeviceCommandQueue.h"
+#include "DeviceIdleSignal.h"
 #include "DeviceManager.h"
 #include "Devices/DeviceInstances.h"
+#include "FrameWriter.h"
 #include "Host.h"
 #include "LogManager.h"
 #include "MMCore.h"
 #include "MMEventCallback.h"
 #include "PluginManager.h"
+#include "PresetMatchCache.h"
+#include "StateCacheTracker.h"
+#include "ThreadPool.h"
 
 #include <algorithm>
 #include <cassert>
 #include <chrono>
+#include <cstdint>
 #include <cstring>
+#include <exception>
 #include <fstream>
+#include <functional>
 #include <set>
 #include <sstream>
+#include <system_error>
+#include <thread>
 #include <vector>
 
 
@@ -74,6 +88,8 @@
 #else
 // for _getcwd
 #include <direct.h>
+// for _getpid
+#include <process.h>
 #endif
 
 using namespace std;
@@ -113,7 +129,129 @@ using namespace std;
  * (Keep the 3 numbers on one line to make it easier to look at diffs when
  * merging/rebasing.)
  */
-const int MMCore_versionMajor = 10, MMCore_versionMinor = 4, MMCore_versionPatch = 0;
+const int MMCore_versionMajor = 10, MMCore_versionMinor = 17, MMCore_versionPatch = 0;
+
+
+namespace
+{
+
+void AddDeviceTime(std::vector< std::pair<std::string, double> >& times,
+      const std::string& label, double elapsedMs)
+{
+   for (size_t i = 0; i < times.size(); ++i)
+   {
+      if (times[i].first == label)
+      {
+         times[i].second += elapsedMs;
+         return;
+      }
+   }
+   times.push_back(std::make_pair(label, elapsedMs));
+}
+
+// Groups the indices of the devices by adapter module, in order of first
+// appearance; null devices are skipped.
+std::vector< std::vector<size_t> > GroupByModule(
+      const std::vector< std::shared_ptr<DeviceInstance> >& devices)
+{
+   std::vector< std::vector<size_t> > moduleDevices;
+   std::vector< std::shared_ptr<LoadedDeviceAdapter> > modules;
+   for (size_t i = 0; i < devices.size(); ++i)
+   {
+      if (!devices[i])
+         continue;
+      const std::shared_ptr<LoadedDeviceAdapter> module =
+         devices[i]->GetAdapterModule();
+      const size_t m = std::find(modules.begin(), modules.end(), module) -
+         modules.begin();
+      if (m == modules.size())
+      {
+         modules.push_back(module);
+         moduleDevices.push_back(std::vector<size_t>());
+      }
+      moduleDevices[m].push_back(i);
+   }
+   return moduleDevices;
+}
+
+// Calls fn(i) for each of the devices, with one thread per adapter module.
+// The calls for devices of the same module are made in order, from the same
+// thread, since they may depend on each other and, unless the adapter
+// declares per-device thread safety, share the module lock. If fn throws,
+// the remaining devices of that module are skipped, and the first
+// exception (in module order) is rethrown once all threads are done.
+void ForEachDeviceByModule(const std::vector< std::shared_ptr<DeviceInstance> >& devices,
+      const std::function<void(size_t)>& fn)
+{
+   const std::vector< std::vector<size_t> > moduleDevices = GroupByModule(devices);
+   if (moduleDevices.empty())
+      return;
+
+   std::vector<std::exception_ptr> exceptions(moduleDevices.size());
+   auto runModule = [&](size_t m) {
+      try
+      {
+         for (size_t j = 0; j < moduleDevices[m].size(); ++j)
+            fn(moduleDevices[m][j]);
+      }
+      catch (...)
+      {
+         exceptions[m] = std::current_exception();
+      }
+   };
+
+   std::vector<std::thread> threads;
+   for (size_t m = 1; m < moduleDevices.size(); ++m)
+   {
+      try
+      {
+         threads.emplace_back(runModule, m);
+      }
+      catch (const std::system_error&)
+      {
+         runModule(m);
+      }
+   }
+   runModule(0);
+   for (size_t t = 0; t < threads.size(); ++t)
+      threads[t].join();
+
+   for (size_t m = 0; m < exceptions.size(); ++m)
+   {
+      if (exceptions[m])
+         std::rethrow_exception(exceptions[m]);
+   }
+}
+
+// Queues each part of an asynchronous command on the worker of the adapter
+// module of the corresponding device, recording its outcome in command.
+void SubmitCommandParts(mm::DeviceCommandQueue& queue,
+      const std::vector< std::shared_ptr<DeviceInstance> >& devices,
+      const std::vector< std::function<void()> >& parts,
+      std::shared_ptr<mm::AsyncCommand> command)
+{
+   for (size_t i = 0; i < parts.size(); ++i)
+   {
+      const std::function<void()> part = parts[i];
+      queue.Submit(devices[i]->GetAdapterModule().get(), [part, command]() {
+         try
+         {
+            part();
+            command->PartDone();
+         }
+         catch (const CMMError& e)
+         {
+            command->PartFailed(e.getMsg(), e.getCode());
+         }
+         catch (const std::exception& e)
+         {
+            command->PartFailed(e.what(), MMERR_GENERIC);
+         }
+      });
+   }
+}
+
+} // anonymous namespace
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -139,20 +277,35 @@ CMMCore::CMMCore() :
    externalCallback_(0),
    pixelSizeGroup_(0),
    cbuf_(0),
+   perCameraBuffers_(false),
+   spillMaxMB_(0),
+   parallelConfigApply_(false),
    pluginManager_(new CPluginManager()),
    deviceManager_(new mm::DeviceManager()),
+   deviceIdleSignal_(new mm::DeviceIdleSignal()),
+   commandQueue_(new mm::DeviceCommandQueue()),
+   lastAsyncCommandId_(0),
+   stateCacheTracker_(new mm::StateCacheTracker()),
+   stateCacheRefreshCount_(0),
    pPostedErrorsLock_(NULL)
 {
    configGroups_ = new ConfigGroupCollection();
    pixelSizeGroup_ = new PixelSizeConfigGroup();
+   configPropertyIndex_ = std::make_shared<mm::ConfigPropertyIndex>(
+         *configGroups_, *pixelSizeGroup_);
+   presetMatchCache_ = std::make_shared<mm::PresetMatchCache>(*configGroups_);
    pPostedErrorsLock_ = new MMThreadLock();
 
    InitializeErrorMessages();
 
    callback_ = new CoreCallback(this);
 
+   threadPool_ = std::make_shared<ThreadPool>();
+
    const unsigned seqBufMegabytes = (sizeof(void*) > 4) ? 250 : 25;
-   cbuf_ = new CircularBuffer(seqBufMegabytes);
+   cbuf_ = new CircularBuffer(seqBufMegabytes, threadPool_);
+   cameraBuffers_ = std::make_shared<mm::CameraBufferPool>(seqBufMegabytes);
+   cameraBuffers_->SetThreadPool(threadPool_);
 
    nullAffine_ = new std::vector<double>(6);
    for (int i = 0; i < 6; i++) {
@@ -179,9 +332,13 @@ CMMCore::~CMMCore()
       LOG_ERROR(coreLogger_) << "Exception caught in CMMCore destructor.";
    }
 
+   commandQueue_.reset(); // Idle, since reset() waited for it
    delete callback_;
+   configPropertyIndex_.reset(); // Uses configGroups_ and pixelSizeGroup_
+   presetMatchCache_.reset(); // Uses configGroups_
    delete configGroups_;
    delete properties_;
+   frameWriter_.reset(); // Uses cbuf_
    delete cbuf_;
    delete pixelSizeGroup_;
    delete pPostedErrorsLock_;
@@ -297,10 +454,57 @@ int CMMCore::startSecondaryLogFile(const char* filename, bool enableDebug,
 }
 
 
+/**
+ * Start capturing logging output into an additional file in a compact binary
+ * format.
+ *
+ * Entries are recorded with their timestamp, thread, logger label and level
+ * as raw fields and the message unformatted, which costs much less than
+ * writing a text log. This keeps debug logging from perturbing acquisition
+ * timing as much. The DecodeBinaryLog tool renders the files in the text
+ * format of the primary log file.
+ *
+ * @param filename The filename to which the log will be captured. Any
+ * existing file is truncated.
+ * @param enableDebug Whether to include debug logging (regardless of whether
+ * debug logging is enabled for the primary log).
+ * @param maxFileSizeMB If positive, rotate the file when it reaches this
+ * size: filename is renamed to filename.1 (and so on) and a new file is
+ * started.
+ * @param maxBackupFiles The number of rotated files to keep.
+ * @param synchronous If true, enable synchronous logging for this file.
+ * @returns A handle required when calling stopSecondaryLogFile().
+ */
+int CMMCore::startSecondaryBinaryLogFile(const char* filename,
+      bool enableDebug, int maxFileSizeMB, int maxBackupFiles,
+      bool synchronous) throw (CMMError)
+{
+   if (!filename)
+      throw CMMError("Filename is null");
+   if (maxFileSizeMB < 0)
+      throw CMMError("Maximum log file size must not be negative",
+            MMERR_InvalidContents);
+   if (maxBackupFiles < 0)
+      throw CMMError("Number of backup log files must not be negative",
+            MMERR_InvalidContents);
+
+   using namespace mm::logging;
+   typedef mm::LogManager::LogFileHandle LogFileHandle;
+
+   LogFileHandle handle = logManager_->AddSecondaryBinaryLogFile(
+            (enableDebug ? LogLevelTrace : LogLevelInfo),
+            filename, static_cast<std::size_t>(maxFileSizeMB) << 20,
+            static_cast<unsigned>(maxBackupFiles),
+            (synchronous ? SinkModeSynchronous : SinkModeAsynchronous));
+   return static_cast<int>(handle);
+}
+
+
 /**
  * Stop capturing logging output into an additional file.
  *
- * @param handle The secondary log handle returned by startSecondaryLogFile().
+ * @param handle The secondary log handle returned by startSecondaryLogFile()
+ * or startSecondaryBinaryLogFile().
  */
 void CMMCore::stopSecondaryLogFile(int handle) throw (CMMError)
 {
@@ -310,6 +514,122 @@ void CMMCore::stopSecondaryLogFile(int handle) throw (CMMError)
 }
 
 
+/**
+ * Set how often entries queued for asynchronous log files (including the
+ * primary log file) are written out while logging is busy.
+ *
+ * Entries are written in batches at most once per interval; an idle logger
+ * writes the next entry immediately. Longer intervals reduce the cost of
+ * verbose logging at the cost of latency and queue space. The default is 10
+ * ms.
+ *
+ * @param intervalMs the batch interval in milliseconds, between 0 and 10000
+ */
+void CMMCore::setLogQueueFlushIntervalMs(double intervalMs) throw (CMMError)
+{
+   if (!(intervalMs >= 0.0 && intervalMs <= 10000.0))
+      throw CMMError("Log queue flush interval must be between 0 and 10000 ms",
+            MMERR_InvalidContents);
+   logManager_->SetAsyncBatchInterval(std::chrono::microseconds(
+            static_cast<long long>(intervalMs * 1000.0 + 0.5)));
+}
+
+/**
+ * Returns the batch interval of the asynchronous log queue in milliseconds.
+ * @see setLogQueueFlushIntervalMs()
+ */
+double CMMCore::getLogQueueFlushIntervalMs()
+{
+   return logManager_->GetAsyncBatchInterval().count() / 1000.0;
+}
+
+/**
+ * Set what happens to log entries when the queue to the asynchronous log
+ * files is full.
+ *
+ * - "Block" (the default): the logging thread waits until there is room, so
+ *   that no entries are lost.
+ * - "DropOldest": the oldest queued entries are discarded to make room.
+ * - "DropNewest": the new entry is discarded.
+ *
+ * Dropped entries are counted; see getLogQueueDroppedCount(). Synchronous
+ * log files receive every entry regardless of this setting.
+ *
+ * @param policy "Block", "DropOldest" or "DropNewest"
+ */
+void CMMCore::setLogQueueOverflowPolicy(const char* policy) throw (CMMError)
+{
+   if (!policy)
+      throw CMMError("Null log queue overflow policy");
+   const std::string p(policy);
+   mm::logging::OverflowPolicy value;
+   if (p == "Block")
+      value = mm::logging::OverflowPolicyBlock;
+   else if (p == "DropOldest")
+      value = mm::logging::OverflowPolicyDropOldest;
+   else if (p == "DropNewest")
+      value = mm::logging::OverflowPolicyDropNewest;
+   else
+      throw CMMError("Invalid log queue overflow policy " + ToQuotedString(p),
+            MMERR_InvalidContents);
+   logManager_->SetAsyncOverflowPolicy(value);
+}
+
+/**
+ * Returns the overflow policy of the asynchronous log queue.
+ * @see setLogQueueOverflowPolicy()
+ */
+std::string CMMCore::getLogQueueOverflowPolicy()
+{
+   switch (logManager_->GetAsyncOverflowPolicy())
+   {
+      case mm::logging::OverflowPolicyDropOldest:
+         return "DropOldest";
+      case mm::logging::OverflowPolicyDropNewest:
+         return "DropNewest";
+      default:
+         return "Block";
+   }
+}
+
+/**
+ * Returns the number of log entries accepted into the asynchronous log queue
+ * since the Core was created or the statistics were last reset.
+ * @see resetLogQueueStatistics()
+ */
+long CMMCore::getLogQueueQueuedCount()
+{
+   return static_cast<long>(logManager_->GetAsyncQueueStatistics().queued);
+}
+
+/**
+ * Returns the number of log entries discarded because the asynchronous log
+ * queue was full.
+ * @see setLogQueueOverflowPolicy()
+ */
+long CMMCore::getLogQueueDroppedCount()
+{
+   return static_cast<long>(logManager_->GetAsyncQueueStatistics().dropped);
+}
+
+/**
+ * Returns the number of log entries the asynchronous log queue has handed to
+ * the log files.
+ */
+long CMMCore::getLogQueueFlushedCount()
+{
+   return static_cast<long>(logManager_->GetAsyncQueueStatistics().flushed);
+}
+
+/**
+ * Resets the asynchronous log queue counters to zero.
+ */
+void CMMCore::resetLogQueueStatistics()
+{
+   logManager_->ResetAsyncQueueStatistics();
+}
+
+
 /*!
  Displays current user name.
  */
@@ -788,11 +1108,14 @@ void CMMCore::unloadDevice(const char* label///< the name of the device to unloa
 {
    std::shared_ptr<DeviceInstance> pDevice = deviceManager_->GetDevice(label);
 
+   commandQueue_->Drain();
+
    try {
       mm::DeviceModuleLockGuard guard(pDevice);
       LOG_DEBUG(coreLogger_) << "Will unload device " << label;
       deviceManager_->UnloadDevice(pDevice);
       LOG_DEBUG(coreLogger_) << "Did unload device " << label;
+      stateCacheTracker_->ForgetDevice(label);
    }
    catch (CMMError& err) {
       logError("MMCore::unloadDevice", err.getMsg().c_str());
@@ -806,6 +1129,8 @@ void CMMCore::unloadDevice(const char* label///< the name of the device to unloa
  */
 void CMMCore::unloadAllDevices() throw (CMMError)
 {
+   commandQueue_->Drain();
+
    try {
       configGroups_->Clear();
 
@@ -825,6 +1150,7 @@ void CMMCore::unloadAllDevices() throw (CMMError)
 
       LOG_DEBUG(coreLogger_) << "Will unload all devices";
       deviceManager_->UnloadAllDevices();
+      stateCacheTracker_->Clear();
       LOG_INFO(coreLogger_) << "Did unload all devices";
 
 	   properties_->Refresh();
@@ -902,6 +1228,7 @@ void CMMCore::initializeAllDevices() throw (CMMError)
       LOG_INFO(coreLogger_) << "Will initialize device " << devices[i];
       pDevice->Initialize();
       LOG_INFO(coreLogger_) << "Did initialize device " << devices[i];
+      stateCacheTracker_->MarkDeviceStale(devices[i]);
 
       assignDefaultRole(pDevice);
    }
@@ -958,6 +1285,7 @@ void CMMCore::initializeDevice(const char* label ///< the device to initialize
    LOG_INFO(coreLogger_) << "Will initialize device " << label;
    pDevice->Initialize();
    LOG_INFO(coreLogger_) << "Did initialize device " << label;
+   stateCacheTracker_->MarkDeviceStale(label);
 
    updateCoreProperties();
 }
@@ -966,16 +1294,343 @@ void CMMCore::initializeDevice(const char* label ///< the device to initialize
 
 /**
  * Updates the state of the entire hardware.
+ *
+ * Reads every property of every device; the devices of different adapter
+ * modules are read in parallel.
+ *
+ * @see refreshSystemStateCache()
  */
 void CMMCore::updateSystemStateCache()
 {
    LOG_DEBUG(coreLogger_) << "Will update system state cache";
-   Configuration wk = getSystemState();
+   refreshStateCache(true);
+   LOG_INFO(coreLogger_) << "Did update system state cache";
+}
+
+/**
+ * Updates the system state cache with the properties that may be out of
+ * date, leaving the others as they are.
+ *
+ * Reads the properties that have never been read into the cache (for
+ * example, of devices loaded since the last update), those marked stale
+ * with markPropertyStale() or markDeviceStale() (devices are marked stale
+ * when initialized), and those older than the maximum age set with
+ * setPropertyCacheMaxAgeMs(). The devices of different adapter modules are
+ * read in parallel.
+ *
+ * The number of properties read and the time spent on each device are
+ * available from getLastStateCacheRefreshCount(),
+ * getLastStateCacheRefreshDevices() and getLastStateCacheRefreshTimeMs().
+ *
+ * @return the number of properties read
+ */
+long CMMCore::refreshSystemStateCache()
+{
+   LOG_DEBUG(coreLogger_) << "Will refresh system state cache";
+   long count = refreshStateCache(false);
+   LOG_DEBUG(coreLogger_) << "Did refresh " << count <<
+      " properties in system state cache";
+   return count;
+}
+
+/**
+ * Marks a property so that the next refreshSystemStateCache() reads it,
+ * e.g. after a change that the device adapter does not report.
+ *
+ * @param label      the device label
+ * @param propName   the property name
+ */
+void CMMCore::markPropertyStale(const char* label, const char* propName) throw (CMMError)
+{
+   CheckDeviceLabel(label);
+   deviceManager_->GetDevice(label); // Throws if not loaded
+   CheckPropertyName(propName);
+   stateCacheTracker_->MarkStale(label, propName);
+}
+
+/**
+ * Marks all properties of a device so that the next
+ * refreshSystemStateCache() reads them.
+ *
+ * @param label   the device label
+ */
+void CMMCore::markDeviceStale(const char* label) throw (CMMError)
+{
+   CheckDeviceLabel(label);
+   deviceManager_->GetDevice(label); // Throws if not loaded
+   stateCacheTracker_->MarkDeviceStale(label);
+}
+
+/**
+ * Sets the age after which refreshSystemStateCache() reads a property
+ * again, even if it was not marked stale. Useful for values that change by
+ * themselves, such as temperatures.
+ *
+ * @param label      the device label
+ * @param propName   the property name
+ * @param maxAgeMs   the maximum age in milliseconds; 0 for no maximum (the
+ *                   default)
+ */
+void CMMCore::setPropertyCacheMaxAgeMs(const char* label, const char* propName,
+      double maxAgeMs) throw (CMMError)
+{
+   CheckDeviceLabel(label);
+   deviceManager_->GetDevice(label); // Throws if not loaded
+   CheckPropertyName(propName);
+   stateCacheTracker_->SetMaxAge(label, propName, maxAgeMs);
+}
+
+/**
+ * Returns the number of device properties read by the last update or
+ * refresh of the system state cache.
+ */
+long CMMCore::getLastStateCacheRefreshCount()
+{
+   MMThreadGuard g(stateCacheRefreshLock_);
+   return stateCacheRefreshCount_;
+}
+
+/**
+ * Returns the labels of the devices visited by the last update or refresh
+ * of the system state cache.
+ *
+ * @see getLastStateCacheRefreshTimeMs()
+ */
+std::vector<std::string> CMMCore::getLastStateCacheRefreshDevices()
+{
+   MMThreadGuard g(stateCacheRefreshLock_);
+   std::vector<std::string> labels;
+   for (size_t i = 0; i < stateCacheRefreshTimes_.size(); ++i)
+      labels.push_back(stateCacheRefreshTimes_[i].first);
+   return labels;
+}
+
+/**
+ * Returns the time spent reading the device's properties during the last
+ * update or refresh of the system state cache, in milliseconds. Returns 0
+ * if the device was not visited.
+ */
+double CMMCore::getLastStateCacheRefreshTimeMs(const char* label)
+{
+   if (!label)
+      return 0.0;
+   MMThreadGuard g(stateCacheRefreshLock_);
+   for (size_t i = 0; i < stateCacheRefreshTimes_.size(); ++i)
+   {
+      if (stateCacheRefreshTimes_[i].first == label)
+         return stateCacheRefreshTimes_[i].second;
+   }
+   return 0.0;
+}
+
+/*
+ * Helper function for getProperties and setProperties
+ * Checks the label, property name and (if given) value of each item and
+ * looks up its device, resolving each label once. devices[i] is left null
+ * for Core properties and for items that fail, whose error message is put
+ * in errors[i]; errors[i] is empty for the others.
+ */
+void CMMCore::resolvePropertyItems(const std::vector<std::string>& labels,
+      const std::vector<std::string>& propNames,
+      const std::vector<std::string>* values,
+      std::vector< std::shared_ptr<DeviceInstance> >& devices,
+      std::vector<std::string>& errors)
+{
+   devices.assign(labels.size(), std::shared_ptr<DeviceInstance>());
+   errors.assign(labels.size(), std::string());
+
+   std::map< std::string, std::shared_ptr<DeviceInstance> > resolved;
+   for (size_t i = 0; i < labels.size(); ++i)
+   {
+      try
+      {
+         CheckDeviceLabel(labels[i].c_str());
+         CheckPropertyName(propNames[i].c_str());
+         if (values)
+            CheckPropertyValue((*values)[i].c_str());
+         if (IsCoreDeviceLabel(labels[i].c_str()))
+            continue;
+
+         std::map< std::string, std::shared_ptr<DeviceInstance> >::const_iterator it =
+            resolved.find(labels[i]);
+         if (it == resolved.end())
+            it = resolved.insert(std::make_pair(labels[i],
+                     deviceManager_->GetDevice(labels[i]))).first;
+         devices[i] = it->second;
+      }
+      catch (const CMMError& e)
+      {
+         errors[i] = e.getMsg();
+      }
+   }
+}
+
+// Returns the handle of a new asynchronous command
+long CMMCore::registerAsyncCommand(std::shared_ptr<mm::AsyncCommand> command)
+{
+   MMThreadGuard g(asyncCommandsLock_);
+   const long id = ++lastAsyncCommandId_;
+   asyncCommands_[id] = command;
+   return id;
+}
+
+std::shared_ptr<mm::AsyncCommand> CMMCore::findAsyncCommand(long command) throw (CMMError)
+{
+   MMThreadGuard g(asyncCommandsLock_);
+   std::map< long, std::shared_ptr<mm::AsyncCommand> >::const_iterator it =
+      asyncCommands_.find(command);
+   if (it == asyncCommands_.end())
+      throw CMMError(getCoreErrorText(MMERR_UnknownAsyncCommand).c_str(),
+            MMERR_UnknownAsyncCommand);
+   return it->second;
+}
+
+/*
+ * Adds or replaces a setting in the system state cache, dropping the
+ * remembered presets that it may affect. Must be called with
+ * stateCacheLock_ held.
+ */
+void CMMCore::addToStateCache(const PropertySetting& setting) const
+{
+   if (!stateCache_.isSettingIncluded(setting))
+      presetMatchCache_->Invalidate(setting.getDeviceLabel(), setting.getPropertyName());
+   stateCache_.addSetting(setting);
+}
+
+/*
+ * Helper function for updateSystemStateCache and refreshSystemStateCache
+ * Reads device properties into the system state cache, with one thread per
+ * adapter module: all of them if all is true, otherwise those that
+ * stateCacheTracker_ reports as needing it. Core properties are always
+ * updated. Returns the number of device properties read. If the properties
+ * of a device cannot be listed, the other devices are still read and the
+ * first such error is thrown afterwards.
+ */
+long CMMCore::refreshStateCache(bool all)
+{
+   typedef mm::StateCacheTracker::Clock Clock;
+
+   vector<string> labels = deviceManager_->GetDeviceList();
+   vector< std::shared_ptr<DeviceInstance> > devices;
+   for (size_t i = 0; i < labels.size(); ++i)
+      devices.push_back(deviceManager_->GetDevice(labels[i]));
+
+   vector< vector<PropertySetting> > deviceSettings(devices.size());
+   vector<Clock::time_point> readTimes(devices.size());
+   vector<double> elapsedMs(devices.size(), 0.0);
+   // Failure to list a device's properties; the device is left out of the
+   // cache update, and the first failure is thrown once the others are done
+   vector<std::exception_ptr> failures(devices.size());
+   ForEachDeviceByModule(devices, [&](size_t i) {
+      std::shared_ptr<DeviceInstance> pDev = devices[i];
+      mm::DeviceModuleLockGuard guard(pDev);
+      readTimes[i] = Clock::now();
+      std::vector<std::string> propertyNames;
+      try
+      {
+         propertyNames = pDev->GetPropertyNames();
+      }
+      catch (const CMMError&)
+      {
+         failures[i] = std::current_exception();
+         return;
+      }
+      for (std::vector<std::string>::const_iterator it = propertyNames.begin(), end = propertyNames.end();
+            it != end; ++it)
+      {
+         if (!all && !stateCacheTracker_->NeedsRefresh(labels[i], *it, readTimes[i]))
+            continue;
+
+         std::string val;
+         try
+         {
+            val = pDev->GetProperty(*it);
+         }
+         catch (const CMMError&)
+         {
+            // Ignored, as in getSystemState()
+         }
+
+         bool readOnly = false;
+         try
+         {
+            readOnly = pDev->GetPropertyReadOnly(it->c_str());
+         }
+         catch (const CMMError&)
+         {
+         }
+         deviceSettings[i].push_back(PropertySetting(labels[i].c_str(), it->c_str(), val.c_str(), readOnly));
+      }
+      elapsedMs[i] = std::chrono::duration<double, std::milli>(
+            Clock::now() - readTimes[i]).count();
+   });
+
    {
       MMThreadGuard scg(stateCacheLock_);
-      stateCache_ = wk;
+      if (all)
+      {
+         stateCache_ = Configuration();
+         presetMatchCache_->InvalidateAll();
+      }
+      else
+      {
+         // Drop the properties of unloaded devices
+         const std::set<string> loaded(labels.begin(), labels.end());
+         Configuration kept;
+         bool dropped = false;
+         for (size_t i = 0; i < stateCache_.size(); ++i)
+         {
+            PropertySetting setting = stateCache_.getSetting(i);
+            if (setting.getDeviceLabel() == MM::g_Keyword_CoreDevice ||
+                  loaded.count(setting.getDeviceLabel()))
+               kept.addSetting(setting);
+            else
+               dropped = true;
+         }
+         if (dropped)
+         {
+            stateCache_ = kept;
+            presetMatchCache_->InvalidateAll();
+         }
+      }
+
+      for (size_t i = 0; i < deviceSettings.size(); ++i)
+      {
+         for (size_t j = 0; j < deviceSettings[i].size(); ++j)
+            addToStateCache(deviceSettings[i][j]);
+      }
+
+      vector<string> coreProps = properties_->GetNames();
+      for (unsigned i=0; i < coreProps.size(); i++)
+      {
+         string name = coreProps[i];
+         string val = properties_->Get(name.c_str());
+         addToStateCache(PropertySetting(MM::g_Keyword_CoreDevice, name.c_str(), val.c_str(), properties_->IsReadOnly(name.c_str())));
+      }
    }
-   LOG_INFO(coreLogger_) << "Did update system state cache";
+
+   long count = 0;
+   DeviceTimes times;
+   for (size_t i = 0; i < devices.size(); ++i)
+   {
+      for (size_t j = 0; j < deviceSettings[i].size(); ++j)
+         stateCacheTracker_->MarkRead(labels[i],
+               deviceSettings[i][j].getPropertyName(), readTimes[i]);
+      count += (long)deviceSettings[i].size();
+      AddDeviceTime(times, labels[i], elapsedMs[i]);
+   }
+   {
+      MMThreadGuard g(stateCacheRefreshLock_);
+      stateCacheRefreshCount_ = count;
+      stateCacheRefreshTimes_.swap(times);
+   }
+
+   for (size_t i = 0; i < failures.size(); ++i)
+   {
+      if (failures[i])
+         std::rethrow_exception(failures[i]);
+   }
+   return count;
 }
 
 /**
@@ -1158,6 +1813,103 @@ bool CMMCore::usesDeviceDelay(const char* label) throw (CMMError)
    return pDevice->UsesDelay();
 }
 
+/**
+ * Signals if calls to the device are serialized by a lock of its own, rather
+ * than by the lock shared by all devices of its adapter module.
+ *
+ * Per-device locking is used when the device adapter declares that its
+ * devices are thread-safe with respect to each other. Calls to different
+ * devices of such an adapter may then run concurrently.
+ *
+ * @param label    the device label
+ * @return true if the device has its own lock
+ */
+bool CMMCore::usesPerDeviceLocking(const char* label) throw (CMMError)
+{
+   if (IsCoreDeviceLabel(label))
+      return false;
+   return deviceManager_->GetDevice(label)->UsesPerDeviceLock();
+}
+
+/**
+ * Returns the number of times the lock serializing calls to the device has
+ * been acquired for the device since it was loaded or the statistics were
+ * last reset.
+ *
+ * @param label    the device label
+ * @see resetDeviceLockStatistics()
+ */
+long CMMCore::getDeviceLockCount(const char* label) throw (CMMError)
+{
+   if (IsCoreDeviceLabel(label))
+      return 0;
+   return static_cast<long>(
+         deviceManager_->GetDevice(label)->GetLockStatistics().Get().count);
+}
+
+/**
+ * Returns the total time, in milliseconds, spent waiting to acquire the lock
+ * for calls to the device. When the device shares its module's lock, this
+ * includes waiting for calls to the other devices of the module.
+ *
+ * @param label    the device label
+ */
+double CMMCore::getDeviceLockWaitTimeMs(const char* label) throw (CMMError)
+{
+   if (IsCoreDeviceLabel(label))
+      return 0.0;
+   return deviceManager_->GetDevice(label)->GetLockStatistics().Get().totalWaitMs;
+}
+
+/**
+ * Returns the longest single wait, in milliseconds, to acquire the lock for a
+ * call to the device.
+ *
+ * @param label    the device label
+ */
+double CMMCore::getDeviceLockMaxWaitTimeMs(const char* label) throw (CMMError)
+{
+   if (IsCoreDeviceLabel(label))
+      return 0.0;
+   return deviceManager_->GetDevice(label)->GetLockStatistics().Get().maxWaitMs;
+}
+
+/**
+ * Returns the total time, in milliseconds, for which the lock was held for
+ * calls to the device.
+ *
+ * @param label    the device label
+ */
+double CMMCore::getDeviceLockHoldTimeMs(const char* label) throw (CMMError)
+{
+   if (IsCoreDeviceLabel(label))
+      return 0.0;
+   return deviceManager_->GetDevice(label)->GetLockStatistics().Get().totalHoldMs;
+}
+
+/**
+ * Returns the longest time, in milliseconds, for which the lock was held for
+ * a single call (or sequence of calls) to the device.
+ *
+ * @param label    the device label
+ */
+double CMMCore::getDeviceLockMaxHoldTimeMs(const char* label) throw (CMMError)
+{
+   if (IsCoreDeviceLabel(label))
+      return 0.0;
+   return deviceManager_->GetDevice(label)->GetLockStatistics().Get().maxHoldMs;
+}
+
+/**
+ * Clears the lock statistics of all loaded devices.
+ */
+void CMMCore::resetDeviceLockStatistics()
+{
+   std::vector<std::string> labels = deviceManager_->GetDeviceList();
+   for (size_t i = 0; i < labels.size(); ++i)
+      deviceManager_->GetDevice(labels[i])->GetLockStatistics().Reset();
+}
+
 /**
  * Checks the busy status of the specific device.
  * @param label the device label
@@ -1207,34 +1959,49 @@ void CMMCore::waitForDevice(std::shared_ptr<DeviceInstance> pDev) throw (CMMErro
 {
    LOG_DEBUG(coreLogger_) << "Waiting for device " << pDev->GetLabel() << "...";
 
+   waitForDevices(std::vector< std::shared_ptr<DeviceInstance> >(1, pDev));
+
+   LOG_DEBUG(coreLogger_) << "Finished waiting for device " << pDev->GetLabel();
+}
+
+/**
+ * Waits (blocks the calling thread) until all the given devices become
+ * non-busy. The busy devices are polled together, so the wait lasts as long
+ * as the slowest device, and the timeout applies to the wait as a whole.
+ * Polls again as soon as a device reports that it is idle (see
+ * MM::Core::OnDeviceIdle()), and otherwise every polling interval.
+ * @param devices   the devices to wait for
+ */
+void CMMCore::waitForDevices(std::vector< std::shared_ptr<DeviceInstance> > devices) throw (CMMError)
+{
    auto now = std::chrono::steady_clock::now();
    auto timeout = std::chrono::duration<long long, std::milli>(timeoutMs_);
    auto deadline = now + timeout;
+   auto pollingInterval = std::chrono::duration<long long, std::milli>(pollingIntervalMs_);
 
-   while (true)
-   {
+   // Each poll keeps only the devices that are still busy
+   auto busy = [&devices]() {
+      std::vector< std::shared_ptr<DeviceInstance> > busyDevices;
+      for (size_t i = 0; i < devices.size(); ++i)
       {
-         mm::DeviceModuleLockGuard guard(pDev);
-         if (!pDev->Busy())
-         {
-            break;
-         }
-      }
-
-      if (std::chrono::steady_clock::now() > deadline)
-      {
-         string label = pDev->GetLabel();
-         std::ostringstream mez;
-         mez << "wait timed out after " << timeoutMs_ << " ms. ";
-         logError(label.c_str(), mez.str().c_str());
-         throw CMMError("Wait for device " + ToQuotedString(label) + " timed out after " +
-               ToString(timeoutMs_) + "ms",
-               MMERR_DevicePollingTimeout);
+         mm::DeviceModuleLockGuard guard(devices[i]);
+         if (devices[i]->Busy())
+            busyDevices.push_back(devices[i]);
       }
+      devices.swap(busyDevices);
+      return !devices.empty();
+   };
 
-     sleep(pollingIntervalMs_);
+   if (!deviceIdleSignal_->WaitWhileBusy(busy, pollingInterval, deadline))
+   {
+      string label = devices.front()->GetLabel();
+      std::ostringstream mez;
+      mez << "wait timed out after " << timeoutMs_ << " ms. ";
+      logError(label.c_str(), mez.str().c_str());
+      throw CMMError("Wait for device " + ToQuotedString(label) + " timed out after " +
+            ToString(timeoutMs_) + "ms",
+            MMERR_DevicePollingTimeout);
    }
-   LOG_DEBUG(coreLogger_) << "Finished waiting for device " << pDev->GetLabel();
 }
 
 /**
@@ -1250,6 +2017,7 @@ bool CMMCore::systemBusy() throw (CMMError)
 
 /**
  * Blocks until all devices in the system become ready (not-busy).
+ * @see waitForDeviceType()
  */
 void CMMCore::waitForSystem() throw (CMMError)
 {
@@ -1287,13 +2055,20 @@ bool CMMCore::deviceTypeBusy(MM::DeviceType devType) throw (CMMError)
 
 /**
  * Blocks until all devices of the specific type become ready (not-busy).
+ * The devices are waited for together rather than one after the other, and
+ * the timeout applies to the wait as a whole.
  * @param devType    a constant specifying the device type
  */
 void CMMCore::waitForDeviceType(MM::DeviceType devType) throw (CMMError)
 {
-   vector<string> devices = deviceManager_->GetDeviceList(devType);
-   for (size_t i=0; i<devices.size(); i++)
-      waitForDevice(devices[i].c_str());
+   vector<string> labels = deviceManager_->GetDeviceList(devType);
+   vector< std::shared_ptr<DeviceInstance> > devices;
+   for (size_t i=0; i<labels.size(); i++)
+      devices.push_back(deviceManager_->GetDevice(labels[i]));
+
+   LOG_DEBUG(coreLogger_) << "Waiting for " << devices.size() << " devices...";
+   waitForDevices(devices);
+   LOG_DEBUG(coreLogger_) << "Finished waiting for " << devices.size() << " devices";
 }
 
 /**
@@ -1308,8 +2083,17 @@ void CMMCore::waitForConfig(const char* group, const char* configName) throw (CM
 
    Configuration cfg = getConfigData(group, configName);
    try {
+      vector< std::shared_ptr<DeviceInstance> > devices;
       for(size_t i=0; i<cfg.size(); i++)
-         waitForDevice(cfg.getSetting(i).getDeviceLabel().c_str());
+      {
+         const string label = cfg.getSetting(i).getDeviceLabel();
+         if (IsCoreDeviceLabel(label.c_str()))
+            continue; // core property commands always block
+         std::shared_ptr<DeviceInstance> pDevice = deviceManager_->GetDevice(label);
+         if (std::find(devices.begin(), devices.end(), pDevice) == devices.end())
+            devices.push_back(pDevice);
+      }
+      waitForDevices(devices);
    } catch (CMMError& err) {
       // trap MM exceptions and keep quiet - this is not a good time to blow up
       logError("waitForConfig", err.getMsg().c_str());
@@ -1317,22 +2101,256 @@ void CMMCore::waitForConfig(const char* group, const char* configName) throw (CM
 }
 
 /**
- * Wait for the slowest device in the ImageSynchro list.
+ * Wait for the slowest device in the ImageSynchro list.
+ *
+ * @deprecated ImageSynchro will not be supported in the future.
+ */
+void CMMCore::waitForImageSynchro() throw (CMMError)
+{
+   for (std::vector< std::weak_ptr<DeviceInstance> >::iterator
+         it = imageSynchroDevices_.begin(), end = imageSynchroDevices_.end();
+         it != end; ++it)
+   {
+      std::shared_ptr<DeviceInstance> device = it->lock();
+      if (device)
+      {
+         waitForDevice(device);
+      }
+   }
+}
+
+/**
+ * Starts moving the stage to a position, without waiting.
+ *
+ * The move is made on the worker thread of the stage's adapter module, after
+ * any asynchronous commands queued earlier for that module, and the command
+ * is done when the stage is no longer busy.
+ *
+ * @return the command handle, for isCommandDone() and waitForCommand()
+ * @param label     the stage device label
+ * @param position  the desired stage position, in microns
+ */
+long CMMCore::setPositionAsync(const char* label, double position) throw (CMMError)
+{
+   std::shared_ptr<StageInstance> pStage =
+      deviceManager_->GetDeviceOfType<StageInstance>(label);
+   const std::string stageLabel(label);
+
+   std::shared_ptr<mm::AsyncCommand> command = std::make_shared<mm::AsyncCommand>(1);
+   const long id = registerAsyncCommand(command);
+   LOG_DEBUG(coreLogger_) << "Will queue command " << id << ": move of " <<
+      label << " to position " << std::fixed << std::setprecision(5) <<
+      position << " um";
+   SubmitCommandParts(*commandQueue_,
+         std::vector< std::shared_ptr<DeviceInstance> >(1, pStage),
+         std::vector< std::function<void()> >(1, [this, stageLabel, pStage, position]() {
+            setPosition(stageLabel.c_str(), position);
+            waitForDevice(pStage);
+         }),
+         command);
+   return id;
+}
+
+/**
+ * Starts moving the XY stage to a position, without waiting.
+ *
+ * The move is made on the worker thread of the stage's adapter module, after
+ * any asynchronous commands queued earlier for that module, and the command
+ * is done when the stage is no longer busy.
+ *
+ * @return the command handle, for isCommandDone() and waitForCommand()
+ * @param label  the XY stage device label
+ * @param x      the X axis position in microns
+ * @param y      the Y axis position in microns
+ */
+long CMMCore::setXYPositionAsync(const char* label, double x, double y) throw (CMMError)
+{
+   std::shared_ptr<XYStageInstance> pXYStage =
+      deviceManager_->GetDeviceOfType<XYStageInstance>(label);
+   const std::string stageLabel(label);
+
+   std::shared_ptr<mm::AsyncCommand> command = std::make_shared<mm::AsyncCommand>(1);
+   const long id = registerAsyncCommand(command);
+   LOG_DEBUG(coreLogger_) << "Will queue command " << id << ": move of " <<
+      label << " to position (" << std::fixed << std::setprecision(3) << x <<
+      ", " << y << ") um";
+   SubmitCommandParts(*commandQueue_,
+         std::vector< std::shared_ptr<DeviceInstance> >(1, pXYStage),
+         std::vector< std::function<void()> >(1, [this, stageLabel, pXYStage, x, y]() {
+            setXYPosition(stageLabel.c_str(), x, y);
+            waitForDevice(pXYStage);
+         }),
+         command);
+   return id;
+}
+
+/**
+ * Starts setting the state of a state device, without waiting.
+ *
+ * The state is set on the worker thread of the device's adapter module,
+ * after any asynchronous commands queued earlier for that module, and the
+ * command is done when the device is no longer busy.
+ *
+ * @return the command handle, for isCommandDone() and waitForCommand()
+ * @param deviceLabel  the device label
+ * @param state        the new state
+ */
+long CMMCore::setStateAsync(const char* deviceLabel, long state) throw (CMMError)
+{
+   std::shared_ptr<StateInstance> pStateDev =
+      deviceManager_->GetDeviceOfType<StateInstance>(deviceLabel);
+   const std::string label(deviceLabel);
+
+   std::shared_ptr<mm::AsyncCommand> command = std::make_shared<mm::AsyncCommand>(1);
+   const long id = registerAsyncCommand(command);
+   LOG_DEBUG(coreLogger_) << "Will queue command " << id << ": set " <<
+      deviceLabel << " to state " << state;
+   SubmitCommandParts(*commandQueue_,
+         std::vector< std::shared_ptr<DeviceInstance> >(1, pStateDev),
+         std::vector< std::function<void()> >(1, [this, label, pStateDev, state]() {
+            setState(label.c_str(), state);
+            waitForDevice(pStateDev);
+         }),
+         command);
+   return id;
+}
+
+/**
+ * Starts applying a configuration preset, without waiting.
+ *
+ * Core properties are set before returning. The device properties of each
+ * adapter module are set in order on that module's worker thread, after any
+ * asynchronous commands queued earlier for the module, so the modules
+ * proceed in parallel. As with setConfig(), properties that fail are tried
+ * again while that makes progress, but only among those of the same module.
+ * The command is done when all the devices involved are no longer busy.
+ *
+ * @return the command handle, for isCommandDone() and waitForCommand()
+ * @param groupName   the configuration group name
+ * @param configName  the configuration preset name
+ */
+long CMMCore::setConfigAsync(const char* groupName, const char* configName) throw (CMMError)
+{
+   CheckConfigGroupName(groupName);
+   CheckConfigPresetName(configName);
+
+   Configuration* pCfg = configGroups_->Find(groupName, configName);
+   if (!pCfg)
+   {
+      throw CMMError("Preset " + ToQuotedString(configName) +
+            " of configuration group " + ToQuotedString(groupName) +
+            " does not exist",
+            MMERR_NoConfiguration);
+   }
+
+   vector<PropertySetting> settings;
+   vector< std::shared_ptr<DeviceInstance> > devices;
+   for (size_t i = 0; i < pCfg->size(); i++)
+   {
+      PropertySetting setting = pCfg->getSetting(i);
+      if (setting.getDeviceLabel().compare(MM::g_Keyword_CoreDevice) == 0)
+      {
+         properties_->Execute(setting.getPropertyName().c_str(), setting.getPropertyValue().c_str());
+         {
+            MMThreadGuard scg(stateCacheLock_);
+            addToStateCache(PropertySetting(MM::g_Keyword_CoreDevice, setting.getPropertyName().c_str(), setting.getPropertyValue().c_str()));
+         }
+      }
+      else
+      {
+         devices.push_back(deviceManager_->GetDevice(setting.getDeviceLabel()));
+         settings.push_back(setting);
+      }
+   }
+
+   const vector< vector<size_t> > modules = GroupByModule(devices);
+   vector< std::shared_ptr<DeviceInstance> > partDevices;
+   vector< std::function<void()> > parts;
+   for (size_t m = 0; m < modules.size(); ++m)
+   {
+      vector<PropertySetting> moduleSettings;
+      vector< std::shared_ptr<DeviceInstance> > moduleDevices;
+      for (size_t j = 0; j < modules[m].size(); ++j)
+      {
+         moduleSettings.push_back(settings[modules[m][j]]);
+         moduleDevices.push_back(devices[modules[m][j]]);
+      }
+      partDevices.push_back(moduleDevices.front());
+      parts.push_back([this, moduleSettings, moduleDevices]() {
+         vector<PropertySetting> pending = moduleSettings;
+         vector< std::shared_ptr<DeviceInstance> > pendingDevices = moduleDevices;
+         string lastError;
+         while (!pending.empty())
+         {
+            vector<PropertySetting> failed;
+            vector< std::shared_ptr<DeviceInstance> > failedDevices;
+            for (size_t i = 0; i < pending.size(); ++i)
+            {
+               double elapsedMs = 0.0;
+               if (!applySetting(pendingDevices[i], pending[i], elapsedMs, &lastError))
+               {
+                  logError(pending[i].getDeviceLabel().c_str(), lastError.c_str());
+                  failed.push_back(pending[i]);
+                  failedDevices.push_back(pendingDevices[i]);
+               }
+            }
+            if (failed.size() == pending.size())
+               throw CMMError(lastError.c_str(), MMERR_DEVICE_GENERIC);
+            pending.swap(failed);
+            pendingDevices.swap(failedDevices);
+         }
+
+         vector< std::shared_ptr<DeviceInstance> > distinctDevices;
+         for (size_t i = 0; i < moduleDevices.size(); ++i)
+         {
+            if (std::find(distinctDevices.begin(), distinctDevices.end(),
+                     moduleDevices[i]) == distinctDevices.end())
+               distinctDevices.push_back(moduleDevices[i]);
+         }
+         waitForDevices(distinctDevices);
+      });
+   }
+
+   std::shared_ptr<mm::AsyncCommand> command =
+      std::make_shared<mm::AsyncCommand>((int)parts.size());
+   const long id = registerAsyncCommand(command);
+   LOG_DEBUG(coreLogger_) << "Will queue command " << id << ": config group " <<
+      groupName << ", preset " << configName << " (" << parts.size() <<
+      " adapter modules)";
+   SubmitCommandParts(*commandQueue_, partDevices, parts, command);
+   return id;
+}
+
+/**
+ * Returns whether an asynchronous command is done, successfully or not.
  *
- * @deprecated ImageSynchro will not be supported in the future.
+ * @param command   the command handle
  */
-void CMMCore::waitForImageSynchro() throw (CMMError)
+bool CMMCore::isCommandDone(long command) throw (CMMError)
 {
-   for (std::vector< std::weak_ptr<DeviceInstance> >::iterator
-         it = imageSynchroDevices_.begin(), end = imageSynchroDevices_.end();
-         it != end; ++it)
+   return findAsyncCommand(command)->IsDone();
+}
+
+/**
+ * Waits for an asynchronous command to be done, and throws its error if it
+ * failed. The handle is released, so this must be called exactly once for
+ * each command.
+ *
+ * @param command   the command handle
+ */
+void CMMCore::waitForCommand(long command) throw (CMMError)
+{
+   std::shared_ptr<mm::AsyncCommand> pCommand = findAsyncCommand(command);
+   pCommand->Wait();
    {
-      std::shared_ptr<DeviceInstance> device = it->lock();
-      if (device)
-      {
-         waitForDevice(device);
-      }
+      MMThreadGuard g(asyncCommandsLock_);
+      asyncCommands_.erase(command);
    }
+
+   std::string message;
+   int code;
+   if (pCommand->GetError(message, code))
+      throw CMMError(message, code);
 }
 
 /**
@@ -2525,7 +3543,7 @@ void CMMCore::setAutoShutter(bool state)
    autoShutter_ = state;
    {
       MMThreadGuard scg(stateCacheLock_);
-      stateCache_.addSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreAutoShutter, state ? "1" : "0"));
+      addToStateCache(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreAutoShutter, state ? "1" : "0"));
    }
    LOG_DEBUG(coreLogger_) << "Autoshutter turned " << (state ? "on" : "off");
 }
@@ -2560,7 +3578,7 @@ void CMMCore::setShutterOpen(const char* shutterLabel, bool state) throw (CMMErr
       {
          {
             MMThreadGuard scg(stateCacheLock_);
-            stateCache_.addSetting(PropertySetting(shutterLabel, MM::g_Keyword_State, CDeviceUtils::ConvertToString(state)));
+            addToStateCache(PropertySetting(shutterLabel, MM::g_Keyword_State, CDeviceUtils::ConvertToString(state)));
          }
       }
    }
@@ -2810,6 +3828,10 @@ void CMMCore::startSequenceAcquisition(long numImages, double intervalMs, bool s
  * This command does not block the calling thread for the duration of the acquisition.
  * The difference between this method and the one with the same name but operating on the "default"
  * camera is that it does not automatically initialize the circular buffer.
+ *
+ * If per-camera circular buffers are enabled, the camera's own buffer is
+ * initialized and cleared, and receives the images instead of the shared
+ * buffer (see enablePerCameraCircularBuffers()).
  */
 void CMMCore::startSequenceAcquisition(const char* label, long numImages, double intervalMs, bool stopOnOverflow) throw (CMMError)
 {
@@ -2821,11 +3843,37 @@ void CMMCore::startSequenceAcquisition(const char* label, long numImages, double
       throw CMMError(getCoreErrorText(MMERR_NotAllowedDuringSequenceAcquisition).c_str(),
                      MMERR_NotAllowedDuringSequenceAcquisition);
 
+   if (perCameraBuffers_)
+   {
+      try
+      {
+         if (!cameraBuffers_->Initialize(label, pCam->GetNumberOfChannels(),
+                  pCam->GetImageWidth(), pCam->GetImageHeight(),
+                  pCam->GetImageBytesPerPixel()))
+         {
+            logError(label, getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str());
+            throw CMMError(getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str(),
+                  MMERR_CircularBufferFailedToInitialize);
+         }
+      }
+      catch (const std::bad_alloc& ex)
+      {
+         ostringstream messs;
+         messs << getCoreErrorText(MMERR_OutOfMemory).c_str() << " " << ex.what() << endl;
+         throw CMMError(messs.str().c_str() , MMERR_OutOfMemory);
+      }
+      cameraBuffers_->Find(label)->Clear();
+      cameraBuffers_->SetStreaming(label, true);
+   }
+
    LOG_DEBUG(coreLogger_) <<
       "Will start sequence acquisition from camera " << label;
    int nRet = pCam->StartSequenceAcquisition(numImages, intervalMs, stopOnOverflow);
    if (nRet != DEVICE_OK)
+   {
+      cameraBuffers_->SetStreaming(label, false);
       throw CMMError(getDeviceErrorText(nRet, pCam).c_str(), MMERR_DEVICE_GENERIC);
+   }
 
    LOG_DEBUG(coreLogger_) <<
       "Did start sequence acquisition from camera " << label;
@@ -2845,6 +3893,13 @@ void CMMCore::prepareSequenceAcquisition(const char* label) throw (CMMError)
       throw CMMError(getCoreErrorText(MMERR_NotAllowedDuringSequenceAcquisition).c_str(),
                      MMERR_NotAllowedDuringSequenceAcquisition);
 
+   // Set aside memory for this camera when the buffers of cameras that are
+   // started before it are sized
+   if (perCameraBuffers_)
+      cameraBuffers_->RegisterDemand(label, pCam->GetNumberOfChannels(),
+            pCam->GetImageWidth(), pCam->GetImageHeight(),
+            pCam->GetImageBytesPerPixel());
+
    LOG_DEBUG(coreLogger_) << "Will prepare camera " << label <<
       " for sequence acquisition";
    int nRet = pCam->PrepareSequenceAcqusition();
@@ -2891,6 +3946,7 @@ void CMMCore::stopSequenceAcquisition(const char* label) throw (CMMError)
    mm::DeviceModuleLockGuard guard(pCam);
    LOG_DEBUG(coreLogger_) << "Will stop sequence acquisition from camera " << label;
    int nRet = pCam->StopSequenceAcquisition();
+   cameraBuffers_->SetStreaming(label, false);
    if (nRet != DEVICE_OK)
    {
       logError(label, getDeviceErrorText(nRet, pCam).c_str());
@@ -2947,6 +4003,7 @@ void CMMCore::stopSequenceAcquisition() throw (CMMError)
       mm::DeviceModuleLockGuard guard(camera);
       LOG_DEBUG(coreLogger_) << "Will stop sequence acquisition from current camera";
       int nRet = camera->StopSequenceAcquisition();
+      cameraBuffers_->SetStreaming(camera->GetLabel(), false);
       if (nRet != DEVICE_OK)
       {
          logError(getDeviceName(camera).c_str(), getDeviceErrorText(nRet, camera).c_str());
@@ -3107,39 +4164,542 @@ void* CMMCore::popNextImage() throw (CMMError)
  * channel indicates which cameraChannel image should be retrieved.
  * slice has not been implement and should always be 0
  */
-void* CMMCore::popNextImageMD(unsigned channel, unsigned slice, Metadata& md) throw (CMMError)
+void* CMMCore::popNextImageMD(unsigned channel, unsigned slice, Metadata& md) throw (CMMError)
+{
+   // Slices have never been implemented on the device interface side
+   if (slice != 0)
+      throw CMMError("Slice must be 0");
+
+   const mm::ImgBuffer* pBuf = cbuf_->GetNextImageBuffer(channel);
+   if (pBuf != 0)
+   {
+      md = pBuf->GetMetadata();
+      return const_cast<unsigned char*>(pBuf->GetPixels());
+   }
+   else
+      throw CMMError(getCoreErrorText(MMERR_CircularBufferEmpty).c_str(), MMERR_CircularBufferEmpty);
+}
+
+/**
+ * Gets and removes the next image (and metadata) from the circular buffer
+ */
+void* CMMCore::popNextImageMD(Metadata& md) throw (CMMError)
+{
+   return popNextImageMD(0, 0, md);
+}
+
+/**
+ * Returns a handle to the image that was last inserted into the circular
+ * buffer, without removing it.
+ *
+ * Unlike getLastImageMD(), the image cannot be overwritten while the handle
+ * (or any copy of it) is held, so the pixels can be used in place. Release
+ * the handle promptly: insertion into a pinned slot backs off as if the
+ * buffer were full.
+ */
+ImageHandle CMMCore::getLastImageHandle() const throw (CMMError)
+{
+   return getLastImageHandle(0);
+}
+
+/**
+ * Returns a handle to the given camera channel of the image that was last
+ * inserted into the circular buffer, without removing it.
+ */
+ImageHandle CMMCore::getLastImageHandle(unsigned channel) const throw (CMMError)
+{
+   ImageHandle handle = cbuf_->GetTopImageHandle(channel);
+   if (!handle.isValid())
+      throw CMMError(getCoreErrorText(MMERR_CircularBufferEmpty).c_str(), MMERR_CircularBufferEmpty);
+   return handle;
+}
+
+/**
+ * Gets and removes the next image from the circular buffer, returning a
+ * handle that keeps it from being overwritten until released.
+ *
+ * This avoids having to copy the pixels out of the buffer before the next
+ * insertion can reuse the slot (see getLastImageHandle()).
+ */
+ImageHandle CMMCore::popNextImageHandle() throw (CMMError)
+{
+   return popNextImageHandle(0);
+}
+
+/**
+ * Gets and removes the next image from the circular buffer, returning a
+ * handle to the given camera channel.
+ */
+ImageHandle CMMCore::popNextImageHandle(unsigned channel) throw (CMMError)
+{
+   ImageHandle handle = cbuf_->GetNextImageHandle(channel);
+   if (!handle.isValid())
+      throw CMMError(getCoreErrorText(MMERR_CircularBufferEmpty).c_str(), MMERR_CircularBufferEmpty);
+   return handle;
+}
+
+/**
+ * Returns a handle to the image that was last inserted into the given
+ * camera's own circular buffer, without removing it.
+ *
+ * Throws if the buffer is empty, or if the camera does not have its own
+ * buffer (see enablePerCameraCircularBuffers()).
+ *
+ * @param cameraLabel   the camera label
+ */
+ImageHandle CMMCore::getLastImageHandleFromCamera(const char* cameraLabel) const throw (CMMError)
+{
+   std::shared_ptr<CircularBuffer> buffer = getCameraCircularBuffer(cameraLabel);
+   ImageHandle handle = buffer ? buffer->GetTopImageHandle(0) : ImageHandle();
+   if (!handle.isValid())
+      throw CMMError(getCoreErrorText(MMERR_CircularBufferEmpty).c_str(), MMERR_CircularBufferEmpty);
+   return handle;
+}
+
+/**
+ * Gets and removes the next image from the given camera's own circular
+ * buffer, returning a handle that keeps it from being overwritten until
+ * released.
+ *
+ * Throws if the buffer is empty, or if the camera does not have its own
+ * buffer (see enablePerCameraCircularBuffers()).
+ *
+ * @param cameraLabel   the camera label
+ */
+ImageHandle CMMCore::popNextImageHandleFromCamera(const char* cameraLabel) throw (CMMError)
+{
+   std::shared_ptr<CircularBuffer> buffer = getCameraCircularBuffer(cameraLabel);
+   ImageHandle handle = buffer ? buffer->GetNextImageHandle(0) : ImageHandle();
+   if (!handle.isValid())
+      throw CMMError(getCoreErrorText(MMERR_CircularBufferEmpty).c_str(), MMERR_CircularBufferEmpty);
+   return handle;
+}
+
+/**
+ * Removes all images from the circular buffer.
+ *
+ * It is rarely necessary to call this directly since starting a sequence
+ * acquisition or changing the ROI will always clear the buffer.
+ */
+void CMMCore::clearCircularBuffer() throw (CMMError)
+{
+   cbuf_->Clear();
+}
+
+/**
+ * Removes all images from the given camera's own circular buffer. Does
+ * nothing if the camera does not have its own buffer.
+ *
+ * @param cameraLabel   the camera label
+ */
+void CMMCore::clearCircularBuffer(const char* cameraLabel) throw (CMMError)
+{
+   std::shared_ptr<CircularBuffer> buffer = getCameraCircularBuffer(cameraLabel);
+   if (buffer)
+      buffer->Clear();
+}
+
+/**
+ * Switch the circular buffer between locked and lock-free synchronization.
+ *
+ * By default, every buffer access takes the same mutex, so that polling the
+ * buffer (e.g. with getRemainingImageCount() or getLastImage()) contends
+ * with image insertion. In lock-free mode, readers and the camera coordinate
+ * through atomic indices and per-slot sequence numbers; only reallocation of
+ * the buffer still takes the lock. The buffer contents and API behave the
+ * same in both modes. The setting is kept when the memory footprint changes.
+ *
+ * @param enable   true to use lock-free synchronization
+ */
+void CMMCore::enableLockFreeCircularBuffer(bool enable)
+{
+   cbuf_->EnableLockFree(enable);
+   cameraBuffers_->EnableLockFree(enable);
+   LOG_DEBUG(coreLogger_) << "Circular buffer lock-free mode " <<
+      (enable ? "enabled" : "disabled");
+}
+
+/**
+ * Returns whether the circular buffer uses lock-free synchronization.
+ */
+bool CMMCore::isLockFreeCircularBufferEnabled()
+{
+   return cbuf_->IsLockFree();
+}
+
+/**
+ * Let the circular buffer hold images of different sizes.
+ *
+ * By default, the buffer is divided into slots of the current camera's image
+ * size, and is reallocated (discarding its contents) whenever that size
+ * changes, e.g. when the ROI or binning is changed. In variable-size mode,
+ * each image takes just the memory it needs from a contiguous ring of
+ * memory, so that images of different sizes can be inserted one after the
+ * other and changing the ROI does not reallocate the buffer.
+ * getBufferTotalCapacity() and getBufferFreeCapacity() then count images of
+ * the current camera's size; use getBufferTotalCapacityBytes() and
+ * getBufferFreeCapacityBytes() for the exact amount of memory.
+ *
+ * The buffer is reinitialized for the current camera, which fails if images
+ * in it are pinned by image handles. The setting is kept when the memory
+ * footprint changes, and also applies to per-camera buffers the next time
+ * they are initialized.
+ *
+ * @param enable   true to allow images of different sizes
+ */
+void CMMCore::enableVariableSizeCircularBuffer(bool enable) throw (CMMError)
+{
+   if (cbuf_->GetPinnedImageCount() > 0)
+      throw CMMError(getCoreErrorText(MMERR_CircularBufferImagesPinned).c_str(),
+            MMERR_CircularBufferImagesPinned);
+
+   cbuf_->EnableVariableSizeFrames(enable);
+   cameraBuffers_->EnableVariableSizeFrames(enable);
+   LOG_DEBUG(coreLogger_) << "Circular buffer variable-size mode " <<
+      (enable ? "enabled" : "disabled");
+
+   std::shared_ptr<CameraInstance> camera = currentCameraDevice_.lock();
+   if (camera)
+   {
+      mm::DeviceModuleLockGuard guard(camera);
+      if (!cbuf_->Initialize(camera->GetNumberOfChannels(), camera->GetImageWidth(), camera->GetImageHeight(), camera->GetImageBytesPerPixel()))
+         throw CMMError(getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str(), MMERR_CircularBufferFailedToInitialize);
+   }
+}
+
+/**
+ * Replace the Core's thread pool according to the Core properties
+ * ThreadPoolSize ("Auto" for one thread per hardware thread),
+ * ThreadPoolAffinity ("PerCore" pins each thread to one CPU) and
+ * ThreadPoolNUMANode (restricts the threads to the CPUs of a node, e.g. the
+ * node holding the circular buffer). Frame copies in progress are finished
+ * on the old pool.
+ *
+ * A placement that the system does not support is logged and ignored.
+ */
+void CMMCore::applyThreadPoolOptions()
+{
+   const std::string size = properties_->Get(MM::g_Keyword_CoreThreadPoolSize);
+   const size_t threadCount = size == "Auto" ? 0 : (size_t)atol(size.c_str());
+   ThreadPool::Placement placement;
+   placement.pinToCores =
+      properties_->Get(MM::g_Keyword_CoreThreadPoolAffinity) == "PerCore";
+   const std::string numaNode = properties_->Get(MM::g_Keyword_CoreThreadPoolNUMANode);
+   if (numaNode != "Any")
+      placement.numaNode = atoi(numaNode.c_str());
+
+   std::shared_ptr<ThreadPool> pool =
+      std::make_shared<ThreadPool>(threadCount, placement);
+   cbuf_->SetThreadPool(pool);
+   cameraBuffers_->SetThreadPool(pool);
+   threadPool_ = pool;
+
+   LOG_INFO(coreLogger_) << "Thread pool: " << pool->GetSize() << " threads" <<
+      (placement.pinToCores ? ", one per CPU" : "") <<
+      (placement.numaNode >= 0 ? ", NUMA node " + numaNode : std::string());
+   if (!pool->IsPlacementApplied())
+      LOG_WARNING(coreLogger_) << "Thread pool placement could not be applied";
+}
+
+/**
+ * Apply the options for allocating the circular buffer memory from the Core
+ * properties (BufferHugePages, BufferLockMemory, BufferNUMANode and
+ * BufferPrefault), and reallocate the buffer for the current camera.
+ *
+ * Options that the system does not support, or that the process lacks the
+ * privileges for, are skipped; the read-only BufferAllocation property
+ * reports what was actually obtained. Explicit huge pages fall back to
+ * transparent huge pages where available.
+ */
+void CMMCore::applyCircularBufferMemoryOptions() throw (CMMError)
+{
+   mm::BufferMemoryOptions options;
+   const std::string hugePages = properties_->Get(MM::g_Keyword_CoreBufferHugePages);
+   if (hugePages == "Transparent")
+      options.hugePages = mm::HugePagesTransparent;
+   else if (hugePages == "Explicit")
+      options.hugePages = mm::HugePagesExplicit;
+   options.lock = properties_->Get(MM::g_Keyword_CoreBufferLockMemory) == "1";
+   const std::string numaNode = properties_->Get(MM::g_Keyword_CoreBufferNUMANode);
+   if (numaNode != "Any")
+      options.numaNode = atoi(numaNode.c_str());
+   options.prefault = properties_->Get(MM::g_Keyword_CoreBufferPrefault) == "1";
+
+   cameraBuffers_->SetMemoryOptions(options);
+   cbuf_->SetMemoryOptions(options);
+   if (cbuf_->GetPinnedImageCount() > 0)
+      throw CMMError(getCoreErrorText(MMERR_CircularBufferImagesPinned).c_str(),
+            MMERR_CircularBufferImagesPinned);
+
+   // Reallocate now rather than when the next acquisition starts, so that
+   // the allocation obtained can be checked beforehand
+   std::shared_ptr<CameraInstance> camera = currentCameraDevice_.lock();
+   if (camera)
+   {
+      mm::DeviceModuleLockGuard guard(camera);
+      if (!cbuf_->Initialize(camera->GetNumberOfChannels(), camera->GetImageWidth(), camera->GetImageHeight(), camera->GetImageBytesPerPixel()))
+         throw CMMError(getCoreErrorText(MMERR_CircularBufferFailedToInitialize).c_str(), MMERR_CircularBufferFailedToInitialize);
+   }
+   LOG_INFO(coreLogger_) << "Circular buffer memory: " <<
+      cbuf_->GetMemoryDescription();
+}
+
+/**
+ * Returns whether the circular buffer can hold images of different sizes.
+ */
+bool CMMCore::isVariableSizeCircularBufferEnabled()
+{
+   return cbuf_->IsVariableSizeFrames();
+}
+
+/**
+ * Keep images that do not fit in the circular buffer in a file instead of
+ * dropping them.
+ *
+ * When the buffer is full, inserting an image moves the oldest unread image
+ * into a memory-mapped file in the given directory, and popNextImage() and
+ * friends return the images in that file (in order) before those in the
+ * buffer. This lets a burst of images that outruns the application exceed
+ * the memory footprint without losing images, at the cost of disk bandwidth;
+ * the directory should be on a fast local disk with room for the burst.
+ * Inserting images fails as before only when the disk is full, or when the
+ * file has reached maxMB.
+ *
+ * The file is reused as a ring: space taken by images that have been read is
+ * written again, so that a reader keeping up on average keeps it small.
+ *
+ * The file is named MMCoreSpill-<process id>-<core>.dat and is deleted when
+ * spill mode is disabled and all images in it have been read, or when the
+ * memory footprint is changed (which discards them). getRemainingImageCount()
+ * includes spilled images.
+ *
+ * Applies to the shared circular buffer only, not to per-camera buffers.
+ *
+ * @param directory   directory in which to create the file
+ * @param maxMB       maximum size of the file in megabytes, or 0 for no limit
+ */
+void CMMCore::enableCircularBufferSpill(const char* directory, unsigned maxMB) throw (CMMError)
+{
+   if (!directory || !*directory)
+      throw CMMError("No directory given for the circular buffer spill file");
+
+   std::ostringstream path;
+   path << directory;
+   const char last = directory[strlen(directory) - 1];
+   if (last != '/' && last != '\\')
+      path << '/';
+#ifdef _WINDOWS
+   path << "MMCoreSpill-" << _getpid();
+#else
+   path << "MMCoreSpill-" << getpid();
+#endif
+   path << '-' << std::hex << reinterpret_cast<std::uintptr_t>(this) << ".dat";
+
+   cbuf_->EnableSpill(path.str(), (unsigned long long)maxMB << 20);
+   spillPath_ = path.str();
+   spillMaxMB_ = maxMB;
+   LOG_INFO(coreLogger_) << "Circular buffer spills to " << spillPath_;
+}
+
+/**
+ * Stop moving images to the spill file when the circular buffer is full.
+ * Images already spilled can still be read.
+ */
+void CMMCore::disableCircularBufferSpill()
+{
+   cbuf_->DisableSpill();
+   spillPath_.clear();
+   LOG_DEBUG(coreLogger_) << "Circular buffer spill mode disabled";
+}
+
+/**
+ * Returns whether images that do not fit in the circular buffer are moved to
+ * a file.
+ */
+bool CMMCore::isCircularBufferSpillEnabled()
+{
+   return cbuf_->IsSpillEnabled();
+}
+
+/**
+ * Returns the number of unread images in the spill file (these are included
+ * in getRemainingImageCount()).
+ */
+long CMMCore::getSpilledImageCount()
+{
+   return (long)cbuf_->GetSpilledImageCount();
+}
+
+/**
+ * Start writing every image inserted into the circular buffer to disk, with
+ * unbuffered I/O where the file system supports it and 2 I/O threads.
+ *
+ * @see startFrameWriter(const char*, bool, unsigned)
+ */
+void CMMCore::startFrameWriter(const char* path) throw (CMMError)
+{
+   startFrameWriter(path, true, 2);
+}
+
+/**
+ * Start writing every image inserted into the circular buffer to disk.
+ *
+ * Images are copied out of the buffer and written by threads of the Core, so
+ * that they can be saved at the rate the disk sustains without passing
+ * through the application. The pixels of all images go back to back into
+ * <path>.raw; <path>.idx holds a 16-byte header (magic number 0x4d4d4649,
+ * version, entry size) followed by one 40-byte entry per image and channel:
+ * frame number, offset in the raw file (both 64-bit), channel, width,
+ * height, bytes per pixel, number of components and metadata length (32-bit
+ * each), then the serialized metadata. Both are in native byte order.
+ *
+ * The writer starts with the oldest unread image and takes images
+ * independently of popNextImage() and friends, which keep working as usual.
+ * An image is only overwritten once both the writer and the application are
+ * done with it; if the application does not keep up with the writer, the
+ * oldest images the writer has already saved are dropped from the buffer
+ * instead (unless spill mode keeps them, see enableCircularBufferSpill()).
+ * If the disk does not keep up, the buffer fills up and overflows as with a
+ * slow application.
+ *
+ * Applies to the shared circular buffer only. The memory footprint cannot
+ * be changed while the writer is running.
+ *
+ * @param path            path of the files to write, without extension
+ * @param directIO        bypass the operating system's file cache if the
+ *                        file system allows
+ * @param ioThreadCount   number of threads issuing writes
+ */
+void CMMCore::startFrameWriter(const char* path, bool directIO,
+      unsigned ioThreadCount) throw (CMMError)
+{
+   if (!path || !*path)
+      throw CMMError("No path given for the frame writer");
+   if (frameWriter_ && frameWriter_->IsRunning())
+      throw CMMError(getCoreErrorText(MMERR_FrameWriterRunning).c_str(),
+            MMERR_FrameWriterRunning);
+
+   mm::FrameWriterOptions options;
+   options.directIO = directIO;
+   options.ioThreadCount = ioThreadCount;
+   frameWriter_.reset();
+   frameWriter_ = std::make_shared<mm::FrameWriter>(*cbuf_, path, options);
+   LOG_INFO(coreLogger_) << "Frame writer started: " << path <<
+      (frameWriter_->IsDirectIO() ? " (unbuffered)" : " (buffered)");
+}
+
+/**
+ * Write the images remaining in the circular buffer, then stop the frame
+ * writer and close its files. Throws if any write failed; the statistics
+ * remain available until the writer is started again.
+ */
+void CMMCore::stopFrameWriter() throw (CMMError)
+{
+   if (!frameWriter_)
+      return;
+   frameWriter_->Stop();
+   LOG_INFO(coreLogger_) << "Frame writer stopped after " <<
+      frameWriter_->GetImageCount() << " images (" <<
+      frameWriter_->GetWriteRateMBps() << " MB/s)";
+}
+
+/**
+ * Returns whether the frame writer is running. It stops by itself if a write
+ * fails.
+ */
+bool CMMCore::isFrameWriterRunning()
+{
+   return frameWriter_ && frameWriter_->IsRunning() &&
+      frameWriter_->GetError().empty();
+}
+
+/**
+ * Returns the number of images the frame writer has taken from the buffer.
+ */
+long long CMMCore::getFrameWriterImageCount()
+{
+   return frameWriter_ ? (long long)frameWriter_->GetImageCount() : 0;
+}
+
+/**
+ * Returns the number of pixel bytes the frame writer has written to disk.
+ */
+long long CMMCore::getFrameWriterBytesWritten()
+{
+   return frameWriter_ ? (long long)frameWriter_->GetBytesWritten() : 0;
+}
+
+/**
+ * Returns the average rate at which the frame writer has written pixels, in
+ * MB (2^20 bytes) per second.
+ */
+double CMMCore::getFrameWriterWriteRateMBps()
+{
+   return frameWriter_ ? frameWriter_->GetWriteRateMBps() : 0.0;
+}
+
+/**
+ * Returns the number of images in the circular buffer that the frame writer
+ * has yet to take.
+ */
+long CMMCore::getFrameWriterBacklog()
+{
+   return (long)cbuf_->GetWriterBacklog();
+}
+
+/**
+ * Give each camera started with startSequenceAcquisition(label, ...) its own
+ * circular buffer.
+ *
+ * By default, all cameras insert their images into the shared circular
+ * buffer, which holds images of a single size and serializes insertion.
+ * With per-camera buffers, the images of cameras started by label go to a
+ * buffer of their own, sized for that camera's images, so that cameras with
+ * different ROIs can stream at the same time. Read them with
+ * popNextImageHandleFromCamera(), getLastImageHandleFromCamera() and
+ * getRemainingImageCount(label). Cameras started with the unlabeled
+ * startSequenceAcquisition() and startContinuousSequenceAcquisition() keep
+ * using the shared buffer.
+ *
+ * The memory footprint (see setCircularBufferMemoryFootprint()) is divided
+ * among the cameras in proportion to their image size. Calling
+ * prepareSequenceAcquisition(label) for each camera before starting any of
+ * them lets the first camera's buffer leave room for the others.
+ *
+ * Disabling per-camera buffers releases them; this fails if images from
+ * them are pinned by image handles.
+ *
+ * @param enable   true to give each camera its own buffer
+ */
+void CMMCore::enablePerCameraCircularBuffers(bool enable) throw (CMMError)
 {
-   // Slices have never been implemented on the device interface side
-   if (slice != 0)
-      throw CMMError("Slice must be 0");
-
-   const mm::ImgBuffer* pBuf = cbuf_->GetNextImageBuffer(channel);
-   if (pBuf != 0)
+   if (!enable)
    {
-      md = pBuf->GetMetadata();
-      return const_cast<unsigned char*>(pBuf->GetPixels());
+      if (cameraBuffers_->GetPinnedImageCount() > 0)
+         throw CMMError(getCoreErrorText(MMERR_CircularBufferImagesPinned).c_str(),
+               MMERR_CircularBufferImagesPinned);
+      cameraBuffers_->Reset();
    }
-   else
-      throw CMMError(getCoreErrorText(MMERR_CircularBufferEmpty).c_str(), MMERR_CircularBufferEmpty);
+   perCameraBuffers_ = enable;
+   LOG_DEBUG(coreLogger_) << "Per-camera circular buffers " <<
+      (enable ? "enabled" : "disabled");
 }
 
 /**
- * Gets and removes the next image (and metadata) from the circular buffer
+ * Returns whether cameras started by label get their own circular buffer.
  */
-void* CMMCore::popNextImageMD(Metadata& md) throw (CMMError)
+bool CMMCore::isPerCameraCircularBuffersEnabled()
 {
-   return popNextImageMD(0, 0, md);
+   return perCameraBuffers_;
 }
 
 /**
- * Removes all images from the circular buffer.
- *
- * It is rarely necessary to call this directly since starting a sequence
- * acquisition or changing the ROI will always clear the buffer.
+ * Returns the labels of the cameras that currently have their own circular
+ * buffer.
  */
-void CMMCore::clearCircularBuffer() throw (CMMError)
+std::vector<std::string> CMMCore::getCircularBufferCameras()
 {
-   cbuf_->Clear();
+   return cameraBuffers_->GetCameraLabels();
 }
 
 /**
@@ -3148,12 +4708,34 @@ void CMMCore::clearCircularBuffer() throw (CMMError)
 void CMMCore::setCircularBufferMemoryFootprint(unsigned sizeMB ///< n megabytes
                                                ) throw (CMMError)
 {
+   if (frameWriter_ && frameWriter_->IsRunning())
+      throw CMMError(getCoreErrorText(MMERR_FrameWriterRunning).c_str(),
+            MMERR_FrameWriterRunning);
+   if ((cbuf_ && cbuf_->GetPinnedImageCount() > 0) ||
+         cameraBuffers_->GetPinnedImageCount() > 0)
+      throw CMMError(getCoreErrorText(MMERR_CircularBufferImagesPinned).c_str(),
+            MMERR_CircularBufferImagesPinned);
+
+   // Per-camera buffers are reallocated from the new footprint when their
+   // cameras are next started
+   cameraBuffers_->Reset();
+   cameraBuffers_->SetMemorySizeMB(sizeMB);
+
+   const bool lockFree = cbuf_ && cbuf_->IsLockFree();
+   const bool variableSize = cbuf_ && cbuf_->IsVariableSizeFrames();
+   const mm::BufferMemoryOptions memoryOptions = cbuf_ ?
+      cbuf_->GetMemoryOptions() : mm::BufferMemoryOptions();
    delete cbuf_; // discard old buffer
    LOG_DEBUG(coreLogger_) << "Will set circular buffer size to " <<
       sizeMB << " MB";
 	try
 	{
-		cbuf_ = new CircularBuffer(sizeMB);
+		cbuf_ = new CircularBuffer(sizeMB, threadPool_);
+      cbuf_->EnableLockFree(lockFree);
+      cbuf_->EnableVariableSizeFrames(variableSize);
+      cbuf_->SetMemoryOptions(memoryOptions);
+      if (!spillPath_.empty())
+         cbuf_->EnableSpill(spillPath_, (unsigned long long)spillMaxMB_ << 20);
 	}
 	catch(bad_alloc& ex)
 	{
@@ -3214,6 +4796,22 @@ long CMMCore::getRemainingImageCount()
    return 0;
 }
 
+/**
+ * Returns the number of images available in the given camera's own circular
+ * buffer, or 0 if the camera does not have its own buffer.
+ *
+ * @param cameraLabel   the camera label
+ */
+long CMMCore::getRemainingImageCount(const char* cameraLabel) throw (CMMError)
+{
+   std::shared_ptr<CircularBuffer> buffer = getCameraCircularBuffer(cameraLabel);
+   if (buffer)
+   {
+      return buffer->GetRemainingImageCount();
+   }
+   return 0;
+}
+
 /**
  * Returns the total number of images that can be stored in the buffer
  */
@@ -3226,6 +4824,23 @@ long CMMCore::getBufferTotalCapacity()
    return 0;
 }
 
+/**
+ * Returns the total number of images that can be stored in the given
+ * camera's own circular buffer, or 0 if the camera does not have its own
+ * buffer.
+ *
+ * @param cameraLabel   the camera label
+ */
+long CMMCore::getBufferTotalCapacity(const char* cameraLabel) throw (CMMError)
+{
+   std::shared_ptr<CircularBuffer> buffer = getCameraCircularBuffer(cameraLabel);
+   if (buffer)
+   {
+      return buffer->GetSize();
+   }
+   return 0;
+}
+
 
 /**
  * Returns the number of images that can be added to the buffer
@@ -3240,6 +4855,35 @@ long CMMCore::getBufferFreeCapacity()
    return 0;
 }
 
+/**
+ * Returns the memory of the circular buffer available for pixel data, in
+ * bytes.
+ */
+long long CMMCore::getBufferTotalCapacityBytes()
+{
+   if (cbuf_)
+   {
+      return (long long)cbuf_->GetSizeBytes();
+   }
+   return 0;
+}
+
+/**
+ * Returns the number of bytes of pixel data that can be added to the buffer
+ * without overflowing. In variable-size mode (see
+ * enableVariableSizeCircularBuffer()), an image fits if it is no larger
+ * than this, unless it has to skip the space left at the end of the buffer's
+ * memory.
+ */
+long long CMMCore::getBufferFreeCapacityBytes()
+{
+   if (cbuf_)
+   {
+      return (long long)cbuf_->GetFreeSizeBytes();
+   }
+   return 0;
+}
+
 /**
  * Indicates whether the circular buffer is overflowed
  */
@@ -3248,6 +4892,26 @@ bool CMMCore::isBufferOverflowed() const
    return cbuf_->Overflow();
 }
 
+/**
+ * Indicates whether the given camera's own circular buffer is overflowed.
+ *
+ * @param cameraLabel   the camera label
+ */
+bool CMMCore::isBufferOverflowed(const char* cameraLabel) const throw (CMMError)
+{
+   std::shared_ptr<CircularBuffer> buffer = getCameraCircularBuffer(cameraLabel);
+   return buffer && buffer->Overflow();
+}
+
+// Returns the camera's own circular buffer, or null if it does not have one.
+// Throws if the label does not name a camera.
+std::shared_ptr<CircularBuffer> CMMCore::getCameraCircularBuffer(const char* cameraLabel) const throw (CMMError)
+{
+   CheckDeviceLabel(cameraLabel);
+   deviceManager_->GetDeviceOfType<CameraInstance>(cameraLabel);
+   return cameraBuffers_->Find(cameraLabel);
+}
+
 /**
  * Returns the label of the currently selected camera device.
  * @return camera name
@@ -3337,7 +5001,7 @@ void CMMCore::setAutoFocusDevice(const char* autofocusLabel) throw (CMMError)
    std::string newAutofocusLabel = getAutoFocusDevice();
    {
       MMThreadGuard scg(stateCacheLock_);
-      stateCache_.addSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreAutoFocus, newAutofocusLabel.c_str()));
+      addToStateCache(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreAutoFocus, newAutofocusLabel.c_str()));
    }
 }
 
@@ -3404,7 +5068,7 @@ void CMMCore::setImageProcessorDevice(const char* procLabel) throw (CMMError)
    std::string newProcLabel = getImageProcessorDevice();
    {
       MMThreadGuard scg(stateCacheLock_);
-      stateCache_.addSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreImageProcessor, newProcLabel.c_str()));
+      addToStateCache(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreImageProcessor, newProcLabel.c_str()));
    }
 }
 
@@ -3428,7 +5092,7 @@ void CMMCore::setSLMDevice(const char* slmLabel) throw (CMMError)
    std::string newSLMLabel = getSLMDevice();
    {
       MMThreadGuard scg(stateCacheLock_);
-      stateCache_.addSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreSLM, newSLMLabel.c_str()));
+      addToStateCache(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreSLM, newSLMLabel.c_str()));
    }
 }
 
@@ -3453,7 +5117,7 @@ void CMMCore::setGalvoDevice(const char* galvoLabel) throw (CMMError)
    std::string newGalvoLabel = getGalvoDevice();
    {
       MMThreadGuard scg(stateCacheLock_);
-      stateCache_.addSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreGalvo, newGalvoLabel.c_str()));
+      addToStateCache(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreGalvo, newGalvoLabel.c_str()));
    }
 }
 
@@ -3480,7 +5144,7 @@ void CMMCore::setChannelGroup(const char* chGroup) throw (CMMError)
 
    {
       MMThreadGuard scg(stateCacheLock_);
-      stateCache_.addSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreChannelGroup, channelGroup_.c_str()));
+      addToStateCache(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreChannelGroup, channelGroup_.c_str()));
    }
    if (externalCallback_ != 0) 
    {
@@ -3542,7 +5206,7 @@ void CMMCore::setShutterDevice(const char* shutterLabel) throw (CMMError)
    std::string newShutterLabel = getShutterDevice();
    {
       MMThreadGuard scg(stateCacheLock_);
-      stateCache_.addSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreShutter, newShutterLabel.c_str()));
+      addToStateCache(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreShutter, newShutterLabel.c_str()));
    }
 }
 
@@ -3567,7 +5231,7 @@ void CMMCore::setFocusDevice(const char* focusLabel) throw (CMMError)
    std::string newFocusLabel = getFocusDevice();
    {
       MMThreadGuard scg(stateCacheLock_);
-      stateCache_.addSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreFocus, newFocusLabel.c_str()));
+      addToStateCache(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreFocus, newFocusLabel.c_str()));
    }
 }
 
@@ -3590,7 +5254,7 @@ void CMMCore::setXYStageDevice(const char* xyDeviceLabel) throw (CMMError)
    std::string newXYStageLabel = getXYStageDevice();
    {
       MMThreadGuard scg(stateCacheLock_);
-      stateCache_.addSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreXYStage, newXYStageLabel.c_str()));
+      addToStateCache(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreXYStage, newXYStageLabel.c_str()));
    }
 }
 
@@ -3629,7 +5293,7 @@ void CMMCore::setCameraDevice(const char* cameraLabel) throw (CMMError)
    std::string newCameraLabel = getCameraDevice();
    {
       MMThreadGuard scg(stateCacheLock_);
-      stateCache_.addSetting(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreCamera, newCameraLabel.c_str()));
+      addToStateCache(PropertySetting(MM::g_Keyword_CoreDevice, MM::g_Keyword_CoreCamera, newCameraLabel.c_str()));
    }
 }
 
@@ -3733,7 +5397,7 @@ string CMMCore::getProperty(const char* label, const char* propName) throw (CMME
    PropertySetting s(label, propName, value.c_str());
    {
       MMThreadGuard scg(stateCacheLock_);
-      stateCache_.addSetting(s);
+      addToStateCache(s);
    }
 
    return value;
@@ -3786,7 +5450,7 @@ void CMMCore::setProperty(const char* label, const char* propName,
       properties_->Execute(propName, propValue);
       {
          MMThreadGuard scg(stateCacheLock_);
-         stateCache_.addSetting(PropertySetting(MM::g_Keyword_CoreDevice, propName, propValue));
+         addToStateCache(PropertySetting(MM::g_Keyword_CoreDevice, propName, propValue));
       }
 
       LOG_DEBUG(coreLogger_) << "Did set Core property: " <<
@@ -3802,7 +5466,7 @@ void CMMCore::setProperty(const char* label, const char* propName,
 
       {
          MMThreadGuard scg(stateCacheLock_);
-         stateCache_.addSetting(PropertySetting(label, propName, propValue));
+         addToStateCache(PropertySetting(label, propName, propValue));
       }
    }
 }
@@ -3859,6 +5523,188 @@ void CMMCore::setProperty(const char* label, const char* propName,
    setProperty(label, propName, ToString(propValue).c_str());
 }
 
+/**
+ * Returns the values of several device properties at once.
+ *
+ * The properties are read one adapter module at a time, taking each device
+ * lock once for consecutive properties of the same device, so this is much
+ * cheaper than calling getProperty() for each.
+ * Errors are reported per property rather than thrown.
+ *
+ * @return the property values, in the order requested (empty where reading
+ *         failed)
+ * @param labels      the device label of each property
+ * @param propNames   the property names, in the same order as labels
+ * @param errors      set to the error message for each property (empty if
+ *                    it was read successfully)
+ */
+std::vector<std::string> CMMCore::getProperties(
+      const std::vector<std::string>& labels,
+      const std::vector<std::string>& propNames,
+      std::vector<std::string>& errors) throw (CMMError)
+{
+   if (labels.size() != propNames.size())
+      throw CMMError("Numbers of device labels and property names differ",
+            MMERR_InvalidContents);
+
+   const size_t n = labels.size();
+   std::vector<std::string> values(n);
+   std::vector< std::shared_ptr<DeviceInstance> > devices;
+   resolvePropertyItems(labels, propNames, 0, devices, errors);
+
+   for (size_t i = 0; i < n; ++i)
+   {
+      if (devices[i] || !errors[i].empty())
+         continue;
+      try
+      {
+         values[i] = properties_->Get(propNames[i].c_str());
+      }
+      catch (const CMMError& e)
+      {
+         errors[i] = e.getMsg();
+      }
+   }
+
+   const std::vector< std::vector<size_t> > modules = GroupByModule(devices);
+   for (size_t m = 0; m < modules.size(); ++m)
+   {
+      const std::vector<size_t>& items = modules[m];
+      std::vector<bool> read(items.size(), false);
+
+      {
+         // One guard per run of items on the same device, so that each
+         // device's own lock is taken and its lock statistics are kept
+         std::unique_ptr<mm::DeviceModuleLockGuard> guard;
+         for (size_t j = 0; j < items.size(); ++j)
+         {
+            const size_t i = items[j];
+            if (j == 0 || devices[i] != devices[items[j - 1]])
+            {
+               guard.reset();
+               guard.reset(new mm::DeviceModuleLockGuard(devices[i]));
+            }
+            try
+            {
+               values[i] = devices[i]->GetProperty(propNames[i]);
+               read[j] = true;
+            }
+            catch (const CMMError& e)
+            {
+               errors[i] = e.getMsg();
+            }
+         }
+      }
+
+      // use the opportunity to update the cache
+      MMThreadGuard scg(stateCacheLock_);
+      for (size_t j = 0; j < items.size(); ++j)
+      {
+         const size_t i = items[j];
+         if (read[j])
+            addToStateCache(PropertySetting(labels[i].c_str(),
+                     propNames[i].c_str(), values[i].c_str()));
+      }
+   }
+
+   return values;
+}
+
+/**
+ * Changes the values of several device properties at once.
+ *
+ * Core properties are set first, in the order given. Device properties are
+ * then set one adapter module at a time, taking each device lock once for
+ * consecutive properties of the same device; the properties of each module
+ * are set in the order given. Errors are reported per property rather
+ * than thrown, and do not stop the remaining properties from being set.
+ *
+ * @return the error message for each property, in the order given (empty if
+ *         it was set successfully)
+ * @param labels      the device label of each property
+ * @param propNames   the property names, in the same order as labels
+ * @param values      the new property values, in the same order as labels
+ */
+std::vector<std::string> CMMCore::setProperties(
+      const std::vector<std::string>& labels,
+      const std::vector<std::string>& propNames,
+      const std::vector<std::string>& values) throw (CMMError)
+{
+   if (labels.size() != propNames.size() || labels.size() != values.size())
+      throw CMMError("Numbers of device labels, property names and values differ",
+            MMERR_InvalidContents);
+
+   const size_t n = labels.size();
+   std::vector<std::string> errors;
+   std::vector< std::shared_ptr<DeviceInstance> > devices;
+   resolvePropertyItems(labels, propNames, &values, devices, errors);
+
+   for (size_t i = 0; i < n; ++i)
+   {
+      if (devices[i] || !errors[i].empty())
+         continue;
+      try
+      {
+         LOG_DEBUG(coreLogger_) << "Will set Core property: " <<
+            propNames[i] << " = " << values[i];
+         properties_->Execute(propNames[i].c_str(), values[i].c_str());
+         {
+            MMThreadGuard scg(stateCacheLock_);
+            addToStateCache(PropertySetting(MM::g_Keyword_CoreDevice,
+                     propNames[i].c_str(), values[i].c_str()));
+         }
+         LOG_DEBUG(coreLogger_) << "Did set Core property: " <<
+            propNames[i] << " = " << values[i];
+      }
+      catch (const CMMError& e)
+      {
+         errors[i] = e.getMsg();
+      }
+   }
+
+   const std::vector< std::vector<size_t> > modules = GroupByModule(devices);
+   for (size_t m = 0; m < modules.size(); ++m)
+   {
+      const std::vector<size_t>& items = modules[m];
+      std::vector<bool> set(items.size(), false);
+
+      {
+         // One guard per run of items on the same device, so that each
+         // device's own lock is taken and its lock statistics are kept
+         std::unique_ptr<mm::DeviceModuleLockGuard> guard;
+         for (size_t j = 0; j < items.size(); ++j)
+         {
+            const size_t i = items[j];
+            if (j == 0 || devices[i] != devices[items[j - 1]])
+            {
+               guard.reset();
+               guard.reset(new mm::DeviceModuleLockGuard(devices[i]));
+            }
+            try
+            {
+               devices[i]->SetProperty(propNames[i], values[i]);
+               set[j] = true;
+            }
+            catch (const CMMError& e)
+            {
+               errors[i] = e.getMsg();
+            }
+         }
+      }
+
+      MMThreadGuard scg(stateCacheLock_);
+      for (size_t j = 0; j < items.size(); ++j)
+      {
+         const size_t i = items[j];
+         if (set[j])
+            addToStateCache(PropertySetting(labels[i].c_str(),
+                     propNames[i].c_str(), values[i].c_str()));
+      }
+   }
+
+   return errors;
+}
+
 
 /**
  * Checks if device has a property with a specified name.
@@ -4226,7 +6072,7 @@ void CMMCore::setExposure(const char* label, double dExp) throw (CMMError)
       {
          {
             MMThreadGuard scg(stateCacheLock_);
-            stateCache_.addSetting(PropertySetting(label, MM::g_Keyword_Exposure, CDeviceUtils::ConvertToString(dExp)));
+            addToStateCache(PropertySetting(label, MM::g_Keyword_Exposure, CDeviceUtils::ConvertToString(dExp)));
          }
       }
    }
@@ -4609,7 +6455,7 @@ void CMMCore::setState(const char* deviceLabel, long state) throw (CMMError)
    {
       {
          MMThreadGuard scg(stateCacheLock_);
-         stateCache_.addSetting(PropertySetting(deviceLabel, MM::g_Keyword_State, CDeviceUtils::ConvertToString(state)));
+         addToStateCache(PropertySetting(deviceLabel, MM::g_Keyword_State, CDeviceUtils::ConvertToString(state)));
       }
    }
    if (pStateDev->HasProperty(MM::g_Keyword_Label))
@@ -4618,7 +6464,7 @@ void CMMCore::setState(const char* deviceLabel, long state) throw (CMMError)
 
       {
          MMThreadGuard scg(stateCacheLock_);
-         stateCache_.addSetting(PropertySetting(deviceLabel, MM::g_Keyword_Label, posLbl.c_str()));
+         addToStateCache(PropertySetting(deviceLabel, MM::g_Keyword_Label, posLbl.c_str()));
       }
    }
 
@@ -4690,7 +6536,7 @@ void CMMCore::setStateLabel(const char* deviceLabel, const char* stateLabel) thr
    {
       {
          MMThreadGuard scg(stateCacheLock_);
-         stateCache_.addSetting(PropertySetting(deviceLabel, MM::g_Keyword_Label, stateLabel));
+         addToStateCache(PropertySetting(deviceLabel, MM::g_Keyword_Label, stateLabel));
       }
    }
    if (pStateDev->HasProperty(MM::g_Keyword_State))
@@ -4698,7 +6544,7 @@ void CMMCore::setStateLabel(const char* deviceLabel, const char* stateLabel) thr
       long state = getStateFromLabel(deviceLabel, stateLabel);
       {
          MMThreadGuard scg(stateCacheLock_);
-         stateCache_.addSetting(PropertySetting(deviceLabel, MM::g_Keyword_State,
+         addToStateCache(PropertySetting(deviceLabel, MM::g_Keyword_State,
                   CDeviceUtils::ConvertToString(state)));
       }
    }
@@ -5259,6 +7105,13 @@ string CMMCore::getCurrentConfigFromCache(const char* groupName) throw (CMMError
 {
    CheckConfigGroupName(groupName);
 
+   // Held throughout so that the remembered answer matches the cache
+   MMThreadGuard scg(stateCacheLock_);
+
+   string preset;
+   if (presetMatchCache_->Get(groupName, preset))
+      return preset;
+
    vector<string> cfgs = configGroups_->GetAvailableConfigs(groupName);
    if (cfgs.empty())
       return "";
@@ -5269,11 +7122,44 @@ string CMMCore::getCurrentConfigFromCache(const char* groupName) throw (CMMError
    {
       Configuration* pCfg = configGroups_->Find(groupName, cfgs[i].c_str());
       if (pCfg && curState.isConfigurationIncluded(*pCfg))
-         return cfgs[i];
+      {
+         preset = cfgs[i];
+         break;
+      }
    }
 
-   // no match
-   return "";
+   // preset is empty if there is no match
+   presetMatchCache_->Put(groupName, preset);
+   return preset;
+}
+
+/**
+ * Returns the current preset of every configuration group, based on the
+ * data in the cache, as with getCurrentConfigFromCache().
+ *
+ * Groups with no matching preset map to an empty string, as do groups
+ * whose properties are not all in the cache.
+ *
+ * @return a map from group name to the name of its current preset
+ */
+std::map<std::string, std::string> CMMCore::getCurrentConfigsFromCache()
+{
+   std::map<std::string, std::string> presets;
+
+   MMThreadGuard scg(stateCacheLock_);
+   vector<string> groups = configGroups_->GetAvailableGroups();
+   for (size_t i = 0; i < groups.size(); ++i)
+   {
+      try
+      {
+         presets[groups[i]] = getCurrentConfigFromCache(groups[i].c_str());
+      }
+      catch (const CMMError&)
+      {
+         presets[groups[i]] = "";
+      }
+   }
+   return presets;
 }
 
 /**
@@ -5301,6 +7187,76 @@ Configuration CMMCore::getConfigData(const char* groupName, const char* configNa
    return *pCfg;
 }
 
+/**
+ * Enables or disables parallel application of configurations.
+ *
+ * By default, setConfig(), setPixelSizeConfig() and the other calls that
+ * apply a configuration set its properties one after the other. With
+ * parallel apply enabled, the Core properties of the configuration are set
+ * first; then the device properties are grouped by device adapter module,
+ * and each module's properties are set on a separate thread, in the order
+ * they appear in the configuration. Properties that fail are retried
+ * serially afterwards, as without parallel apply, so that properties that
+ * depend on a setting in another module still succeed.
+ *
+ * This shortens the time taken by configurations that involve several
+ * slow devices from different adapters. Device adapters are only ever
+ * called concurrently from different modules, which the module locks
+ * already allow.
+ */
+void CMMCore::enableParallelConfigApply(bool enable)
+{
+   parallelConfigApply_ = enable;
+   LOG_DEBUG(coreLogger_) << "Parallel configuration apply " <<
+      (enable ? "enabled" : "disabled");
+}
+
+/**
+ * Returns whether configurations are applied in parallel.
+ *
+ * @see enableParallelConfigApply()
+ */
+bool CMMCore::isParallelConfigApplyEnabled()
+{
+   return parallelConfigApply_;
+}
+
+/**
+ * Returns the labels of the devices whose properties were set by the last
+ * configuration applied, in the order they were first set.
+ *
+ * @see getLastConfigApplyTimeMs()
+ */
+std::vector<std::string> CMMCore::getLastConfigApplyDevices()
+{
+   MMThreadGuard g(configApplyTimesLock_);
+   std::vector<std::string> labels;
+   for (size_t i = 0; i < configApplyTimes_.size(); ++i)
+      labels.push_back(configApplyTimes_[i].first);
+   return labels;
+}
+
+/**
+ * Returns the time the device took to set its properties during the last
+ * configuration applied, in milliseconds, including retries. Returns 0 if
+ * the configuration did not include the device.
+ *
+ * With parallel apply, the times of devices from different modules overlap,
+ * so they add up to more than the time taken by the configuration.
+ */
+double CMMCore::getLastConfigApplyTimeMs(const char* deviceLabel)
+{
+   if (!deviceLabel)
+      return 0.0;
+   MMThreadGuard g(configApplyTimesLock_);
+   for (size_t i = 0; i < configApplyTimes_.size(); ++i)
+   {
+      if (configApplyTimes_[i].first == deviceLabel)
+         return configApplyTimes_[i].second;
+   }
+   return 0.0;
+}
+
 /**
  * Returns the configuration object for a give pixel size preset.
  * @return The configuration object
@@ -7289,6 +9245,8 @@ void CMMCore::InitializeErrorMessages()
    errorText_[MMERR_CircularBufferFailedToInitialize] =
       "Failed to initialize circular buffer - memory requirements not adequate.";
    errorText_[MMERR_CircularBufferEmpty] = "Circular buffer is empty.";
+   errorText_[MMERR_CircularBufferImagesPinned] =
+      "Circular buffer cannot be reallocated while image handles are held.";
    errorText_[MMERR_ContFocusNotAvailable] = "Auto-focus focus device not defined.";
    errorText_[MMERR_BadConfigName] = "Configuration name contains illegal characters (/\\*!')";
    errorText_[MMERR_NotAllowedDuringSequenceAcquisition] =
@@ -7297,6 +9255,10 @@ void CMMCore::InitializeErrorMessages()
    errorText_[MMERR_InvalidImageSequence] = "Issue snapImage before getImage.";
    errorText_[MMERR_NullPointerException] = "Null Pointer Exception.";
    errorText_[MMERR_CreatePeripheralFailed] = "Hub failed to create specified peripheral device.";
+   errorText_[MMERR_FrameWriterRunning] =
+      "Not allowed while the frame writer is running.";
+   errorText_[MMERR_UnknownAsyncCommand] =
+      "No such asynchronous command, or it has already been waited for.";
    errorText_[MMERR_BadAffineTransform] = "Bad affine transform.  Affine transforms need to have 6 numbers; 2 rows of 3 column.";
 }
 
@@ -7356,6 +9318,53 @@ void CMMCore::CreateCoreProperties()
    CoreProperty propBusyTimeoutMs;
    properties_->Add(MM::g_Keyword_CoreTimeoutMs, propBusyTimeoutMs);
 
+   // Circular buffer backing memory (see applyCircularBufferMemoryOptions())
+   CoreProperty propHugePages("None", false);
+   propHugePages.AddAllowedValue("None");
+   propHugePages.AddAllowedValue("Transparent");
+   propHugePages.AddAllowedValue("Explicit");
+   properties_->Add(MM::g_Keyword_CoreBufferHugePages, propHugePages);
+
+   CoreProperty propLockMemory("0", false);
+   propLockMemory.AddAllowedValue("0");
+   propLockMemory.AddAllowedValue("1");
+   properties_->Add(MM::g_Keyword_CoreBufferLockMemory, propLockMemory);
+
+   CoreProperty propNumaNode("Any", false);
+   propNumaNode.AddAllowedValue("Any");
+   for (int node = 0; node < mm::BufferMemory::GetNumaNodeCount(); ++node)
+      propNumaNode.AddAllowedValue(CDeviceUtils::ConvertToString(node));
+   properties_->Add(MM::g_Keyword_CoreBufferNUMANode, propNumaNode);
+
+   CoreProperty propPrefault("0", false);
+   propPrefault.AddAllowedValue("0");
+   propPrefault.AddAllowedValue("1");
+   properties_->Add(MM::g_Keyword_CoreBufferPrefault, propPrefault);
+
+   // Read-only; the value is obtained from the buffer when read
+   CoreProperty propAllocation("", true);
+   properties_->Add(MM::g_Keyword_CoreBufferAllocation, propAllocation);
+
+   // Thread pool for parallel work such as copying frames into the buffer
+   // (see applyThreadPoolOptions())
+   CoreProperty propPoolSize("Auto", false);
+   propPoolSize.AddAllowedValue("Auto");
+   const unsigned hwThreads = std::max(1u, std::thread::hardware_concurrency());
+   for (unsigned n = 1; n <= hwThreads; ++n)
+      propPoolSize.AddAllowedValue(CDeviceUtils::ConvertToString((long)n));
+   properties_->Add(MM::g_Keyword_CoreThreadPoolSize, propPoolSize);
+
+   CoreProperty propPoolAffinity("None", false);
+   propPoolAffinity.AddAllowedValue("None");
+   propPoolAffinity.AddAllowedValue("PerCore");
+   properties_->Add(MM::g_Keyword_CoreThreadPoolAffinity, propPoolAffinity);
+
+   CoreProperty propPoolNumaNode("Any", false);
+   propPoolNumaNode.AddAllowedValue("Any");
+   for (int node = 0; node < mm::BufferMemory::GetNumaNodeCount(); ++node)
+      propPoolNumaNode.AddAllowedValue(CDeviceUtils::ConvertToString(node));
+   properties_->Add(MM::g_Keyword_CoreThreadPoolNUMANode, propPoolNumaNode);
+
    properties_->Refresh();
 }
 
@@ -7445,12 +9454,17 @@ bool CMMCore::IsCoreDeviceLabel(const char* label) const throw (CMMError)
  * Upon error, don't stop, but try to set all failed properties again
  * until all success or no more change takes place
  * If errors remain, throw an error
+ *
+ * With parallel apply enabled, Core properties are set first, then the
+ * device properties of each adapter module are set in order on a thread of
+ * their own (see enableParallelConfigApply()).
  */
 void CMMCore::applyConfiguration(const Configuration& config) throw (CMMError)
 {
-   std::ostringstream sall;
-   bool error = false;
    vector<PropertySetting> failedProps;
+   vector<PropertySetting> deviceSettings;
+   vector< std::shared_ptr<DeviceInstance> > devices;
+   DeviceTimes times;
    for (size_t i=0; i<config.size(); i++)
    {
       PropertySetting setting = config.getSetting(i);
@@ -7461,7 +9475,7 @@ void CMMCore::applyConfiguration(const Configuration& config) throw (CMMError)
          properties_->Execute(setting.getPropertyName().c_str(), setting.getPropertyValue().c_str());
          {
             MMThreadGuard scg(stateCacheLock_);
-            stateCache_.addSetting(PropertySetting(MM::g_Keyword_CoreDevice, setting.getPropertyName().c_str(), setting.getPropertyValue().c_str()));
+            addToStateCache(PropertySetting(MM::g_Keyword_CoreDevice, setting.getPropertyName().c_str(), setting.getPropertyValue().c_str()));
          }
       }
       else
@@ -7469,35 +9483,40 @@ void CMMCore::applyConfiguration(const Configuration& config) throw (CMMError)
          // normal processing
          std::shared_ptr<DeviceInstance> pDevice =
             deviceManager_->GetDevice(setting.getDeviceLabel());
-         mm::DeviceModuleLockGuard guard(pDevice);
-         try
+         if (parallelConfigApply_)
          {
-            pDevice->SetProperty(setting.getPropertyName(),
-                  setting.getPropertyValue());
-
-            {
-               MMThreadGuard scg(stateCacheLock_);
-               stateCache_.addSetting(setting);
-            }
+            deviceSettings.push_back(setting);
+            devices.push_back(pDevice);
+            continue;
          }
-         catch (const CMMError&)
-         {
+
+         double elapsedMs = 0.0;
+         if (!applySetting(pDevice, setting, elapsedMs, 0))
             failedProps.push_back(setting);
-            error = true;
-         }
+         AddDeviceTime(times, setting.getDeviceLabel(), elapsedMs);
       }
    }
-   if (error)
+   if (!deviceSettings.empty())
+      applySettingsByModule(devices, deviceSettings, failedProps, times);
+
+   string errorString;
+   while (!failedProps.empty() &&
+         failedProps.size() > (unsigned) applyProperties(failedProps, errorString, times))
    {
-      string errorString;
-      while (failedProps.size() > (unsigned) applyProperties(failedProps, errorString) )
-      {
-         if (failedProps.size() == 0)
-            return;
-      }
+   }
 
-      throw CMMError(errorString.c_str(), MMERR_DEVICE_GENERIC);
+   std::ostringstream timesText;
+   for (size_t i = 0; i < times.size(); ++i)
+      timesText << (i > 0 ? ", " : "") << times[i].first << " " <<
+         times[i].second << " ms";
+   LOG_DEBUG(coreLogger_) << "Configuration applied (" << timesText.str() << ")";
+   {
+      MMThreadGuard g(configApplyTimesLock_);
+      configApplyTimes_.swap(times);
    }
+
+   if (!failedProps.empty())
+      throw CMMError(errorString.c_str(), MMERR_DEVICE_GENERIC);
 }
 
 /*
@@ -7505,40 +9524,91 @@ void CMMCore::applyConfiguration(const Configuration& config) throw (CMMError)
  * It is possible that setting certain properties failed because they are dependent
  * on other properties to be set first. As a workaround, continue to apply these failed
  * properties until there are none left or none succeed
- * returns number of properties successfully set
+ * returns number of properties that failed again
  */
-int CMMCore::applyProperties(vector<PropertySetting>& props, string& lastError)
+int CMMCore::applyProperties(vector<PropertySetting>& props, string& lastError,
+      DeviceTimes& times)
 {
-  // int succeeded = 0;
    vector<PropertySetting> failedProps;
    for (size_t i=0; i<props.size(); i++)
    {
       // normal processing
       std::shared_ptr<DeviceInstance> pDevice =
          deviceManager_->GetDevice(props[i].getDeviceLabel());
-      mm::DeviceModuleLockGuard guard(pDevice);
-      try
-      {
-         pDevice->SetProperty(props[i].getPropertyName(),
-               props[i].getPropertyValue());
-
-         {
-            MMThreadGuard scg(stateCacheLock_);
-            stateCache_.addSetting(props[i]);
-         }
-      }
-      catch (const CMMError& e)
+      double elapsedMs = 0.0;
+      std::string message;
+      if (!applySetting(pDevice, props[i], elapsedMs, &message))
       {
          failedProps.push_back(props[i]);
-         std::string message = e.getFullMsg();
          logError(props[i].getDeviceLabel().c_str(), message.c_str());
          lastError = message;
       }
+      AddDeviceTime(times, props[i].getDeviceLabel(), elapsedMs);
    }
    props = failedProps;
    return (int) failedProps.size();
 }
 
+/*
+ * Helper function for applyConfiguration
+ * Sets one device property under the device's module lock and records it in
+ * the state cache. Adds the time taken by the device to elapsedMs. Returns
+ * false (with the error message, if requested) if the device fails.
+ */
+bool CMMCore::applySetting(std::shared_ptr<DeviceInstance> pDevice,
+      const PropertySetting& setting, double& elapsedMs, std::string* errorMessage)
+{
+   mm::DeviceModuleLockGuard guard(pDevice);
+   const std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+   bool ok = true;
+   try
+   {
+      pDevice->SetProperty(setting.getPropertyName(),
+            setting.getPropertyValue());
+
+      {
+         MMThreadGuard scg(stateCacheLock_);
+         addToStateCache(setting);
+      }
+   }
+   catch (const CMMError& e)
+   {
+      if (errorMessage)
+         *errorMessage = e.getFullMsg();
+      ok = false;
+   }
+   elapsedMs += std::chrono::duration<double, std::milli>(
+         std::chrono::steady_clock::now() - start).count();
+   return ok;
+}
+
+/*
+ * Helper function for applyConfiguration
+ * Sets device properties with one thread per adapter module. Settings for
+ * devices of the same module are applied in their original order, since
+ * they may depend on each other and usually share the module lock.
+ * Appends the settings that failed to failedProps, in their original order.
+ */
+void CMMCore::applySettingsByModule(
+      const vector< std::shared_ptr<DeviceInstance> >& devices,
+      const vector<PropertySetting>& settings,
+      vector<PropertySetting>& failedProps, DeviceTimes& times)
+{
+   vector<char> succeeded(settings.size(), 0);
+   vector<double> elapsedMs(settings.size(), 0.0);
+   ForEachDeviceByModule(devices, [&](size_t i) {
+      succeeded[i] = applySetting(devices[i], settings[i], elapsedMs[i], 0);
+   });
+
+   for (size_t i = 0; i < settings.size(); ++i)
+   {
+      if (!succeeded[i])
+         failedProps.push_back(settings[i]);
+      AddDeviceTime(times, settings[i].getDeviceLabel(), elapsedMs[i]);
+   }
+}
+
 
 
 
@@ -60,6 +60,7 @@
 #include "CoreUtils.h"
 #include "Error.h"
 #include "ErrorCodes.h"
+#include "ImageHandle.h"
 #include "Logging/Logger.h"
 
 #include <cstring>
@@ -92,6 +93,7 @@ class MMEventCallback;
 class Metadata;
 class PixelSizeConfigGroup;
 class PropertyBlock;
+class ThreadPool;
 
 class AutoFocusInstance;
 class CameraInstance;
@@ -106,8 +108,16 @@ class XYStageInstance;
 class CMMCore;
 
 namespace mm {
+   class CameraBufferPool;
+   class ConfigPropertyIndex;
+   class AsyncCommand;
+   class DeviceCommandQueue;
+   class DeviceIdleSignal;
    class DeviceManager;
+   class FrameWriter;
    class LogManager;
+   class PresetMatchCache;
+   class StateCacheTracker;
 } // namespace mm
 
 typedef unsigned int* imgRGB32;
@@ -182,8 +192,20 @@ public:
 
    int startSecondaryLogFile(const char* filename, bool enableDebug,
          bool truncate = true, bool synchronous = false) throw (CMMError);
+   int startSecondaryBinaryLogFile(const char* filename, bool enableDebug,
+         int maxFileSizeMB = 0, int maxBackupFiles = 1,
+         bool synchronous = false) throw (CMMError);
    void stopSecondaryLogFile(int handle) throw (CMMError);
 
+   void setLogQueueFlushIntervalMs(double intervalMs) throw (CMMError);
+   double getLogQueueFlushIntervalMs();
+   void setLogQueueOverflowPolicy(const char* policy) throw (CMMError);
+   std::string getLogQueueOverflowPolicy();
+   long getLogQueueQueuedCount();
+   long getLogQueueDroppedCount();
+   long getLogQueueFlushedCount();
+   void resetLogQueueStatistics();
+
    ///@}
 
    /** \name Device listing. */
@@ -220,6 +242,12 @@ public:
    void setProperty(const char* label, const char* propName, const long propValue) throw (CMMError);
    void setProperty(const char* label, const char* propName, const float propValue) throw (CMMError);
    void setProperty(const char* label, const char* propName, const double propValue) throw (CMMError);
+   std::vector<std::string> getProperties(const std::vector<std::string>& labels,
+         const std::vector<std::string>& propNames,
+         std::vector<std::string>& errors) throw (CMMError);
+   std::vector<std::string> setProperties(const std::vector<std::string>& labels,
+         const std::vector<std::string>& propNames,
+         const std::vector<std::string>& values) throw (CMMError);
 
    std::vector<std::string> getAllowedPropertyValues(const char* label, const char* propName) throw (CMMError);
    bool isPropertyReadOnly(const char* label, const char* propName) throw (CMMError);
@@ -248,6 +276,14 @@ public:
    void setDeviceDelayMs(const char* label, double delayMs) throw (CMMError);
    bool usesDeviceDelay(const char* label) throw (CMMError);
 
+   bool usesPerDeviceLocking(const char* label) throw (CMMError);
+   long getDeviceLockCount(const char* label) throw (CMMError);
+   double getDeviceLockWaitTimeMs(const char* label) throw (CMMError);
+   double getDeviceLockMaxWaitTimeMs(const char* label) throw (CMMError);
+   double getDeviceLockHoldTimeMs(const char* label) throw (CMMError);
+   double getDeviceLockMaxHoldTimeMs(const char* label) throw (CMMError);
+   void resetDeviceLockStatistics();
+
    void setTimeoutMs(long timeoutMs) {if (timeoutMs > 0) timeoutMs_ = timeoutMs;}
    long getTimeoutMs() { return timeoutMs_;}
 
@@ -284,9 +320,18 @@ public:
    ///@{
    Configuration getSystemStateCache() const;
    void updateSystemStateCache();
+   long refreshSystemStateCache();
+   void markPropertyStale(const char* label, const char* propName) throw (CMMError);
+   void markDeviceStale(const char* label) throw (CMMError);
+   void setPropertyCacheMaxAgeMs(const char* label, const char* propName,
+         double maxAgeMs) throw (CMMError);
+   long getLastStateCacheRefreshCount();
+   std::vector<std::string> getLastStateCacheRefreshDevices();
+   double getLastStateCacheRefreshTimeMs(const char* label);
    std::string getPropertyFromCache(const char* deviceLabel,
          const char* propName) const throw (CMMError);
    std::string getCurrentConfigFromCache(const char* groupName) throw (CMMError);
+   std::map<std::string, std::string> getCurrentConfigsFromCache();
    Configuration getConfigGroupStateFromCache(const char* group) throw (CMMError);
    ///@}
 
@@ -313,6 +358,10 @@ public:
    std::string getCurrentConfig(const char* groupName) throw (CMMError);
    Configuration getConfigData(const char* configGroup,
          const char* configName) throw (CMMError);
+   void enableParallelConfigApply(bool enable);
+   bool isParallelConfigApplyEnabled();
+   std::vector<std::string> getLastConfigApplyDevices();
+   double getLastConfigApplyTimeMs(const char* deviceLabel);
    ///@}
 
    /** \name The pixel size configuration group. */
@@ -417,14 +466,51 @@ public:
       const throw (CMMError);
    void* popNextImageMD(Metadata& md) throw (CMMError);
 
+   ImageHandle getLastImageHandle() const throw (CMMError);
+   ImageHandle getLastImageHandle(unsigned channel) const throw (CMMError);
+   ImageHandle popNextImageHandle() throw (CMMError);
+   ImageHandle popNextImageHandle(unsigned channel) throw (CMMError);
+   ImageHandle getLastImageHandleFromCamera(const char* cameraLabel)
+      const throw (CMMError);
+   ImageHandle popNextImageHandleFromCamera(const char* cameraLabel)
+      throw (CMMError);
+
    long getRemainingImageCount();
+   long getRemainingImageCount(const char* cameraLabel) throw (CMMError);
    long getBufferTotalCapacity();
+   long getBufferTotalCapacity(const char* cameraLabel) throw (CMMError);
    long getBufferFreeCapacity();
+   long long getBufferTotalCapacityBytes();
+   long long getBufferFreeCapacityBytes();
    bool isBufferOverflowed() const;
+   bool isBufferOverflowed(const char* cameraLabel) const throw (CMMError);
    void setCircularBufferMemoryFootprint(unsigned sizeMB) throw (CMMError);
    unsigned getCircularBufferMemoryFootprint();
    void initializeCircularBuffer() throw (CMMError);
    void clearCircularBuffer() throw (CMMError);
+   void clearCircularBuffer(const char* cameraLabel) throw (CMMError);
+   void enableLockFreeCircularBuffer(bool enable);
+   bool isLockFreeCircularBufferEnabled();
+   void enableVariableSizeCircularBuffer(bool enable) throw (CMMError);
+   bool isVariableSizeCircularBufferEnabled();
+   void enableCircularBufferSpill(const char* directory,
+         unsigned maxMB = 0) throw (CMMError);
+   void disableCircularBufferSpill();
+   bool isCircularBufferSpillEnabled();
+   long getSpilledImageCount();
+
+   void startFrameWriter(const char* path) throw (CMMError);
+   void startFrameWriter(const char* path, bool directIO,
+         unsigned ioThreadCount) throw (CMMError);
+   void stopFrameWriter() throw (CMMError);
+   bool isFrameWriterRunning();
+   long long getFrameWriterImageCount();
+   long long getFrameWriterBytesWritten();
+   double getFrameWriterWriteRateMBps();
+   long getFrameWriterBacklog();
+   void enablePerCameraCircularBuffers(bool enable) throw (CMMError);
+   bool isPerCameraCircularBuffersEnabled();
+   std::vector<std::string> getCircularBufferCameras();
 
    bool isExposureSequenceable(const char* cameraLabel) throw (CMMError);
    void startExposureSequence(const char* cameraLabel) throw (CMMError);
@@ -609,6 +695,21 @@ public:
    std::string getGalvoChannel(const char* galvoLabel) throw (CMMError);
    ///@}
 
+   /** \name Asynchronous device commands.
+    * These return at once with a command handle. Each command runs on a
+    * worker thread of the device's adapter module, and is done when the
+    * devices involved report that they are no longer busy.
+    */
+   ///@{
+   long setPositionAsync(const char* stageLabel, double position) throw (CMMError);
+   long setXYPositionAsync(const char* xyStageLabel,
+         double x, double y) throw (CMMError);
+   long setStateAsync(const char* stateDeviceLabel, long state) throw (CMMError);
+   long setConfigAsync(const char* groupName, const char* configName) throw (CMMError);
+   bool isCommandDone(long command) throw (CMMError);
+   void waitForCommand(long command) throw (CMMError);
+   ///@}
+
    /** \name Device discovery. */
    ///@{
    bool supportsDeviceDetection(char* deviceLabel);
@@ -669,11 +770,31 @@ private:
    CorePropertyCollection* properties_;
    MMEventCallback* externalCallback_;  // notification hook to the higher layer (e.g. GUI)
    PixelSizeConfigGroup* pixelSizeGroup_;
+   std::shared_ptr<mm::ConfigPropertyIndex> configPropertyIndex_; // Of configGroups_ and pixelSizeGroup_
    CircularBuffer* cbuf_;
+   std::shared_ptr<mm::CameraBufferPool> cameraBuffers_;
+   std::shared_ptr<ThreadPool> threadPool_; // Shared by the core's parallel work
+   bool perCameraBuffers_;
+   std::string spillPath_; // Empty unless spill mode is enabled
+   unsigned spillMaxMB_; // 0 for no limit
+   std::shared_ptr<mm::FrameWriter> frameWriter_; // Kept after stopping, for its statistics
+   bool parallelConfigApply_;
+
+   // Time spent on each device, in milliseconds, in order of first access
+   typedef std::vector< std::pair<std::string, double> > DeviceTimes;
+
+   // Of the last applyConfiguration()
+   MMThreadLock configApplyTimesLock_;
+   DeviceTimes configApplyTimes_; // Synchronized by configApplyTimesLock_
 
    std::vector< std::weak_ptr<DeviceInstance> > imageSynchroDevices_;
    std::shared_ptr<CPluginManager> pluginManager_;
    std::shared_ptr<mm::DeviceManager> deviceManager_;
+   std::shared_ptr<mm::DeviceIdleSignal> deviceIdleSignal_;
+   std::shared_ptr<mm::DeviceCommandQueue> commandQueue_;
+   MMThreadLock asyncCommandsLock_;
+   long lastAsyncCommandId_; // Synchronized by asyncCommandsLock_
+   std::map< long, std::shared_ptr<mm::AsyncCommand> > asyncCommands_; // Synchronized by asyncCommandsLock_
    std::map<int, std::string> errorText_;
    CPropBlockMap propBlocks_;
 
@@ -681,6 +802,13 @@ private:
    // or acquiring a module lock
    mutable MMThreadLock stateCacheLock_;
    mutable Configuration stateCache_; // Synchronized by stateCacheLock_
+   std::shared_ptr<mm::StateCacheTracker> stateCacheTracker_;
+   std::shared_ptr<mm::PresetMatchCache> presetMatchCache_; // Of stateCache_; synchronized by stateCacheLock_
+
+   // Of the last update or refresh of stateCache_
+   MMThreadLock stateCacheRefreshLock_;
+   long stateCacheRefreshCount_; // Synchronized by stateCacheRefreshLock_
+   DeviceTimes stateCacheRefreshTimes_; // Synchronized by stateCacheRefreshLock_
 
    MMThreadLock* pPostedErrorsLock_;
    mutable std::deque<std::pair< int, std::string> > postedErrors_;
@@ -700,8 +828,27 @@ private:
    bool IsCoreDeviceLabel(const char* label) const throw (CMMError);
 
    void applyConfiguration(const Configuration& config) throw (CMMError);
-   int applyProperties(std::vector<PropertySetting>& props, std::string& lastError);
+   int applyProperties(std::vector<PropertySetting>& props, std::string& lastError,
+         DeviceTimes& times);
+   bool applySetting(std::shared_ptr<DeviceInstance> pDevice,
+         const PropertySetting& setting, double& elapsedMs, std::string* errorMessage);
+   void applySettingsByModule(const std::vector< std::shared_ptr<DeviceInstance> >& devices,
+         const std::vector<PropertySetting>& settings,
+         std::vector<PropertySetting>& failedProps, DeviceTimes& times);
    void waitForDevice(std::shared_ptr<DeviceInstance> pDev) throw (CMMError);
+   long refreshStateCache(bool all);
+   void addToStateCache(const PropertySetting& setting) const;
+   void resolvePropertyItems(const std::vector<std::string>& labels,
+         const std::vector<std::string>& propNames,
+         const std::vector<std::string>* values,
+         std::vector< std::shared_ptr<DeviceInstance> >& devices,
+         std::vector<std::string>& errors);
+   void waitForDevices(std::vector< std::shared_ptr<DeviceInstance> > devices) throw (CMMError);
+   long registerAsyncCommand(std::shared_ptr<mm::AsyncCommand> command);
+   std::shared_ptr<mm::AsyncCommand> findAsyncCommand(long command) throw (CMMError);
+   std::shared_ptr<CircularBuffer> getCameraCircularBuffer(const char* cameraLabel) const throw (CMMError);
+   void applyCircularBufferMemoryOptions() throw (CMMError);
+   void applyThreadPoolOptions();
    Configuration getConfigGroupState(const char* group, bool fromCache) throw (CMMError);
    std::string getDeviceErrorText(int deviceCode, std::shared_ptr<DeviceInstance> pDevice);
    std::string getDeviceName(std::shared_ptr<DeviceInstance> pDev);
@@ -0,0 +1,124 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          PresetMatchCache.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Cache of configuration presets matching the system state
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "PresetMatchCache.h"
+
+#include "ConfigGroup.h"
+#include "SymbolTable.h"
+
+#include "../MMDevice/MMDeviceConstants.h"
+
+
+namespace mm
+{
+
+PresetMatchCache::PresetMatchCache(ConfigGroupCollection& groups) :
+   groups_(groups),
+   built_(false),
+   groupsChangeCount_(0)
+{
+}
+
+/**
+ * Looks up the remembered matching preset of the group (empty if none
+ * matches). Returns false if there is no answer for the group.
+ */
+bool PresetMatchCache::Get(const std::string& group, std::string& preset)
+{
+   CheckGroups();
+   std::map<std::string, std::string>::const_iterator it = presets_.find(group);
+   if (it == presets_.end())
+      return false;
+   preset = it->second;
+   return true;
+}
+
+/**
+ * Remembers the matching preset of the group (empty if none matches).
+ */
+void PresetMatchCache::Put(const std::string& group, const std::string& preset)
+{
+   CheckGroups();
+   if (uncacheable_.count(group))
+      return;
+   presets_[group] = preset;
+}
+
+/**
+ * Drops the answers of the groups that include the property. To be called
+ * when the property's value in the cache changes.
+ */
+void PresetMatchCache::Invalidate(const std::string& device,
+      const std::string& property)
+{
+   if (presets_.empty())
+      return;
+
+   unsigned long long key;
+   if (!SymbolTable::FindKey(device.c_str(), property.c_str(), key))
+      return;
+   std::unordered_map<unsigned long long, std::vector<std::string> >::const_iterator it =
+      groupsByProperty_.find(key);
+   if (it == groupsByProperty_.end())
+      return;
+   for (size_t i = 0; i < it->second.size(); ++i)
+      presets_.erase(it->second[i]);
+}
+
+// Rebuilds the property index, dropping all answers, if the groups changed
+void PresetMatchCache::CheckGroups()
+{
+   if (built_ && groupsChangeCount_ == groups_.GetChangeCount())
+      return;
+
+   presets_.clear();
+   groupsByProperty_.clear();
+   uncacheable_.clear();
+   groupsChangeCount_ = groups_.GetChangeCount();
+
+   const std::vector<std::string> groupNames = groups_.GetAvailableGroups();
+   for (size_t g = 0; g < groupNames.size(); ++g)
+   {
+      std::set<unsigned long long> keys;
+      const std::vector<std::string> presets =
+         groups_.GetAvailableConfigs(groupNames[g].c_str());
+      for (size_t p = 0; p < presets.size(); ++p)
+      {
+         const Configuration* config =
+            groups_.Find(groupNames[g].c_str(), presets[p].c_str());
+         if (!config)
+            continue;
+         for (size_t i = 0; i < config->size(); ++i)
+         {
+            const PropertySetting setting = config->getSetting(i);
+            if (setting.getDeviceLabel() == MM::g_Keyword_CoreDevice)
+               uncacheable_.insert(groupNames[g]);
+            keys.insert(SymbolTable::InternKey(setting.getDeviceLabel().c_str(),
+                     setting.getPropertyName().c_str()));
+         }
+      }
+      for (std::set<unsigned long long>::const_iterator it = keys.begin(), end = keys.end();
+            it != end; ++it)
+         groupsByProperty_[*it].push_back(groupNames[g]);
+   }
+   built_ = true;
+}
+
+} // namespace mm
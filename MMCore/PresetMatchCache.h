@@ -0,0 +1,73 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          PresetMatchCache.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Cache of configuration presets matching the system state
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ConfigGroupCollection;
+
+namespace mm
+{
+
+/**
+ * Remembers, for each configuration group, which preset (if any) matches
+ * the system state cache, so that repeated queries need not match every
+ * preset again.
+ *
+ * An answer is dropped when a property included in the group changes value
+ * in the cache, and all answers are dropped when the groups are edited.
+ * Groups that include Core properties are not cached, because those are
+ * read from the Core rather than from the cache.
+ *
+ * Not thread-safe; the owner must serialize access together with the state
+ * cache.
+ */
+class PresetMatchCache
+{
+   ConfigGroupCollection& groups_;
+
+   bool built_;
+   unsigned long long groupsChangeCount_;
+   // Interned (device, property) key to the groups that include it
+   std::unordered_map<unsigned long long, std::vector<std::string> > groupsByProperty_;
+   std::set<std::string> uncacheable_;
+   std::map<std::string, std::string> presets_; // Group to matching preset
+
+public:
+   explicit PresetMatchCache(ConfigGroupCollection& groups);
+
+   PresetMatchCache(const PresetMatchCache&) = delete;
+   PresetMatchCache& operator=(const PresetMatchCache&) = delete;
+
+   bool Get(const std::string& group, std::string& preset);
+   void Put(const std::string& group, const std::string& preset);
+   void Invalidate(const std::string& device, const std::string& property);
+   void InvalidateAll() { presets_.clear(); }
+
+private:
+   void CheckGroups();
+};
+
+} // namespace mm
@@ -0,0 +1,378 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          SpillFile.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   File holding frames moved out of the circular buffer
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "SpillFile.h"
+
+#include "ErrorCodes.h"
+#include "FrameBuffer.h"
+#include "StreamingCopy.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace mm
+{
+
+namespace
+{
+
+// The file grows by at least this much at a time
+const unsigned long long growthBytes = 256ULL << 20;
+
+// Length of the part of the file mapped for writing or reading at a time
+const size_t windowBytes = 64 << 20;
+
+const unsigned recordMagic = 0x4d4d5346; // "MMSF"
+
+struct RecordHeader
+{
+   unsigned magic;
+   unsigned channels;
+   unsigned long long bytes;
+};
+
+struct ChannelHeader
+{
+   unsigned width;
+   unsigned height;
+   unsigned depth;
+   unsigned reserved;
+   unsigned long long metadataBytes;
+};
+
+size_t PadTo8(size_t bytes)
+{
+   return (bytes + 7) & ~(size_t)7;
+}
+
+// Mapping offsets must be multiples of this
+size_t MappingGranularity()
+{
+#ifdef _WIN32
+   SYSTEM_INFO info;
+   GetSystemInfo(&info);
+   return info.dwAllocationGranularity;
+#else
+   long size = sysconf(_SC_PAGESIZE);
+   return size > 0 ? (size_t)size : 4096;
+#endif
+}
+
+} // anonymous namespace
+
+SpillFile::SpillFile(const std::string& path) throw (CMMError) :
+   path_(path),
+#ifdef _WIN32
+   file_(INVALID_HANDLE_VALUE),
+   mapping_(0),
+#else
+   fd_(-1),
+#endif
+   fileBytes_(0),
+   maxBytes_(0),
+   writeOffset_(0),
+   queuedBytes_(0)
+{
+#ifdef _WIN32
+   file_ = CreateFileA(path_.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL,
+         CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY, NULL);
+   if (file_ == INVALID_HANDLE_VALUE)
+#else
+   fd_ = open(path_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+   if (fd_ < 0)
+#endif
+   {
+      throw CMMError("Cannot create circular buffer spill file " + path_,
+            MMERR_FileOpenFailed);
+   }
+}
+
+SpillFile::~SpillFile()
+{
+   Close();
+#ifdef _WIN32
+   DeleteFileA(path_.c_str());
+#else
+   unlink(path_.c_str());
+#endif
+}
+
+void SpillFile::Close()
+{
+   Unmap(writeWindow_);
+   Unmap(readWindow_);
+#ifdef _WIN32
+   if (mapping_)
+      CloseHandle(mapping_);
+   mapping_ = 0;
+   if (file_ != INVALID_HANDLE_VALUE)
+      CloseHandle(file_);
+   file_ = INVALID_HANDLE_VALUE;
+#else
+   if (fd_ >= 0)
+      close(fd_);
+   fd_ = -1;
+#endif
+}
+
+/**
+ * Appends all channels of a frame, with their metadata. Returns false, leaving
+ * the file unchanged, if there is no room for it (on the disk, or within the
+ * maximum size).
+ */
+bool SpillFile::Append(const FrameBuffer& frame)
+{
+   std::vector<const ImgBuffer*> images;
+   std::vector<std::string> metadata;
+   size_t bytes = sizeof(RecordHeader);
+   for (unsigned i = 0; ; ++i)
+   {
+      const ImgBuffer* img = frame.FindImage(i);
+      if (!img)
+         break;
+      images.push_back(img);
+      metadata.push_back(img->GetMetadata().Serialize());
+      bytes += sizeof(ChannelHeader) + PadTo8(metadata.back().size()) +
+         PadTo8((size_t)img->Width() * img->Height() * img->Depth());
+   }
+   if (images.empty())
+      return false;
+
+   unsigned long long offset = writeOffset_;
+   if (!records_.empty() && writeOffset_ <= records_.front().offset)
+   {
+      // Wrapped around: the free space ends at the oldest frame
+      if (writeOffset_ + bytes > records_.front().offset)
+         return false;
+   }
+   else if (writeOffset_ + bytes > fileBytes_)
+   {
+      // Reuse the space of the frames read back so far, if there is enough
+      if (!records_.empty() && bytes <= records_.front().offset)
+         offset = 0;
+      else if (!Grow(writeOffset_ + bytes))
+         return false;
+   }
+   unsigned char* p = Map(writeWindow_, offset, bytes);
+   if (!p)
+      return false;
+
+   RecordHeader header;
+   header.magic = recordMagic;
+   header.channels = (unsigned)images.size();
+   header.bytes = bytes;
+   memcpy(p, &header, sizeof(header));
+   p += sizeof(header);
+   for (size_t i = 0; i < images.size(); ++i)
+   {
+      const ImgBuffer* img = images[i];
+      ChannelHeader channel;
+      channel.width = img->Width();
+      channel.height = img->Height();
+      channel.depth = img->Depth();
+      channel.reserved = 0;
+      channel.metadataBytes = metadata[i].size();
+      memcpy(p, &channel, sizeof(channel));
+      p += sizeof(channel);
+      memcpy(p, metadata[i].data(), metadata[i].size());
+      p += PadTo8(metadata[i].size());
+      const size_t pixelBytes = (size_t)channel.width * channel.height * channel.depth;
+      // Spilled images are not read again soon; keep them out of the cache
+      StreamingCopy(p, img->GetPixels(), pixelBytes);
+      p += PadTo8(pixelBytes);
+   }
+
+   Record record;
+   record.offset = offset;
+   record.bytes = bytes;
+   records_.push_back(record);
+   queuedBytes_ += bytes;
+   writeOffset_ = offset + bytes;
+   return true;
+}
+
+/**
+ * Removes the oldest frame from the file, copying its channels into new
+ * images. Returns false if the file holds no frames, or if the frame could
+ * not be read back (it is removed all the same).
+ */
+bool SpillFile::ReadNext(std::vector<std::shared_ptr<ImgBuffer> >& images)
+{
+   images.clear();
+   if (records_.empty())
+      return false;
+   const Record record = records_.front();
+   records_.pop_front();
+   queuedBytes_ -= record.bytes;
+
+   const unsigned char* p = Map(readWindow_, record.offset, record.bytes);
+   RecordHeader header;
+   if (p)
+   {
+      memcpy(&header, p, sizeof(header));
+      p += sizeof(header);
+   }
+   if (p && header.magic == recordMagic && header.bytes == record.bytes)
+   {
+      for (unsigned i = 0; i < header.channels; ++i)
+      {
+         ChannelHeader channel;
+         memcpy(&channel, p, sizeof(channel));
+         p += sizeof(channel);
+         const std::string serialized(reinterpret_cast<const char*>(p),
+               (size_t)channel.metadataBytes);
+         p += PadTo8(serialized.size());
+
+         // Resizing an empty image allocates without zero-filling
+         std::shared_ptr<ImgBuffer> img = std::make_shared<ImgBuffer>(0, 0, 0);
+         img->Resize(channel.width, channel.height, channel.depth);
+         img->SetPixels(p);
+         p += PadTo8((size_t)channel.width * channel.height * channel.depth);
+         Metadata md;
+         md.Restore(serialized.c_str());
+         img->SetMetadata(md);
+         images.push_back(img);
+      }
+   }
+
+   if (records_.empty())
+      writeOffset_ = 0; // Start over, reusing the space
+   return !images.empty();
+}
+
+/**
+ * Removes the frame appended last, as if it had never been appended.
+ */
+void SpillFile::DiscardLast()
+{
+   if (records_.empty())
+      return;
+   const Record record = records_.back();
+   records_.pop_back();
+   queuedBytes_ -= record.bytes;
+   writeOffset_ = records_.empty() ? 0 : record.offset;
+}
+
+/**
+ * Discards all frames. The file keeps its size, to be reused.
+ */
+void SpillFile::Clear()
+{
+   records_.clear();
+   queuedBytes_ = 0;
+   writeOffset_ = 0;
+}
+
+bool SpillFile::Grow(unsigned long long minBytes)
+{
+   unsigned long long newBytes = std::max(minBytes, fileBytes_ + growthBytes);
+   if (maxBytes_ > 0)
+   {
+      if (minBytes > maxBytes_)
+         return false;
+      newBytes = std::min(newBytes, maxBytes_);
+   }
+#ifdef _WIN32
+   // The mapping cannot outlive a change of the file size
+   Unmap(writeWindow_);
+   Unmap(readWindow_);
+   if (mapping_)
+      CloseHandle(mapping_);
+   mapping_ = 0;
+
+   LARGE_INTEGER size;
+   size.QuadPart = (LONGLONG)newBytes;
+   bool ok = SetFilePointerEx(file_, size, NULL, FILE_BEGIN) && SetEndOfFile(file_);
+   if (ok)
+      fileBytes_ = newBytes;
+   if (fileBytes_ > 0)
+   {
+      mapping_ = CreateFileMappingA(file_, NULL, PAGE_READWRITE, 0, 0, NULL);
+      if (!mapping_)
+         return false;
+   }
+   return ok;
+#else
+   // Reserve the blocks now: running out of space while writing through the
+   // mapping would raise SIGBUS
+#ifdef __linux__
+   if (posix_fallocate(fd_, (off_t)fileBytes_, (off_t)(newBytes - fileBytes_)) != 0)
+      return false;
+#else
+   if (ftruncate(fd_, (off_t)newBytes) != 0)
+      return false;
+#endif
+   fileBytes_ = newBytes;
+   return true;
+#endif
+}
+
+// Returns a pointer to the given range of the file, mapping a new window if
+// the current one does not cover it
+unsigned char* SpillFile::Map(Window& window, unsigned long long offset, size_t bytes)
+{
+   if (window.base && offset >= window.offset &&
+         offset + bytes <= window.offset + window.length)
+      return window.base + (offset - window.offset);
+
+   Unmap(window);
+   const unsigned long long start = offset / MappingGranularity() * MappingGranularity();
+   const unsigned long long end = std::min(fileBytes_,
+         std::max(offset + bytes, start + windowBytes));
+   if (end < offset + bytes)
+      return 0;
+   const size_t length = (size_t)(end - start);
+#ifdef _WIN32
+   void* p = MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS,
+         (DWORD)(start >> 32), (DWORD)start, length);
+   if (!p)
+      return 0;
+#else
+   void* p = mmap(0, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, (off_t)start);
+   if (p == MAP_FAILED)
+      return 0;
+#endif
+   window.base = static_cast<unsigned char*>(p);
+   window.offset = start;
+   window.length = length;
+   return window.base + (offset - start);
+}
+
+void SpillFile::Unmap(Window& window)
+{
+   if (!window.base)
+      return;
+#ifdef _WIN32
+   UnmapViewOfFile(window.base);
+#else
+   munmap(window.base, window.length);
+#endif
+   window = Window();
+}
+
+} // namespace mm
@@ -0,0 +1,115 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          SpillFile.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   File holding frames moved out of the circular buffer
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include "Error.h"
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+#pragma warning(disable : 4290) // exception declaration warning
+#endif
+
+namespace mm
+{
+
+class FrameBuffer;
+class ImgBuffer;
+
+/**
+ * Memory-mapped file holding frames that were moved out of a circular
+ * buffer, read back in first-in, first-out order.
+ *
+ * The file is created (or truncated) on construction and deleted on
+ * destruction. It is used as a ring: when a frame does not fit at the end of
+ * the file, it is written at the beginning if the frames read back so far
+ * have left room there. Otherwise the file grows in large steps, reserving
+ * the disk space up front so that writing through the mapping cannot fail.
+ *
+ * The file does not grow beyond the size given to SetMaxBytes(), if any;
+ * Append() then fails as it does when the disk is full, and the circular
+ * buffer overflows as it would without a spill file.
+ *
+ * Not thread-safe; the owner serializes access.
+ */
+class SpillFile
+{
+   struct Record
+   {
+      unsigned long long offset;
+      size_t bytes;
+   };
+
+   struct Window
+   {
+      unsigned char* base;
+      unsigned long long offset;
+      size_t length;
+
+      Window() : base(0), offset(0), length(0) {}
+   };
+
+   std::string path_;
+#ifdef _WIN32
+   void* file_;
+   void* mapping_;
+#else
+   int fd_;
+#endif
+   unsigned long long fileBytes_;
+   unsigned long long maxBytes_; // 0 for no limit
+   unsigned long long writeOffset_;
+   std::deque<Record> records_;
+   unsigned long long queuedBytes_;
+   Window writeWindow_;
+   Window readWindow_;
+
+public:
+   explicit SpillFile(const std::string& path) throw (CMMError);
+   ~SpillFile();
+
+   SpillFile(const SpillFile&) = delete;
+   SpillFile& operator=(const SpillFile&) = delete;
+
+   const std::string& GetPath() const { return path_; }
+   size_t GetFrameCount() const { return records_.size(); }
+   unsigned long long GetQueuedBytes() const { return queuedBytes_; }
+   unsigned long long GetFileBytes() const { return fileBytes_; }
+   unsigned long long GetMaxBytes() const { return maxBytes_; }
+   void SetMaxBytes(unsigned long long maxBytes) { maxBytes_ = maxBytes; }
+
+   bool Append(const FrameBuffer& frame);
+   bool ReadNext(std::vector<std::shared_ptr<ImgBuffer> >& images);
+   void DiscardLast();
+   void Clear();
+
+private:
+   bool Grow(unsigned long long minBytes);
+   unsigned char* Map(Window& window, unsigned long long offset, size_t bytes);
+   void Unmap(Window& window);
+   void Close();
+};
+
+} // namespace mm
@@ -0,0 +1,111 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          StateCacheTracker.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Age of the properties in the system state cache
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "StateCacheTracker.h"
+
+namespace mm
+{
+
+/**
+ * Returns whether the property must be read again: it has never been read,
+ * was marked stale, or has exceeded its maximum age.
+ */
+bool StateCacheTracker::NeedsRefresh(const std::string& device,
+      const std::string& property, Clock::time_point now)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   EntryMap::const_iterator it = entries_.find(std::make_pair(device, property));
+   if (it == entries_.end())
+      return true;
+   const Entry& entry = it->second;
+   if (!entry.read || entry.stale)
+      return true;
+   if (entry.maxAgeMs <= 0.0)
+      return false;
+   return std::chrono::duration<double, std::milli>(now - entry.readTime).count() >=
+      entry.maxAgeMs;
+}
+
+/**
+ * Records that the property was read. readTime should be taken before the
+ * read, so that a change during the read is not mistaken for fresh.
+ */
+void StateCacheTracker::MarkRead(const std::string& device,
+      const std::string& property, Clock::time_point readTime)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   Entry& entry = entries_[std::make_pair(device, property)];
+   entry.readTime = readTime;
+   entry.read = true;
+   entry.stale = false;
+}
+
+void StateCacheTracker::MarkStale(const std::string& device,
+      const std::string& property)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   entries_[std::make_pair(device, property)].stale = true;
+}
+
+void StateCacheTracker::MarkDeviceStale(const std::string& device)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   for (EntryMap::iterator it = DeviceBegin(device);
+         it != entries_.end() && it->first.first == device; ++it)
+      it->second.stale = true;
+}
+
+/**
+ * Sets the age (in milliseconds) after which the property is read again; 0
+ * removes the limit.
+ */
+void StateCacheTracker::SetMaxAge(const std::string& device,
+      const std::string& property, double maxAgeMs)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   entries_[std::make_pair(device, property)].maxAgeMs = maxAgeMs;
+}
+
+/**
+ * Forgets the device's properties, including their maximum ages. Called
+ * when the device is unloaded.
+ */
+void StateCacheTracker::ForgetDevice(const std::string& device)
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   EntryMap::iterator it = DeviceBegin(device);
+   while (it != entries_.end() && it->first.first == device)
+      it = entries_.erase(it);
+}
+
+void StateCacheTracker::Clear()
+{
+   std::lock_guard<std::mutex> lock(mutex_);
+   entries_.clear();
+}
+
+// Must be called with mutex_ held
+StateCacheTracker::EntryMap::iterator StateCacheTracker::DeviceBegin(
+      const std::string& device)
+{
+   return entries_.lower_bound(std::make_pair(device, std::string()));
+}
+
+} // namespace mm
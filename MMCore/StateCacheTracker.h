@@ -0,0 +1,82 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          StateCacheTracker.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Age of the properties in the system state cache
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace mm
+{
+
+/**
+ * Keeps track of when each device property was last read into the system
+ * state cache, so that a refresh can re-read only the properties that need
+ * it: those never read, those marked stale, and those older than their
+ * maximum age, if one is set.
+ *
+ * Thread-safe.
+ */
+class StateCacheTracker
+{
+public:
+   typedef std::chrono::steady_clock Clock;
+
+private:
+   struct Entry
+   {
+      Clock::time_point readTime;
+      bool read;
+      bool stale;
+      double maxAgeMs; // No maximum age if not positive
+
+      Entry() : read(false), stale(false), maxAgeMs(0.0) {}
+   };
+
+   typedef std::map<std::pair<std::string, std::string>, Entry> EntryMap;
+
+   std::mutex mutex_;
+   EntryMap entries_; // Guarded by mutex_
+
+public:
+   StateCacheTracker() {}
+
+   StateCacheTracker(const StateCacheTracker&) = delete;
+   StateCacheTracker& operator=(const StateCacheTracker&) = delete;
+
+   bool NeedsRefresh(const std::string& device, const std::string& property,
+         Clock::time_point now);
+   void MarkRead(const std::string& device, const std::string& property,
+         Clock::time_point readTime);
+   void MarkStale(const std::string& device, const std::string& property);
+   void MarkDeviceStale(const std::string& device);
+   void SetMaxAge(const std::string& device, const std::string& property,
+         double maxAgeMs);
+   void ForgetDevice(const std::string& device);
+   void Clear();
+
+private:
+   EntryMap::iterator DeviceBegin(const std::string& device);
+};
+
+} // namespace mm
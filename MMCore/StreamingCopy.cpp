@@ -0,0 +1,278 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          StreamingCopy.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Memory copy with non-temporal stores
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "StreamingCopy.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define MM_STREAMING_COPY_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only generate code for instruction sets enabled for the
+// function; MSVC allows intrinsics anywhere
+#if defined(MM_STREAMING_COPY_X86) && (defined(__GNUC__) || defined(__clang__))
+#define MM_TARGET(isa) __attribute__((target(isa)))
+#else
+#define MM_TARGET(isa)
+#endif
+
+namespace mm
+{
+
+namespace
+{
+
+// A frame this large is already a sizable part of a typical last-level
+// cache; StreamingCopy-Bench shows where the crossover lies on a given
+// machine
+std::atomic<size_t> g_streamingThreshold(2 << 20);
+
+#ifdef MM_STREAMING_COPY_X86
+
+// Copies the unaligned head so that dst is aligned to `alignment`; returns
+// the number of bytes copied
+inline size_t CopyHead(unsigned char* dst, const unsigned char* src,
+      size_t bytes, size_t alignment)
+{
+   size_t head = (alignment - (reinterpret_cast<uintptr_t>(dst) & (alignment - 1))) &
+      (alignment - 1);
+   if (head > bytes)
+      head = bytes;
+   std::memcpy(dst, src, head);
+   return head;
+}
+
+void CopySSE2(void* dst, const void* src, size_t bytes)
+{
+   unsigned char* d = static_cast<unsigned char*>(dst);
+   const unsigned char* s = static_cast<const unsigned char*>(src);
+   const size_t head = CopyHead(d, s, bytes, 16);
+   d += head; s += head; bytes -= head;
+   for (; bytes >= 64; d += 64, s += 64, bytes -= 64)
+   {
+      const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+      const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 16));
+      const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 32));
+      const __m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 48));
+      _mm_stream_si128(reinterpret_cast<__m128i*>(d), a);
+      _mm_stream_si128(reinterpret_cast<__m128i*>(d + 16), b);
+      _mm_stream_si128(reinterpret_cast<__m128i*>(d + 32), c);
+      _mm_stream_si128(reinterpret_cast<__m128i*>(d + 48), e);
+   }
+   _mm_sfence();
+   std::memcpy(d, s, bytes);
+}
+
+MM_TARGET("avx2")
+void CopyAVX2(void* dst, const void* src, size_t bytes)
+{
+   unsigned char* d = static_cast<unsigned char*>(dst);
+   const unsigned char* s = static_cast<const unsigned char*>(src);
+   const size_t head = CopyHead(d, s, bytes, 32);
+   d += head; s += head; bytes -= head;
+   for (; bytes >= 128; d += 128, s += 128, bytes -= 128)
+   {
+      const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s));
+      const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + 32));
+      const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + 64));
+      const __m256i e = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + 96));
+      _mm256_stream_si256(reinterpret_cast<__m256i*>(d), a);
+      _mm256_stream_si256(reinterpret_cast<__m256i*>(d + 32), b);
+      _mm256_stream_si256(reinterpret_cast<__m256i*>(d + 64), c);
+      _mm256_stream_si256(reinterpret_cast<__m256i*>(d + 96), e);
+   }
+   _mm_sfence();
+   _mm256_zeroupper();
+   std::memcpy(d, s, bytes);
+}
+
+MM_TARGET("avx512f")
+void CopyAVX512(void* dst, const void* src, size_t bytes)
+{
+   unsigned char* d = static_cast<unsigned char*>(dst);
+   const unsigned char* s = static_cast<const unsigned char*>(src);
+   const size_t head = CopyHead(d, s, bytes, 64);
+   d += head; s += head; bytes -= head;
+   for (; bytes >= 256; d += 256, s += 256, bytes -= 256)
+   {
+      const __m512i a = _mm512_loadu_si512(s);
+      const __m512i b = _mm512_loadu_si512(s + 64);
+      const __m512i c = _mm512_loadu_si512(s + 128);
+      const __m512i e = _mm512_loadu_si512(s + 192);
+      _mm512_stream_si512(reinterpret_cast<__m512i*>(d), a);
+      _mm512_stream_si512(reinterpret_cast<__m512i*>(d + 64), b);
+      _mm512_stream_si512(reinterpret_cast<__m512i*>(d + 128), c);
+      _mm512_stream_si512(reinterpret_cast<__m512i*>(d + 192), e);
+   }
+   _mm_sfence();
+   _mm256_zeroupper();
+   std::memcpy(d, s, bytes);
+}
+
+#ifdef _MSC_VER
+bool CpuHas(int leaf, int subleaf, int reg, int bit)
+{
+   int info[4];
+   __cpuidex(info, leaf, subleaf);
+   return (info[reg] & (1 << bit)) != 0;
+}
+
+// Whether the OS saves the given XSAVE state components
+bool OsSaves(unsigned long long mask)
+{
+   if (!CpuHas(1, 0, 2, 27)) // OSXSAVE
+      return false;
+   return (_xgetbv(0) & mask) == mask;
+}
+#endif
+
+bool HasAVX2()
+{
+#ifdef _MSC_VER
+   return OsSaves(0x6) && CpuHas(7, 0, 1, 5);
+#else
+   return __builtin_cpu_supports("avx2");
+#endif
+}
+
+bool HasAVX512()
+{
+#ifdef _MSC_VER
+   return OsSaves(0xe6) && CpuHas(7, 0, 1, 16);
+#else
+   return __builtin_cpu_supports("avx512f");
+#endif
+}
+
+#endif // MM_STREAMING_COPY_X86
+
+typedef void (*CopyFunction)(void*, const void*, size_t);
+
+void CopyMemcpy(void* dst, const void* src, size_t bytes)
+{
+   std::memcpy(dst, src, bytes);
+}
+
+CopyFunction GetCopyFunction(CopyKernel kernel)
+{
+   switch (kernel)
+   {
+#ifdef MM_STREAMING_COPY_X86
+      case CopyKernelSSE2: return CopySSE2;
+      case CopyKernelAVX2: return CopyAVX2;
+      case CopyKernelAVX512: return CopyAVX512;
+#endif
+      default: return CopyMemcpy;
+   }
+}
+
+} // anonymous namespace
+
+const char* GetCopyKernelName(CopyKernel kernel)
+{
+   switch (kernel)
+   {
+      case CopyKernelSSE2: return "SSE2";
+      case CopyKernelAVX2: return "AVX2";
+      case CopyKernelAVX512: return "AVX-512";
+      default: return "memcpy";
+   }
+}
+
+bool IsCopyKernelSupported(CopyKernel kernel)
+{
+   switch (kernel)
+   {
+      case CopyKernelMemcpy:
+         return true;
+#ifdef MM_STREAMING_COPY_X86
+      case CopyKernelSSE2:
+         return true; // Part of x86-64
+      case CopyKernelAVX2:
+         return HasAVX2();
+      case CopyKernelAVX512:
+         return HasAVX512();
+#endif
+      default:
+         return false;
+   }
+}
+
+CopyKernel GetBestCopyKernel()
+{
+   static const CopyKernel best =
+      IsCopyKernelSupported(CopyKernelAVX512) ? CopyKernelAVX512 :
+      IsCopyKernelSupported(CopyKernelAVX2) ? CopyKernelAVX2 :
+      IsCopyKernelSupported(CopyKernelSSE2) ? CopyKernelSSE2 :
+      CopyKernelMemcpy;
+   return best;
+}
+
+void StreamingCopy(void* dst, const void* src, size_t bytes)
+{
+   static const CopyFunction copy = GetCopyFunction(GetBestCopyKernel());
+   copy(dst, src, bytes);
+}
+
+/**
+ * Copies with the given kernel, which must be supported by the CPU (see
+ * IsCopyKernelSupported()).
+ */
+void StreamingCopy(void* dst, const void* src, size_t bytes, CopyKernel kernel)
+{
+   GetCopyFunction(kernel)(dst, src, bytes);
+}
+
+size_t GetStreamingCopyThreshold()
+{
+   return g_streamingThreshold.load(std::memory_order_relaxed);
+}
+
+void SetStreamingCopyThreshold(size_t bytes)
+{
+   g_streamingThreshold.store(bytes, std::memory_order_relaxed);
+}
+
+bool UseStreamingCopy(size_t frameBytes)
+{
+   return frameBytes >= GetStreamingCopyThreshold();
+}
+
+void CopyFrame(void* dst, const void* src, size_t bytes)
+{
+   CopyFrame(dst, src, bytes, bytes);
+}
+
+void CopyFrame(void* dst, const void* src, size_t bytes, size_t frameBytes)
+{
+   if (UseStreamingCopy(frameBytes))
+      StreamingCopy(dst, src, bytes);
+   else
+      std::memcpy(dst, src, bytes);
+}
+
+} // namespace mm
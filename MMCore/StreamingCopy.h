@@ -0,0 +1,61 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          StreamingCopy.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Memory copy with non-temporal stores
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <cstddef>
+
+namespace mm
+{
+
+/**
+ * Instruction sets for copying with non-temporal (cache-bypassing) stores.
+ */
+enum CopyKernel
+{
+   CopyKernelMemcpy, // Plain memcpy; always supported
+   CopyKernelSSE2,
+   CopyKernelAVX2,
+   CopyKernelAVX512,
+};
+
+const char* GetCopyKernelName(CopyKernel kernel);
+bool IsCopyKernelSupported(CopyKernel kernel);
+CopyKernel GetBestCopyKernel();
+
+// Copies with non-temporal stores, using the best kernel the CPU supports.
+// The destination is not left in the cache, and the stores are complete
+// (fenced) on return.
+void StreamingCopy(void* dst, const void* src, size_t bytes);
+void StreamingCopy(void* dst, const void* src, size_t bytes, CopyKernel kernel);
+
+// Frames of at least this many bytes are copied with StreamingCopy() by
+// CopyFrame(); smaller ones with memcpy, so that frames which are likely to
+// be read right away (e.g. for display) stay in the cache.
+size_t GetStreamingCopyThreshold();
+void SetStreamingCopyThreshold(size_t bytes);
+bool UseStreamingCopy(size_t frameBytes);
+
+// Copies a whole frame, or a chunk of a frame of frameBytes bytes, choosing
+// between memcpy and StreamingCopy() by the frame size.
+void CopyFrame(void* dst, const void* src, size_t bytes);
+void CopyFrame(void* dst, const void* src, size_t bytes, size_t frameBytes);
+
+} // namespace mm
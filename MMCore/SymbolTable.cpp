@@ -0,0 +1,162 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          SymbolTable.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Interned device labels and property names
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#include "SymbolTable.h"
+
+namespace mm
+{
+
+namespace
+{
+
+// Initial capacity of the hash table
+const std::size_t initialSlots = 256;
+
+} // anonymous namespace
+
+std::size_t SymbolTable::CStrHash::operator()(const char* s) const
+{
+   // FNV-1a
+   std::size_t h = static_cast<std::size_t>(14695981039346656037ULL);
+   for (; *s; ++s)
+   {
+      h ^= static_cast<unsigned char>(*s);
+      h *= static_cast<std::size_t>(1099511628211ULL);
+   }
+   return h;
+}
+
+SymbolTable::IdTable::IdTable(std::size_t capacity) :
+   mask(capacity - 1),
+   slots(new Slot[capacity])
+{
+}
+
+SymbolTable::SymbolTable() :
+   ids_(nullptr)
+{
+   tables_.push_back(std::unique_ptr<IdTable>(new IdTable(initialSlots)));
+   ids_.store(tables_.back().get(), std::memory_order_release);
+   InternLocked("");
+}
+
+SymbolTable& SymbolTable::Instance()
+{
+   static SymbolTable instance;
+   return instance;
+}
+
+// Looks up an interned name without locking
+bool SymbolTable::Find(const char* name, Id& id) const
+{
+   const IdTable* table = ids_.load(std::memory_order_acquire);
+   for (std::size_t i = CStrHash()(name) & table->mask; ;
+         i = (i + 1) & table->mask)
+   {
+      const char* slotName = table->slots[i].name.load(std::memory_order_acquire);
+      if (!slotName)
+         return false;
+      if (std::strcmp(slotName, name) == 0)
+      {
+         id = table->slots[i].id.load(std::memory_order_relaxed);
+         return true;
+      }
+   }
+}
+
+// Must be called with mutex_ held, on a table with room for the name
+void SymbolTable::Insert(IdTable& table, const char* name, Id id)
+{
+   std::size_t i = CStrHash()(name) & table.mask;
+   while (table.slots[i].name.load(std::memory_order_relaxed))
+      i = (i + 1) & table.mask;
+   table.slots[i].id.store(id, std::memory_order_relaxed);
+   table.slots[i].name.store(name, std::memory_order_release);
+}
+
+// Must be called with mutex_ held (or from the constructor)
+SymbolTable::Id SymbolTable::InternLocked(const char* name)
+{
+   Id id;
+   if (Find(name, id))
+      return id;
+   id = static_cast<Id>(names_.size());
+   names_.push_back(name);
+
+   IdTable& table = *tables_.back();
+   if (2 * names_.size() <= table.mask + 1)
+   {
+      Insert(table, names_.back().c_str(), id);
+      return id;
+   }
+
+   // Publish a larger copy, complete before readers can see it
+   std::unique_ptr<IdTable> larger(new IdTable(2 * (table.mask + 1)));
+   for (std::size_t i = 0; i < names_.size(); ++i)
+      Insert(*larger, names_[i].c_str(), static_cast<Id>(i));
+   tables_.push_back(std::move(larger));
+   ids_.store(tables_.back().get(), std::memory_order_release);
+   return id;
+}
+
+/**
+ * Returns the id of the name, assigning one if it has none yet.
+ */
+SymbolTable::Id SymbolTable::Intern(const char* name)
+{
+   SymbolTable& table = Instance();
+   Id id;
+   if (table.Find(name, id))
+      return id;
+   std::lock_guard<std::mutex> lock(table.mutex_);
+   return table.InternLocked(name);
+}
+
+/**
+ * Returns the key of the (device, property) pair, interning both names.
+ */
+unsigned long long SymbolTable::InternKey(const char* device,
+      const char* property)
+{
+   SymbolTable& table = Instance();
+   unsigned long long key;
+   if (FindKey(device, property, key))
+      return key;
+   std::lock_guard<std::mutex> lock(table.mutex_);
+   return Key(table.InternLocked(device), table.InternLocked(property));
+}
+
+/**
+ * Looks up the key of the (device, property) pair without interning.
+ * Returns false if either name has never been interned, in which case no
+ * setting can have that key.
+ */
+bool SymbolTable::FindKey(const char* device, const char* property,
+      unsigned long long& key)
+{
+   const SymbolTable& table = Instance();
+   Id dev, prop;
+   if (!table.Find(device, dev) || !table.Find(property, prop))
+      return false;
+   key = Key(dev, prop);
+   return true;
+}
+
+} // namespace mm
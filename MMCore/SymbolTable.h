@@ -0,0 +1,103 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          SymbolTable.h
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Interned device labels and property names
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mm
+{
+
+/**
+ * Process-wide table of interned device labels and property names.
+ *
+ * Each distinct name gets a small integer id, so that settings can be
+ * indexed and compared by (device, property) without building or
+ * comparing strings. Ids are never released; the set of names in use is
+ * bounded by the devices and properties that have been configured.
+ *
+ * The empty string is always id 0. Thread-safe; looking up names that have
+ * already been interned does not take a lock, so it can be done from many
+ * threads at once.
+ */
+class SymbolTable
+{
+public:
+   typedef unsigned Id;
+
+   /// Key of a (device, property) pair.
+   static unsigned long long Key(Id device, Id property)
+   {
+      return (static_cast<unsigned long long>(device) << 32) | property;
+   }
+
+   static Id Intern(const char* name);
+   static unsigned long long InternKey(const char* device, const char* property);
+   static bool FindKey(const char* device, const char* property,
+         unsigned long long& key);
+
+private:
+   struct CStrHash
+   {
+      std::size_t operator()(const char* s) const;
+   };
+
+   struct Slot
+   {
+      std::atomic<const char*> name; // Points into names_; null if empty
+      std::atomic<Id> id;
+
+      Slot() : name(nullptr), id(0) {}
+   };
+
+   // Open-addressing hash table from name to id, at most half full
+   struct IdTable
+   {
+      std::size_t mask; // Capacity - 1
+      std::unique_ptr<Slot[]> slots;
+
+      explicit IdTable(std::size_t capacity);
+   };
+
+   // Readers probe ids_ without locking. Entries are only added, under
+   // mutex_, by storing the id before publishing the name. When the table
+   // fills up, a larger copy is published instead; the old ones are kept in
+   // tables_ for readers that may still be probing them.
+   std::mutex mutex_;
+   std::deque<std::string> names_; // Guarded by mutex_
+   std::vector< std::unique_ptr<IdTable> > tables_; // Guarded by mutex_
+   std::atomic<const IdTable*> ids_; // Latest of tables_
+
+   SymbolTable();
+
+   static SymbolTable& Instance();
+   bool Find(const char* name, Id& id) const;
+   Id InternLocked(const char* name);
+   static void Insert(IdTable& table, const char* name, Id id);
+};
+
+} // namespace mm
@@ -23,6 +23,8 @@
 
 #include "TaskSet_CopyMemory.h"
 
+#include "StreamingCopy.h"
+
 #include <algorithm>
 #include <cassert>
 #include <cstring>
@@ -53,7 +55,8 @@ void TaskSet_CopyMemory::ATask::Execute()
     void* dst = static_cast<char*>(dst_) + chunkOffset;
     const void* src = static_cast<const char*>(src_) + chunkOffset;
 
-    std::memcpy(dst, src, chunkBytes);
+    // The whole frame's size decides whether to bypass the cache
+    mm::CopyFrame(dst, src, chunkBytes, bytes_);
 }
 
 TaskSet_CopyMemory::TaskSet_CopyMemory(std::shared_ptr<ThreadPool> pool)
@@ -68,13 +71,13 @@ void TaskSet_CopyMemory::SetUp(void* dst, const void* src, size_t bytes)
     assert(src);
     assert(bytes > 0);
 
-    // Call memcpy directly without threading for small frames up to 1MB
+    // Copy directly without threading for small frames up to 1MB
     // Otherwise do parallel copy and add one thread for each 1MB
     // The limits were found experimentally
     usedTaskCount_ = std::min<size_t>(1 + bytes / 1000000, tasks_.size());
     if (usedTaskCount_ == 1)
     {
-        std::memcpy(dst, src, bytes);
+        mm::CopyFrame(dst, src, bytes);
         return;
     }
 
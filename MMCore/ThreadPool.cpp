@@ -5,6 +5,8 @@
 //-----------------------------------------------------------------------------
 // DESCRIPTION:   A class executing queued tasks on separate threads
 //                and scaling number of threads based on hardware.
+//                Each worker has its own queue; idle workers steal from
+//                the others.
 //
 // AUTHOR:        Tomas Hanak, tomas.hanak@teledyne.com, 03/03/2021
 //                Andrej Bencur, andrej.bencur@teledyne.com, 03/03/2021
@@ -28,79 +30,302 @@
 
 #include <algorithm>
 #include <cassert>
+#include <exception>
 #include <mutex>
 #include <thread>
 
-ThreadPool::ThreadPool()
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#endif
+
+ThreadPool::ThreadPool(size_t threadCount, const Placement& placement)
+    : placement_(placement)
 {
-    const size_t hwThreadCount = std::max<size_t>(1, std::thread::hardware_concurrency());
-    for (size_t n = 0; n < hwThreadCount; ++n)
+    const bool restricted = placement_.pinToCores || placement_.numaNode >= 0;
+    const std::vector<int> cpus = restricted ? GetAllowedCpus(placement_.numaNode) : std::vector<int>();
+    if (restricted && cpus.empty())
+        placementApplied_ = false;
+
+    if (threadCount == 0)
     {
-        auto thread = std::make_unique<std::thread>(&ThreadPool::ThreadFunc, this);
-        threads_.push_back(std::move(thread));
+        threadCount = (placement_.numaNode >= 0 && !cpus.empty())
+            ? cpus.size()
+            : std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+
+    for (size_t n = 0; n < threadCount; ++n)
+        workers_.push_back(std::make_unique<Worker>());
+    // Start the threads only once all workers exist, since they steal from
+    // each other
+    for (size_t n = 0; n < threadCount; ++n)
+    {
+        Worker& worker = *workers_[n];
+        worker.thread = std::thread(&ThreadPool::ThreadFunc, this, n);
+        if (cpus.empty())
+            continue;
+        const std::vector<int> workerCpus = placement_.pinToCores
+            ? std::vector<int>(1, cpus[n % cpus.size()])
+            : cpus;
+        if (!SetThreadAffinity(worker.thread, workerCpus))
+            placementApplied_ = false;
     }
 }
 
 ThreadPool::~ThreadPool()
 {
+    abortFlag_ = true;
+    for (const auto& worker : workers_)
     {
-        std::lock_guard<std::mutex> lock(mx_);
-        abortFlag_ = true;
+        // Lock so that the notification cannot fall between a worker's check
+        // of the flag and its wait
+        std::lock_guard<std::mutex> lock(worker->mx);
+        worker->cv.notify_one();
     }
-    cv_.notify_all();
 
-    for (const auto& thread : threads_)
-        thread->join();
+    for (const auto& worker : workers_)
+        worker->thread.join();
 }
 
 size_t ThreadPool::GetSize() const
 {
-    return threads_.size();
+    return workers_.size();
 }
 
 void ThreadPool::Execute(Task* task)
 {
     assert(task);
-    {
-        std::lock_guard<std::mutex> lock(mx_);
-        if (abortFlag_)
-            return;
-        queue_.push_back(task);
-    }
-    cv_.notify_one();
+    if (abortFlag_)
+        return;
+    Push(nextWorker_++ % workers_.size(), [task]() { task->Execute(); task->Done(); });
 }
 
 void ThreadPool::Execute(const std::vector<Task*>& tasks)
 {
     assert(!tasks.empty());
+    if (abortFlag_)
+        return;
 
+    // Consecutive tasks go to consecutive workers, so that only as many
+    // workers are woken as there are tasks
+    const size_t first = nextWorker_.fetch_add(tasks.size());
+    for (size_t n = 0; n < tasks.size(); ++n)
     {
-        std::lock_guard<std::mutex> lock(mx_);
-        if (abortFlag_)
-            return;
-        for (Task* task : tasks)
+        Task* task = tasks[n];
+        assert(task);
+        Push((first + n) % workers_.size(), [task]() { task->Execute(); task->Done(); });
+    }
+}
+
+void ThreadPool::ParallelFor(size_t begin, size_t end, size_t grain,
+    const std::function<void(size_t, size_t)>& body)
+{
+    if (end <= begin)
+        return;
+    grain = std::max<size_t>(1, grain);
+    const size_t chunkCount = (end - begin - 1) / grain + 1;
+    const size_t helperCount = std::min(chunkCount - 1, workers_.size());
+    if (helperCount == 0 || abortFlag_)
+    {
+        body(begin, end);
+        return;
+    }
+
+    // Helpers may start after the last chunk is done (and this function has
+    // returned), so they share ownership of the state; body is only used by
+    // a thread that has claimed a chunk, which is always before we return.
+    struct State
+    {
+        std::atomic<size_t> nextChunk{ 0 };
+        size_t doneChunks{ 0 }; // Guarded by mx
+        std::exception_ptr error{}; // Guarded by mx
+        std::mutex mx{};
+        std::condition_variable cv{};
+    };
+    auto state = std::make_shared<State>();
+    const std::function<void(size_t, size_t)>* pBody = &body;
+    auto run = [state, pBody, begin, end, grain, chunkCount]()
+    {
+        for (;;)
         {
-            assert(task);
-            queue_.push_back(task);
+            const size_t chunk = state->nextChunk++;
+            if (chunk >= chunkCount)
+                return;
+            const size_t chunkBegin = begin + chunk * grain;
+            const size_t chunkEnd = std::min(end, chunkBegin + grain);
+            std::exception_ptr error;
+            try
+            {
+                (*pBody)(chunkBegin, chunkEnd);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(state->mx);
+            if (error && !state->error)
+                state->error = error;
+            if (++state->doneChunks == chunkCount)
+                state->cv.notify_all();
         }
+    };
+
+    const size_t first = nextWorker_.fetch_add(helperCount);
+    for (size_t n = 0; n < helperCount; ++n)
+        Push((first + n) % workers_.size(), run);
+
+    // Work on the chunks here too, so that progress never depends on a free
+    // worker (e.g. when called from a worker)
+    run();
+
+    std::unique_lock<std::mutex> lock(state->mx);
+    state->cv.wait(lock, [&]() { return state->doneChunks == chunkCount; });
+    if (state->error)
+        std::rethrow_exception(state->error);
+}
+
+void ThreadPool::Push(size_t workerIndex, std::function<void()>&& job)
+{
+    Worker& worker = *workers_[workerIndex];
+    {
+        std::lock_guard<std::mutex> lock(worker.mx);
+        worker.queue.push_back(std::move(job));
+    }
+    worker.cv.notify_one();
+}
+
+bool ThreadPool::Pop(size_t workerIndex, std::function<void()>& job)
+{
+    Worker& worker = *workers_[workerIndex];
+    std::lock_guard<std::mutex> lock(worker.mx);
+    if (worker.queue.empty())
+        return false;
+    job = std::move(worker.queue.front());
+    worker.queue.pop_front();
+    return true;
+}
+
+bool ThreadPool::Steal(size_t thiefIndex, std::function<void()>& job)
+{
+    const size_t count = workers_.size();
+    for (size_t n = 1; n < count; ++n)
+    {
+        Worker& victim = *workers_[(thiefIndex + n) % count];
+        // Don't wait for a busy queue; another one may have work
+        std::unique_lock<std::mutex> lock(victim.mx, std::try_to_lock);
+        if (!lock.owns_lock() || victim.queue.empty())
+            continue;
+        job = std::move(victim.queue.back());
+        victim.queue.pop_back();
+        return true;
     }
-    cv_.notify_all();
+    return false;
 }
 
-void ThreadPool::ThreadFunc()
+void ThreadPool::ThreadFunc(size_t workerIndex)
 {
+    Worker& worker = *workers_[workerIndex];
     for (;;)
     {
-        Task* task = nullptr;
+        std::function<void()> job;
+        if (Pop(workerIndex, job) || Steal(workerIndex, job))
+        {
+            job();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(worker.mx);
+        worker.cv.wait(lock, [&]() { return abortFlag_ || !worker.queue.empty(); });
+        if (abortFlag_)
+            break;
+    }
+}
+
+// Returns the CPUs this process may run on, optionally restricted to a NUMA
+// node; empty if they cannot be determined
+std::vector<int> ThreadPool::GetAllowedCpus(int numaNode)
+{
+    std::vector<int> cpus;
+#ifdef _WIN32
+    ULONGLONG mask = 0;
+    if (numaNode >= 0)
+    {
+        if (!GetNumaNodeProcessorMask(static_cast<UCHAR>(numaNode), &mask))
+            mask = 0;
+    }
+    else
+    {
+        DWORD_PTR processMask, systemMask;
+        if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+            mask = processMask;
+    }
+    for (int cpu = 0; cpu < 64; ++cpu)
+        if (mask & (1ULL << cpu))
+            cpus.push_back(cpu);
+#elif defined(__linux__)
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return cpus;
+    if (numaNode < 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            if (CPU_ISSET(cpu, &allowed))
+                cpus.push_back(cpu);
+        return cpus;
+    }
+
+    // The node's CPU list is a comma-separated list of ranges, e.g. "0-7,16"
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", numaNode);
+    FILE* file = fopen(path, "r");
+    if (!file)
+        return cpus;
+    int first, last;
+    while (fscanf(file, "%d", &first) == 1)
+    {
+        last = first;
+        int c = fgetc(file);
+        if (c == '-')
         {
-            std::unique_lock<std::mutex> lock(mx_);
-            cv_.wait(lock, [&]() { return abortFlag_ || !queue_.empty(); });
-            if (abortFlag_)
+            if (fscanf(file, "%d", &last) != 1)
                 break;
-            task = queue_.front();
-            queue_.pop_front();
+            c = fgetc(file);
         }
-        task->Execute();
-        task->Done();
+        for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu)
+            if (CPU_ISSET(cpu, &allowed))
+                cpus.push_back(cpu);
+        if (c != ',')
+            break;
     }
+    fclose(file);
+#else
+    (void)numaNode;
+#endif
+    return cpus;
+}
+
+bool ThreadPool::SetThreadAffinity(std::thread& thread, const std::vector<int>& cpus)
+{
+#ifdef _WIN32
+    DWORD_PTR mask = 0;
+    for (int cpu : cpus)
+        if (cpu < static_cast<int>(8 * sizeof(DWORD_PTR)))
+            mask |= static_cast<DWORD_PTR>(1) << cpu;
+    return mask != 0 && SetThreadAffinityMask(thread.native_handle(), mask) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+        CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) == 0;
+#else
+    // Not supported (macOS only offers affinity hints)
+    (void)thread;
+    (void)cpus;
+    return false;
+#endif
 }
@@ -5,6 +5,8 @@
 //-----------------------------------------------------------------------------
 // DESCRIPTION:   A class executing queued tasks on separate threads
 //                and scaling number of threads based on hardware.
+//                Each worker has its own queue; idle workers steal from
+//                the others.
 //
 // AUTHOR:        Tomas Hanak, tomas.hanak@teledyne.com, 03/03/2021
 //                Andrej Bencur, andrej.bencur@teledyne.com, 03/03/2021
@@ -24,8 +26,11 @@
 
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
+#include <cstddef>
 #include <deque>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <thread>
@@ -36,21 +41,65 @@ class Task;
 class ThreadPool final
 {
 public:
-    explicit ThreadPool();
+    // Where the worker threads run
+    struct Placement
+    {
+        // Pin each worker to one CPU (round-robin over the allowed CPUs);
+        // otherwise workers may run on any allowed CPU
+        bool pinToCores;
+        // Restrict workers to the CPUs of this NUMA node; -1 for any
+        int numaNode;
+
+        Placement() : pinToCores(false), numaNode(-1) {}
+
+        bool operator==(const Placement& other) const
+        { return pinToCores == other.pinToCores && numaNode == other.numaNode; }
+    };
+
+    // threadCount 0 means one thread per hardware thread (of the NUMA node,
+    // if one is given)
+    explicit ThreadPool(size_t threadCount = 0, const Placement& placement = Placement());
     ~ThreadPool();
 
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
     size_t GetSize() const;
+    const Placement& GetPlacement() const { return placement_; }
+    // False if the requested placement could not be applied to every worker
+    bool IsPlacementApplied() const { return placementApplied_; }
 
     void Execute(Task* task);
     void Execute(const std::vector<Task*>& tasks);
 
+    // Calls body(chunkBegin, chunkEnd) for consecutive chunks of at most
+    // grain indices covering [begin, end), on the pool's threads and the
+    // calling thread, and returns when all chunks are done. Safe to call from
+    // a pool thread. The first exception thrown by body is rethrown.
+    void ParallelFor(size_t begin, size_t end, size_t grain,
+        const std::function<void(size_t, size_t)>& body);
+
 private:
-    void ThreadFunc();
+    struct Worker
+    {
+        std::mutex mx{};
+        std::condition_variable cv{};
+        std::deque<std::function<void()>> queue{}; // Guarded by mx
+        std::thread thread{};
+    };
+
+    void Push(size_t workerIndex, std::function<void()>&& job);
+    bool Pop(size_t workerIndex, std::function<void()>& job);
+    bool Steal(size_t thiefIndex, std::function<void()>& job);
+    void ThreadFunc(size_t workerIndex);
+
+    static std::vector<int> GetAllowedCpus(int numaNode);
+    static bool SetThreadAffinity(std::thread& thread, const std::vector<int>& cpus);
 
 private:
-    std::vector<std::unique_ptr<std::thread>> threads_{};
-    bool abortFlag_{ false };
-    std::mutex mx_{};
-    std::condition_variable cv_{};
-    std::deque<Task*> queue_{};
+    const Placement placement_;
+    std::vector<std::unique_ptr<Worker>> workers_{};
+    std::atomic<bool> abortFlag_{ false };
+    std::atomic<size_t> nextWorker_{ 0 };
+    bool placementApplied_{ true };
 };
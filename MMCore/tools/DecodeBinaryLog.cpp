@@ -0,0 +1,73 @@
+///////////////////////////////////////////////////////////////////////////////
+// FILE:          DecodeBinaryLog.cpp
+// PROJECT:       Micro-Manager
+// SUBSYSTEM:     MMCore
+//-----------------------------------------------------------------------------
+// DESCRIPTION:   Renders binary log files in the text log format
+//
+// COPYRIGHT:     University of California, San Francisco, 2026
+//
+// LICENSE:       This file is distributed under the "Lesser GPL" (LGPL) license.
+//                License text is included with the source distribution.
+//
+//                This file is distributed in the hope that it will be useful,
+//                but WITHOUT ANY WARRANTY; without even the implied warranty
+//                of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+//
+//                IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+//                CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+//                INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES.
+
+// Renders binary log files written by startSecondaryBinaryLogFile() in the
+// text format of the regular log files.
+//
+// Usage: DecodeBinaryLog file...
+//
+// The files are decoded in the order given and written to standard output;
+// for a rotated set, list the oldest first (e.g. log.bin.2 log.bin.1
+// log.bin). A truncated last record, as left by a crash, is reported and
+// ends decoding of that file.
+
+#include "Logging/BinaryLog.h"
+
+#include <fstream>
+#include <iostream>
+
+using namespace mm::logging;
+
+
+int main(int argc, char** argv)
+{
+   if (argc < 2)
+   {
+      std::cerr << "Usage: " << argv[0] << " file...\n";
+      return 2;
+   }
+
+   int ret = 0;
+   for (int i = 1; i < argc; ++i)
+   {
+      std::ifstream file(argv[i], std::ios_base::in | std::ios_base::binary);
+      if (!file)
+      {
+         std::cerr << argv[i] << ": cannot open file\n";
+         ret = 1;
+         continue;
+      }
+
+      try
+      {
+         BinaryLogReader reader(file);
+         BinaryLogReader::Entry entry;
+         while (reader.ReadEntry(entry))
+            FormatBinaryLogEntry(std::cout, entry);
+      }
+      catch (const BadBinaryLogException& e)
+      {
+         std::cout.flush();
+         std::cerr << argv[i] << ": " << e.what() << '\n';
+         ret = 1;
+      }
+   }
+   return ret;
+}
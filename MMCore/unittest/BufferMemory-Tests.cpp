@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+
+#include "BufferMemory.h"
+#include "CircularBuffer.h"
+#include "MMCore.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+TEST(BufferMemoryTests, DefaultAllocationIsUsable)
+{
+   mm::BufferMemory memory(3 << 20, mm::BufferMemoryOptions());
+   ASSERT_NE(nullptr, memory.Get());
+   EXPECT_EQ(3u << 20, memory.Size());
+   EXPECT_EQ(mm::HugePagesNone, memory.GetHugePages());
+   EXPECT_FALSE(memory.IsLocked());
+   EXPECT_EQ(-1, memory.GetNumaNode());
+   EXPECT_FALSE(memory.IsPrefaulted());
+   EXPECT_EQ("3 MB, standard pages", memory.Describe());
+
+   std::memset(memory.Get(), 0x5a, memory.Size());
+   EXPECT_EQ(0x5a, memory.Get()[memory.Size() - 1]);
+}
+
+TEST(BufferMemoryTests, UnavailableOptionsAreReported)
+{
+   // Whether these can be applied depends on the system; either way the
+   // memory must be usable and the description must say what was obtained
+   mm::BufferMemoryOptions options;
+   options.hugePages = mm::HugePagesExplicit;
+   options.lock = true;
+   options.numaNode = 0;
+   options.prefault = true;
+   mm::BufferMemory memory(1 << 20, options);
+   ASSERT_NE(nullptr, memory.Get());
+   EXPECT_TRUE(memory.IsPrefaulted());
+   memory.Get()[0] = 1;
+   memory.Get()[memory.Size() - 1] = 2;
+
+   const std::string desc = memory.Describe();
+   EXPECT_NE(std::string::npos, desc.find("prefaulted"));
+   if (memory.GetHugePages() == mm::HugePagesNone)
+   {
+      EXPECT_NE(std::string::npos, desc.find("huge pages unavailable"));
+   }
+   if (!memory.IsLocked())
+   {
+      EXPECT_NE(std::string::npos, desc.find("lock failed"));
+   }
+   if (memory.GetNumaNode() < 0)
+   {
+      EXPECT_NE(std::string::npos, desc.find("not bound to NUMA node 0"));
+   }
+}
+
+TEST(BufferMemoryTests, SystemQueries)
+{
+   EXPECT_GT(mm::BufferMemory::GetPhysicalMemoryBytes(), 0u);
+   EXPECT_GE(mm::BufferMemory::GetNumaNodeCount(), 1);
+}
+
+TEST(BufferMemoryTests, CircularBufferSlotsShareOneAllocation)
+{
+   CircularBuffer cb(1);
+   EXPECT_EQ("Not allocated", cb.GetMemoryDescription());
+   ASSERT_TRUE(cb.Initialize(2, 64, 64, 2));
+   EXPECT_EQ("1 MB, standard pages", cb.GetMemoryDescription());
+
+   Metadata md;
+   md.put("Camera", "Cam");
+   std::vector<unsigned char> frame(2 * 64 * 64 * 2);
+   ASSERT_TRUE(cb.InsertMultiChannel(&frame[0], 2, 64, 64, 2, &md));
+   ASSERT_TRUE(cb.InsertMultiChannel(&frame[0], 2, 64, 64, 2, &md));
+   const unsigned char* first = cb.GetNthFromTopImageBuffer(1, 0)->GetPixels();
+   EXPECT_EQ(first + 64 * 64 * 2, cb.GetNthFromTopImageBuffer(1, 1)->GetPixels());
+   EXPECT_EQ(first + 2 * 64 * 64 * 2, cb.GetNthFromTopImageBuffer(0, 0)->GetPixels());
+
+   // New options reallocate the buffer even though the image size is the same
+   mm::BufferMemoryOptions options;
+   options.prefault = true;
+   cb.SetMemoryOptions(options);
+   ASSERT_TRUE(cb.Initialize(2, 64, 64, 2));
+   EXPECT_EQ(0u, cb.GetRemainingImageCount());
+   EXPECT_NE(std::string::npos, cb.GetMemoryDescription().find("prefaulted"));
+}
+
+TEST(BufferMemoryTests, CorePropertiesSelectOptions)
+{
+   CMMCore core;
+   EXPECT_EQ("None", core.getProperty("Core", "BufferHugePages"));
+   EXPECT_TRUE(core.isPropertyReadOnly("Core", "BufferAllocation"));
+   EXPECT_EQ("Not allocated", core.getProperty("Core", "BufferAllocation"));
+   EXPECT_THROW(core.setProperty("Core", "BufferHugePages", "Gigantic"), CMMError);
+   EXPECT_THROW(core.setProperty("Core", "BufferAllocation", "1 MB"), CMMError);
+
+   // Without a camera, the options take effect when the buffer is next
+   // initialized
+   core.setProperty("Core", "BufferPrefault", "1");
+   core.setProperty("Core", "BufferNUMANode", "Any");
+   EXPECT_EQ("1", core.getProperty("Core", "BufferPrefault"));
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
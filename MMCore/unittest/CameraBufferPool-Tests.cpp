@@ -0,0 +1,152 @@
+#include <gtest/gtest.h>
+
+#include "CameraBufferPool.h"
+#include "CircularBuffer.h"
+
+#include <vector>
+
+
+namespace {
+
+const unsigned long long bytesInMB = 1 << 20;
+
+// The Core always adds the camera label before inserting an image
+Metadata CameraMetadata(const char* label)
+{
+   Metadata md;
+   md.put("Camera", label);
+   return md;
+}
+
+} // anonymous namespace
+
+
+TEST(CameraBufferPoolTests, NoBuffersUntilInitialized)
+{
+   mm::CameraBufferPool pool(16);
+   ASSERT_FALSE(pool.HasBuffers());
+   ASSERT_FALSE(pool.Find("Camera"));
+
+   pool.RegisterDemand("Camera", 1, 512, 512, 2);
+   ASSERT_FALSE(pool.HasBuffers());
+   ASSERT_TRUE(pool.GetCameraLabels().empty());
+}
+
+
+TEST(CameraBufferPoolTests, CamerasWithDifferentSizesStreamTogether)
+{
+   mm::CameraBufferPool pool(16);
+   pool.RegisterDemand("Small", 1, 256, 256, 1);
+   pool.RegisterDemand("Large", 1, 512, 512, 2);
+
+   ASSERT_TRUE(pool.Initialize("Small", 1, 256, 256, 1));
+   pool.SetStreaming("Small", true);
+   ASSERT_TRUE(pool.Initialize("Large", 1, 512, 512, 2));
+   pool.SetStreaming("Large", true);
+
+   std::shared_ptr<CircularBuffer> small = pool.Find("Small");
+   std::shared_ptr<CircularBuffer> large = pool.Find("Large");
+   ASSERT_TRUE(small && large);
+   ASSERT_NE(small, large);
+
+   // Memory is divided by frame size: same number of images each
+   ASSERT_EQ(small->GetSize(), large->GetSize());
+   ASSERT_LE(small->GetMemorySizeBytes() + large->GetMemorySizeBytes(),
+         16 * bytesInMB);
+
+   std::vector<unsigned char> smallImage(256 * 256, 1);
+   std::vector<unsigned char> largeImage(512 * 512 * 2, 2);
+   Metadata smallMd = CameraMetadata("Small");
+   Metadata largeMd = CameraMetadata("Large");
+   ASSERT_TRUE(small->InsertImage(&smallImage[0], 256, 256, 1, &smallMd));
+   ASSERT_TRUE(large->InsertImage(&largeImage[0], 512, 512, 2, &largeMd));
+   ASSERT_EQ(1u, small->GetRemainingImageCount());
+   ASSERT_EQ(1u, large->GetRemainingImageCount());
+   ASSERT_EQ(2, large->GetTopImageBuffer(0)->GetPixels()[0]);
+
+   std::vector<std::string> labels = pool.GetCameraLabels();
+   ASSERT_EQ(2u, labels.size());
+}
+
+
+TEST(CameraBufferPoolTests, BusyBufferKeepsItsMemory)
+{
+   mm::CameraBufferPool pool(4);
+
+   // Started alone, the first camera takes the whole footprint
+   ASSERT_TRUE(pool.Initialize("A", 1, 512, 512, 1));
+   pool.SetStreaming("A", true);
+   ASSERT_EQ(16u, pool.Find("A")->GetSize());
+
+   ASSERT_FALSE(pool.Initialize("B", 1, 512, 512, 1));
+
+   // Once idle and empty, its memory goes to the camera that needs it
+   pool.SetStreaming("A", false);
+   ASSERT_TRUE(pool.Initialize("B", 1, 512, 512, 1));
+   ASSERT_FALSE(pool.Find("A"));
+   ASSERT_EQ(8u, pool.Find("B")->GetSize());
+}
+
+
+TEST(CameraBufferPoolTests, UnreadImagesKeepBufferAlive)
+{
+   mm::CameraBufferPool pool(4);
+   ASSERT_TRUE(pool.Initialize("A", 1, 512, 512, 1));
+   std::vector<unsigned char> image(512 * 512);
+   Metadata md = CameraMetadata("A");
+   ASSERT_TRUE(pool.Find("A")->InsertImage(&image[0], 512, 512, 1, &md));
+
+   ASSERT_FALSE(pool.Initialize("B", 1, 256, 256, 1));
+   ASSERT_TRUE(pool.Find("A"));
+   ASSERT_EQ(1u, pool.Find("A")->GetRemainingImageCount());
+}
+
+
+TEST(CameraBufferPoolTests, HandleOutlivesRelease)
+{
+   mm::CameraBufferPool pool(4);
+   pool.RegisterDemand("B", 1, 64, 64, 1);
+   ASSERT_TRUE(pool.Initialize("A", 1, 64, 64, 1));
+   std::shared_ptr<CircularBuffer> buffer = pool.Find("A");
+   std::vector<unsigned char> image(64 * 64, 7);
+   Metadata md = CameraMetadata("A");
+   ASSERT_TRUE(buffer->InsertImage(&image[0], 64, 64, 1, &md));
+
+   ImageHandle handle = buffer->GetNextImageHandle(0);
+   ASSERT_TRUE(handle.isValid());
+   ASSERT_EQ(1u, pool.GetPinnedImageCount());
+
+   // Pinned buffers are not released for other cameras
+   ASSERT_TRUE(pool.Initialize("B", 1, 64, 64, 1));
+   ASSERT_EQ(buffer, pool.Find("A"));
+   ASSERT_EQ(7, static_cast<unsigned char*>(handle.getPixels())[0]);
+
+   handle.release();
+   ASSERT_EQ(0u, pool.GetPinnedImageCount());
+   pool.Reset();
+   ASSERT_FALSE(pool.HasBuffers());
+   ASSERT_FALSE(pool.Find("A"));
+}
+
+
+TEST(CameraBufferPoolTests, ReinitializeResizesBuffer)
+{
+   mm::CameraBufferPool pool(4);
+   ASSERT_TRUE(pool.Initialize("A", 1, 512, 512, 1));
+   ASSERT_EQ(16u, pool.Find("A")->GetSize());
+
+   ASSERT_TRUE(pool.Initialize("A", 1, 512, 512, 2));
+   ASSERT_EQ(8u, pool.Find("A")->GetSize());
+
+   pool.SetMemorySizeMB(8);
+   ASSERT_TRUE(pool.Initialize("A", 1, 512, 512, 2));
+   ASSERT_EQ(16u, pool.Find("A")->GetSize());
+
+   ASSERT_FALSE(pool.Initialize("A", 1, 0, 512, 2));
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -0,0 +1,115 @@
+// Insert latency of the circular buffer while other threads poll it, in the
+// default (locked) and lock-free modes.
+//
+// Usage: CircularBuffer-Bench [imageCount [width]]
+//
+// Not run by "make check"; build with "make CircularBuffer-Bench".
+
+#include "CircularBuffer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+
+namespace {
+
+struct LatencyStats
+{
+   double p50;
+   double p99;
+   double p999;
+   double max;
+   long overflows;
+};
+
+LatencyStats RunInserts(bool lockFree, unsigned readerCount, long imageCount,
+      unsigned width)
+{
+   CircularBuffer cb(64);
+   cb.EnableLockFree(lockFree);
+   cb.Initialize(1, width, width, 1);
+
+   std::atomic<bool> done(false);
+   std::vector<std::thread> readers;
+   for (unsigned r = 0; r < readerCount; ++r)
+   {
+      // Poll the way an acquisition engine and a live display do
+      readers.emplace_back([&cb, &done]() {
+         while (!done)
+         {
+            if (cb.GetRemainingImageCount() > 0)
+            {
+               cb.GetTopImage();
+               cb.GetNextImage();
+            }
+         }
+      });
+   }
+
+   Metadata md;
+   md.put("Camera", "Bench");
+   std::vector<unsigned char> pixels(width * width, 1);
+   std::vector<double> latencies;
+   latencies.reserve(imageCount);
+   long overflows = 0;
+
+   for (long i = 0; i < imageCount; ++i)
+   {
+      auto start = std::chrono::steady_clock::now();
+      bool inserted = cb.InsertImage(&pixels[0], width, width, 1, &md);
+      auto end = std::chrono::steady_clock::now();
+      if (!inserted)
+      {
+         ++overflows;
+         cb.Clear();
+         continue;
+      }
+      latencies.push_back(
+            std::chrono::duration<double, std::micro>(end - start).count());
+   }
+
+   done = true;
+   for (size_t r = 0; r < readers.size(); ++r)
+      readers[r].join();
+
+   std::sort(latencies.begin(), latencies.end());
+   LatencyStats stats;
+   stats.p50 = latencies[latencies.size() / 2];
+   stats.p99 = latencies[latencies.size() * 99 / 100];
+   stats.p999 = latencies[latencies.size() * 999 / 1000];
+   stats.max = latencies.back();
+   stats.overflows = overflows;
+   return stats;
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+   long imageCount = argc > 1 ? std::atol(argv[1]) : 200000;
+   unsigned width = argc > 2 ? (unsigned)std::atoi(argv[2]) : 64;
+
+   std::printf("%ld inserts of %ux%u 8-bit images; latencies in us\n",
+         imageCount, width, width);
+   std::printf("%-10s %7s %9s %9s %9s %9s %9s\n",
+         "mode", "readers", "p50", "p99", "p99.9", "max", "overflows");
+
+   const unsigned readerCounts[] = { 0, 1, 2, 4 };
+   for (int lockFree = 0; lockFree <= 1; ++lockFree)
+   {
+      for (unsigned readerCount : readerCounts)
+      {
+         LatencyStats stats = RunInserts(lockFree != 0, readerCount,
+               imageCount, width);
+         std::printf("%-10s %7u %9.2f %9.2f %9.2f %9.2f %9ld\n",
+               lockFree ? "lock-free" : "locked", readerCount,
+               stats.p50, stats.p99, stats.p999, stats.max, stats.overflows);
+      }
+   }
+   return 0;
+}
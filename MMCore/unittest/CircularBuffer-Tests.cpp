@@ -0,0 +1,645 @@
+#include <gtest/gtest.h>
+
+#include "CircularBuffer.h"
+#include "StreamingCopy.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+TEST(CircularBufferTests, SlotCommitIsVisibleToReader)
+{
+   CircularBuffer cb(1);
+   ASSERT_TRUE(cb.Initialize(1, 4, 4, 1));
+
+   unsigned char* slot = cb.AcquireSlot(4, 4, 1, 1);
+   ASSERT_NE(nullptr, slot);
+   EXPECT_EQ(0u, cb.GetRemainingImageCount());
+   std::memset(slot, 42, 16);
+
+   Metadata md;
+   md.put("Camera", "Cam");
+   ASSERT_TRUE(cb.CommitSlot(&md));
+   EXPECT_EQ(1u, cb.GetRemainingImageCount());
+
+   const mm::ImgBuffer* img = cb.GetNextImageBuffer(0);
+   ASSERT_NE(nullptr, img);
+   EXPECT_EQ(42, img->GetPixels()[15]);
+   EXPECT_EQ("Cam", img->GetMetadata().GetSingleTag("Camera").GetValue());
+   EXPECT_EQ("0", img->GetMetadata().GetSingleTag(
+            MM::g_Keyword_Metadata_ImageNumber).GetValue());
+}
+
+TEST(CircularBufferTests, DiscardedSlotIsNotPublished)
+{
+   CircularBuffer cb(1);
+   ASSERT_TRUE(cb.Initialize(1, 4, 4, 1));
+
+   Metadata md;
+   md.put("Camera", "Cam");
+
+   ASSERT_NE(nullptr, cb.AcquireSlot(4, 4, 1, 1));
+   cb.DiscardSlot();
+   EXPECT_EQ(0u, cb.GetRemainingImageCount());
+   EXPECT_FALSE(cb.CommitSlot(&md));
+
+   // The insert lock must have been released
+   const unsigned char pixels[16] = { 0 };
+   EXPECT_TRUE(cb.InsertImage(pixels, 4, 4, 1, &md));
+}
+
+TEST(CircularBufferTests, SlotRejectsIncompatibleImage)
+{
+   CircularBuffer cb(1);
+   ASSERT_TRUE(cb.Initialize(1, 4, 4, 1));
+   EXPECT_THROW(cb.AcquireSlot(8, 4, 1, 1), CMMError);
+   EXPECT_NE(nullptr, cb.AcquireSlot(4, 4, 1, 1));
+   cb.DiscardSlot();
+}
+
+TEST(CircularBufferTests, SlotReturnsNullWhenFull)
+{
+   CircularBuffer cb(1);
+   ASSERT_TRUE(cb.Initialize(1, 1024, 1024, 1));
+   ASSERT_EQ(1u, cb.GetSize());
+
+   Metadata md;
+   md.put("Camera", "Cam");
+   ASSERT_NE(nullptr, cb.AcquireSlot(1024, 1024, 1, 1));
+   ASSERT_TRUE(cb.CommitSlot(&md));
+   EXPECT_EQ(nullptr, cb.AcquireSlot(1024, 1024, 1, 1));
+   EXPECT_TRUE(cb.Overflow());
+}
+
+TEST(CircularBufferTests, PinnedSlotIsNotOverwritten)
+{
+   CircularBuffer cb(1);
+   ASSERT_TRUE(cb.Initialize(1, 1024, 512, 1));
+   ASSERT_EQ(2u, cb.GetSize());
+
+   Metadata md;
+   md.put("Camera", "Cam");
+   std::vector<unsigned char> pixels(1024 * 512, 1);
+   ASSERT_TRUE(cb.InsertImage(pixels.data(), 1024, 512, 1, &md));
+
+   ImageHandle handle = cb.GetNextImageHandle(0);
+   ASSERT_TRUE(handle.isValid());
+   EXPECT_EQ(1u, cb.GetPinnedImageCount());
+   EXPECT_EQ(0u, cb.GetRemainingImageCount());
+
+   // The other slot is free; the next one after it is pinned
+   pixels.assign(pixels.size(), 2);
+   ASSERT_TRUE(cb.InsertImage(pixels.data(), 1024, 512, 1, &md));
+   ASSERT_TRUE(cb.GetNextImageBuffer(0) != nullptr);
+   EXPECT_FALSE(cb.InsertImage(pixels.data(), 1024, 512, 1, &md));
+   EXPECT_EQ(1, static_cast<const unsigned char*>(handle.getPixels())[0]);
+
+   // Handles are not invalidated by reinitialization attempts
+   EXPECT_FALSE(cb.Initialize(1, 512, 512, 1));
+
+   ImageHandle copy = handle;
+   handle.release();
+   EXPECT_FALSE(handle.isValid());
+   EXPECT_EQ(1u, cb.GetPinnedImageCount());
+   copy.release();
+   EXPECT_EQ(0u, cb.GetPinnedImageCount());
+   EXPECT_TRUE(cb.InsertImage(pixels.data(), 1024, 512, 1, &md));
+}
+
+TEST(CircularBufferTests, HandleToEmptyBufferIsInvalid)
+{
+   CircularBuffer cb(1);
+   ASSERT_TRUE(cb.Initialize(1, 4, 4, 1));
+   EXPECT_FALSE(cb.GetNextImageHandle(0).isValid());
+   EXPECT_FALSE(cb.GetTopImageHandle(0).isValid());
+   EXPECT_THROW(cb.GetTopImageHandle(0).getPixels(), CMMError);
+}
+
+TEST(CircularBufferTests, LockFreeModeKeepsOrderAndPins)
+{
+   CircularBuffer cb(1);
+   cb.EnableLockFree(true);
+   ASSERT_TRUE(cb.Initialize(1, 1024, 512, 1));
+   ASSERT_EQ(2u, cb.GetSize());
+
+   Metadata md;
+   md.put("Camera", "Cam");
+   std::vector<unsigned char> pixels(1024 * 512, 1);
+   ASSERT_TRUE(cb.InsertImage(pixels.data(), 1024, 512, 1, &md));
+   pixels.assign(pixels.size(), 2);
+   ASSERT_TRUE(cb.InsertImage(pixels.data(), 1024, 512, 1, &md));
+   EXPECT_FALSE(cb.InsertImage(pixels.data(), 1024, 512, 1, &md));
+   EXPECT_EQ(2u, cb.GetRemainingImageCount());
+   EXPECT_EQ(0u, cb.GetFreeSize());
+   EXPECT_EQ(2, cb.GetTopImage()[0]);
+
+   ImageHandle handle = cb.GetNextImageHandle(0);
+   ASSERT_TRUE(handle.isValid());
+   EXPECT_EQ(1, static_cast<const unsigned char*>(handle.getPixels())[0]);
+   EXPECT_EQ(2, cb.GetNextImage()[0]);
+   EXPECT_EQ(nullptr, cb.GetNextImage());
+
+   // The next slot is pinned, and survives a clear
+   pixels.assign(pixels.size(), 3);
+   EXPECT_FALSE(cb.InsertImage(pixels.data(), 1024, 512, 1, &md));
+   cb.Clear();
+   ASSERT_TRUE(cb.InsertImage(pixels.data(), 1024, 512, 1, &md));
+   EXPECT_EQ(1, static_cast<const unsigned char*>(handle.getPixels())[0]);
+   EXPECT_EQ(3, cb.GetNextImage()[0]);
+}
+
+TEST(CircularBufferTests, LockFreeReadersSeeEachImageOnce)
+{
+   CircularBuffer cb(1);
+   cb.EnableLockFree(true);
+   ASSERT_TRUE(cb.Initialize(1, 64, 64, 1));
+
+   const long imageCount = 20000;
+   std::atomic<bool> done(false);
+   std::vector<std::vector<long> > seen(3);
+   std::vector<std::thread> readers;
+   for (size_t r = 0; r < seen.size(); ++r)
+   {
+      readers.emplace_back([&cb, &done, &seen, r]() {
+         for (;;)
+         {
+            bool finished = done;
+            ImageHandle handle = cb.GetNextImageHandle(0);
+            if (!handle.isValid())
+            {
+               if (finished)
+                  return;
+               cb.GetTopImageHandle(0);
+               continue;
+            }
+            long number = std::atol(handle.getMetadata().GetSingleTag(
+                     MM::g_Keyword_Metadata_ImageNumber).GetValue().c_str());
+            // Pixels are written before publication
+            EXPECT_EQ(static_cast<unsigned char>(number),
+                  static_cast<const unsigned char*>(handle.getPixels())[4095]);
+            seen[r].push_back(number);
+         }
+      });
+   }
+
+   Metadata md;
+   md.put("Camera", "Cam");
+   std::vector<unsigned char> pixels(64 * 64);
+   long inserted = 0;
+   while (inserted < imageCount)
+   {
+      pixels.assign(pixels.size(), static_cast<unsigned char>(inserted));
+      if (cb.InsertImage(pixels.data(), 64, 64, 1, &md))
+         ++inserted;
+      else
+         std::this_thread::yield();
+   }
+   done = true;
+   for (size_t r = 0; r < readers.size(); ++r)
+      readers[r].join();
+
+   std::set<long> all;
+   size_t total = 0;
+   for (size_t r = 0; r < seen.size(); ++r)
+   {
+      total += seen[r].size();
+      for (size_t i = 1; i < seen[r].size(); ++i)
+         EXPECT_LT(seen[r][i - 1], seen[r][i]);
+      all.insert(seen[r].begin(), seen[r].end());
+   }
+   EXPECT_EQ(static_cast<size_t>(imageCount), total);
+   EXPECT_EQ(static_cast<size_t>(imageCount), all.size());
+   EXPECT_EQ(0u, cb.GetPinnedImageCount());
+}
+
+TEST(CircularBufferTests, VariableSizeFramesCoexist)
+{
+   CircularBuffer cb(1);
+   cb.EnableVariableSizeFrames(true);
+   ASSERT_TRUE(cb.Initialize(1, 512, 512, 1));
+   EXPECT_EQ(4u, cb.GetSize());
+   EXPECT_EQ(1024u * 1024u, cb.GetSizeBytes());
+
+   Metadata md;
+   md.put("Camera", "Cam");
+   std::vector<unsigned char> large(512 * 512, 1);
+   std::vector<unsigned char> small(64 * 64 * 2, 2);
+   std::vector<unsigned char> twoChannels(2 * 128 * 128, 3);
+   twoChannels[128 * 128] = 4;
+   ASSERT_TRUE(cb.InsertImage(&large[0], 512, 512, 1, &md));
+   ASSERT_TRUE(cb.InsertImage(&small[0], 64, 64, 2, &md));
+   ASSERT_TRUE(cb.InsertMultiChannel(&twoChannels[0], 2, 128, 128, 1, &md));
+   EXPECT_EQ(1024u * 1024u - 512u * 512u - 64u * 64u * 2u - 2u * 128u * 128u,
+         cb.GetFreeSizeBytes());
+
+   // A new image size does not discard the images already in the buffer
+   ASSERT_TRUE(cb.Initialize(1, 256, 256, 2));
+   EXPECT_EQ(3u, cb.GetRemainingImageCount());
+   EXPECT_EQ(8u, cb.GetSize());
+
+   const mm::ImgBuffer* img = cb.GetNextImageBuffer(0);
+   ASSERT_NE(nullptr, img);
+   EXPECT_EQ(512u, img->Width());
+   EXPECT_EQ(1, img->GetPixels()[512 * 512 - 1]);
+   img = cb.GetNextImageBuffer(0);
+   ASSERT_NE(nullptr, img);
+   EXPECT_EQ(64u, img->Height());
+   EXPECT_EQ(2u, img->Depth());
+   EXPECT_EQ(2, img->GetPixels()[64 * 64 * 2 - 1]);
+   ASSERT_NE(nullptr, cb.GetNthFromTopImageBuffer(0, 1));
+   EXPECT_EQ(4, cb.GetNthFromTopImageBuffer(0, 1)->GetPixels()[0]);
+   EXPECT_EQ(3, cb.GetNthFromTopImageBuffer(0, 0)->GetPixels()[0]);
+}
+
+TEST(CircularBufferTests, VariableSizeCapacityIsShared)
+{
+   CircularBuffer cb(1);
+   cb.EnableVariableSizeFrames(true);
+   ASSERT_TRUE(cb.Initialize(1, 512, 512, 1));
+
+   Metadata md;
+   md.put("Camera", "Cam");
+   std::vector<unsigned char> quarter(512 * 512);
+   std::vector<unsigned char> half(512 * 1024);
+   for (int i = 0; i < 3; ++i)
+      ASSERT_TRUE(cb.InsertImage(&quarter[0], 512, 512, 1, &md));
+   EXPECT_EQ(1u, cb.GetFreeSize());
+   EXPECT_EQ(512u * 512u, cb.GetFreeSizeBytes());
+
+   EXPECT_FALSE(cb.InsertImage(&half[0], 1024, 512, 1, &md));
+   EXPECT_TRUE(cb.Overflow());
+   ASSERT_TRUE(cb.InsertImage(&quarter[0], 512, 512, 1, &md));
+   EXPECT_EQ(0u, cb.GetFreeSizeBytes());
+
+   // Reading the two oldest images makes room for a frame twice their size
+   ASSERT_NE(nullptr, cb.GetNextImage());
+   EXPECT_FALSE(cb.InsertImage(&half[0], 1024, 512, 1, &md));
+   ASSERT_NE(nullptr, cb.GetNextImage());
+   ASSERT_TRUE(cb.InsertImage(&half[0], 1024, 512, 1, &md));
+   EXPECT_EQ(3u, cb.GetRemainingImageCount());
+   EXPECT_EQ(0u, cb.GetFreeSizeBytes());
+}
+
+TEST(CircularBufferTests, PinnedVariableSizeFrameIsNotOverwritten)
+{
+   CircularBuffer cb(1);
+   cb.EnableVariableSizeFrames(true);
+   ASSERT_TRUE(cb.Initialize(1, 512, 512, 1));
+
+   Metadata md;
+   md.put("Camera", "Cam");
+   std::vector<unsigned char> image(512 * 512);
+   for (int i = 0; i < 4; ++i)
+   {
+      std::fill(image.begin(), image.end(), static_cast<unsigned char>(i));
+      ASSERT_TRUE(cb.InsertImage(&image[0], 512, 512, 1, &md));
+   }
+
+   ImageHandle handle = cb.GetNextImageHandle(0);
+   ASSERT_TRUE(handle.isValid());
+   while (cb.GetNextImage())
+      ;
+
+   // The oldest pixels in the arena are pinned
+   std::fill(image.begin(), image.end(), 9);
+   EXPECT_FALSE(cb.InsertImage(&image[0], 512, 512, 1, &md));
+   EXPECT_FALSE(cb.InsertImage(&image[0], 64, 64, 1, &md));
+
+   // Neither does a new image size reallocate the pinned memory
+   ASSERT_TRUE(cb.Initialize(1, 256, 256, 1));
+   EXPECT_EQ(0, static_cast<const unsigned char*>(handle.getPixels())[512 * 512 - 1]);
+
+   handle.release();
+   EXPECT_TRUE(cb.InsertImage(&image[0], 512, 512, 1, &md));
+   EXPECT_EQ(9, cb.GetTopImage()[0]);
+}
+
+TEST(CircularBufferTests, LockFreeVariableSizeFramesStayIntact)
+{
+   CircularBuffer cb(1);
+   cb.EnableLockFree(true);
+   cb.EnableVariableSizeFrames(true);
+   ASSERT_TRUE(cb.Initialize(1, 512, 64, 1));
+
+   const long imageCount = 20000;
+   std::atomic<bool> done(false);
+   std::atomic<long> seen(0);
+   std::vector<std::thread> readers;
+   for (int r = 0; r < 2; ++r)
+   {
+      readers.emplace_back([&cb, &done, &seen]() {
+         for (;;)
+         {
+            bool finished = done;
+            ImageHandle handle = cb.GetNextImageHandle(0);
+            if (!handle.isValid())
+            {
+               if (finished)
+                  return;
+               continue;
+            }
+            long number = std::atol(handle.getMetadata().GetSingleTag(
+                     MM::g_Keyword_Metadata_ImageNumber).GetValue().c_str());
+            const unsigned width = 64 + (number % 8) * 64;
+            const unsigned char* pixels =
+               static_cast<const unsigned char*>(handle.getPixels());
+            EXPECT_EQ(width, handle.getImageWidth());
+            EXPECT_EQ(static_cast<unsigned char>(number), pixels[0]);
+            EXPECT_EQ(static_cast<unsigned char>(number), pixels[width * 64 - 1]);
+            ++seen;
+         }
+      });
+   }
+
+   Metadata md;
+   md.put("Camera", "Cam");
+   std::vector<unsigned char> pixels(512 * 64);
+   long inserted = 0;
+   while (inserted < imageCount)
+   {
+      const unsigned width = 64 + (inserted % 8) * 64;
+      pixels.assign(pixels.size(), static_cast<unsigned char>(inserted));
+      if (cb.InsertImage(pixels.data(), width, 64, 1, &md))
+         ++inserted;
+      else
+         std::this_thread::yield();
+   }
+   done = true;
+   for (size_t r = 0; r < readers.size(); ++r)
+      readers[r].join();
+
+   EXPECT_EQ(imageCount, seen);
+   EXPECT_EQ(0u, cb.GetPinnedImageCount());
+}
+
+namespace {
+
+const char* const spillPath = "CircularBuffer-Tests-spill.dat";
+
+bool FileExists(const char* path)
+{
+   FILE* f = std::fopen(path, "rb");
+   if (f)
+      std::fclose(f);
+   return f != 0;
+}
+
+} // anonymous namespace
+
+TEST(CircularBufferTests, SpilledImagesComeBackInOrder)
+{
+   CircularBuffer cb(1);
+   ASSERT_TRUE(cb.Initialize(1, 512, 512, 1));
+   ASSERT_EQ(4u, cb.GetSize());
+   cb.EnableSpill(spillPath);
+   ASSERT_TRUE(FileExists(spillPath));
+
+   std::vector<unsigned char> pixels(512 * 512);
+   for (int i = 0; i < 10; ++i)
+   {
+      Metadata md;
+      md.put("Camera", "Cam");
+      md.put("Index", std::to_string(i));
+      pixels.assign(pixels.size(), static_cast<unsigned char>(i));
+      ASSERT_TRUE(cb.InsertImage(pixels.data(), 512, 512, 1, &md));
+   }
+   EXPECT_FALSE(cb.Overflow());
+   EXPECT_EQ(6u, cb.GetSpilledImageCount());
+   EXPECT_EQ(10u, cb.GetRemainingImageCount());
+
+   for (int i = 0; i < 10; ++i)
+   {
+      const mm::ImgBuffer* img = cb.GetNextImageBuffer(0);
+      ASSERT_NE(nullptr, img);
+      EXPECT_EQ(512u, img->Width());
+      EXPECT_EQ(i, img->GetPixels()[0]);
+      EXPECT_EQ(i, img->GetPixels()[512 * 512 - 1]);
+      EXPECT_EQ(std::to_string(i),
+            img->GetMetadata().GetSingleTag("Index").GetValue());
+   }
+   EXPECT_EQ(nullptr, cb.GetNextImageBuffer(0));
+   EXPECT_EQ(0u, cb.GetSpilledImageCount());
+
+   cb.DisableSpill();
+   EXPECT_FALSE(FileExists(spillPath));
+}
+
+TEST(CircularBufferTests, SpilledImageHandleOwnsItsPixels)
+{
+   CircularBuffer cb(1);
+   ASSERT_TRUE(cb.Initialize(1, 512, 512, 1));
+   cb.EnableSpill(spillPath);
+
+   Metadata md;
+   md.put("Camera", "Cam");
+   std::vector<unsigned char> pixels(512 * 512);
+   for (int i = 0; i < 6; ++i)
+   {
+      pixels.assign(pixels.size(), static_cast<unsigned char>(i + 1));
+      ASSERT_TRUE(cb.InsertImage(pixels.data(), 512, 512, 1, &md));
+   }
+
+   ImageHandle first = cb.GetNextImageHandle(0);
+   ImageHandle second = cb.GetNextImageHandle(0);
+   ASSERT_TRUE(first.isValid() && second.isValid());
+   EXPECT_EQ(0u, cb.GetPinnedImageCount());
+
+   // Spilled images remain valid while the buffer keeps filling
+   for (int i = 0; i < 8; ++i)
+      ASSERT_TRUE(cb.InsertImage(pixels.data(), 512, 512, 1, &md));
+   EXPECT_EQ(1, static_cast<const unsigned char*>(first.getPixels())[0]);
+   EXPECT_EQ(2, static_cast<const unsigned char*>(second.getPixels())[1000]);
+   EXPECT_EQ(1u, first.getNumberOfComponents());
+   EXPECT_EQ("GRAY8", first.getMetadata().GetSingleTag("PixelType").GetValue());
+}
+
+TEST(CircularBufferTests, ClearDropsSpilledImages)
+{
+   CircularBuffer cb(1);
+   ASSERT_TRUE(cb.Initialize(1, 512, 512, 1));
+   cb.EnableSpill(spillPath);
+
+   Metadata md;
+   md.put("Camera", "Cam");
+   std::vector<unsigned char> pixels(512 * 512, 7);
+   for (int i = 0; i < 9; ++i)
+      ASSERT_TRUE(cb.InsertImage(pixels.data(), 512, 512, 1, &md));
+   ASSERT_EQ(5u, cb.GetSpilledImageCount());
+
+   // Images already spilled remain readable after disabling
+   cb.DisableSpill();
+   EXPECT_TRUE(FileExists(spillPath));
+   EXPECT_FALSE(cb.InsertImage(pixels.data(), 512, 512, 1, &md));
+
+   cb.Clear();
+   EXPECT_EQ(0u, cb.GetSpilledImageCount());
+   EXPECT_EQ(0u, cb.GetRemainingImageCount());
+   EXPECT_EQ(nullptr, cb.GetNextImageBuffer(0));
+   EXPECT_FALSE(FileExists(spillPath));
+}
+
+TEST(CircularBufferTests, SpillFileIsReusedAsARing)
+{
+   CircularBuffer cb(1);
+   ASSERT_TRUE(cb.Initialize(1, 512, 512, 1));
+   ASSERT_EQ(4u, cb.GetSize());
+   // Room for 3 spilled images, with their metadata
+   cb.EnableSpill(spillPath, 3 * (512 * 512 + 4096));
+
+   Metadata md;
+   md.put("Camera", "Cam");
+   std::vector<unsigned char> pixels(512 * 512);
+   int inserted = 0;
+   for (; inserted < 6; ++inserted)
+   {
+      pixels.assign(pixels.size(), static_cast<unsigned char>(inserted));
+      ASSERT_TRUE(cb.InsertImage(pixels.data(), 512, 512, 1, &md));
+   }
+
+   // The reader stays 2 spilled images behind, so the file never empties
+   for (int read = 0; read < 50; ++read, ++inserted)
+   {
+      pixels.assign(pixels.size(), static_cast<unsigned char>(inserted));
+      ASSERT_TRUE(cb.InsertImage(pixels.data(), 512, 512, 1, &md));
+      ASSERT_EQ(3u, cb.GetSpilledImageCount());
+      const mm::ImgBuffer* img = cb.GetNextImageBuffer(0);
+      ASSERT_NE(nullptr, img);
+      EXPECT_EQ(read, img->GetPixels()[0]);
+      EXPECT_EQ(read, img->GetPixels()[512 * 512 - 1]);
+   }
+   EXPECT_FALSE(cb.Overflow());
+}
+
+TEST(CircularBufferTests, FullSpillFileOverflowsTheBuffer)
+{
+   CircularBuffer cb(1);
+   ASSERT_TRUE(cb.Initialize(1, 512, 512, 1));
+   cb.EnableSpill(spillPath, 2 * (512 * 512 + 4096));
+
+   Metadata md;
+   md.put("Camera", "Cam");
+   std::vector<unsigned char> pixels(512 * 512);
+   for (int i = 0; i < 6; ++i)
+      ASSERT_TRUE(cb.InsertImage(pixels.data(), 512, 512, 1, &md));
+   EXPECT_EQ(2u, cb.GetSpilledImageCount());
+
+   EXPECT_FALSE(cb.InsertImage(pixels.data(), 512, 512, 1, &md));
+   EXPECT_TRUE(cb.Overflow());
+   EXPECT_EQ(6u, cb.GetRemainingImageCount());
+}
+
+TEST(CircularBufferTests, SpilledImagesOutliveLaterReads)
+{
+   CircularBuffer cb(1);
+   ASSERT_TRUE(cb.Initialize(1, 512, 512, 1));
+   cb.EnableSpill(spillPath);
+
+   Metadata md;
+   md.put("Camera", "Cam");
+   std::vector<unsigned char> pixels(512 * 512);
+   for (int i = 0; i < 10; ++i)
+   {
+      pixels.assign(pixels.size(), static_cast<unsigned char>(i + 1));
+      ASSERT_TRUE(cb.InsertImage(pixels.data(), 512, 512, 1, &md));
+   }
+
+   const mm::ImgBuffer* first = cb.GetNextImageBuffer(0);
+   ASSERT_NE(nullptr, first);
+   for (int i = 0; i < 5; ++i)
+      ASSERT_NE(nullptr, cb.GetNextImageBuffer(0));
+   EXPECT_EQ(0u, cb.GetSpilledImageCount());
+   EXPECT_EQ(512u, first->Width());
+   EXPECT_EQ(1, first->GetPixels()[0]);
+   EXPECT_EQ(1, first->GetPixels()[512 * 512 - 1]);
+}
+
+TEST(CircularBufferTests, LockFreeSpillKeepsOrder)
+{
+   CircularBuffer cb(1);
+   cb.EnableLockFree(true);
+   cb.EnableVariableSizeFrames(true);
+   ASSERT_TRUE(cb.Initialize(1, 256, 256, 1));
+   cb.EnableSpill(spillPath);
+
+   const long imageCount = 2000;
+   std::atomic<bool> done(false);
+   std::vector<long> seen;
+   std::thread reader([&cb, &done, &seen]() {
+      for (;;)
+      {
+         bool finished = done;
+         ImageHandle handle = cb.GetNextImageHandle(0);
+         if (!handle.isValid())
+         {
+            if (finished)
+               return;
+            std::this_thread::yield();
+            continue;
+         }
+         long number = std::atol(handle.getMetadata().GetSingleTag(
+                  MM::g_Keyword_Metadata_ImageNumber).GetValue().c_str());
+         const unsigned char* p = static_cast<const unsigned char*>(handle.getPixels());
+         const size_t bytes = (size_t)handle.getImageWidth() * handle.getImageHeight();
+         EXPECT_EQ(static_cast<unsigned char>(number), p[0]);
+         EXPECT_EQ(static_cast<unsigned char>(number), p[bytes - 1]);
+         seen.push_back(number);
+      }
+   });
+
+   Metadata md;
+   md.put("Camera", "Cam");
+   std::vector<unsigned char> pixels(512 * 256);
+   for (long i = 0; i < imageCount; ++i)
+   {
+      // Alternate sizes, so that spilling frees varying amounts of memory
+      const unsigned height = (i % 2) ? 256 : 128;
+      pixels.assign(pixels.size(), static_cast<unsigned char>(i));
+      ASSERT_TRUE(cb.InsertImage(pixels.data(), 512, height, 1, &md));
+   }
+   done = true;
+   reader.join();
+
+   ASSERT_EQ(static_cast<size_t>(imageCount), seen.size());
+   for (size_t i = 0; i < seen.size(); ++i)
+      EXPECT_EQ(static_cast<long>(i), seen[i]);
+   EXPECT_EQ(0u, cb.GetSpilledImageCount());
+}
+
+TEST(CircularBufferTests, InsertedFramesAreCopiedExactlyWithStreamingStores)
+{
+   // Inserted frames are copied by the pool's tasks with CopyFrame(); make
+   // every frame use streaming stores, split into unevenly sized chunks
+   const size_t oldThreshold = mm::GetStreamingCopyThreshold();
+   mm::SetStreamingCopyThreshold(1);
+
+   CircularBuffer cb(16, std::make_shared<ThreadPool>(3));
+   const unsigned width = 1021, height = 1023;
+   ASSERT_TRUE(cb.Initialize(1, width, height, 2));
+
+   std::vector<unsigned char> pixels(width * height * 2);
+   for (size_t i = 0; i < pixels.size(); ++i)
+      pixels[i] = static_cast<unsigned char>(i * 7 + i / 251);
+   Metadata md;
+   md.put("Camera", "Cam");
+   ASSERT_TRUE(cb.InsertImage(pixels.data(), width, height, 2, &md));
+
+   const mm::ImgBuffer* img = cb.GetNextImageBuffer(0);
+   ASSERT_NE(nullptr, img);
+   EXPECT_EQ(0, std::memcmp(pixels.data(), img->GetPixels(), pixels.size()));
+
+   mm::SetStreamingCopyThreshold(oldThreshold);
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
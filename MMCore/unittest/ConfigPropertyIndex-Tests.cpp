@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+
+#include "ConfigGroup.h"
+#include "ConfigPropertyIndex.h"
+
+#include <string>
+#include <vector>
+
+
+TEST(ConfigPropertyIndexTests, FindsGroupsAndPixelSizeConfigs)
+{
+   ConfigGroupCollection groups;
+   PixelSizeConfigGroup pixelSizeGroup;
+   mm::ConfigPropertyIndex index(groups, pixelSizeGroup);
+
+   groups.Define("Channel", "DAPI", "Wheel", "State", "1");
+   groups.Define("Channel", "DAPI", "Shutter", "State", "0");
+   groups.Define("Channel", "FITC", "Wheel", "State", "2");
+   groups.Define("Binning", "1", "Camera", "Binning", "1"); // Single setting
+   groups.Define("Objective", "10x", "Turret", "State", "0");
+   groups.Define("Objective", "10x", "Wheel", "State", "0");
+   pixelSizeGroup.DefinePixelSize("Res10x", "Turret", "State", "0", 0.65);
+
+   std::vector<std::string> found;
+   bool inPixelSizeConfig = true;
+   ASSERT_TRUE(index.Find("Wheel", "State", found, inPixelSizeConfig));
+   ASSERT_EQ(2u, found.size());
+   EXPECT_EQ("Channel", found[0]);
+   EXPECT_EQ("Objective", found[1]);
+   EXPECT_FALSE(inPixelSizeConfig);
+
+   ASSERT_TRUE(index.Find("Turret", "State", found, inPixelSizeConfig));
+   ASSERT_EQ(1u, found.size());
+   EXPECT_EQ("Objective", found[0]);
+   EXPECT_TRUE(inPixelSizeConfig);
+
+   EXPECT_FALSE(index.Find("Camera", "Binning", found, inPixelSizeConfig));
+   EXPECT_TRUE(found.empty());
+   EXPECT_FALSE(index.Find("Wheel", "Label", found, inPixelSizeConfig));
+}
+
+TEST(ConfigPropertyIndexTests, FollowsChanges)
+{
+   ConfigGroupCollection groups;
+   PixelSizeConfigGroup pixelSizeGroup;
+   mm::ConfigPropertyIndex index(groups, pixelSizeGroup);
+
+   std::vector<std::string> found;
+   bool inPixelSizeConfig;
+   EXPECT_FALSE(index.Find("Wheel", "State", found, inPixelSizeConfig));
+
+   groups.Define("Channel", "DAPI", "Wheel", "State", "1");
+   groups.Define("Channel", "DAPI", "Shutter", "State", "0");
+   ASSERT_TRUE(index.Find("Wheel", "State", found, inPixelSizeConfig));
+   EXPECT_EQ("Channel", found[0]);
+
+   groups.RenameGroup("Channel", "Filter");
+   ASSERT_TRUE(index.Find("Wheel", "State", found, inPixelSizeConfig));
+   EXPECT_EQ("Filter", found[0]);
+
+   groups.RenameConfig("Filter", "DAPI", "Blue");
+   EXPECT_TRUE(index.Find("Wheel", "State", found, inPixelSizeConfig));
+
+   groups.Delete("Filter", "Blue", "Shutter", "State");
+   EXPECT_FALSE(index.Find("Wheel", "State", found, inPixelSizeConfig));
+
+   groups.Define("Filter", "Blue", "Shutter", "State", "0");
+   EXPECT_TRUE(index.Find("Wheel", "State", found, inPixelSizeConfig));
+   groups.Delete("Filter", "Blue");
+   EXPECT_FALSE(index.Find("Wheel", "State", found, inPixelSizeConfig));
+
+   groups.Define("Filter", "Blue", "Wheel", "State", "1");
+   groups.Define("Filter", "Blue", "Shutter", "State", "0");
+   EXPECT_TRUE(index.Find("Wheel", "State", found, inPixelSizeConfig));
+   groups.Delete("Filter");
+   EXPECT_FALSE(index.Find("Wheel", "State", found, inPixelSizeConfig));
+
+   pixelSizeGroup.DefinePixelSize("Res10x", "Turret", "State", "0", 0.65);
+   ASSERT_TRUE(index.Find("Turret", "State", found, inPixelSizeConfig));
+   EXPECT_TRUE(inPixelSizeConfig);
+   pixelSizeGroup.Rename("Res10x", "Res4x");
+   EXPECT_TRUE(index.Find("Turret", "State", found, inPixelSizeConfig));
+   pixelSizeGroup.Delete("Res4x");
+   EXPECT_FALSE(index.Find("Turret", "State", found, inPixelSizeConfig));
+
+   groups.Define("Channel", "DAPI", "Wheel", "State", "1");
+   groups.Define("Channel", "DAPI", "Shutter", "State", "0");
+   groups.Clear();
+   EXPECT_FALSE(index.Find("Wheel", "State", found, inPixelSizeConfig));
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
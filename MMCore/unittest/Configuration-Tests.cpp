@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+
+#include "Configuration.h"
+
+
+TEST(ConfigurationTests, AddsReplacesAndFindsSettings)
+{
+   Configuration config;
+   config.addSetting(PropertySetting("Wheel", "State", "1"));
+   config.addSetting(PropertySetting("Camera", "Binning", "2"));
+   config.addSetting(PropertySetting("Wheel", "State", "3")); // Replaces
+   ASSERT_EQ(2u, config.size());
+   EXPECT_EQ("3", config.getSetting(0).getPropertyValue());
+   EXPECT_EQ("Wheel-State", config.getSetting(0).getKey());
+
+   EXPECT_TRUE(config.isPropertyIncluded("Camera", "Binning"));
+   EXPECT_FALSE(config.isPropertyIncluded("Camera", "State"));
+   EXPECT_FALSE(config.isPropertyIncluded("NeverSeenDevice", "State"));
+   EXPECT_EQ("2", config.getSetting("Camera", "Binning").getPropertyValue());
+   EXPECT_THROW(config.getSetting("NeverSeenDevice", "State"), CMMError);
+   EXPECT_THROW(config.getSetting(2), CMMError);
+}
+
+TEST(ConfigurationTests, KeysDoNotCollideOnSeparator)
+{
+   // "A-B" + "C" and "A" + "B-C" have the same string key
+   Configuration config;
+   config.addSetting(PropertySetting("A-B", "C", "1"));
+   config.addSetting(PropertySetting("A", "B-C", "2"));
+   EXPECT_EQ(2u, config.size());
+   EXPECT_EQ("1", config.getSetting("A-B", "C").getPropertyValue());
+   EXPECT_EQ("2", config.getSetting("A", "B-C").getPropertyValue());
+}
+
+TEST(ConfigurationTests, DeletesSettings)
+{
+   Configuration config;
+   config.addSetting(PropertySetting("D1", "P", "1"));
+   config.addSetting(PropertySetting("D2", "P", "2"));
+   config.addSetting(PropertySetting("D3", "P", "3"));
+
+   config.deleteSetting("D1", "P");
+   ASSERT_EQ(2u, config.size());
+   EXPECT_FALSE(config.isPropertyIncluded("D1", "P"));
+   EXPECT_EQ("2", config.getSetting("D2", "P").getPropertyValue());
+   EXPECT_EQ("3", config.getSetting("D3", "P").getPropertyValue());
+   EXPECT_EQ("D3", config.getSetting(1).getDeviceLabel());
+   EXPECT_THROW(config.deleteSetting("D1", "P"), CMMError);
+
+   config.addSetting(PropertySetting("D1", "P", "4"));
+   EXPECT_EQ("D1", config.getSetting(2).getDeviceLabel());
+}
+
+TEST(ConfigurationTests, MatchesIncludedConfigurations)
+{
+   Configuration state;
+   state.addSetting(PropertySetting("Wheel", "State", "1"));
+   state.addSetting(PropertySetting("Shutter", "State", "0"));
+   state.addSetting(PropertySetting("Camera", "Binning", "2"));
+
+   Configuration preset;
+   preset.addSetting(PropertySetting("Shutter", "State", "0"));
+   preset.addSetting(PropertySetting("Wheel", "State", "1"));
+   EXPECT_TRUE(state.isConfigurationIncluded(preset));
+   EXPECT_TRUE(state.isSettingIncluded(PropertySetting("Wheel", "State", "1")));
+   EXPECT_FALSE(state.isSettingIncluded(PropertySetting("Wheel", "State", "2")));
+
+   preset.addSetting(PropertySetting("Wheel", "State", "2"));
+   EXPECT_FALSE(state.isConfigurationIncluded(preset));
+
+   Configuration other;
+   other.addSetting(PropertySetting("Stage", "Position", "0"));
+   EXPECT_FALSE(state.isConfigurationIncluded(other));
+   EXPECT_TRUE(state.isConfigurationIncluded(Configuration()));
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+
+#include "AsyncCommand.h"
+#include "DeviceCommandQueue.h"
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+TEST(DeviceCommandQueueTests, RunsJobsOfAModuleInOrder)
+{
+   std::mutex mutex;
+   std::vector<int> order;
+   mm::DeviceCommandQueue queue;
+   int module;
+   for (int i = 0; i < 10; ++i)
+   {
+      queue.Submit(&module, [&mutex, &order, i]() {
+         std::lock_guard<std::mutex> lock(mutex);
+         order.push_back(i);
+      });
+   }
+   queue.Drain();
+
+   std::lock_guard<std::mutex> lock(mutex);
+   ASSERT_EQ(10u, order.size());
+   for (int i = 0; i < 10; ++i)
+      EXPECT_EQ(i, order[i]);
+}
+
+TEST(DeviceCommandQueueTests, OverlapsJobsOfDifferentModules)
+{
+   mm::DeviceCommandQueue queue;
+   int module1, module2;
+   auto sleep = []() { std::this_thread::sleep_for(std::chrono::milliseconds(100)); };
+
+   auto start = std::chrono::steady_clock::now();
+   queue.Submit(&module1, sleep);
+   queue.Submit(&module2, sleep);
+   queue.Drain();
+   double elapsedMs = std::chrono::duration<double, std::milli>(
+         std::chrono::steady_clock::now() - start).count();
+   EXPECT_LT(elapsedMs, 190.0);
+}
+
+TEST(DeviceCommandQueueTests, RunsRemainingJobsOnDestruction)
+{
+   int count = 0;
+   {
+      mm::DeviceCommandQueue queue;
+      int module;
+      for (int i = 0; i < 5; ++i)
+         queue.Submit(&module, [&count]() { ++count; });
+   }
+   EXPECT_EQ(5, count);
+}
+
+TEST(AsyncCommandTests, IsDoneWhenAllPartsAre)
+{
+   mm::AsyncCommand command(2);
+   EXPECT_FALSE(command.IsDone());
+   command.PartFailed("first", 1);
+   EXPECT_FALSE(command.IsDone());
+   command.PartFailed("second", 2);
+   EXPECT_TRUE(command.IsDone());
+   command.Wait();
+
+   std::string message;
+   int code = 0;
+   ASSERT_TRUE(command.GetError(message, code));
+   EXPECT_EQ("first", message);
+   EXPECT_EQ(1, code);
+
+   mm::AsyncCommand empty(0);
+   EXPECT_TRUE(empty.IsDone());
+   EXPECT_FALSE(empty.GetError(message, code));
+}
+
+TEST(AsyncCommandTests, WaitBlocksUntilDone)
+{
+   mm::AsyncCommand command(1);
+   std::thread t([&command]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      command.PartDone();
+   });
+   command.Wait();
+   EXPECT_TRUE(command.IsDone());
+   t.join();
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include "DeviceIdleSignal.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// Stage that stays busy until FinishMove(); reports becoming idle the way
+// CoreCallback::OnDeviceIdle() does, if given a signal
+class MockStage
+{
+   std::atomic<bool> busy_;
+   mm::DeviceIdleSignal* signal_;
+
+public:
+   explicit MockStage(mm::DeviceIdleSignal* signal) :
+      busy_(true),
+      signal_(signal)
+   {
+   }
+
+   bool Busy() const { return busy_; }
+
+   void FinishMove()
+   {
+      busy_ = false;
+      if (signal_)
+         signal_->Notify();
+   }
+};
+
+} // anonymous namespace
+
+TEST(DeviceIdleSignalTests, WaitWakesWhenDeviceReportsIdle)
+{
+   mm::DeviceIdleSignal signal;
+   MockStage stage(&signal);
+   std::thread mover([&stage]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      stage.FinishMove();
+   });
+
+   // The polling interval alone would make the wait last 10 s
+   const Clock::time_point start = Clock::now();
+   EXPECT_TRUE(signal.WaitWhileBusy([&stage]() { return stage.Busy(); },
+            std::chrono::seconds(10), start + std::chrono::seconds(20)));
+   const Clock::duration elapsed = Clock::now() - start;
+   mover.join();
+
+   EXPECT_GE(elapsed, std::chrono::milliseconds(50));
+   EXPECT_LT(elapsed, std::chrono::seconds(5));
+}
+
+TEST(DeviceIdleSignalTests, WaitPollsDevicesThatDoNotReport)
+{
+   mm::DeviceIdleSignal signal;
+   MockStage stage(0);
+   std::thread mover([&stage]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      stage.FinishMove();
+   });
+
+   const Clock::time_point start = Clock::now();
+   EXPECT_TRUE(signal.WaitWhileBusy([&stage]() { return stage.Busy(); },
+            std::chrono::milliseconds(200), start + std::chrono::seconds(20)));
+   const Clock::duration elapsed = Clock::now() - start;
+   mover.join();
+
+   // Noticed at the first poll after the move
+   EXPECT_GE(elapsed, std::chrono::milliseconds(200));
+   EXPECT_LT(elapsed, std::chrono::seconds(5));
+}
+
+TEST(DeviceIdleSignalTests, WaitTimesOutWhileDeviceIsBusy)
+{
+   mm::DeviceIdleSignal signal;
+   MockStage stage(&signal);
+
+   const Clock::time_point start = Clock::now();
+   EXPECT_FALSE(signal.WaitWhileBusy([&stage]() { return stage.Busy(); },
+            std::chrono::milliseconds(10), start + std::chrono::milliseconds(100)));
+   EXPECT_GE(Clock::now() - start, std::chrono::milliseconds(100));
+}
+
+TEST(DeviceIdleSignalTests, NotificationBeforeWaitIsNotMissed)
+{
+   mm::DeviceIdleSignal signal;
+   const unsigned long long count = signal.GetCount();
+   signal.Notify();
+
+   const Clock::time_point start = Clock::now();
+   signal.WaitUntil(count, start + std::chrono::seconds(10));
+   EXPECT_LT(Clock::now() - start, std::chrono::seconds(5));
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
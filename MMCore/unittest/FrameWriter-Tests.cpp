@@ -0,0 +1,199 @@
+#include <gtest/gtest.h>
+
+#include "CircularBuffer.h"
+#include "FrameWriter.h"
+#include "MMCore.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace {
+
+const char* const writerPath = "FrameWriter-Tests-output";
+
+struct IndexEntry
+{
+   unsigned long long frame;
+   unsigned long long offset;
+   unsigned channel;
+   unsigned width;
+   unsigned height;
+   unsigned bytesPerPixel;
+   unsigned components;
+   unsigned metadataBytes;
+};
+
+std::vector<char> ReadFile(const std::string& path)
+{
+   std::vector<char> contents;
+   FILE* f = std::fopen(path.c_str(), "rb");
+   if (!f)
+      return contents;
+   char buf[65536];
+   size_t n;
+   while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0)
+      contents.insert(contents.end(), buf, buf + n);
+   std::fclose(f);
+   return contents;
+}
+
+void RemoveFiles()
+{
+   std::remove((std::string(writerPath) + ".raw").c_str());
+   std::remove((std::string(writerPath) + ".idx").c_str());
+}
+
+// Inserts the image, waiting while the buffer is full
+void Insert(CircularBuffer& cb, const std::vector<unsigned char>& pixels,
+      unsigned width, unsigned height)
+{
+   Metadata md;
+   md.put("Camera", "Cam");
+   while (!cb.InsertImage(pixels.data(), width, height, 1, &md))
+      std::this_thread::yield();
+}
+
+} // anonymous namespace
+
+
+TEST(FrameWriterTests, WritesEveryImageWithIndex)
+{
+   CircularBuffer cb(1);
+   ASSERT_TRUE(cb.Initialize(1, 128, 64, 1));
+   mm::FrameWriterOptions options;
+   options.chunkBytes = 20000; // Images straddle chunks
+   options.chunkCount = 3;
+
+   const unsigned imageCount = 300;
+   {
+      mm::FrameWriter writer(cb, writerPath, options);
+      EXPECT_TRUE(writer.IsRunning());
+      std::vector<unsigned char> pixels(128 * 64);
+      for (unsigned i = 0; i < imageCount; ++i)
+      {
+         pixels.assign(pixels.size(), static_cast<unsigned char>(i));
+         pixels[0] = static_cast<unsigned char>(i + 1);
+         Insert(cb, pixels, 128, 64);
+      }
+      writer.Stop();
+      EXPECT_FALSE(writer.IsRunning());
+      EXPECT_EQ(imageCount, writer.GetImageCount());
+      EXPECT_EQ(imageCount * 128ULL * 64, writer.GetBytesWritten());
+      EXPECT_EQ("", writer.GetError());
+   }
+
+   // Unread images remain for the application
+   EXPECT_LE(1u, cb.GetRemainingImageCount());
+   EXPECT_EQ(0u, cb.GetWriterBacklog());
+
+   std::vector<char> raw = ReadFile(std::string(writerPath) + ".raw");
+   ASSERT_EQ(imageCount * 128u * 64, raw.size());
+   std::vector<char> index = ReadFile(std::string(writerPath) + ".idx");
+   ASSERT_LE(16u, index.size());
+   unsigned header[4];
+   std::memcpy(header, index.data(), sizeof(header));
+   EXPECT_EQ(0x4d4d4649u, header[0]);
+   EXPECT_EQ(40u, header[2]);
+
+   size_t pos = 16;
+   for (unsigned i = 0; i < imageCount; ++i)
+   {
+      ASSERT_LE(pos + sizeof(IndexEntry), index.size());
+      IndexEntry entry;
+      std::memcpy(&entry, index.data() + pos, sizeof(entry));
+      pos += sizeof(entry);
+      EXPECT_EQ(i, entry.frame);
+      EXPECT_EQ(i * 128ULL * 64, entry.offset);
+      EXPECT_EQ(128u, entry.width);
+      EXPECT_EQ(64u, entry.height);
+      EXPECT_EQ(1u, entry.bytesPerPixel);
+      EXPECT_EQ(1u, entry.components);
+
+      Metadata md;
+      md.Restore(std::string(index.data() + pos, entry.metadataBytes).c_str());
+      pos += entry.metadataBytes;
+      EXPECT_EQ(std::to_string(i), md.GetSingleTag(
+               MM::g_Keyword_Metadata_ImageNumber).GetValue());
+
+      EXPECT_EQ(static_cast<char>(i + 1), raw[entry.offset]);
+      EXPECT_EQ(static_cast<char>(i), raw[entry.offset + 128 * 64 - 1]);
+   }
+   EXPECT_EQ(index.size(), pos);
+   RemoveFiles();
+}
+
+TEST(FrameWriterTests, ReadersStillSeeEveryImage)
+{
+   CircularBuffer cb(1);
+   ASSERT_TRUE(cb.Initialize(1, 64, 64, 1));
+   mm::FrameWriter writer(cb, writerPath, mm::FrameWriterOptions());
+
+   std::vector<unsigned char> pixels(64 * 64);
+   for (unsigned i = 0; i < 100; ++i)
+   {
+      pixels.assign(pixels.size(), static_cast<unsigned char>(i));
+      Insert(cb, pixels, 64, 64);
+      const mm::ImgBuffer* img = cb.GetNextImageBuffer(0);
+      ASSERT_NE(nullptr, img);
+      EXPECT_EQ(static_cast<unsigned char>(i), img->GetPixels()[100]);
+   }
+   writer.Stop();
+   EXPECT_EQ(100u, writer.GetImageCount());
+   RemoveFiles();
+}
+
+TEST(FrameWriterTests, UnreadImagesAreDroppedOnceWritten)
+{
+   CircularBuffer cb(1);
+   ASSERT_TRUE(cb.Initialize(1, 512, 512, 1));
+   ASSERT_EQ(4u, cb.GetSize());
+   mm::FrameWriter writer(cb, writerPath, mm::FrameWriterOptions());
+
+   std::vector<unsigned char> pixels(512 * 512);
+   for (unsigned i = 0; i < 20; ++i)
+   {
+      pixels.assign(pixels.size(), static_cast<unsigned char>(i));
+      Insert(cb, pixels, 512, 512);
+   }
+   writer.Stop();
+   EXPECT_EQ(20u, writer.GetImageCount());
+
+   // The application sees the most recent images
+   EXPECT_GE(4u, cb.GetRemainingImageCount());
+   const mm::ImgBuffer* img = cb.GetNextImageBuffer(0);
+   ASSERT_NE(nullptr, img);
+   EXPECT_LE(16, img->GetPixels()[0]);
+
+   // Without a writer, a full buffer rejects images again
+   Metadata md;
+   md.put("Camera", "Cam");
+   for (unsigned i = 0; i < 4; ++i)
+      cb.InsertImage(pixels.data(), 512, 512, 1, &md);
+   EXPECT_FALSE(cb.InsertImage(pixels.data(), 512, 512, 1, &md));
+   RemoveFiles();
+}
+
+TEST(FrameWriterTests, CoreRefusesFootprintChangeWhileRunning)
+{
+   CMMCore core;
+   EXPECT_FALSE(core.isFrameWriterRunning());
+   core.startFrameWriter(writerPath, false, 1);
+   EXPECT_TRUE(core.isFrameWriterRunning());
+   EXPECT_THROW(core.setCircularBufferMemoryFootprint(10), CMMError);
+   EXPECT_THROW(core.startFrameWriter(writerPath), CMMError);
+   core.stopFrameWriter();
+   EXPECT_FALSE(core.isFrameWriterRunning());
+   EXPECT_EQ(0, core.getFrameWriterImageCount());
+   core.setCircularBufferMemoryFootprint(10);
+   RemoveFiles();
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+
+#include "LockStatistics.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+
+TEST(LockStatisticsTests, StartsEmpty)
+{
+   mm::LockStatistics stats;
+   mm::LockStatistics::Snapshot s = stats.Get();
+   EXPECT_EQ(0u, s.count);
+   EXPECT_EQ(0.0, s.totalWaitMs);
+   EXPECT_EQ(0.0, s.maxWaitMs);
+   EXPECT_EQ(0.0, s.totalHoldMs);
+   EXPECT_EQ(0.0, s.maxHoldMs);
+}
+
+TEST(LockStatisticsTests, AccumulatesTotalsAndMaxima)
+{
+   mm::LockStatistics stats;
+   stats.Record(std::chrono::milliseconds(2), std::chrono::milliseconds(10));
+   stats.Record(std::chrono::milliseconds(5), std::chrono::milliseconds(3));
+   stats.Record(std::chrono::milliseconds(0), std::chrono::milliseconds(7));
+
+   mm::LockStatistics::Snapshot s = stats.Get();
+   EXPECT_EQ(3u, s.count);
+   EXPECT_DOUBLE_EQ(7.0, s.totalWaitMs);
+   EXPECT_DOUBLE_EQ(5.0, s.maxWaitMs);
+   EXPECT_DOUBLE_EQ(20.0, s.totalHoldMs);
+   EXPECT_DOUBLE_EQ(10.0, s.maxHoldMs);
+}
+
+TEST(LockStatisticsTests, IgnoresNegativeDurations)
+{
+   mm::LockStatistics stats;
+   stats.Record(-std::chrono::milliseconds(1), -std::chrono::milliseconds(1));
+   mm::LockStatistics::Snapshot s = stats.Get();
+   EXPECT_EQ(1u, s.count);
+   EXPECT_EQ(0.0, s.totalWaitMs);
+   EXPECT_EQ(0.0, s.totalHoldMs);
+}
+
+TEST(LockStatisticsTests, ResetClearsEverything)
+{
+   mm::LockStatistics stats;
+   stats.Record(std::chrono::milliseconds(4), std::chrono::milliseconds(4));
+   stats.Reset();
+   mm::LockStatistics::Snapshot s = stats.Get();
+   EXPECT_EQ(0u, s.count);
+   EXPECT_EQ(0.0, s.maxWaitMs);
+   EXPECT_EQ(0.0, s.maxHoldMs);
+}
+
+TEST(LockStatisticsTests, RecordsConcurrently)
+{
+   mm::LockStatistics stats;
+   const int nThreads = 4;
+   const int perThread = 10000;
+   std::vector<std::thread> threads;
+   for (int t = 0; t < nThreads; ++t)
+   {
+      threads.push_back(std::thread([&stats, t]() {
+         for (int i = 0; i < perThread; ++i)
+            stats.Record(std::chrono::microseconds(1),
+                  std::chrono::microseconds(t + 1));
+      }));
+   }
+   for (size_t t = 0; t < threads.size(); ++t)
+      threads[t].join();
+
+   mm::LockStatistics::Snapshot s = stats.Get();
+   EXPECT_EQ(static_cast<unsigned long long>(nThreads * perThread), s.count);
+   EXPECT_NEAR(nThreads * perThread * 0.001, s.totalWaitMs, 1e-6);
+   EXPECT_DOUBLE_EQ(nThreads * 0.001, s.maxHoldMs);
+}
+
+int main(int argc, char** argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
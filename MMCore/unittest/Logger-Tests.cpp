@@ -54,6 +54,80 @@ TEST(LoggerTests, BasicLogStream)
 }
 
 
+namespace {
+
+int CountEvaluation(int& count)
+{
+   return ++count;
+}
+
+} // anonymous namespace
+
+
+TEST(LoggerTests, MinimumLevelFollowsSinks)
+{
+   std::shared_ptr<LoggingCore> c =
+      std::make_shared<LoggingCore>();
+   Logger lgr = c->NewLogger("mylabel");
+
+   // No sinks: nothing is enabled
+   EXPECT_FALSE(lgr.IsEnabled(LogLevelFatal));
+
+   std::shared_ptr<LogSink> infoSink = std::make_shared<StdErrLogSink>();
+   infoSink->SetFilter(std::make_shared<LevelFilter>(LogLevelInfo));
+   c->AddSink(infoSink, SinkModeSynchronous);
+   EXPECT_EQ(LogLevelInfo, c->GetMinimumLevel());
+   EXPECT_FALSE(lgr.IsEnabled(LogLevelDebug));
+   EXPECT_TRUE(lgr.IsEnabled(LogLevelInfo));
+
+   std::shared_ptr<LogSink> traceSink = std::make_shared<StdErrLogSink>();
+   traceSink->SetFilter(std::make_shared<LevelFilter>(LogLevelTrace));
+   c->AddSink(traceSink, SinkModeAsynchronous);
+   EXPECT_TRUE(lgr.IsEnabled(LogLevelTrace));
+
+   c->RemoveSink(traceSink, SinkModeAsynchronous);
+   EXPECT_FALSE(lgr.IsEnabled(LogLevelTrace));
+
+   typedef std::pair<std::pair<std::shared_ptr<LogSink>, SinkMode>,
+           std::shared_ptr<EntryFilter> > FilterChange;
+   std::vector<FilterChange> changes;
+   changes.push_back(FilterChange(
+            std::make_pair(infoSink, SinkModeSynchronous),
+            std::make_shared<LevelFilter>(LogLevelError)));
+   c->AtomicSetSinkFilters(changes.begin(), changes.end());
+   EXPECT_EQ(LogLevelError, c->GetMinimumLevel());
+   EXPECT_FALSE(lgr.IsEnabled(LogLevelWarning));
+
+   // A sink without a filter accepts every level
+   c->AddSink(std::make_shared<StdErrLogSink>(), SinkModeSynchronous);
+   EXPECT_TRUE(lgr.IsEnabled(LogLevelTrace));
+}
+
+
+TEST(LoggerTests, DisabledLogStreamIsNotEvaluated)
+{
+   std::shared_ptr<LoggingCore> c =
+      std::make_shared<LoggingCore>();
+   std::shared_ptr<LogSink> sink = std::make_shared<StdErrLogSink>();
+   sink->SetFilter(std::make_shared<LevelFilter>(LogLevelInfo));
+   c->AddSink(sink, SinkModeSynchronous);
+   Logger lgr = c->NewLogger("mylabel");
+
+   int count = 0;
+   LOG_DEBUG(lgr) << CountEvaluation(count);
+   EXPECT_EQ(0, count);
+   LOG_INFO(lgr) << CountEvaluation(count);
+   EXPECT_EQ(1, count);
+
+   // The macro must not capture a following else
+   if (count == 0)
+      LOG_INFO(lgr) << CountEvaluation(count);
+   else
+      ++count;
+   EXPECT_EQ(2, count);
+}
+
+
 class LoggerTestThreadFunc
 {
    unsigned n_;
@@ -0,0 +1,89 @@
+// Cost of a LOG_DEBUG statement when no sink accepts debug entries (the
+// Core's default with debug logging off), compared with formatting the entry
+// and letting the sink filter drop it as the Core used to, and with an
+// enabled entry delivered to a sink that discards it.
+//
+// Usage: Logging-Bench [callCount]
+//
+// Not run by "make check"; build with "make Logging-Bench".
+
+#include "Logging/Logging.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+using namespace mm::logging;
+
+
+namespace {
+
+class NullSink : public LogSink
+{
+public:
+   virtual void Consume(const PacketArrayType&) {}
+};
+
+// Same expansion as LOG_WITH_LEVEL without the enabled-level check
+#define LOG_DEBUG_UNCHECKED(logger) \
+   for (::mm::logging::LogStream strm((logger), LogLevelDebug); \
+         !strm.Used(); strm.MarkUsed()) \
+      strm
+
+template <typename F>
+double NsPerCall(unsigned callCount, F f)
+{
+   typedef std::chrono::steady_clock Clock;
+   Clock::time_point start = Clock::now();
+   for (unsigned i = 0; i < callCount; ++i)
+      f(i);
+   return std::chrono::duration<double, std::nano>(
+         Clock::now() - start).count() / callCount;
+}
+
+} // anonymous namespace
+
+
+int main(int argc, char** argv)
+{
+   const unsigned callCount = argc > 1 ?
+      static_cast<unsigned>(std::strtoul(argv[1], 0, 10)) : 1000000;
+   if (callCount == 0)
+   {
+      std::fprintf(stderr, "Usage: %s [callCount]\n", argv[0]);
+      return 1;
+   }
+
+   std::shared_ptr<LoggingCore> core = std::make_shared<LoggingCore>();
+   std::shared_ptr<LogSink> sink = std::make_shared<NullSink>();
+   sink->SetFilter(std::make_shared<LevelFilter>(LogLevelInfo));
+   core->AddSink(sink, SinkModeSynchronous);
+   Logger logger = core->NewLogger("Bench");
+
+   const std::string label = "Camera";
+   const double value = 12.5;
+
+   const double gated = NsPerCall(callCount, [&](unsigned i) {
+      LOG_DEBUG(logger) << "Frame " << i << " from " << label <<
+         " exposure " << value << " ms";
+   });
+   const double filtered = NsPerCall(callCount, [&](unsigned i) {
+      LOG_DEBUG_UNCHECKED(logger) << "Frame " << i << " from " << label <<
+         " exposure " << value << " ms";
+   });
+   const double delivered = NsPerCall(callCount, [&](unsigned i) {
+      LOG_INFO(logger) << "Frame " << i << " from " << label <<
+         " exposure " << value << " ms";
+   });
+
+   std::printf("%u calls per case\n", callCount);
+   std::printf("%-34s %10.1f ns/call\n", "disabled, skipped by level check",
+         gated);
+   std::printf("%-34s %10.1f ns/call\n", "disabled, dropped by sink filter",
+         filtered);
+   std::printf("%-34s %10.1f ns/call\n", "enabled, discarded by sink",
+         delivered);
+   return 0;
+}
@@ -0,0 +1,181 @@
+#include <gtest/gtest.h>
+
+#include "Logging/BinaryLog.h"
+#include "Logging/Logging.h"
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace mm::logging;
+
+
+namespace {
+
+const char* const logFilename = "LoggingBinaryLog-Tests.bin";
+
+std::vector<BinaryLogReader::Entry> ReadAll(const std::string& filename)
+{
+   std::ifstream file(filename.c_str(),
+         std::ios_base::in | std::ios_base::binary);
+   BinaryLogReader reader(file);
+   std::vector<BinaryLogReader::Entry> entries;
+   BinaryLogReader::Entry entry;
+   while (reader.ReadEntry(entry))
+      entries.push_back(entry);
+   return entries;
+}
+
+class LoggingBinaryLogTest : public ::testing::Test
+{
+protected:
+   virtual void TearDown()
+   {
+      std::remove(logFilename);
+      for (int i = 1; i <= 3; ++i)
+         std::remove((std::string(logFilename) + '.' +
+                  std::to_string(i)).c_str());
+   }
+};
+
+} // anonymous namespace
+
+
+TEST_F(LoggingBinaryLogTest, RoundTrip)
+{
+   {
+      std::shared_ptr<LoggingCore> c = std::make_shared<LoggingCore>();
+      std::shared_ptr<LogSink> sink =
+         std::make_shared<BinaryFileLogSink>(logFilename);
+      sink->SetFilter(std::make_shared<LevelFilter>(LogLevelDebug));
+      c->AddSink(sink, SinkModeSynchronous);
+
+      Logger first = c->NewLogger("first");
+      Logger second = c->NewLogger("second");
+      LOG_INFO(first) << "one";
+      LOG_TRACE(first) << "filtered out";
+      LOG_ERROR(second) << "two\nthree";
+      LOG_DEBUG(first) << std::string(300, 'x');
+   }
+
+   std::vector<BinaryLogReader::Entry> entries = ReadAll(logFilename);
+   ASSERT_EQ(3u, entries.size());
+   EXPECT_EQ("first", entries[0].label);
+   EXPECT_EQ(LogLevelInfo, entries[0].level);
+   EXPECT_EQ("one", entries[0].text);
+   EXPECT_EQ("second", entries[1].label);
+   EXPECT_EQ(LogLevelError, entries[1].level);
+   EXPECT_EQ("two\nthree", entries[1].text);
+   EXPECT_EQ("first", entries[2].label);
+   EXPECT_EQ(std::string(300, 'x'), entries[2].text);
+   EXPECT_LE(entries[0].timestamp, entries[1].timestamp);
+}
+
+
+TEST_F(LoggingBinaryLogTest, DecodesToTextFormat)
+{
+   StampData stamp;
+   stamp.Stamp();
+   internal::GenericPacketArray<Metadata> packets;
+   packets.AppendEntry("label", LogLevelWarning, stamp,
+         "first line\nsecond line");
+
+   {
+      BinaryFileLogSink sink(logFilename);
+      sink.Consume(packets);
+   }
+
+   std::ostringstream expected;
+   internal::WritePacketsToStream<internal::MetadataFormatter>(expected,
+         packets.Begin(), packets.End(),
+         std::shared_ptr<EntryFilter>());
+
+   std::vector<BinaryLogReader::Entry> entries = ReadAll(logFilename);
+   ASSERT_EQ(1u, entries.size());
+   std::ostringstream decoded;
+   FormatBinaryLogEntry(decoded, entries[0]);
+   EXPECT_EQ(expected.str(), decoded.str());
+}
+
+
+TEST_F(LoggingBinaryLogTest, RotatesBySize)
+{
+   {
+      std::shared_ptr<LoggingCore> c = std::make_shared<LoggingCore>();
+      c->AddSink(std::make_shared<BinaryFileLogSink>(logFilename, 1000, 2),
+            SinkModeSynchronous);
+      Logger lgr = c->NewLogger("rotating");
+      for (int i = 0; i < 100; ++i)
+         LOG_INFO(lgr) << "entry " << i;
+   }
+
+   // Each file defines its own labels and can be read on its own
+   std::vector<BinaryLogReader::Entry> current = ReadAll(logFilename);
+   std::vector<BinaryLogReader::Entry> backup1 =
+      ReadAll(std::string(logFilename) + ".1");
+   std::vector<BinaryLogReader::Entry> backup2 =
+      ReadAll(std::string(logFilename) + ".2");
+   ASSERT_FALSE(current.empty());
+   ASSERT_FALSE(backup1.empty());
+   ASSERT_FALSE(backup2.empty());
+   EXPECT_FALSE(std::ifstream(std::string(logFilename) + ".3").good());
+
+   EXPECT_EQ("entry 99", current.back().text);
+   EXPECT_EQ("rotating", current.front().label);
+   EXPECT_EQ("entry " + std::to_string(100 - current.size() - 1),
+         backup1.back().text);
+}
+
+
+TEST_F(LoggingBinaryLogTest, RejectsOtherFiles)
+{
+   {
+      std::ofstream file(logFilename);
+      file << "2024-01-01T00:00:00.000000 tid1 [IFO,Core] text\n";
+   }
+   std::ifstream file(logFilename, std::ios_base::in | std::ios_base::binary);
+   EXPECT_THROW(BinaryLogReader reader(file), BadBinaryLogException);
+}
+
+
+TEST_F(LoggingBinaryLogTest, ReportsTruncatedRecord)
+{
+   {
+      std::shared_ptr<LoggingCore> c = std::make_shared<LoggingCore>();
+      c->AddSink(std::make_shared<BinaryFileLogSink>(logFilename),
+            SinkModeSynchronous);
+      Logger lgr = c->NewLogger("label");
+      LOG_INFO(lgr) << "complete";
+      LOG_INFO(lgr) << "will be cut short";
+   }
+
+   std::string contents;
+   {
+      std::ifstream in(logFilename, std::ios_base::in | std::ios_base::binary);
+      std::ostringstream ss;
+      ss << in.rdbuf();
+      contents = ss.str();
+   }
+   {
+      std::ofstream out(logFilename,
+            std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+      out.write(contents.data(), contents.size() - 4);
+   }
+
+   std::ifstream file(logFilename, std::ios_base::in | std::ios_base::binary);
+   BinaryLogReader reader(file);
+   BinaryLogReader::Entry entry;
+   ASSERT_TRUE(reader.ReadEntry(entry));
+   EXPECT_EQ("complete", entry.text);
+   EXPECT_THROW(reader.ReadEntry(entry), BadBinaryLogException);
+}
+
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -0,0 +1,202 @@
+#include <gtest/gtest.h>
+
+#include "Logging/GenericPacketArray.h"
+#include "Logging/GenericPacketQueue.h"
+#include "Logging/Logging.h"
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace mm::logging;
+
+typedef internal::GenericPacketArray<Metadata> PacketArrayType;
+typedef internal::GenericPacketQueue<Metadata> PacketQueueType;
+
+
+namespace {
+
+PacketArrayType MakeEntry(const std::string& text)
+{
+   StampData stamp;
+   stamp.Stamp();
+   PacketArrayType packets;
+   packets.AppendEntry("test", LogLevelInfo, stamp, text.c_str());
+   return packets;
+}
+
+void Send(PacketQueueType& queue, const std::string& text)
+{
+   PacketArrayType packets = MakeEntry(text);
+   queue.SendPackets(packets.Begin(), packets.End());
+}
+
+// Collects the text of each packet passed to the sinks
+class Collector
+{
+   std::mutex mutex_;
+   std::vector<std::string> lines_;
+
+public:
+   void Consume(PacketArrayType& packets)
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (PacketArrayType::ConstIteratorType it = packets.Begin(),
+            end = packets.End(); it != end; ++it)
+         lines_.push_back(it->GetText());
+   }
+
+   std::vector<std::string> Lines()
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return lines_;
+   }
+};
+
+void RunLoop(PacketQueueType& queue, Collector& collector)
+{
+   queue.RunReceiveLoop(
+         [&collector](PacketArrayType& packets) { collector.Consume(packets); });
+}
+
+} // anonymous namespace
+
+
+TEST(LoggingPacketQueueTests, DeliversEntriesInOrder)
+{
+   PacketQueueType queue;
+   Collector collector;
+   RunLoop(queue, collector);
+   for (int i = 0; i < 1000; ++i)
+      Send(queue, std::to_string(i));
+   queue.ShutdownReceiveLoop();
+
+   std::vector<std::string> lines = collector.Lines();
+   ASSERT_EQ(1000u, lines.size());
+   for (int i = 0; i < 1000; ++i)
+      EXPECT_EQ(std::to_string(i), lines[i]);
+
+   PacketQueueStatistics stats = queue.GetStatistics();
+   EXPECT_EQ(1000u, stats.queued);
+   EXPECT_EQ(0u, stats.dropped);
+   EXPECT_EQ(1000u, stats.flushed);
+}
+
+
+TEST(LoggingPacketQueueTests, ConcurrentEntriesDoNotInterleave)
+{
+   PacketQueueType queue(64);
+   queue.SetBatchInterval(std::chrono::microseconds(100));
+   Collector collector;
+   RunLoop(queue, collector);
+
+   const unsigned threadCount = 4;
+   const unsigned entriesPerThread = 500;
+   std::vector<std::thread> threads;
+   for (unsigned t = 0; t < threadCount; ++t)
+   {
+      threads.emplace_back([&queue, t] {
+         const std::string id = std::to_string(t);
+         for (unsigned i = 0; i < entriesPerThread; ++i)
+            Send(queue, id + "a\n" + id + "b\n" + id + "c");
+      });
+   }
+   for (std::thread& th : threads)
+      th.join();
+   queue.ShutdownReceiveLoop();
+
+   std::vector<std::string> lines = collector.Lines();
+   ASSERT_EQ(3u * threadCount * entriesPerThread, lines.size());
+   for (size_t i = 0; i < lines.size(); i += 3)
+   {
+      const char id = lines[i][0];
+      EXPECT_EQ(std::string(1, id) + "a", lines[i]);
+      EXPECT_EQ(std::string(1, id) + "b", lines[i + 1]);
+      EXPECT_EQ(std::string(1, id) + "c", lines[i + 2]);
+   }
+   EXPECT_EQ(threadCount * entriesPerThread, queue.GetStatistics().flushed);
+}
+
+
+TEST(LoggingPacketQueueTests, DropNewestKeepsOldestEntries)
+{
+   PacketQueueType queue(16);
+   queue.SetOverflowPolicy(OverflowPolicyDropNewest);
+   for (int i = 0; i < 20; ++i)
+      Send(queue, std::to_string(i));
+
+   PacketQueueStatistics stats = queue.GetStatistics();
+   EXPECT_EQ(16u, stats.queued);
+   EXPECT_EQ(4u, stats.dropped);
+
+   Collector collector;
+   RunLoop(queue, collector);
+   queue.ShutdownReceiveLoop();
+   std::vector<std::string> lines = collector.Lines();
+   ASSERT_EQ(16u, lines.size());
+   EXPECT_EQ("0", lines.front());
+   EXPECT_EQ("15", lines.back());
+}
+
+
+TEST(LoggingPacketQueueTests, DropOldestKeepsNewestEntries)
+{
+   PacketQueueType queue(16);
+   queue.SetOverflowPolicy(OverflowPolicyDropOldest);
+   for (int i = 0; i < 20; ++i)
+      Send(queue, std::to_string(i));
+
+   PacketQueueStatistics stats = queue.GetStatistics();
+   EXPECT_EQ(20u, stats.queued);
+   EXPECT_EQ(4u, stats.dropped);
+
+   Collector collector;
+   RunLoop(queue, collector);
+   queue.ShutdownReceiveLoop();
+   std::vector<std::string> lines = collector.Lines();
+   ASSERT_EQ(16u, lines.size());
+   EXPECT_EQ("4", lines.front());
+   EXPECT_EQ("19", lines.back());
+}
+
+
+TEST(LoggingPacketQueueTests, BlockWaitsForRoom)
+{
+   PacketQueueType queue(16);
+   for (int i = 0; i < 16; ++i)
+      Send(queue, std::to_string(i));
+
+   std::thread producer([&queue] { Send(queue, "16"); });
+   std::this_thread::sleep_for(std::chrono::milliseconds(20));
+   EXPECT_EQ(16u, queue.GetStatistics().queued);
+
+   Collector collector;
+   RunLoop(queue, collector);
+   producer.join();
+   queue.ShutdownReceiveLoop();
+
+   std::vector<std::string> lines = collector.Lines();
+   ASSERT_EQ(17u, lines.size());
+   EXPECT_EQ("16", lines.back());
+   EXPECT_EQ(0u, queue.GetStatistics().dropped);
+}
+
+
+TEST(LoggingPacketQueueTests, BatchIntervalIsConfigurable)
+{
+   PacketQueueType queue;
+   EXPECT_EQ(std::chrono::microseconds(10000), queue.GetBatchInterval());
+   queue.SetBatchInterval(std::chrono::microseconds(250));
+   EXPECT_EQ(std::chrono::microseconds(250), queue.GetBatchInterval());
+   queue.SetBatchInterval(std::chrono::microseconds(-1));
+   EXPECT_EQ(std::chrono::microseconds(0), queue.GetBatchInterval());
+}
+
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
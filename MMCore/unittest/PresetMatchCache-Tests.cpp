@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+
+#include "ConfigGroup.h"
+#include "PresetMatchCache.h"
+
+#include <string>
+
+
+TEST(PresetMatchCacheTests, InvalidatesGroupsIncludingProperty)
+{
+   ConfigGroupCollection groups;
+   groups.Define("Channel", "DAPI", "Wheel", "State", "1");
+   groups.Define("Channel", "DAPI", "Shutter", "State", "0");
+   groups.Define("Channel", "FITC", "Wheel", "State", "2");
+   groups.Define("Objective", "10x", "Turret", "State", "0");
+   mm::PresetMatchCache cache(groups);
+
+   std::string preset;
+   EXPECT_FALSE(cache.Get("Channel", preset));
+   cache.Put("Channel", "DAPI");
+   cache.Put("Objective", "");
+   ASSERT_TRUE(cache.Get("Channel", preset));
+   EXPECT_EQ("DAPI", preset);
+   ASSERT_TRUE(cache.Get("Objective", preset));
+   EXPECT_EQ("", preset);
+
+   cache.Invalidate("Camera", "Binning"); // In no group
+   cache.Invalidate("NeverSeenDevice", "State");
+   EXPECT_TRUE(cache.Get("Channel", preset));
+
+   cache.Invalidate("Shutter", "State"); // Only in some presets
+   EXPECT_FALSE(cache.Get("Channel", preset));
+   EXPECT_TRUE(cache.Get("Objective", preset));
+
+   cache.InvalidateAll();
+   EXPECT_FALSE(cache.Get("Objective", preset));
+}
+
+TEST(PresetMatchCacheTests, DropsAnswersWhenGroupsChange)
+{
+   ConfigGroupCollection groups;
+   groups.Define("Channel", "DAPI", "Wheel", "State", "1");
+   mm::PresetMatchCache cache(groups);
+
+   std::string preset;
+   cache.Put("Channel", "DAPI");
+   groups.Define("Channel", "FITC", "Wheel", "State", "2");
+   EXPECT_FALSE(cache.Get("Channel", preset));
+
+   // The index is rebuilt for the new preset's properties
+   groups.Define("Channel", "FITC", "Filter", "State", "2");
+   cache.Put("Channel", "");
+   cache.Invalidate("Filter", "State");
+   EXPECT_FALSE(cache.Get("Channel", preset));
+}
+
+TEST(PresetMatchCacheTests, DoesNotCacheGroupsWithCoreProperties)
+{
+   ConfigGroupCollection groups;
+   groups.Define("System", "Startup", "Core", "AutoShutter", "1");
+   groups.Define("System", "Startup", "Wheel", "State", "1");
+   mm::PresetMatchCache cache(groups);
+
+   std::string preset;
+   cache.Put("System", "Startup");
+   EXPECT_FALSE(cache.Get("System", preset));
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
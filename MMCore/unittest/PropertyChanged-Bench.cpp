@@ -0,0 +1,147 @@
+// Cost of a device property change notification (CoreCallback::
+// OnPropertyChanged) against the number of configuration groups, compared
+// with scanning every preset of every group as the Core used to.
+//
+// Usage: PropertyChanged-Bench [callCount]
+//
+// Not run by "make check"; build with "make PropertyChanged-Bench".
+
+#include "../../MMDevice/DeviceBase.h"
+#include "CoreCallback.h"
+#include "MMCore.h"
+#include "MMEventCallback.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+
+namespace {
+
+const char* const benchDeviceName = "BenchDevice";
+
+class BenchDevice : public CGenericBase<BenchDevice>
+{
+public:
+   BenchDevice()
+   {
+      CreateProperty("State", "0", MM::Integer, false);
+      CreateProperty("Mode", "0", MM::Integer, false);
+   }
+
+   int Initialize() { return DEVICE_OK; }
+   int Shutdown() { return DEVICE_OK; }
+   void GetName(char* name) const
+   {
+      CDeviceUtils::CopyLimitedString(name, benchDeviceName);
+   }
+   bool Busy() { return false; }
+};
+
+class SilentCallback : public MMEventCallback
+{
+public:
+   void onPropertyChanged(const char*, const char*, const char*) {}
+   void onConfigGroupChanged(const char*, const char*) {}
+   void onPixelSizeChanged(double) {}
+   void onPixelSizeAffineChanged(double, double, double, double, double, double) {}
+};
+
+// Defines groupCount groups of 4 presets with 2 settings each, of which
+// only the last group includes the benchmarked device
+void DefineGroups(CMMCore& core, unsigned groupCount)
+{
+   for (unsigned g = 0; g < groupCount; ++g)
+   {
+      const std::string group = "Group" + std::to_string(g);
+      const std::string device = g + 1 == groupCount ?
+         "Bench" : "Other" + std::to_string(g);
+      for (unsigned p = 0; p < 4; ++p)
+      {
+         const std::string preset = "Preset" + std::to_string(p);
+         const std::string value = std::to_string(p);
+         core.defineConfig(group.c_str(), preset.c_str(), device.c_str(), "State", value.c_str());
+         core.defineConfig(group.c_str(), preset.c_str(), device.c_str(), "Mode", value.c_str());
+      }
+   }
+   core.definePixelSizeConfig("Res", "Turret", "State", "0");
+}
+
+// The per-change lookup done before the property index existed
+void ScanGroups(CMMCore& core, const char* label, const char* propName)
+{
+   std::vector<std::string> configGroups = core.getAvailableConfigGroups();
+   for (size_t g = 0; g < configGroups.size(); ++g)
+   {
+      std::vector<std::string> configs =
+         core.getAvailableConfigs(configGroups[g].c_str());
+      for (size_t c = 0; c < configs.size(); ++c)
+      {
+         Configuration config =
+            core.getConfigData(configGroups[g].c_str(), configs[c].c_str());
+         if (config.size() > 1 && config.isPropertyIncluded(label, propName))
+         {
+            core.getCurrentConfigFromCache(configGroups[g].c_str());
+            break;
+         }
+      }
+   }
+   std::vector<std::string> pixelSizeConfigs = core.getAvailablePixelSizeConfigs();
+   for (size_t p = 0; p < pixelSizeConfigs.size(); ++p)
+   {
+      Configuration config = core.getPixelSizeConfigData(pixelSizeConfigs[p].c_str());
+      if (config.isPropertyIncluded(label, propName))
+         break;
+   }
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+   long callCount = argc > 1 ? std::atol(argv[1]) : 2000;
+
+   std::printf("%ld property changes; mean time per change in us\n", callCount);
+   std::printf("%7s %12s %12s\n", "groups", "scan", "index");
+
+   const unsigned groupCounts[] = { 1, 10, 30, 100, 300 };
+   for (unsigned groupCount : groupCounts)
+   {
+      CMMCore core;
+      SilentCallback events;
+      core.registerCallback(&events);
+      DefineGroups(core, groupCount);
+
+      BenchDevice device;
+      device.SetLabel("Bench");
+      CoreCallback callback(&core);
+      // Puts the device's properties in the state cache; the first call
+      // fails to find the current preset, since State is not cached yet
+      try
+      {
+         callback.OnPropertyChanged(&device, "Mode", "1");
+      }
+      catch (const CMMError&)
+      {
+      }
+      callback.OnPropertyChanged(&device, "State", "1");
+
+      auto start = std::chrono::steady_clock::now();
+      for (long i = 0; i < callCount; ++i)
+         ScanGroups(core, "Bench", "State");
+      const double scanUs = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - start).count() / callCount;
+
+      start = std::chrono::steady_clock::now();
+      for (long i = 0; i < callCount; ++i)
+         callback.OnPropertyChanged(&device, "State", "1");
+      const double indexUs = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - start).count() / callCount;
+
+      std::printf("%7u %12.2f %12.2f\n", groupCount, scanUs, indexUs);
+      core.registerCallback(0);
+   }
+   return 0;
+}
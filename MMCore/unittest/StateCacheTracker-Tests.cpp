@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+
+#include "StateCacheTracker.h"
+
+#include <chrono>
+
+typedef mm::StateCacheTracker::Clock Clock;
+
+
+TEST(StateCacheTrackerTests, RefreshesUnreadAndStaleProperties)
+{
+   mm::StateCacheTracker tracker;
+   Clock::time_point t0 = Clock::now();
+
+   EXPECT_TRUE(tracker.NeedsRefresh("Camera", "Binning", t0));
+   tracker.MarkRead("Camera", "Binning", t0);
+   tracker.MarkRead("Camera", "Exposure", t0);
+   tracker.MarkRead("Wheel", "State", t0);
+   EXPECT_FALSE(tracker.NeedsRefresh("Camera", "Binning", t0));
+
+   tracker.MarkStale("Camera", "Binning");
+   EXPECT_TRUE(tracker.NeedsRefresh("Camera", "Binning", t0));
+   EXPECT_FALSE(tracker.NeedsRefresh("Camera", "Exposure", t0));
+   tracker.MarkRead("Camera", "Binning", t0);
+   EXPECT_FALSE(tracker.NeedsRefresh("Camera", "Binning", t0));
+
+   tracker.MarkDeviceStale("Camera");
+   EXPECT_TRUE(tracker.NeedsRefresh("Camera", "Binning", t0));
+   EXPECT_TRUE(tracker.NeedsRefresh("Camera", "Exposure", t0));
+   EXPECT_FALSE(tracker.NeedsRefresh("Wheel", "State", t0));
+}
+
+TEST(StateCacheTrackerTests, RefreshesPropertiesOlderThanMaxAge)
+{
+   mm::StateCacheTracker tracker;
+   Clock::time_point t0 = Clock::now();
+
+   tracker.SetMaxAge("Camera", "Temperature", 100.0);
+   tracker.MarkRead("Camera", "Temperature", t0);
+   EXPECT_FALSE(tracker.NeedsRefresh("Camera", "Temperature",
+            t0 + std::chrono::milliseconds(50)));
+   EXPECT_TRUE(tracker.NeedsRefresh("Camera", "Temperature",
+            t0 + std::chrono::milliseconds(100)));
+
+   tracker.SetMaxAge("Camera", "Temperature", 0.0);
+   EXPECT_FALSE(tracker.NeedsRefresh("Camera", "Temperature",
+            t0 + std::chrono::hours(1)));
+}
+
+TEST(StateCacheTrackerTests, ForgetsDevices)
+{
+   mm::StateCacheTracker tracker;
+   Clock::time_point t0 = Clock::now();
+
+   tracker.MarkRead("Cam", "Binning", t0);
+   tracker.MarkRead("Camera", "Binning", t0);
+   tracker.SetMaxAge("Camera", "Temperature", 100.0);
+   tracker.MarkRead("Camera", "Temperature", t0);
+
+   tracker.ForgetDevice("Camera");
+   EXPECT_TRUE(tracker.NeedsRefresh("Camera", "Binning", t0));
+   EXPECT_FALSE(tracker.NeedsRefresh("Cam", "Binning", t0));
+
+   // The maximum age is forgotten too
+   tracker.MarkRead("Camera", "Temperature", t0);
+   EXPECT_FALSE(tracker.NeedsRefresh("Camera", "Temperature",
+            t0 + std::chrono::hours(1)));
+
+   tracker.Clear();
+   EXPECT_TRUE(tracker.NeedsRefresh("Cam", "Binning", t0));
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -0,0 +1,112 @@
+// Copy throughput of the frame copy kernels for typical sCMOS frame sizes,
+// into a ring larger than the cache, and their impact on the last-level
+// cache: after each frame is copied, a consumer reads a small working set
+// that was cached beforehand; the slower that read, the more of it the copy
+// evicted.
+//
+// Usage: StreamingCopy-Bench [ringMegabytes [workingSetKilobytes]]
+//
+// Not run by "make check"; build with "make StreamingCopy-Bench".
+
+#include "StreamingCopy.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct FrameSize
+{
+   const char* name;
+   size_t width;
+   size_t height;
+};
+
+const FrameSize frameSizes[] = {
+   { "512x512", 512, 512 },
+   { "1024x1024", 1024, 1024 },
+   { "2048x2048", 2048, 2048 },
+   { "2304x2304", 2304, 2304 },
+   { "3200x3200", 3200, 3200 },
+};
+
+const mm::CopyKernel kernels[] = {
+   mm::CopyKernelMemcpy,
+   mm::CopyKernelSSE2,
+   mm::CopyKernelAVX2,
+   mm::CopyKernelAVX512,
+};
+
+volatile unsigned long long g_sink;
+
+// Reads the working set; returns the time taken in microseconds
+double ReadWorkingSet(const std::vector<unsigned long long>& workingSet)
+{
+   Clock::time_point start = Clock::now();
+   unsigned long long sum = 0;
+   for (size_t i = 0; i < workingSet.size(); i += 8) // One read per line
+      sum += workingSet[i];
+   g_sink = sum;
+   return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+   const size_t ringBytes = (argc > 1 ? (size_t)atol(argv[1]) : 512) << 20;
+   const size_t workingSetBytes = (argc > 2 ? (size_t)atol(argv[2]) : 4096) << 10;
+
+   std::vector<unsigned char> ring(ringBytes, 0);
+   std::vector<unsigned long long> workingSet(workingSetBytes / sizeof(unsigned long long), 1);
+
+   // Warm the working set and measure reading it while it is cached
+   double cachedUs = 0.0;
+   for (int i = 0; i < 20; ++i)
+      cachedUs = ReadWorkingSet(workingSet);
+
+   std::printf("Ring %zu MB, working set %zu KB (%.1f us to read when cached)\n",
+         ringBytes >> 20, workingSetBytes >> 10, cachedUs);
+   std::printf("Best kernel: %s; CopyFrame() streams frames of %zu bytes or more\n",
+         mm::GetCopyKernelName(mm::GetBestCopyKernel()),
+         mm::GetStreamingCopyThreshold());
+   std::printf("%-10s %-8s %10s %20s\n", "frame", "kernel", "GB/s", "working set read (us)");
+
+   for (const FrameSize& size : frameSizes)
+   {
+      const size_t frameBytes = size.width * size.height * 2; // 16-bit pixels
+      const size_t slots = ringBytes / frameBytes;
+      if (slots < 2)
+         continue;
+      std::vector<unsigned char> frame(frameBytes, 0x5A);
+      const size_t copies = std::max<size_t>(2 * slots, 32);
+
+      for (mm::CopyKernel kernel : kernels)
+      {
+         if (!mm::IsCopyKernelSupported(kernel))
+            continue;
+
+         double copySeconds = 0.0;
+         double readUs = 0.0;
+         for (size_t n = 0; n < copies; ++n)
+         {
+            unsigned char* dst = &ring[(n % slots) * frameBytes];
+            Clock::time_point start = Clock::now();
+            mm::StreamingCopy(dst, frame.data(), frameBytes, kernel);
+            copySeconds += std::chrono::duration<double>(Clock::now() - start).count();
+            readUs += ReadWorkingSet(workingSet);
+         }
+         std::printf("%-10s %-8s %10.2f %20.1f\n", size.name,
+               mm::GetCopyKernelName(kernel),
+               (double)frameBytes * copies / copySeconds / 1.0e9,
+               readUs / copies);
+      }
+   }
+   return 0;
+}
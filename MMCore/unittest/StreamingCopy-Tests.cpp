@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+
+#include "StreamingCopy.h"
+
+#include <cstring>
+#include <vector>
+
+
+namespace {
+
+const mm::CopyKernel allKernels[] = {
+   mm::CopyKernelMemcpy,
+   mm::CopyKernelSSE2,
+   mm::CopyKernelAVX2,
+   mm::CopyKernelAVX512,
+};
+
+// Copies every size up to a few vector widths, and a large one, at every
+// combination of small source and destination misalignments
+void CheckKernel(mm::CopyKernel kernel)
+{
+   const size_t sizes[] = { 0, 1, 15, 16, 17, 63, 64, 65, 127, 128, 129,
+      255, 256, 257, 511, 1000, 4096 + 33, 1 << 20 };
+   const size_t maxSize = 1 << 20;
+   std::vector<unsigned char> src(maxSize + 128), dst(maxSize + 128);
+   for (size_t i = 0; i < src.size(); ++i)
+      src[i] = static_cast<unsigned char>(i * 7 + 3);
+
+   for (size_t srcOffset = 0; srcOffset < 64; srcOffset += 13)
+   {
+      for (size_t dstOffset = 0; dstOffset < 64; dstOffset += 7)
+      {
+         for (size_t size : sizes)
+         {
+            std::fill(dst.begin(), dst.end(), 0xAB);
+            mm::StreamingCopy(&dst[dstOffset], &src[srcOffset], size, kernel);
+            ASSERT_EQ(0, std::memcmp(&dst[dstOffset], &src[srcOffset], size))
+               << mm::GetCopyKernelName(kernel) << " size " << size <<
+               " offsets " << srcOffset << "/" << dstOffset;
+            // Nothing outside the destination is touched
+            for (size_t i = 0; i < dstOffset; ++i)
+               ASSERT_EQ(0xAB, dst[i]);
+            for (size_t i = dstOffset + size; i < dst.size(); ++i)
+               ASSERT_EQ(0xAB, dst[i]);
+         }
+      }
+   }
+}
+
+} // anonymous namespace
+
+TEST(StreamingCopyTests, SupportedKernelsCopyExactly)
+{
+   for (mm::CopyKernel kernel : allKernels)
+   {
+      if (mm::IsCopyKernelSupported(kernel))
+         CheckKernel(kernel);
+   }
+}
+
+TEST(StreamingCopyTests, BestKernelIsSupported)
+{
+   EXPECT_TRUE(mm::IsCopyKernelSupported(mm::CopyKernelMemcpy));
+   EXPECT_TRUE(mm::IsCopyKernelSupported(mm::GetBestCopyKernel()));
+}
+
+TEST(StreamingCopyTests, ThresholdSelectsStreaming)
+{
+   const size_t saved = mm::GetStreamingCopyThreshold();
+   mm::SetStreamingCopyThreshold(1000);
+   EXPECT_FALSE(mm::UseStreamingCopy(999));
+   EXPECT_TRUE(mm::UseStreamingCopy(1000));
+
+   std::vector<unsigned char> src(5000, 9), dst(5000, 0);
+   mm::CopyFrame(dst.data(), src.data(), 500);
+   mm::CopyFrame(dst.data() + 500, src.data() + 500, 4500, 5000);
+   EXPECT_EQ(src, dst);
+   mm::SetStreamingCopyThreshold(saved);
+}
+
+int main(int argc, char** argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+
+#include "SymbolTable.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using mm::SymbolTable;
+
+
+TEST(SymbolTableTests, EmptyStringIsIdZero)
+{
+   EXPECT_EQ(0u, SymbolTable::Intern(""));
+}
+
+TEST(SymbolTableTests, SameNameGetsSameId)
+{
+   const SymbolTable::Id id = SymbolTable::Intern("SymbolTableTests-Name");
+   EXPECT_NE(0u, id);
+   EXPECT_EQ(id, SymbolTable::Intern(std::string("SymbolTableTests-Name").c_str()));
+   EXPECT_NE(id, SymbolTable::Intern("SymbolTableTests-Other"));
+}
+
+TEST(SymbolTableTests, FindKeyDoesNotIntern)
+{
+   unsigned long long key;
+   EXPECT_FALSE(SymbolTable::FindKey("SymbolTableTests-Device",
+            "SymbolTableTests-Property", key));
+   EXPECT_FALSE(SymbolTable::FindKey("SymbolTableTests-Device",
+            "SymbolTableTests-Property", key));
+
+   const unsigned long long interned = SymbolTable::InternKey(
+         "SymbolTableTests-Device", "SymbolTableTests-Property");
+   ASSERT_TRUE(SymbolTable::FindKey("SymbolTableTests-Device",
+            "SymbolTableTests-Property", key));
+   EXPECT_EQ(interned, key);
+   EXPECT_EQ(SymbolTable::Key(SymbolTable::Intern("SymbolTableTests-Device"),
+            SymbolTable::Intern("SymbolTableTests-Property")), key);
+}
+
+TEST(SymbolTableTests, ConcurrentInterningAgreesOnIds)
+{
+   // Enough names to make the table grow while other threads look them up
+   const int nameCount = 5000;
+   const int threadCount = 4;
+   std::vector<std::string> names;
+   for (int i = 0; i < nameCount; ++i)
+      names.push_back("SymbolTableTests-Concurrent-" + std::to_string(i));
+
+   std::vector< std::vector<SymbolTable::Id> > ids(threadCount);
+   std::vector<std::thread> threads;
+   for (int t = 0; t < threadCount; ++t)
+   {
+      threads.push_back(std::thread([&names, &ids, t]() {
+         for (int i = 0; i < nameCount; ++i)
+         {
+            // Each thread starts at a different name
+            const int n = (i + t * nameCount / threadCount) % nameCount;
+            ids[t].push_back(SymbolTable::Intern(names[n].c_str()));
+         }
+      }));
+   }
+   for (int t = 0; t < threadCount; ++t)
+      threads[t].join();
+
+   std::vector<SymbolTable::Id> expected(nameCount);
+   for (int i = 0; i < nameCount; ++i)
+      expected[i] = SymbolTable::Intern(names[i].c_str());
+   for (int t = 0; t < threadCount; ++t)
+   {
+      for (int i = 0; i < nameCount; ++i)
+      {
+         const int n = (i + t * nameCount / threadCount) % nameCount;
+         ASSERT_EQ(expected[n], ids[t][i]);
+      }
+   }
+   for (int i = 1; i < nameCount; ++i)
+      EXPECT_NE(expected[i - 1], expected[i]);
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
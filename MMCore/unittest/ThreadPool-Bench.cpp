@@ -0,0 +1,79 @@
+// Scaling of the thread pool with its size: parallel frame copies (as done
+// when inserting into the circular buffer) and a compute-bound ParallelFor.
+//
+// Usage: ThreadPool-Bench [frameMegabytes [iterations]]
+//
+// Not run by "make check"; build with "make ThreadPool-Bench".
+
+#include "TaskSet_CopyMemory.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double ElapsedMs(Clock::time_point start)
+{
+   return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+double CopyMs(std::shared_ptr<ThreadPool> pool, std::vector<unsigned char>& dst,
+      const std::vector<unsigned char>& src, int iterations)
+{
+   TaskSet_CopyMemory tasks(pool);
+   tasks.MemCopy(dst.data(), src.data(), src.size()); // Warm up
+   Clock::time_point start = Clock::now();
+   for (int i = 0; i < iterations; ++i)
+      tasks.MemCopy(dst.data(), src.data(), src.size());
+   return ElapsedMs(start) / iterations;
+}
+
+double ComputeMs(ThreadPool& pool, std::vector<double>& data, int iterations)
+{
+   Clock::time_point start = Clock::now();
+   for (int i = 0; i < iterations; ++i)
+   {
+      pool.ParallelFor(0, data.size(), 4096, [&data](size_t begin, size_t end) {
+         for (size_t j = begin; j < end; ++j)
+            data[j] = std::sqrt(data[j] * 1.0001 + 1.0);
+      });
+   }
+   return ElapsedMs(start) / iterations;
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+   const size_t frameMB = argc > 1 ? (size_t)atol(argv[1]) : 32;
+   const int iterations = argc > 2 ? atoi(argv[2]) : 50;
+   const size_t hwThreads = std::max(1u, std::thread::hardware_concurrency());
+
+   std::vector<unsigned char> src(frameMB << 20, 1), dst(frameMB << 20, 0);
+   std::vector<double> data(4 << 20, 1.0);
+
+   std::printf("%zu MB frames, %d iterations, %zu hardware threads\n",
+         frameMB, iterations, hwThreads);
+   std::printf("%8s %12s %10s %14s\n", "threads", "copy (ms)", "GB/s", "compute (ms)");
+   for (size_t threads = 1; ; threads = std::min(threads * 2, hwThreads))
+   {
+      std::shared_ptr<ThreadPool> pool = std::make_shared<ThreadPool>(threads);
+      const double copyMs = CopyMs(pool, dst, src, iterations);
+      const double computeMs = ComputeMs(*pool, data, iterations);
+      std::printf("%8zu %12.3f %10.2f %14.3f\n", threads, copyMs,
+            (double)src.size() / copyMs / 1.0e6, computeMs);
+      if (threads == hwThreads)
+         break;
+   }
+   return 0;
+}
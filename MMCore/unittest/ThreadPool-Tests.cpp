@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+
+#include "TaskSet_CopyMemory.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+
+TEST(ThreadPoolTests, UsesRequestedSize)
+{
+   ThreadPool pool(3);
+   EXPECT_EQ(3u, pool.GetSize());
+   ThreadPool defaultPool;
+   EXPECT_LE(1u, defaultPool.GetSize());
+}
+
+TEST(ThreadPoolTests, ParallelForCoversEachIndexOnce)
+{
+   ThreadPool pool(4);
+   std::vector<std::atomic<int>> hits(1001);
+   for (auto& h : hits)
+      h = 0;
+   pool.ParallelFor(0, hits.size(), 7, [&](size_t begin, size_t end) {
+      EXPECT_LE(end - begin, 7u);
+      for (size_t i = begin; i < end; ++i)
+         ++hits[i];
+   });
+   for (size_t i = 0; i < hits.size(); ++i)
+      EXPECT_EQ(1, hits[i]) << i;
+}
+
+TEST(ThreadPoolTests, ParallelForHandlesEmptyAndSingleChunkRanges)
+{
+   ThreadPool pool(2);
+   int calls = 0;
+   pool.ParallelFor(5, 5, 1, [&](size_t, size_t) { ++calls; });
+   EXPECT_EQ(0, calls);
+   pool.ParallelFor(5, 8, 10, [&](size_t begin, size_t end) {
+      EXPECT_EQ(5u, begin);
+      EXPECT_EQ(8u, end);
+      ++calls;
+   });
+   EXPECT_EQ(1, calls);
+}
+
+TEST(ThreadPoolTests, NestedParallelForDoesNotDeadlock)
+{
+   ThreadPool pool(2);
+   std::atomic<int> sum(0);
+   pool.ParallelFor(0, 8, 1, [&](size_t, size_t) {
+      pool.ParallelFor(0, 8, 1, [&](size_t begin, size_t end) {
+         sum += static_cast<int>(end - begin);
+      });
+   });
+   EXPECT_EQ(64, sum);
+}
+
+TEST(ThreadPoolTests, ParallelForRethrowsFirstException)
+{
+   ThreadPool pool(4);
+   std::atomic<int> done(0);
+   EXPECT_THROW(pool.ParallelFor(0, 100, 1, [&](size_t begin, size_t) {
+      if (begin == 42)
+         throw std::runtime_error("chunk failed");
+      ++done;
+   }), std::runtime_error);
+   EXPECT_EQ(99, done);
+}
+
+TEST(ThreadPoolTests, CopiesMemoryWithTasks)
+{
+   auto pool = std::make_shared<ThreadPool>(4);
+   TaskSet_CopyMemory tasks(pool);
+   const size_t bytes = 5 * 1000000 + 123;
+   std::vector<unsigned char> src(bytes), dst(bytes, 0);
+   for (size_t i = 0; i < bytes; ++i)
+      src[i] = static_cast<unsigned char>(i * 31);
+   for (int n = 0; n < 20; ++n)
+   {
+      std::fill(dst.begin(), dst.end(), 0);
+      tasks.MemCopy(dst.data(), src.data(), bytes);
+      ASSERT_EQ(0, std::memcmp(dst.data(), src.data(), bytes));
+   }
+}
+
+TEST(ThreadPoolTests, RecordsWhetherPlacementWasApplied)
+{
+   ThreadPool unplaced(2);
+   EXPECT_TRUE(unplaced.IsPlacementApplied());
+
+   ThreadPool::Placement placement;
+   placement.numaNode = 100000; // No such node
+   ThreadPool placed(2, placement);
+   EXPECT_EQ(2u, placed.GetSize());
+   EXPECT_FALSE(placed.IsPlacementApplied());
+}
+
+int main(int argc, char** argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}
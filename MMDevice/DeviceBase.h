@@ -1131,6 +1131,16 @@ protected:
       return DEVICE_NO_CALLBACK_REGISTERED;
    }
 
+   /**
+    * Signals to the core that the device is no longer busy.
+    */
+   int OnDeviceIdle()
+   {
+      if (callback_)
+         return callback_->OnDeviceIdle(this);
+      return DEVICE_NO_CALLBACK_REGISTERED;
+   }
+
    /**
    * Gets the system ticks in microseconds.
    * OBSOLETE, use GetCurrentTime()
@@ -1543,24 +1553,82 @@ protected:
 
    virtual int InsertImage()
    {
-      char label[MM::MaxStrLength];
-      this->GetLabel(label);
-      Metadata md;
-      md.put("Camera", label);
-      int ret = GetCoreCallback()->InsertImage(this, GetImageBuffer(), GetImageWidth(),
-         GetImageHeight(), GetImageBytesPerPixel(),
-         md.Serialize().c_str());
+      // The Core adds the camera label
+      const MM::ImageTag* noTags = 0;
+      int ret = GetCoreCallback()->InsertImage(this, GetImageBuffer(),
+         GetImageWidth(), GetImageHeight(), GetImageBytesPerPixel(),
+         GetNumberOfComponents(), noTags, 0);
       if (!stopWhenCBOverflows_ && ret == DEVICE_BUFFER_OVERFLOW)
       {
          // do not stop on overflow - just reset the buffer
          GetCoreCallback()->ClearImageBuffer(this);
-         return GetCoreCallback()->InsertImage(this, GetImageBuffer(), GetImageWidth(),
-            GetImageHeight(), GetImageBytesPerPixel(),
-            md.Serialize().c_str());
+         return GetCoreCallback()->InsertImage(this, GetImageBuffer(),
+            GetImageWidth(), GetImageHeight(), GetImageBytesPerPixel(),
+            GetNumberOfComponents(), noTags, 0);
       } else
          return ret;
    }
 
+   /*
+    * Inserts the next image into the Core's sequence buffer without an
+    * intermediate copy: the next buffer slot is acquired, filled by
+    * FillImageSlot(), and committed with the given metadata. Only for
+    * cameras that override FillImageSlot(); call it from InsertImage().
+    */
+   int InsertImageInSlot(const char* serializedMetadata, bool doProcess = true)
+   {
+      int ret = AcquireAndFillImageSlot();
+      if (ret != DEVICE_OK)
+         return ret;
+      return GetCoreCallback()->CommitImageSlot(this, serializedMetadata,
+         doProcess);
+   }
+
+   /*
+    * Same as above, with the metadata given as binary tags, which avoids
+    * serializing it.
+    */
+   int InsertImageInSlot(const MM::ImageTag* tags, unsigned tagCount,
+      bool doProcess = true)
+   {
+      int ret = AcquireAndFillImageSlot();
+      if (ret != DEVICE_OK)
+         return ret;
+      return GetCoreCallback()->CommitImageSlot(this, tags, tagCount,
+         doProcess);
+   }
+
+   /*
+    * Writes the next image into a sequence buffer slot of
+    * GetImageWidth() * GetImageHeight() * GetImageBytesPerPixel() bytes.
+    * Cameras that can read out (or generate) pixels directly into the slot
+    * override this and insert with InsertImageInSlot(). Cameras that only
+    * have the image in their own buffer should use the Core's InsertImage()
+    * instead, which copies it in parallel.
+    */
+   virtual int FillImageSlot(unsigned char* /*slot*/)
+   {
+      return DEVICE_NOT_SUPPORTED;
+   }
+
+private:
+   // Leaves the slot acquired (to be committed) only on success
+   int AcquireAndFillImageSlot()
+   {
+      unsigned char* slot = 0;
+      int ret = GetCoreCallback()->AcquireImageSlot(this, GetImageWidth(),
+         GetImageHeight(), GetImageBytesPerPixel(), GetNumberOfComponents(),
+         &slot);
+      if (ret != DEVICE_OK)
+         return ret;
+
+      ret = FillImageSlot(slot);
+      if (ret != DEVICE_OK)
+         GetCoreCallback()->DiscardImageSlot(this);
+      return ret;
+   }
+
+protected:
    virtual double GetIntervalMs() {return thd_->GetIntervalMs();}
    virtual long GetImageCounter() {return thd_->GetImageCounter();}
    virtual long GetNumberOfImages() {return thd_->GetNumberOfImages();}
@@ -31,12 +31,14 @@
 
 #include "MMDeviceConstants.h"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <map>
 #include <sstream>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 ///////////////////////////////////////////////////////////////////////////////
 // MetadataError
@@ -278,6 +280,13 @@ private:
 
 /**
  * Container for all metadata associated with a single image.
+ *
+ * Tags are stored by value in a vector sorted by qualified name, so lookups
+ * are binary searches and copying metadata copies one vector rather than a
+ * tree of individually allocated tags. Each tag still holds its qualified
+ * name, name, device label and value as separate strings, and any of these
+ * longer than the library's short-string capacity (15 characters with
+ * libstdc++ and MSVC) is a separate allocation.
  */
 class Metadata
 {
@@ -285,73 +294,91 @@ public:
 
    Metadata() {} // empty constructor
 
-   ~Metadata() // destructor
+   ~Metadata() {} // destructor
+
+   Metadata(const Metadata& original) : // copy constructor
+      tags_(original.tags_)
    {
-      Clear();
    }
 
-   Metadata(const Metadata& original) // copy constructor
+#ifndef SWIG
+   Metadata(Metadata&& original) :
+      tags_(std::move(original.tags_))
    {
-      for (TagConstIter it = original.tags_.begin(); it != original.tags_.end(); it++)
-      {
-         SetTag(*it->second);
-      }
    }
+#endif
 
    void Clear()
    {
-      for (TagConstIter it=tags_.begin(); it != tags_.end(); it++)
-         delete it->second;
       tags_.clear();
    }
 
    std::vector<std::string> GetKeys() const
    {
       std::vector<std::string> keyList;
+      keyList.reserve(tags_.size());
       for (TagConstIter it = tags_.begin(), end = tags_.end(); it != end; ++it)
-         keyList.push_back(it->first);
+         keyList.push_back(it->key);
       return keyList;
    }
 
-   bool HasTag(const char* key)
+   bool HasTag(const char* key) const
    {
-      TagConstIter it = tags_.find(key);
-      if (it != tags_.end())
-         return true;
-      else
-         return false;
+      return FindEntry(key) != 0;
    }
-   
+
    MetadataSingleTag GetSingleTag(const char* key) const throw (MetadataKeyError)
    {
-      MetadataTag* tag = FindTag(key);
-      const MetadataSingleTag* stag = tag->ToSingleTag();
-      return *stag;
+      const Entry* entry = FindEntry(key);
+      if (!entry || entry->isArray)
+         throw MetadataKeyError();
+      MetadataSingleTag tag(entry->name.c_str(), entry->device.c_str(), entry->readOnly);
+      tag.SetValue(entry->value.c_str());
+      return tag;
    }
 
    MetadataArrayTag GetArrayTag(const char* key) const throw (MetadataKeyError)
    {
-      MetadataTag* tag = FindTag(key);
-      const MetadataArrayTag* atag = tag->ToArrayTag();
-      return *atag;
+      const Entry* entry = FindEntry(key);
+      if (!entry || !entry->isArray)
+         throw MetadataKeyError();
+      MetadataArrayTag tag(entry->name.c_str(), entry->device.c_str(), entry->readOnly);
+      for (size_t i = 0; i < entry->values.size(); i++)
+         tag.AddValue(entry->values[i].c_str());
+      return tag;
    }
 
    void SetTag(MetadataTag& tag)
    {
-      MetadataTag* newTag = tag.Clone();
-      const std::string key(tag.GetQualifiedName());
-      RemoveTag(key.c_str());
-      tags_[key] = newTag;
+      const MetadataArrayTag* atag = tag.ToArrayTag();
+      const MetadataSingleTag* stag = tag.ToSingleTag();
+      if (!atag && !stag)
+         return;
+
+      Entry& entry = FindOrInsertEntry(tag.GetQualifiedName());
+      entry.name = tag.GetName();
+      entry.device = tag.GetDevice();
+      entry.readOnly = tag.IsReadOnly();
+      entry.isArray = (atag != 0);
+      if (atag)
+      {
+         entry.value.clear();
+         entry.values.resize(atag->GetSize());
+         for (size_t i = 0; i < entry.values.size(); i++)
+            entry.values[i] = atag->GetValue(i);
+      }
+      else
+      {
+         entry.value = stag->GetValue();
+         entry.values.clear();
+      }
    }
 
    void RemoveTag(const char* key)
    {
-      TagIter it = tags_.find(key);
-      if (it != tags_.end())
-      {
-         delete it->second;
-         tags_.erase(it); // Non-const iterator needed in pre-C++11 code
-      }
+      TagIter it = LowerBound(key);
+      if (it != tags_.end() && it->key.compare(key) == 0)
+         tags_.erase(it);
    }
 
    /*
@@ -362,11 +389,53 @@ public:
    {
       std::stringstream os;
       os << value;
-      MetadataSingleTag* newTag = new MetadataSingleTag(key.c_str(), deviceLabel.c_str(), true);
-      newTag->SetValue(os.str().c_str());
-      tags_[newTag->GetQualifiedName()] = newTag;
+      PutSingleTag(key, deviceLabel, os.str());
    }
 
+#ifndef SWIG
+   // Overloads that avoid going through a stringstream for the common
+   // value types (formatting is the same)
+   void PutTag(const std::string& key, const std::string& deviceLabel, const std::string& value)
+   {
+      PutSingleTag(key, deviceLabel, value);
+   }
+
+   void PutTag(const std::string& key, const std::string& deviceLabel, const char* value)
+   {
+      PutSingleTag(key, deviceLabel, value);
+   }
+
+   void PutTag(const std::string& key, const std::string& deviceLabel, int value)
+   {
+      PutSingleTag(key, deviceLabel, std::to_string(value));
+   }
+
+   void PutTag(const std::string& key, const std::string& deviceLabel, unsigned value)
+   {
+      PutSingleTag(key, deviceLabel, std::to_string(value));
+   }
+
+   void PutTag(const std::string& key, const std::string& deviceLabel, long value)
+   {
+      PutSingleTag(key, deviceLabel, std::to_string(value));
+   }
+
+   void PutTag(const std::string& key, const std::string& deviceLabel, unsigned long value)
+   {
+      PutSingleTag(key, deviceLabel, std::to_string(value));
+   }
+
+   void PutTag(const std::string& key, const std::string& deviceLabel, long long value)
+   {
+      PutSingleTag(key, deviceLabel, std::to_string(value));
+   }
+
+   void PutTag(const std::string& key, const std::string& deviceLabel, unsigned long long value)
+   {
+      PutSingleTag(key, deviceLabel, std::to_string(value));
+   }
+#endif
+
    /*
     * Add a tag not associated with any device.
     */
@@ -388,39 +457,34 @@ public:
 #ifndef SWIG
    Metadata& operator=(const Metadata& rhs)
    {
-      Clear();
-      
-      for (TagConstIter it=rhs.tags_.begin(); it != rhs.tags_.end(); it++)
-      {
-         SetTag(*it->second);
-      }
+      tags_ = rhs.tags_;
+      return *this;
+   }
 
+   Metadata& operator=(Metadata&& rhs)
+   {
+      tags_ = std::move(rhs.tags_);
       return *this;
    }
 #endif
 
    void Merge(const Metadata& newTags)
-   {     
+   {
       for (TagConstIter it=newTags.tags_.begin(); it != newTags.tags_.end(); it++)
       {
-         SetTag(*it->second);
+         FindOrInsertEntry(it->key) = *it;
       }
    }
 
    std::string Serialize() const
    {
       std::string str;
-
-      std::ostringstream os;
-      os << tags_.size();
-      str.append(os.str()).append("\n");
+      str.append(std::to_string(tags_.size())).append("\n");
 
       for (TagConstIter it = tags_.begin(); it != tags_.end(); it++)
       {
-         const std::string id((it->second->ToArrayTag()) ? "a" : "s");
-         str.append(id).append("\n");
-
-         str.append(it->second->Serialize());
+         str.append(it->isArray ? "a" : "s").append("\n");
+         SerializeEntry(*it, str);
       }
 
       return str;
@@ -436,30 +500,47 @@ public:
    {
       Clear();
 
-      std::istringstream is(stream);
-
-      const size_t sz = atol(readLine(is).c_str());
+      const size_t sz = atol(NextLine(stream).c_str());
+      tags_.reserve(sz);
 
       for (size_t i=0; i<sz; i++)
       {
-         const std::string id(readLine(is));
+         const std::string id(NextLine(stream));
 
-         MetadataTag* newTag;
+         Entry entry;
          if (id.compare("s") == 0)
          {
-            newTag = new MetadataSingleTag();
+            entry.isArray = false;
          }
          else if (id.compare("a") == 0)
          {
-            newTag = new MetadataArrayTag();
+            entry.isArray = true;
          }
          else
          {
             return false;
          }
 
-         newTag->Restore(is);
-         tags_[newTag->GetQualifiedName()] = newTag;
+         entry.name = NextLine(stream);
+         entry.device = NextLine(stream);
+         entry.readOnly = atoi(NextLine(stream).c_str()) != 0;
+         if (entry.isArray)
+         {
+            entry.values.resize(atol(NextLine(stream).c_str()));
+            for (size_t j = 0; j < entry.values.size(); j++)
+               entry.values[j] = NextLine(stream);
+         }
+         else
+         {
+            entry.value = NextLine(stream);
+         }
+
+         entry.key = QualifiedName(entry.name, entry.device);
+         // Serialized tags are in key order, so this is normally an append
+         if (tags_.empty() || tags_.back().key < entry.key)
+            tags_.push_back(std::move(entry));
+         else
+            FindOrInsertEntry(entry.key) = std::move(entry);
       }
       return true;
    }
@@ -472,9 +553,10 @@ public:
       for (TagConstIter it = tags_.begin(); it != tags_.end(); it++)
       {
          std::string id("s");
-         if (it->second->ToArrayTag())
+         if (it->isArray)
             id = "a";
-         std::string ser = it->second->Serialize();
+         std::string ser;
+         SerializeEntry(*it, ser);
          os << id << " : " << ser << std::endl;
       }
 
@@ -482,18 +564,110 @@ public:
    }
 
 private:
-   MetadataTag* FindTag(const char* key) const
+   struct Entry
+   {
+      Entry() : readOnly(false), isArray(false) {}
+
+      std::string key; // qualified name
+      std::string name;
+      std::string device;
+      bool readOnly;
+      bool isArray;
+      std::string value; // single tags
+      std::vector<std::string> values; // array tags
+   };
+
+   typedef std::vector<Entry>::iterator TagIter;
+   typedef std::vector<Entry>::const_iterator TagConstIter;
+
+   struct KeyLess
+   {
+      bool operator()(const Entry& entry, const char* key) const
+      {
+         return entry.key.compare(key) < 0;
+      }
+   };
+
+   TagIter LowerBound(const char* key)
+   {
+      return std::lower_bound(tags_.begin(), tags_.end(), key, KeyLess());
+   }
+
+   const Entry* FindEntry(const char* key) const
+   {
+      TagConstIter it = std::lower_bound(tags_.begin(), tags_.end(), key, KeyLess());
+      if (it != tags_.end() && it->key.compare(key) == 0)
+         return &*it;
+      return 0;
+   }
+
+   Entry& FindOrInsertEntry(const std::string& key)
+   {
+      TagIter it = LowerBound(key.c_str());
+      if (it == tags_.end() || it->key != key)
+      {
+         it = tags_.insert(it, Entry());
+         it->key = key;
+      }
+      return *it;
+   }
+
+   void PutSingleTag(const std::string& name, const std::string& device, std::string value)
    {
-      TagConstIter it = tags_.find(key);
-      if (it != tags_.end())
-         return it->second;
+      Entry& entry = FindOrInsertEntry(QualifiedName(name, device));
+      entry.name = name;
+      entry.device = device;
+      entry.readOnly = true;
+      entry.isArray = false;
+      entry.value.swap(value);
+      entry.values.clear();
+   }
+
+   // Same as MetadataTag::GetQualifiedName()
+   static std::string QualifiedName(const std::string& name, const std::string& device)
+   {
+      if (device.compare("_") == 0)
+         return name;
+      std::string str;
+      str.reserve(device.size() + 1 + name.size());
+      return str.append(device).append("-").append(name);
+   }
+
+   // Same format as MetadataTag::Serialize()
+   static void SerializeEntry(const Entry& entry, std::string& str)
+   {
+      str.append(entry.name).append("\n");
+      str.append(entry.device).append("\n");
+      str.append(entry.readOnly ? "1" : "0").append("\n");
+
+      if (entry.isArray)
+      {
+         str.append(std::to_string(entry.values.size())).append("\n");
+         for (size_t i = 0; i < entry.values.size(); i++)
+            str.append(entry.values[i]).append("\n");
+      }
       else
-         throw MetadataKeyError();
+      {
+         str.append(entry.value).append("\n");
+      }
+   }
+
+   // Same as std::getline() on the rest of the stream, and advances it
+   static std::string NextLine(const char*& stream)
+   {
+      const char* end = strchr(stream, '\n');
+      if (!end)
+      {
+         std::string line(stream);
+         stream += line.size();
+         return line;
+      }
+      std::string line(stream, end);
+      stream = end + 1;
+      return line;
    }
 
-   std::map<std::string, MetadataTag*> tags_;
-   typedef std::map<std::string, MetadataTag*>::iterator TagIter;
-   typedef std::map<std::string, MetadataTag*>::const_iterator TagConstIter;
+   std::vector<Entry> tags_;
 };
 
 #endif //_IMAGE_METADATA_H_
\ No newline at end of file
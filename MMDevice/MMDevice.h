@@ -27,7 +27,7 @@
 // Header version
 // If any of the class definitions changes, the interface version
 // must be incremented
-#define DEVICE_INTERFACE_VERSION 71
+#define DEVICE_INTERFACE_VERSION 75
 ///////////////////////////////////////////////////////////////////////////////
 
 
@@ -228,6 +228,59 @@ namespace MM {
    };
 
 
+   /**
+    * Per-image metadata tag in binary form.
+    *
+    * An array of these can be passed to Core::InsertImage() or
+    * Core::CommitImageSlot() instead of a serialized Metadata object, which
+    * avoids formatting and parsing text on every frame. Well-known keys are
+    * given as an ImageTagKey; other keys by name. Strings are only borrowed
+    * for the duration of the call. Numeric values are formatted by the Core
+    * (floating point values with two decimals, as by
+    * CDeviceUtils::ConvertToString()).
+    */
+   struct ImageTag
+   {
+      ImageTagKey key;
+      const char* name; // for ImageTagCustom
+      PropertyType type;
+      long long integerValue;
+      double floatValue;
+      const char* stringValue;
+
+      static ImageTag Integer(ImageTagKey key, long long value)
+      {
+         ImageTag tag = { key, 0, MM::Integer, value, 0.0, 0 };
+         return tag;
+      }
+      static ImageTag Integer(const char* name, long long value)
+      {
+         ImageTag tag = { ImageTagCustom, name, MM::Integer, value, 0.0, 0 };
+         return tag;
+      }
+      static ImageTag Float(ImageTagKey key, double value)
+      {
+         ImageTag tag = { key, 0, MM::Float, 0, value, 0 };
+         return tag;
+      }
+      static ImageTag Float(const char* name, double value)
+      {
+         ImageTag tag = { ImageTagCustom, name, MM::Float, 0, value, 0 };
+         return tag;
+      }
+      static ImageTag String(ImageTagKey key, const char* value)
+      {
+         ImageTag tag = { key, 0, MM::String, 0, 0.0, value };
+         return tag;
+      }
+      static ImageTag String(const char* name, const char* value)
+      {
+         ImageTag tag = { ImageTagCustom, name, MM::String, 0, 0.0, value };
+         return tag;
+      }
+   };
+
+
    /**
     * Generic device interface.
     */
@@ -1300,6 +1353,14 @@ namespace MM {
        * Magnifiers can use this to signal changes in magnification
        */
       virtual int OnMagnifierChanged(const Device* caller) = 0;
+      /**
+       * Devices whose Busy() state is driven by the hardware (e.g. a stage
+       * that reports arrival) should call this as soon as Busy() returns
+       * false, so that threads waiting for the device wake immediately
+       * instead of at the next poll. May be called from any thread, without
+       * holding the device's own locks.
+       */
+      virtual int OnDeviceIdle(const Device* caller) = 0;
 
       // Deprecated: Return value overflows in ~72 minutes on Windows.
       // Prefer std::chrono::steady_clock for time delta measurements.
@@ -1318,11 +1379,44 @@ namespace MM {
       virtual int InsertImage(const Device* caller, const unsigned char* buf, unsigned width, unsigned height, unsigned byteDepth, const Metadata* md = 0, const bool doProcess = true) = 0;
       /// \deprecated Use the other forms instead.
       virtual int InsertImage(const Device* caller, const unsigned char* buf, unsigned width, unsigned height, unsigned byteDepth, const char* serializedMetadata, const bool doProcess = true) = 0;
+      /**
+       * Inserts an image with metadata given as binary tags (see ImageTag),
+       * which is cheaper than passing serialized metadata.
+       */
+      virtual int InsertImage(const Device* caller, const unsigned char* buf, unsigned width, unsigned height, unsigned byteDepth, unsigned nComponents, const ImageTag* tags, unsigned tagCount, const bool doProcess = true) = 0;
       virtual void ClearImageBuffer(const Device* caller) = 0;
       virtual bool InitializeImageBuffer(unsigned channels, unsigned slices, unsigned int w, unsigned int h, unsigned int pixDepth) = 0;
       /// \deprecated Use the other forms instead.
       virtual int InsertMultiChannel(const Device* caller, const unsigned char* buf, unsigned numChannels, unsigned width, unsigned height, unsigned byteDepth, Metadata* md = 0) = 0;
 
+      /**
+       * Zero-copy image insertion: obtains the pixel buffer of the next free
+       * slot in the sequence buffer, so that the camera can write an image
+       * directly into it instead of passing it to InsertImage().
+       *
+       * On success (DEVICE_OK), *slot points to width * height * byteDepth
+       * writable bytes. Returns DEVICE_BUFFER_OVERFLOW if the buffer is full
+       * and DEVICE_INCOMPATIBLE_IMAGE if the dimensions do not match the
+       * buffer. A successfully acquired slot must be passed to
+       * CommitImageSlot() or DiscardImageSlot() from the same thread; other
+       * insertions block until then.
+       */
+      virtual int AcquireImageSlot(const Device* caller, unsigned width, unsigned height, unsigned byteDepth, unsigned nComponents, unsigned char** slot) = 0;
+      /**
+       * Publishes the slot obtained from AcquireImageSlot(), with the given
+       * metadata, making it available to sequence buffer readers.
+       */
+      virtual int CommitImageSlot(const Device* caller, const char* serializedMetadata, const bool doProcess = true) = 0;
+      /**
+       * Same as above, with metadata given as binary tags (see ImageTag).
+       */
+      virtual int CommitImageSlot(const Device* caller, const ImageTag* tags, unsigned tagCount, const bool doProcess = true) = 0;
+      /**
+       * Abandons the slot obtained from AcquireImageSlot() without inserting
+       * an image.
+       */
+      virtual int DiscardImageSlot(const Device* caller) = 0;
+
       // autofocus
       // TODO This interface needs improvement: the caller pointer should be
       // passed, and it should be clarified whether the use of these methods is
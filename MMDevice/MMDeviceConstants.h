@@ -131,6 +131,14 @@ namespace MM {
    const char* const g_Keyword_CoreSLM          = "SLM";
    const char* const g_Keyword_CoreGalvo        = "Galvo";
    const char* const g_Keyword_CoreTimeoutMs    = "TimeoutMs";
+   const char* const g_Keyword_CoreBufferHugePages = "BufferHugePages";
+   const char* const g_Keyword_CoreBufferLockMemory = "BufferLockMemory";
+   const char* const g_Keyword_CoreBufferNUMANode = "BufferNUMANode";
+   const char* const g_Keyword_CoreBufferPrefault = "BufferPrefault";
+   const char* const g_Keyword_CoreBufferAllocation = "BufferAllocation";
+   const char* const g_Keyword_CoreThreadPoolSize = "ThreadPoolSize";
+   const char* const g_Keyword_CoreThreadPoolAffinity = "ThreadPoolAffinity";
+   const char* const g_Keyword_CoreThreadPoolNUMANode = "ThreadPoolNUMANode";
    const char* const g_Keyword_Channel          = "Channel";
    const char* const g_Keyword_Version          = "Version";
    const char* const g_Keyword_ColorMode        = "ColorMode";
@@ -249,6 +257,18 @@ namespace MM {
       FocusDirectionAwayFromSample,
    };
 
+   // Interned keys of per-image metadata tags passed as MM::ImageTag
+   enum ImageTagKey {
+      ImageTagCustom = 0,         // key given by ImageTag::name
+      ImageTagElapsedTimeMs,      // g_Keyword_Elapsed_Time_ms
+      ImageTagROIX,               // g_Keyword_Metadata_ROI_X
+      ImageTagROIY,               // g_Keyword_Metadata_ROI_Y
+      ImageTagBinning,            // g_Keyword_Binning
+      ImageTagScore,              // g_Keyword_Metadata_Score
+      ImageTagCameraChannelIndex, // g_Keyword_CameraChannelIndex
+      ImageTagCameraChannelName   // g_Keyword_CameraChannelName
+   };
+
    //////////////////////////////////////////////////////////////////////////////
    // Notification constants
    //
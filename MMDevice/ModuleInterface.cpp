@@ -58,6 +58,9 @@ public:
 // Registered devices in this module (device adapter library)
 static std::vector<DeviceInfo> g_registeredDevices;
 
+// Set by DeclarePerDeviceThreadSafety()
+static bool g_perDeviceThreadSafety = false;
+
 
 MODULE_API long GetModuleVersion()
 {
@@ -119,6 +122,11 @@ MODULE_API bool GetDeviceDescription(const char* deviceName, char* description,
    return true;
 }
 
+MODULE_API bool GetPerDeviceThreadSafety()
+{
+   return g_perDeviceThreadSafety;
+}
+
 void RegisterDevice(const char* deviceName, MM::DeviceType deviceType, const char* deviceDescription)
 {
    if (!deviceName)
@@ -135,3 +143,8 @@ void RegisterDevice(const char* deviceName, MM::DeviceType deviceType, const cha
 
    g_registeredDevices.push_back(DeviceInfo(deviceName, deviceType, deviceDescription));
 }
+
+void DeclarePerDeviceThreadSafety()
+{
+   g_perDeviceThreadSafety = true;
+}
@@ -49,7 +49,7 @@
 // If any of the exported module API calls (below) changes, the interface
 // version must be incremented. Note that the signature and name of
 // GetModuleVersion() must never change.
-#define MODULE_INTERFACE_VERSION 10
+#define MODULE_INTERFACE_VERSION 11
 
 
 /*
@@ -104,6 +104,7 @@ extern "C" {
    MODULE_API bool GetDeviceName(unsigned deviceIndex, char* name, unsigned bufferLength);
    MODULE_API bool GetDeviceType(const char* deviceName, int* type);
    MODULE_API bool GetDeviceDescription(const char* deviceName, char* name, unsigned bufferLength);
+   MODULE_API bool GetPerDeviceThreadSafety();
 
    // Function pointer types for module interface functions
    // (Not for use by device adapters)
@@ -117,6 +118,7 @@ extern "C" {
    typedef bool (*fnGetDeviceName)(unsigned, char*, unsigned);
    typedef bool (*fnGetDeviceType)(const char*, int*);
    typedef bool (*fnGetDeviceDescription)(const char*, char*, unsigned);
+   typedef bool (*fnGetPerDeviceThreadSafety)();
 #endif
 }
 
@@ -137,5 +139,23 @@ extern "C" {
  */
 void RegisterDevice(const char* deviceName, MM::DeviceType deviceType, const char* description);
 
+/// Declare that the devices of this module may be called concurrently.
+/**
+ * May be called in the device adapter module's implementation of
+ * InitializeModuleData().
+ *
+ * By default, the Core serializes all calls into the devices of a module with
+ * a single lock. Calling this function indicates that each device only needs
+ * its own calls to be serialized, because the devices do not share state
+ * without synchronizing it themselves. The Core then locks each device
+ * separately, so that a slow call to one device does not hold up the others.
+ *
+ * Only call this if it is known to be safe for every device of the module,
+ * including hubs and their peripherals.
+ *
+ * \see InitializeModuleData()
+ */
+void DeclarePerDeviceThreadSafety();
+
 
 #endif //_MODULE_INTERFACE_H_
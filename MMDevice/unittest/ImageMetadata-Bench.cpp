@@ -0,0 +1,90 @@
+// Per-frame cost of the image metadata container, following what the Core
+// does for each inserted image: copy the camera's metadata, merge in the
+// system state, add the standard tags, copy the result into the buffer,
+// look up a few tags when the image is read and (for remote clients)
+// serialize and restore it.
+//
+// Usage: ImageMetadata-Bench [frameCount [systemTagCount]]
+//
+// Not run by "make check"; build with "make ImageMetadata-Bench".
+
+#include "ImageMetadata.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+
+namespace {
+
+template <class Func>
+double NsPerFrame(long frameCount, Func func)
+{
+   auto start = std::chrono::steady_clock::now();
+   for (long i = 0; i < frameCount; ++i)
+      func(i);
+   auto end = std::chrono::steady_clock::now();
+   return std::chrono::duration<double, std::nano>(end - start).count() /
+      frameCount;
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+   long frameCount = argc > 1 ? std::atol(argv[1]) : 200000;
+   int systemTagCount = argc > 2 ? std::atoi(argv[2]) : 40;
+
+   Metadata cameraMd;
+   cameraMd.PutImageTag("ElapsedTime-ms", 12.5);
+   cameraMd.PutTag("ROI-X-start", "Camera", 0);
+   cameraMd.PutTag("ROI-Y-start", "Camera", 0);
+   cameraMd.PutTag("Binning", "Camera", 1);
+
+   // Cached system state, as merged into each image by the Core
+   Metadata systemMd;
+   for (int i = 0; i < systemTagCount; ++i)
+   {
+      char device[32];
+      std::snprintf(device, sizeof(device), "Device%d", i % 8);
+      systemMd.PutTag("Property" + std::to_string(i), device, i * 1.5);
+   }
+
+   volatile size_t sink = 0;
+
+   double perFrame = NsPerFrame(frameCount, [&](long i) {
+      Metadata md(cameraMd);
+      md.Merge(systemMd);
+      md.PutImageTag("Camera", "Camera");
+      md.PutImageTag("Width", 512);
+      md.PutImageTag("Height", 512);
+      md.PutImageTag("Bytes", 1);
+      md.PutImageTag("PixelType", "GRAY8");
+      md.PutImageTag("ImageNumber", i);
+      Metadata stored(md);
+      sink += stored.GetSingleTag("ImageNumber").GetValue().size();
+      sink += stored.HasTag("Camera-Binning");
+   });
+
+   Metadata frameMd(cameraMd);
+   frameMd.Merge(systemMd);
+   const std::string serialized = frameMd.Serialize();
+
+   double serialize = NsPerFrame(frameCount, [&](long) {
+      sink += frameMd.Serialize().size();
+   });
+
+   double restore = NsPerFrame(frameCount, [&](long) {
+      Metadata md;
+      md.Restore(serialized.c_str());
+      sink += md.GetKeys().size();
+   });
+
+   std::printf("%ld frames, %d system state tags; ns per frame\n",
+         frameCount, systemTagCount);
+   std::printf("%-12s %10.0f\n", "insert path", perFrame);
+   std::printf("%-12s %10.0f\n", "serialize", serialize);
+   std::printf("%-12s %10.0f\n", "restore", restore);
+   return sink == 0;
+}
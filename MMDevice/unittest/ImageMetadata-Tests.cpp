@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+
+#include "ImageMetadata.h"
+
+
+TEST(ImageMetadataTests, PutTagOverwrites)
+{
+    Metadata md;
+    md.PutTag("Exposure", "Camera", 10);
+    md.PutTag("Exposure", "Camera", 20.5);
+    md.PutImageTag("ImageNumber", 3L);
+
+    ASSERT_EQ(2u, md.GetKeys().size());
+    ASSERT_EQ("20.5", md.GetSingleTag("Camera-Exposure").GetValue());
+    ASSERT_EQ("Exposure", md.GetSingleTag("Camera-Exposure").GetName());
+    ASSERT_EQ("Camera", md.GetSingleTag("Camera-Exposure").GetDevice());
+    ASSERT_EQ("3", md.GetSingleTag("ImageNumber").GetValue());
+}
+
+
+TEST(ImageMetadataTests, KeysAreSorted)
+{
+    Metadata md;
+    md.PutImageTag("b", "2");
+    md.PutImageTag("c", std::string("3"));
+    md.PutImageTag("a", 'x');
+
+    std::vector<std::string> keys = md.GetKeys();
+    ASSERT_EQ(3u, keys.size());
+    ASSERT_EQ("a", keys[0]);
+    ASSERT_EQ("b", keys[1]);
+    ASSERT_EQ("c", keys[2]);
+    ASSERT_EQ("x", md.GetSingleTag("a").GetValue());
+}
+
+
+TEST(ImageMetadataTests, MissingOrMismatchedKeyThrows)
+{
+    Metadata md;
+    md.PutImageTag("single", 1);
+    MetadataArrayTag array("array", "Dev", false);
+    array.AddValue("1");
+    md.SetTag(array);
+
+    ASSERT_FALSE(md.HasTag("missing"));
+    ASSERT_THROW(md.GetSingleTag("missing"), MetadataKeyError);
+    ASSERT_THROW(md.GetSingleTag("Dev-array"), MetadataKeyError);
+    ASSERT_THROW(md.GetArrayTag("single"), MetadataKeyError);
+
+    md.RemoveTag("single");
+    ASSERT_FALSE(md.HasTag("single"));
+    ASSERT_TRUE(md.HasTag("Dev-array"));
+}
+
+
+TEST(ImageMetadataTests, MergeReplacesExistingTags)
+{
+    Metadata md;
+    md.PutTag("Binning", "Camera", 1);
+    md.PutTag("Position", "Stage", 0.0);
+
+    Metadata newTags;
+    newTags.PutTag("Binning", "Camera", 2);
+    newTags.PutImageTag("Width", 512);
+    md.Merge(newTags);
+
+    ASSERT_EQ(3u, md.GetKeys().size());
+    ASSERT_EQ("2", md.GetSingleTag("Camera-Binning").GetValue());
+    ASSERT_EQ("0", md.GetSingleTag("Stage-Position").GetValue());
+    ASSERT_EQ("512", md.GetSingleTag("Width").GetValue());
+}
+
+
+TEST(ImageMetadataTests, SerializeRoundTrip)
+{
+    Metadata md;
+    md.PutTag("Exposure", "Camera", 12.25);
+    md.PutImageTag("Empty", "");
+    MetadataSingleTag writable("Gain", "Camera", false);
+    writable.SetValue("4");
+    md.SetTag(writable);
+    MetadataArrayTag array("Channels", "Camera", true);
+    array.AddValue("Red");
+    array.AddValue("Green");
+    md.SetTag(array);
+
+    const std::string serialized = md.Serialize();
+    ASSERT_EQ("4\n"
+          "a\nChannels\nCamera\n1\n2\nRed\nGreen\n"
+          "s\nExposure\nCamera\n1\n12.25\n"
+          "s\nGain\nCamera\n0\n4\n"
+          "s\nEmpty\n_\n1\n\n", serialized);
+
+    Metadata restored;
+    restored.PutImageTag("Stale", 1);
+    ASSERT_TRUE(restored.Restore(serialized.c_str()));
+    ASSERT_EQ(serialized, restored.Serialize());
+    ASSERT_FALSE(restored.GetSingleTag("Camera-Gain").IsReadOnly());
+    MetadataArrayTag restoredArray = restored.GetArrayTag("Camera-Channels");
+    ASSERT_EQ(2u, restoredArray.GetSize());
+    ASSERT_EQ("Green", restoredArray.GetValue(1));
+
+    ASSERT_FALSE(restored.Restore("1\nx\n"));
+}
+
+
+TEST(ImageMetadataTests, CopyAndMove)
+{
+    Metadata md;
+    md.PutImageTag("a", 1);
+
+    Metadata copy(md);
+    copy.PutImageTag("b", 2);
+    ASSERT_EQ(1u, md.GetKeys().size());
+    ASSERT_EQ(2u, copy.GetKeys().size());
+
+    Metadata moved(std::move(copy));
+    ASSERT_EQ(2u, moved.GetKeys().size());
+
+    md = moved;
+    ASSERT_EQ("2", md.GetSingleTag("b").GetValue());
+}
+
+int main(int argc, char **argv)
+{
+   ::testing::InitGoogleTest(&argc, argv);
+   return RUN_ALL_TESTS();
+}